@@ -26,6 +26,7 @@
 
 #include "klm_matrix.h"
 #include "klm_segment.h"
+#include "klm_alloc.h"
 
 
 /** Switch a matrix pixel on */
@@ -65,19 +66,39 @@ void klm_mat_scan(klm_matrix * const matrix) {
     sleep(1);
 }
 
+/** Drive the matrix display for a single row */
+void klm_mat_scan_row(klm_matrix * const matrix) {
+    if (!matrix->on) return;
+
+    matrix->scan_row = (matrix->scan_row + 1) % matrix->config->height;
+}
+
 void klm_mat_init_hardware(klm_matrix * const matrix) {
     return;
 }
 
+void klm_mat_destroy_hardware(klm_matrix * const matrix) {
+    return;
+}
+
 void klm_mat_init_display_buffer(klm_matrix * const matrix) {
     matrix->display_buffer0 =
-        calloc(KLM_BUFFER_LEN(matrix->config->height, matrix->config->width),
+        klm_calloc(KLM_BUFFER_LEN(matrix->config->height, matrix->config->width),
                sizeof(*matrix->display_buffer0));
 
     matrix->display_buffer1 =
-        calloc(KLM_BUFFER_LEN(matrix->config->height, matrix->config->width),
+        klm_calloc(KLM_BUFFER_LEN(matrix->config->height, matrix->config->width),
                sizeof(*matrix->display_buffer1));
 
     klm_mat_clear(matrix);
 }
 
+void klm_mat_init_wire_format(klm_matrix * const matrix) {
+    // The dummy display takes the buffer as-is
+    matrix->wire_format.invert = false;
+    matrix->wire_format.reverse_bytes = false;
+    matrix->wire_format.reverse_bits = false;
+    matrix->wire_format.reverse_rows = false;
+    matrix->wire_format.interleave = 1;
+}
+
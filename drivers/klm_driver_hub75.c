@@ -0,0 +1,224 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <unistd.h>
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_alloc.h"
+
+#ifndef KLM_NON_GPIO_MACHINE
+static void _klm_mat_scan_address(klm_matrix * const matrix, uint16_t address);
+static inline void _klm_mat_shift_out(klm_matrix * const matrix, const uint8_t *wire, size_t len);
+static inline void _klm_mat_latch_row(klm_matrix * const matrix, uint16_t address);
+#endif
+
+/** Switch a matrix pixel on */
+void klm_mat_set_pixel(klm_matrix * const matrix, int16_t x, int16_t y) {
+    size_t p = KLM_BUF_OFFSET(matrix, x, y);
+    bitWrite(matrix->display_buffer0[p], x % KLM_BYTE_WIDTH, KLM_ON);
+}
+
+/** Switch a matrix pixel off */
+void klm_mat_clear_pixel(klm_matrix * const matrix, int16_t x, int16_t y) {
+    size_t p = KLM_BUF_OFFSET(matrix, x, y);
+    bitWrite(matrix->display_buffer0[p], x % KLM_BYTE_WIDTH, KLM_OFF);
+}
+
+/** Switch a matrix pixel off */
+void klm_mat_mask_pixel(klm_matrix * const matrix, int16_t x, int16_t y, bool reverse) {
+    size_t p = KLM_BUF_OFFSET(matrix, x, y);
+    bitWrite(matrix->display_buffer0[p], x % KLM_BYTE_WIDTH,
+            bitRead(matrix->display_buffer0[p], x % KLM_BYTE_WIDTH) ^ reverse);
+}
+
+/** Query whether or not the given pixel has been set */
+bool klm_mat_is_pixel_set(klm_matrix * const matrix, int16_t x, int16_t y) {
+    size_t p = KLM_BUF_OFFSET(matrix, x, y);
+    if (bitRead(matrix->display_buffer1[p], x % KLM_BYTE_WIDTH) == KLM_ON) {
+        return true;
+    }
+    return false;
+}
+
+/** Drive the matrix display */
+void klm_mat_scan(klm_matrix * const matrix) {
+    if (!matrix->on) return;
+#ifdef KLM_GPIOD
+    if (matrix->gpiod == NULL) return;
+#endif
+
+#ifndef KLM_NON_GPIO_MACHINE
+    uint16_t addresses = matrix->bitplanes->address_count;
+    for (matrix->scan_row=0; matrix->scan_row<addresses; matrix->scan_row++) {
+        _klm_mat_scan_address(matrix, matrix->scan_row);
+    }
+    matrix->scan_row = 0;
+#endif
+}
+
+/** Drive the matrix display for a single row address, with all of its bitplanes */
+void klm_mat_scan_row(klm_matrix * const matrix) {
+    if (!matrix->on) return;
+#ifdef KLM_GPIOD
+    if (matrix->gpiod == NULL) return;
+#endif
+
+#ifndef KLM_NON_GPIO_MACHINE
+    _klm_mat_scan_address(matrix, matrix->scan_row);
+    matrix->scan_row = (matrix->scan_row + 1) % matrix->bitplanes->address_count;
+#endif
+}
+
+void klm_mat_init_hardware(klm_matrix * const matrix) {
+#if defined(KLM_GPIOD)
+    // Request all the control lines, including the colour lines, as one set
+    const char *chip = matrix->config->gpio_chip ?
+                            matrix->config->gpio_chip : KLM_GPIOD_DEFAULT_CHIP;
+    matrix->gpiod = klm_gpiod_create(chip, matrix->config, true);
+    if (matrix->gpiod == NULL) {
+        KLM_LOG(matrix, "Could not request GPIO lines from %s\n", chip);
+    }
+    else if (matrix->gpiod->num_lines < KLM_GPIOD_NUM_RGB_LINES) {
+        KLM_LOG(matrix, "No colour data pins configured\n");
+    }
+#elif !defined(KLM_NON_GPIO_MACHINE)
+    // Initilize pin modes
+    pinMode(klm_config_get_pin(matrix->config, 'a'), OUTPUT);
+    pinMode(klm_config_get_pin(matrix->config, 'b'), OUTPUT);
+    pinMode(klm_config_get_pin(matrix->config, 'c'), OUTPUT);
+    pinMode(klm_config_get_pin(matrix->config, 'd'), OUTPUT);
+    pinMode(klm_config_get_pin(matrix->config, 'o'), OUTPUT);
+    pinMode(klm_config_get_pin(matrix->config, 's'), OUTPUT);
+    pinMode(klm_config_get_pin(matrix->config, 'x'), OUTPUT);
+    pinMode(klm_config_get_pin(matrix->config, KLM_PIN_R1), OUTPUT);
+    pinMode(klm_config_get_pin(matrix->config, KLM_PIN_G1), OUTPUT);
+    pinMode(klm_config_get_pin(matrix->config, KLM_PIN_B1), OUTPUT);
+    pinMode(klm_config_get_pin(matrix->config, KLM_PIN_R2), OUTPUT);
+    pinMode(klm_config_get_pin(matrix->config, KLM_PIN_G2), OUTPUT);
+    pinMode(klm_config_get_pin(matrix->config, KLM_PIN_B2), OUTPUT);
+#endif
+}
+
+void klm_mat_destroy_hardware(klm_matrix * const matrix) {
+    return;
+}
+
+void klm_mat_init_display_buffer(klm_matrix * const matrix) {
+    matrix->display_buffer0 =
+        klm_calloc(KLM_BUFFER_LEN(matrix->config->height, matrix->config->width),
+               sizeof(*matrix->display_buffer0));
+
+    matrix->display_buffer1 =
+        klm_calloc(KLM_BUFFER_LEN(matrix->config->height, matrix->config->width),
+               sizeof(*matrix->display_buffer1));
+
+    klm_mat_clear(matrix);
+}
+
+void klm_mat_init_wire_format(klm_matrix * const matrix) {
+    // Each row address drives a row in the top half and one in the bottom half,
+    // and the panel's LEDs are active high, chained from the left hand end
+    matrix->wire_format.invert = false;
+    matrix->wire_format.reverse_bytes = false;
+    matrix->wire_format.reverse_bits = false;
+    matrix->wire_format.reverse_rows = false;
+    matrix->wire_format.interleave = 2;
+
+    // Frames are encoded into colour bitplanes rather than the mono wire buffer
+    matrix->bitplanes =
+        klm_bitplanes_create(matrix->config->width,
+                             matrix->config->height,
+                             KLM_BITPLANES_DEFAULT_DEPTH);
+}
+
+#ifndef KLM_NON_GPIO_MACHINE
+/**
+ * Show each bitplane of the given row address in turn, for binary weighted
+ * times, shifting out the next plane while the current one is displayed.
+ */
+static void _klm_mat_scan_address(klm_matrix * const matrix, uint16_t address) {
+    klm_bitplanes * const bitplanes = matrix->bitplanes;
+
+    uint8_t plane;
+    for (plane=0; plane<bitplanes->depth; plane++) {
+        _klm_mat_shift_out(matrix,
+                           klm_bitplanes_get_row(bitplanes, plane, address),
+                           bitplanes->width);
+
+        // Latch when the previous plane's time is up, this one then stays on for 2^plane periods
+        klm_pacer_wait_periods(matrix->pacer, 1 << plane);
+        _klm_mat_latch_row(matrix, address);
+    }
+}
+
+/** Clock out one row of a bitplane, each byte setting all six colour lines */
+static inline void _klm_mat_shift_out(klm_matrix * const matrix, const uint8_t *wire, size_t len) {
+#if defined(KLM_GPIOD)
+    klm_gpiod_shift_out_rgb(matrix->gpiod, wire, len);
+#else
+    const uint8_t clk = klm_config_get_pin(matrix->config, 'x');
+    const uint8_t pins[6] = {
+        klm_config_get_pin(matrix->config, KLM_PIN_R1),
+        klm_config_get_pin(matrix->config, KLM_PIN_G1),
+        klm_config_get_pin(matrix->config, KLM_PIN_B1),
+        klm_config_get_pin(matrix->config, KLM_PIN_R2),
+        klm_config_get_pin(matrix->config, KLM_PIN_G2),
+        klm_config_get_pin(matrix->config, KLM_PIN_B2)
+    };
+
+    size_t i;
+    uint8_t bit;
+    for (i=0; i<len; i++) {
+        for (bit=0; bit<6; bit++) {
+            digitalWrite(pins[bit], (wire[i] >> bit) & 0x01);
+        }
+        digitalWrite(clk, HIGH);
+        digitalWrite(clk, LOW);
+    }
+#endif
+}
+
+/** Latch the shifted data onto the given row address */
+static inline void _klm_mat_latch_row(klm_matrix * const matrix, uint16_t address) {
+#if defined(KLM_GPIOD)
+    klm_gpiod_latch_row(matrix->gpiod, address);
+#else
+    // Disable display
+    digitalWrite(klm_config_get_pin(matrix->config, 'o'), HIGH);
+
+    // Select row
+    digitalWrite(klm_config_get_pin(matrix->config, 'a'), (address & 0x01));
+    digitalWrite(klm_config_get_pin(matrix->config, 'b'), (address & 0x02));
+    digitalWrite(klm_config_get_pin(matrix->config, 'c'), (address & 0x04));
+    digitalWrite(klm_config_get_pin(matrix->config, 'd'), (address & 0x08));
+
+    // Latch data
+    digitalWrite(klm_config_get_pin(matrix->config, 's'), HIGH);
+    digitalWrite(klm_config_get_pin(matrix->config, 's'), LOW);
+
+    // Enable display
+    digitalWrite(klm_config_get_pin(matrix->config, 'o'), LOW);
+#endif
+}
+#endif
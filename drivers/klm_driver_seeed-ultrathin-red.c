@@ -25,9 +25,12 @@
 #include <unistd.h>
 #include "klm_matrix.h"
 #include "klm_segment.h"
+#include "klm_alloc.h"
 
-#define SCAN_LOOP_DELAY_MICROS 400
-
+#ifndef KLM_NON_GPIO_MACHINE
+static inline void _klm_mat_shift_out(klm_matrix * const matrix, const uint8_t *wire, size_t len);
+static inline void _klm_mat_latch_row(klm_matrix * const matrix, uint16_t address);
+#endif
 
 /** Switch a matrix pixel on */
 void klm_mat_set_pixel(klm_matrix * const matrix, int16_t x, int16_t y) {
@@ -60,83 +63,173 @@ bool klm_mat_is_pixel_set(klm_matrix * const matrix, int16_t x, int16_t y) {
 /** Drive the matrix display */
 void klm_mat_scan(klm_matrix * const matrix) {
     if (!matrix->on) return;
+#ifdef KLM_GPIOD
+    if (matrix->gpiod == NULL) return;
+#endif
 
 #ifndef KLM_NON_GPIO_MACHINE
     matrix->scan_row = 0;
-    uint16_t loop_limit = matrix->config->height;
+    uint16_t loop_limit =
+        klm_wire_get_address_count(&matrix->wire_format,
+                                   matrix->config->width, matrix->config->height);
     uint16_t mod_limit = loop_limit + 1;
+    size_t stride =
+        klm_wire_get_address_stride(&matrix->wire_format,
+                                    matrix->config->width, matrix->config->height);
 
     while (matrix->scan_row < loop_limit) {
-        // Process each 8-pixel byte in the row
-        uint8_t offset = KLM_ROW_OFFSET(matrix, matrix->scan_row);
-
-        // Process the row in reverse order
-        int16_t x8;
-        for (x8=matrix->_row_width-1; x8>=0; x8--) {
-            uint8_t pixel8 = matrix->display_buffer1[offset + x8];
-
-            // Flip all bits
-            pixel8 ^= 0xFF;
-
-            // Write each pixel in the byte, in reverse order
-            shiftOut(klm_config_get_pin(matrix->config, 'r'),
-                     klm_config_get_pin(matrix->config, 'x'),
-                     MSBFIRST,
-                     pixel8);
-        }
+        // The wire buffer already holds the bytes for this row address in send order
+        const uint8_t *wire = matrix->wire_buffer + matrix->scan_row*stride;
 
-        // Disable display
-        digitalWrite(klm_config_get_pin(matrix->config, 'o'), HIGH);
+        _klm_mat_shift_out(matrix, wire, stride);
 
-        // Display the rows in reverse order
-        uint16_t display_row = (matrix->config->height - 1 - matrix->scan_row);
-
-        // Select row
-        digitalWrite(klm_config_get_pin(matrix->config, 'a'), (display_row & 0x01));
-        digitalWrite(klm_config_get_pin(matrix->config, 'b'), (display_row & 0x02));
-        digitalWrite(klm_config_get_pin(matrix->config, 'c'), (display_row & 0x04));
-        digitalWrite(klm_config_get_pin(matrix->config, 'd'), (display_row & 0x08));
-
-        // Latch data
-        digitalWrite(klm_config_get_pin(matrix->config, 's'), LOW);
-        digitalWrite(klm_config_get_pin(matrix->config, 's'), HIGH);
-        digitalWrite(klm_config_get_pin(matrix->config, 's'), LOW);
-
-        // Enable display
-        digitalWrite(klm_config_get_pin(matrix->config, 'o'), LOW);
+        // Latch on the row's deadline, so every row gets the same on-time
+        // however long the shift-out took
+        klm_pacer_wait_row(matrix->pacer);
+        _klm_mat_latch_row(matrix, matrix->scan_row);
 
         // Next row, wrap around at the bottom
         matrix->scan_row = (matrix->scan_row + 1) % mod_limit;
+    }
+#endif
+}
 
-        // Avoid a tight loop using all the CPU
-        usleep(SCAN_LOOP_DELAY_MICROS);
+/** Drive the matrix display for a single row */
+void klm_mat_scan_row(klm_matrix * const matrix) {
+    if (!matrix->on) return;
+#ifdef KLM_GPIOD
+    if (matrix->gpiod == NULL) return;
+#endif
+
+#ifndef KLM_NON_GPIO_MACHINE
+    uint16_t addresses =
+        klm_wire_get_address_count(&matrix->wire_format,
+                                   matrix->config->width, matrix->config->height);
+    size_t stride =
+        klm_wire_get_address_stride(&matrix->wire_format,
+                                    matrix->config->width, matrix->config->height);
+
+    // Latch the row which was shifted out on the previous call, so that the
+    // latch happens as close to the timer expiry as possible...
+    if (matrix->scan_row >= addresses) {
+        matrix->scan_row = 0;
     }
+    _klm_mat_latch_row(matrix, matrix->scan_row);
+
+    // ...then get the next row ready while this one is displayed
+    matrix->scan_row = (matrix->scan_row + 1) % addresses;
+    _klm_mat_shift_out(matrix,
+                       matrix->wire_buffer + matrix->scan_row*stride,
+                       stride);
 #endif
 }
 
 void klm_mat_init_hardware(klm_matrix * const matrix) {
-#ifndef KLM_NON_GPIO_MACHINE
+    // Pixel data goes out over SPI if a device is configured
+    if (matrix->config->spi_device) {
+        matrix->spidev = klm_spidev_create(matrix->config->spi_device,
+                                           matrix->config->spi_speed_hz);
+        if (matrix->spidev == NULL) {
+            KLM_LOG(matrix, "Could not open %s, falling back to bit-banging\n",
+                    matrix->config->spi_device);
+        }
+    }
+
+#if defined(KLM_GPIOD)
+    // Request the control lines as one set, leaving data/clock to SPI if it's driving them
+    const char *chip = matrix->config->gpio_chip ?
+                            matrix->config->gpio_chip : KLM_GPIOD_DEFAULT_CHIP;
+    matrix->gpiod = klm_gpiod_create(chip, matrix->config, matrix->spidev == NULL);
+    if (matrix->gpiod == NULL) {
+        KLM_LOG(matrix, "Could not request GPIO lines from %s\n", chip);
+    }
+#elif !defined(KLM_NON_GPIO_MACHINE)
     // Initilize pin modes
     pinMode(klm_config_get_pin(matrix->config, 'a'), OUTPUT);
     pinMode(klm_config_get_pin(matrix->config, 'b'), OUTPUT);
     pinMode(klm_config_get_pin(matrix->config, 'c'), OUTPUT);
     pinMode(klm_config_get_pin(matrix->config, 'd'), OUTPUT);
     pinMode(klm_config_get_pin(matrix->config, 'o'), OUTPUT);
-    pinMode(klm_config_get_pin(matrix->config, 'r'), OUTPUT);
-    pinMode(klm_config_get_pin(matrix->config, 'x'), OUTPUT);
     pinMode(klm_config_get_pin(matrix->config, 's'), OUTPUT);
+
+    // Leave the SPI pins alone if the SPI controller is driving data/clock
+    if (matrix->spidev == NULL) {
+        pinMode(klm_config_get_pin(matrix->config, 'r'), OUTPUT);
+        pinMode(klm_config_get_pin(matrix->config, 'x'), OUTPUT);
+    }
 #endif
 }
 
+void klm_mat_destroy_hardware(klm_matrix * const matrix) {
+    return;
+}
+
 void klm_mat_init_display_buffer(klm_matrix * const matrix) {
     matrix->display_buffer0 =
-        calloc(KLM_BUFFER_LEN(matrix->config->height, matrix->config->width),
+        klm_calloc(KLM_BUFFER_LEN(matrix->config->height, matrix->config->width),
                sizeof(*matrix->display_buffer0));
 
     matrix->display_buffer1 =
-        calloc(KLM_BUFFER_LEN(matrix->config->height, matrix->config->width),
+        klm_calloc(KLM_BUFFER_LEN(matrix->config->height, matrix->config->width),
                sizeof(*matrix->display_buffer1));
 
     klm_mat_clear(matrix);
 }
 
+void klm_mat_init_wire_format(klm_matrix * const matrix) {
+    // The panel's LEDs are active low, and the shift registers are chained
+    // from the right hand end, with the rows addressed from the bottom up
+    matrix->wire_format.invert = true;
+    matrix->wire_format.reverse_bytes = true;
+    matrix->wire_format.reverse_bits = false;
+    matrix->wire_format.reverse_rows = true;
+    matrix->wire_format.interleave = 1;
+}
+
+#ifndef KLM_NON_GPIO_MACHINE
+/** Send one row address' worth of wire data to the panel */
+static inline void _klm_mat_shift_out(klm_matrix * const matrix, const uint8_t *wire, size_t len) {
+    if (matrix->spidev) {
+        // Send the whole row in one transfer
+        klm_spidev_transfer(matrix->spidev, wire, len);
+        return;
+    }
+
+#if defined(KLM_GPIOD)
+    klm_gpiod_shift_out(matrix->gpiod, wire, len);
+#else
+    size_t i;
+    for (i=0; i<len; i++) {
+        shiftOut(klm_config_get_pin(matrix->config, 'r'),
+                 klm_config_get_pin(matrix->config, 'x'),
+                 MSBFIRST,
+                 wire[i]);
+    }
+#endif
+}
+
+/** Latch the shifted data onto the given row address */
+static inline void _klm_mat_latch_row(klm_matrix * const matrix, uint16_t address) {
+#if defined(KLM_GPIOD)
+    klm_gpiod_latch_row(matrix->gpiod, address);
+#else
+    // Disable display
+    digitalWrite(klm_config_get_pin(matrix->config, 'o'), HIGH);
+
+    // Select row
+    digitalWrite(klm_config_get_pin(matrix->config, 'a'), (address & 0x01));
+    digitalWrite(klm_config_get_pin(matrix->config, 'b'), (address & 0x02));
+    digitalWrite(klm_config_get_pin(matrix->config, 'c'), (address & 0x04));
+    digitalWrite(klm_config_get_pin(matrix->config, 'd'), (address & 0x08));
+
+    // Latch data
+    digitalWrite(klm_config_get_pin(matrix->config, 's'), LOW);
+    digitalWrite(klm_config_get_pin(matrix->config, 's'), HIGH);
+    digitalWrite(klm_config_get_pin(matrix->config, 's'), LOW);
+
+    // Enable display
+    digitalWrite(klm_config_get_pin(matrix->config, 'o'), LOW);
+#endif
+}
+#endif
+
@@ -0,0 +1,272 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_alloc.h"
+
+/**
+ * Preview the matrix in a terminal.
+ *
+ * Each character cell shows two rows of pixels using the Unicode half
+ * block characters. Only cells which differ from the last frame drawn are
+ * written, as one write per frame, so it keeps up with the real refresh
+ * rate even over SSH.
+ */
+
+#define KLM_TERMINAL_FD STDOUT_FILENO
+
+// Longest cursor movement: ESC [ row ; col H
+#define KLM_TERMINAL_MOVE_LEN 16
+
+// Longest cell: a three byte UTF-8 block character
+#define KLM_TERMINAL_CELL_LEN 3
+
+#define KLM_TERMINAL_INIT "\x1b[2J\x1b[?25l\x1b[31m"
+#define KLM_TERMINAL_RESET "\x1b[0m\x1b[?25h"
+
+// Driver state, hung off the matrix
+typedef struct __klm_terminal_t {
+    // The frame currently on the terminal
+    uint8_t *shown;
+
+    // Escape sequences for one frame
+    char *out;
+
+    // Draw every cell next time, e.g. the first frame
+    bool full_redraw;
+
+} __klm_terminal_t;
+
+static void _klm_mat_terminal_draw(klm_matrix * const matrix);
+static char * _klm_mat_terminal_cell(char *p, bool top, bool bottom);
+
+
+/** Switch a matrix pixel on */
+void klm_mat_set_pixel(klm_matrix * const matrix, int16_t x, int16_t y) {
+    size_t p = KLM_BUF_OFFSET(matrix, x, y);
+    bitWrite(matrix->display_buffer0[p], x % KLM_BYTE_WIDTH, KLM_ON);
+}
+
+/** Switch a matrix pixel off */
+void klm_mat_clear_pixel(klm_matrix * const matrix, int16_t x, int16_t y) {
+    size_t p = KLM_BUF_OFFSET(matrix, x, y);
+    bitWrite(matrix->display_buffer0[p], x % KLM_BYTE_WIDTH, KLM_OFF);
+}
+
+/** Switch a matrix pixel off */
+void klm_mat_mask_pixel(klm_matrix * const matrix, int16_t x, int16_t y, bool mask) {
+    size_t p = KLM_BUF_OFFSET(matrix, x, y);
+    bitWrite(matrix->display_buffer0[p], x % KLM_BYTE_WIDTH,
+            bitRead(matrix->display_buffer0[p], x % KLM_BYTE_WIDTH) ^ mask);
+}
+
+/** Query whether or not the given pixel has been set */
+bool klm_mat_is_pixel_set(klm_matrix * const matrix, int16_t x, int16_t y) {
+    size_t p = KLM_BUF_OFFSET(matrix, x, y);
+    if (bitRead(matrix->display_buffer1[p], x % KLM_BYTE_WIDTH) == KLM_ON) {
+        return true;
+    }
+    return false;
+}
+
+/** Drive the matrix display */
+void klm_mat_scan(klm_matrix * const matrix) {
+    if (!matrix->on) return;
+
+    // Like the dummy driver the scan also drives the animation,
+    // but at the real tick rate so that scroll speeds are true
+    KLM_NOW_MICROSECS(matrix->micros_1, matrix->now_t);
+    if (matrix->micros_1 - matrix->micros_0 >= KLM_TICK_PERIOD_MICROS) {
+        klm_mat_tick(matrix);
+        matrix->micros_0 = matrix->micros_1;
+    }
+
+    _klm_mat_terminal_draw(matrix);
+
+    // Hold the frame for as long as a real panel's scan would take
+    uint16_t rows = klm_wire_get_address_count(&matrix->wire_format,
+                                               matrix->config->width, matrix->config->height);
+    uint16_t i;
+    for (i=0; i<rows; i++) {
+        klm_pacer_wait_row(matrix->pacer);
+    }
+}
+
+/** Drive the matrix display for a single row */
+void klm_mat_scan_row(klm_matrix * const matrix) {
+    if (!matrix->on) return;
+
+    // Draw the whole frame at the start of each scan
+    if (matrix->scan_row == 0) {
+        _klm_mat_terminal_draw(matrix);
+    }
+    matrix->scan_row = (matrix->scan_row + 1) % matrix->config->height;
+}
+
+void klm_mat_init_hardware(klm_matrix * const matrix) {
+    uint16_t cell_rows = (matrix->config->height + 1) / 2;
+
+    __klm_terminal_t * const terminal = klm_malloc(sizeof(__klm_terminal_t));
+    terminal->shown =
+        klm_calloc(KLM_BUFFER_LEN(matrix->config->width, matrix->config->height),
+                   sizeof(*terminal->shown));
+    terminal->out =
+        klm_malloc(sizeof(KLM_TERMINAL_RESET) +
+                   cell_rows * (KLM_TERMINAL_MOVE_LEN +
+                                matrix->config->width * (KLM_TERMINAL_MOVE_LEN + KLM_TERMINAL_CELL_LEN)));
+    terminal->full_redraw = true;
+    matrix->_driver_data = terminal;
+
+    // Clear the screen, hide the cursor and draw in red
+    if (write(KLM_TERMINAL_FD, KLM_TERMINAL_INIT, sizeof(KLM_TERMINAL_INIT) - 1) < 0) {
+        KLM_LOG(matrix, "Could not write to the terminal\n");
+    }
+}
+
+void klm_mat_destroy_hardware(klm_matrix * const matrix) {
+    __klm_terminal_t * const terminal = matrix->_driver_data;
+    if (terminal == NULL) {
+        return;
+    }
+
+    // Put the cursor back below the preview, and the terminal back how it was
+    uint16_t cell_rows = (matrix->config->height + 1) / 2;
+    int len = sprintf(terminal->out, "\x1b[%d;1H" KLM_TERMINAL_RESET, cell_rows + 1);
+    if (write(KLM_TERMINAL_FD, terminal->out, len) < 0) {
+        KLM_LOG(matrix, "Could not write to the terminal\n");
+    }
+
+    klm_free(terminal->shown);
+    klm_free(terminal->out);
+    klm_free(terminal);
+    matrix->_driver_data = NULL;
+}
+
+void klm_mat_init_display_buffer(klm_matrix * const matrix) {
+    matrix->display_buffer0 =
+        klm_calloc(KLM_BUFFER_LEN(matrix->config->height, matrix->config->width),
+               sizeof(*matrix->display_buffer0));
+
+    matrix->display_buffer1 =
+        klm_calloc(KLM_BUFFER_LEN(matrix->config->height, matrix->config->width),
+               sizeof(*matrix->display_buffer1));
+
+    klm_mat_clear(matrix);
+}
+
+void klm_mat_init_wire_format(klm_matrix * const matrix) {
+    // The terminal is drawn straight from the display buffer
+    matrix->wire_format.invert = false;
+    matrix->wire_format.reverse_bytes = false;
+    matrix->wire_format.reverse_bits = false;
+    matrix->wire_format.reverse_rows = false;
+    matrix->wire_format.interleave = 1;
+}
+
+/** Write out the cells which have changed since the last frame */
+static void _klm_mat_terminal_draw(klm_matrix * const matrix) {
+    __klm_terminal_t * const terminal = matrix->_driver_data;
+    if (terminal == NULL) {
+        return;
+    }
+
+    const uint8_t *frame = matrix->display_buffer1;
+    const uint16_t width = matrix->config->width;
+    const uint16_t height = matrix->config->height;
+    const uint16_t row_width = matrix->_row_width;
+    char *p = terminal->out;
+
+    uint16_t y, bx, bit;
+    for (y=0; y<height; y+=2) {
+        const uint8_t *top = frame + y*row_width;
+        const uint8_t *bottom = (y + 1 < height) ? top + row_width : NULL;
+        const uint8_t *shown_top = terminal->shown + y*row_width;
+        const uint8_t *shown_bottom = shown_top + row_width;
+
+        // Column the terminal's cursor is at on this line, -1 if not on it
+        int32_t cursor = -1;
+
+        for (bx=0; bx<row_width; bx++) {
+            uint8_t t = top[bx];
+            uint8_t b = bottom ? bottom[bx] : 0;
+
+            // Eight cells at a time are usually unchanged
+            uint8_t changed = (t ^ shown_top[bx]) | (bottom ? (b ^ shown_bottom[bx]) : 0);
+            if (terminal->full_redraw) {
+                changed = 0xFF;
+            }
+            if (changed == 0) {
+                continue;
+            }
+
+            for (bit=0; bit<KLM_BYTE_WIDTH; bit++) {
+                int32_t x = bx*KLM_BYTE_WIDTH + bit;
+                if (!bitRead(changed, bit) || x >= width) {
+                    continue;
+                }
+
+                // Only move the cursor if this cell doesn't follow on from the last one
+                if (cursor != x) {
+                    p += sprintf(p, "\x1b[%d;%dH", y/2 + 1, x + 1);
+                }
+                p = _klm_mat_terminal_cell(p, bitRead(t, bit), bitRead(b, bit));
+                cursor = x + 1;
+            }
+        }
+    }
+
+    if (p != terminal->out) {
+        // The whole frame in one write
+        if (write(KLM_TERMINAL_FD, terminal->out, p - terminal->out) < 0) {
+            KLM_LOG(matrix, "Could not write to the terminal\n");
+        }
+    }
+
+    memcpy(terminal->shown, frame, KLM_BUFFER_LEN(width, height));
+    terminal->full_redraw = false;
+}
+
+static char * _klm_mat_terminal_cell(char *p, bool top, bool bottom) {
+    if (top && bottom) {
+        // U+2588 FULL BLOCK
+        *p++ = '\xe2'; *p++ = '\x96'; *p++ = '\x88';
+    }
+    else if (top) {
+        // U+2580 UPPER HALF BLOCK
+        *p++ = '\xe2'; *p++ = '\x96'; *p++ = '\x80';
+    }
+    else if (bottom) {
+        // U+2584 LOWER HALF BLOCK
+        *p++ = '\xe2'; *p++ = '\x96'; *p++ = '\x84';
+    }
+    else {
+        *p++ = ' ';
+    }
+    return p;
+}
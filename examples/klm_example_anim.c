@@ -0,0 +1,274 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "klm_matrix.h"
+#include "klm_anim.h"
+#include "klm_dither.h"
+
+#define EXAMPLE_MATRIX_WIDTH 32
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_A 0
+#define EXAMPLE_B 2
+#define EXAMPLE_C 3
+#define EXAMPLE_D 1
+#define EXAMPLE_R1 4
+#define EXAMPLE_OE 21
+#define EXAMPLE_STB 22
+#define EXAMPLE_CLK 23
+
+#define EXAMPLE_DEFAULT_PATH "klm_example.klma"
+#define EXAMPLE_DEMO_FRAMES 400
+#define EXAMPLE_BUFFER_LEN KLM_BUFFER_LEN(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT)
+
+
+/** Read the next number from a PNM header, skipping whitespace and comments */
+static int example_pnm_read_int(FILE *fp) {
+    int c;
+    do {
+        c = fgetc(fp);
+        if (c == '#') {
+            while (c != '\n' && c != EOF) {
+                c = fgetc(fp);
+            }
+        }
+    } while (c != EOF && isspace(c));
+
+    int n = 0;
+    while (c != EOF && isdigit(c)) {
+        n = n*10 + (c - '0');
+        c = fgetc(fp);
+    }
+    return n;
+}
+
+/** Load a PBM, PGM or PPM image into a 1bpp frame, dithering grey and colour images */
+static bool example_load_pnm(const char *path, klm_dither * const grey, klm_dither * const rgb, uint8_t * const frame) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    char magic[2];
+    bool ok = (fread(magic, 1, 2, fp) == 2 && magic[0] == 'P');
+    int type = ok ? magic[1] - '0' : 0;
+    int width = example_pnm_read_int(fp);
+    int height = example_pnm_read_int(fp);
+    if (type == 5 || type == 6) {
+        example_pnm_read_int(fp);
+    }
+    ok = ok && width == EXAMPLE_MATRIX_WIDTH && height == EXAMPLE_MATRIX_HEIGHT;
+
+    uint8_t row[EXAMPLE_MATRIX_WIDTH * KLM_PIXEL_RGB24];
+    int y, x;
+    for (y=0; ok && y<height; y++) {
+        uint8_t * const out = frame + y*(width/KLM_BYTE_WIDTH);
+        if (type == 4) {
+            // PBM is packed most significant bit first, with 1 for black
+            ok = (fread(row, 1, width/KLM_BYTE_WIDTH, fp) == (size_t)width/KLM_BYTE_WIDTH);
+            for (x=0; x<width/KLM_BYTE_WIDTH; x++) {
+                uint8_t b = row[x], r = 0, bit;
+                for (bit=0; bit<KLM_BYTE_WIDTH; bit++) {
+                    r |= ((b >> (7 - bit)) & 0x01) << bit;
+                }
+                out[x] = r;
+            }
+        }
+        else if (type == 5) {
+            ok = (fread(row, 1, width, fp) == (size_t)width);
+            klm_dither_row(grey, row, y, out);
+        }
+        else if (type == 6) {
+            ok = (fread(row, KLM_PIXEL_RGB24, width, fp) == (size_t)width);
+            klm_dither_row(rgb, row, y, out);
+        }
+        else {
+            ok = false;
+        }
+    }
+
+    fclose(fp);
+    return ok;
+}
+
+/** Write a demo animation of a ball bouncing around the display */
+static bool example_write_demo(const char *path) {
+    klm_anim_encoder *encoder =
+        klm_anim_encoder_create(path, EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT,
+                                KLM_ANIM_DEFAULT_KEY_INTERVAL);
+    if (encoder == NULL) {
+        return false;
+    }
+
+    uint8_t frame[EXAMPLE_BUFFER_LEN];
+    int x = 3, y = 2, dx = 1, dy = 1;
+    int i, bx, by;
+    for (i=0; i<EXAMPLE_DEMO_FRAMES; i++) {
+        memset(frame, 0, sizeof(frame));
+        for (by=y-2; by<=y+2; by++) {
+            for (bx=x-2; bx<=x+2; bx++) {
+                if ((bx-x)*(bx-x) + (by-y)*(by-y) <= 5) {
+                    frame[by*(EXAMPLE_MATRIX_WIDTH/KLM_BYTE_WIDTH) + bx/KLM_BYTE_WIDTH] |=
+                        1 << (bx % KLM_BYTE_WIDTH);
+                }
+            }
+        }
+
+        // Pause for a moment on each bounce
+        bool bounce = false;
+        if (x + dx < 2 || x + dx > EXAMPLE_MATRIX_WIDTH - 3) { dx = -dx; bounce = true; }
+        if (y + dy < 2 || y + dy > EXAMPLE_MATRIX_HEIGHT - 3) { dy = -dy; bounce = true; }
+        klm_anim_encoder_add_frame(encoder, frame, 1);
+        if (bounce) {
+            klm_anim_encoder_add_frame(encoder, frame, 4);
+        }
+        x += dx;
+        y += dy;
+    }
+
+    return klm_anim_encoder_finish(encoder);
+}
+
+/**
+ * With -e, encode PBM/PGM/PPM images into an animation file:
+ *     klm_example_anim -e out.klma [-t ticks] [-k key_interval] frame...
+ *
+ * Otherwise play the given animation file, writing a demo one first if none is given.
+ */
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    int ticks = 1;
+    int key_interval = KLM_ANIM_DEFAULT_KEY_INTERVAL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "e:t:k:")) != -1) {
+        switch (opt) {
+            case 'e': out_path = optarg; break;
+            case 't': ticks = atoi(optarg); break;
+            case 'k': key_interval = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-e out.klma [-t ticks] [-k key_interval] frame...] [file.klma]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (out_path) {
+        klm_anim_encoder *encoder =
+            klm_anim_encoder_create(out_path, EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT, key_interval);
+        klm_dither *grey = klm_dither_create(EXAMPLE_MATRIX_WIDTH, KLM_PIXEL_GREY8, KLM_DITHER_DIFFUSION);
+        klm_dither *rgb = klm_dither_create(EXAMPLE_MATRIX_WIDTH, KLM_PIXEL_RGB24, KLM_DITHER_DIFFUSION);
+        if (encoder == NULL) {
+            fprintf(stderr, "Could not create %s. Aborting", out_path);
+            exit(EXIT_FAILURE);
+        }
+
+        uint8_t frame[EXAMPLE_BUFFER_LEN];
+        for (; optind<argc; optind++) {
+            if (!example_load_pnm(argv[optind], grey, rgb, frame)) {
+                fprintf(stderr, "Could not read %s as a %dx%d image. Aborting",
+                        argv[optind], EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+                exit(EXIT_FAILURE);
+            }
+            klm_anim_encoder_add_frame(encoder, frame, ticks);
+        }
+
+        klm_dither_destroy(rgb);
+        klm_dither_destroy(grey);
+        if (!klm_anim_encoder_finish(encoder)) {
+            fprintf(stderr, "Could not write %s", out_path);
+            exit(EXIT_FAILURE);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    const char *path = (optind < argc) ? argv[optind] : EXAMPLE_DEFAULT_PATH;
+    if (optind >= argc && !example_write_demo(path)) {
+        fprintf(stderr, "Could not write %s. Aborting", path);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Konker's LED Matrix library\n");
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_anim_player *example_player = klm_anim_player_open(path);
+    if (example_player == NULL) {
+        fprintf(stderr, "Could not open %s. Aborting", path);
+        exit(EXIT_FAILURE);
+    }
+    printf("%s: %u frames, %u keyframes, %u ticks in %zu bytes (%zu raw)\n",
+           path,
+           example_player->header.frame_count,
+           example_player->header.index_count,
+           example_player->header.total_ticks,
+           example_player->_map_len,
+           example_player->header.frame_count * example_player->buffer_len);
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    klm_config_set_pin(example_config, 'a', EXAMPLE_A);
+    klm_config_set_pin(example_config, 'b', EXAMPLE_B);
+    klm_config_set_pin(example_config, 'c', EXAMPLE_C);
+    klm_config_set_pin(example_config, 'd', EXAMPLE_D);
+    klm_config_set_pin(example_config, 'o', EXAMPLE_OE);
+    klm_config_set_pin(example_config, 'r', EXAMPLE_R1);
+    klm_config_set_pin(example_config, 's', EXAMPLE_STB);
+    klm_config_set_pin(example_config, 'x', EXAMPLE_CLK);
+
+    // Create a matrix, the animation plays beneath any segments
+    klm_matrix *example_matrix = klm_mat_create(stdout, example_config);
+    klm_mat_init(example_matrix, NULL, NULL);
+    if (!klm_mat_set_animation(example_matrix, example_player)) {
+        fprintf(stderr, "%s is the wrong size for the matrix. Aborting", path);
+        exit(EXIT_FAILURE);
+    }
+
+    // Call the animation driver for a while
+    int16_t j = 0;
+    for (j=0; j<10000; j++) {
+        klm_mat_scan(example_matrix);
+
+#ifdef KLM_NON_GPIO_MACHINE
+        if (example_matrix->scan_row == 0) {
+            sleep(1);
+        }
+#endif
+    }
+
+    // Clean up the matrix, then the animation
+    klm_mat_destroy(example_matrix);
+    klm_anim_player_close(example_player);
+    klm_config_destroy(example_config);
+
+    printf("Goodbye\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 32
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_A 0
+#define EXAMPLE_B 2
+#define EXAMPLE_C 3
+#define EXAMPLE_D 1
+#define EXAMPLE_R1 4
+#define EXAMPLE_OE 21
+#define EXAMPLE_STB 22
+#define EXAMPLE_CLK 23
+
+#define EXAMPLE_DEFAULT_SECONDS 5
+#define EXAMPLE_TICK_PERIOD_SCANS 10
+
+
+/**
+ * Scan the matrix for a while and report the achieved refresh rate
+ * for the configured output backend.
+ *
+ * Usage: klm_example_bench [-g gpiochip] [-s spidev] [-r refresh_hz] [-t seconds]
+ *
+ * The libgpiod backend (built with KLM_GPIOD) can be exercised on any
+ * Linux box using the kernel's gpio-sim module:
+ *
+ *   modprobe gpio-sim
+ *   mkdir -p /sys/kernel/config/gpio-sim/klm/gpio-bank0
+ *   echo 32 > /sys/kernel/config/gpio-sim/klm/gpio-bank0/num_lines
+ *   echo 1 > /sys/kernel/config/gpio-sim/klm/live
+ *   klm_example_bench -g /dev/$(cat /sys/kernel/config/gpio-sim/klm/gpio-bank0/chip_name)
+ */
+int main(int argc, char **argv) {
+    const char *gpio_chip = NULL;
+    const char *spi_device = NULL;
+    int seconds = EXAMPLE_DEFAULT_SECONDS;
+    uint32_t refresh_hz = KLM_PACER_DEFAULT_REFRESH_HZ;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "g:s:r:t:")) != -1) {
+        switch (opt) {
+            case 'g': gpio_chip = optarg; break;
+            case 's': spi_device = optarg; break;
+            case 'r': refresh_hz = atoi(optarg); break;
+            case 't': seconds = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-g gpiochip] [-s spidev] [-r refresh_hz] [-t seconds]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("Konker's LED Matrix library: scan benchmark\n");
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    klm_config_set_pin(example_config, 'a', EXAMPLE_A);
+    klm_config_set_pin(example_config, 'b', EXAMPLE_B);
+    klm_config_set_pin(example_config, 'c', EXAMPLE_C);
+    klm_config_set_pin(example_config, 'd', EXAMPLE_D);
+    klm_config_set_pin(example_config, 'o', EXAMPLE_OE);
+    klm_config_set_pin(example_config, 'r', EXAMPLE_R1);
+    klm_config_set_pin(example_config, 's', EXAMPLE_STB);
+    klm_config_set_pin(example_config, 'x', EXAMPLE_CLK);
+    klm_config_set_gpio_chip(example_config, gpio_chip);
+    if (spi_device) {
+        klm_config_set_spi_device(example_config, spi_device, KLM_SPIDEV_DEFAULT_SPEED_HZ);
+    }
+
+    // Create a matrix
+    klm_matrix *example_matrix = klm_mat_create(stdout, example_config);
+
+    // Initialize a font
+    hexfont * const example_font = hexfont_load_data(hexfont_iso_8859_15, 16);
+
+    klm_mat_simple_init(example_matrix, example_font);
+    klm_mat_simple_set_text(example_matrix, "BENCHMARK");
+    klm_mat_simple_set_text_speed(example_matrix, -1, 0);
+    klm_mat_set_refresh_rate(example_matrix, refresh_hz);
+
+    // Work out which backends are in use
+    const char *data_backend = "none";
+    const char *control_backend = "none";
+#if defined(KLM_GPIOD)
+    control_backend = example_matrix->gpiod ? "libgpiod" : "none";
+    data_backend = example_matrix->gpiod ? "libgpiod" : "none";
+#elif !defined(KLM_NON_GPIO_MACHINE)
+    control_backend = "wiringPi";
+    data_backend = "wiringPi shiftOut";
+#endif
+    if (example_matrix->spidev) {
+        data_backend = klm_spidev_is_fake(example_matrix->spidev) ? "spidev (stand-in)" : "spidev";
+    }
+
+    // Scan for the given number of seconds
+    int64_t micros_0, micros_1;
+    struct timespec now_t;
+    KLM_NOW_MICROSECS(micros_0, now_t);
+    micros_1 = micros_0;
+
+    uint32_t frames = 0;
+    while (micros_1 - micros_0 < (int64_t)seconds * KLM_ONE_MILLION) {
+        if (frames % EXAMPLE_TICK_PERIOD_SCANS == 0) {
+            klm_mat_tick(example_matrix);
+        }
+        klm_mat_scan(example_matrix);
+        frames++;
+
+        KLM_NOW_MICROSECS(micros_1, now_t);
+    }
+
+    double elapsed = (double)(micros_1 - micros_0) / KLM_ONE_MILLION;
+    printf("data: %s, control: %s\n", data_backend, control_backend);
+    printf("%u frames in %.2fs: %.1f Hz refresh rate\n",
+           frames, elapsed, frames / elapsed);
+    printf("pacer: target %u Hz, achieved %.1f Hz, duty-cycle error %.2f%%, "
+           "max row error %lldns, %u overruns\n",
+           example_matrix->pacer->refresh_hz,
+           klm_pacer_get_refresh_rate(example_matrix->pacer),
+           klm_pacer_get_duty_error(example_matrix->pacer) * 100,
+           (long long)example_matrix->pacer->max_error_nanos,
+           example_matrix->pacer->overrun_count);
+#if defined(KLM_GPIOD)
+    if (example_matrix->gpiod) {
+        printf("%.1f set_values calls per frame\n",
+               (double)example_matrix->gpiod->set_count / frames);
+    }
+#endif
+
+    // Clean up the matrix
+    klm_mat_destroy(example_matrix);
+    klm_config_destroy(example_config);
+
+    printf("Goodbye\n");
+    return EXIT_SUCCESS;
+}
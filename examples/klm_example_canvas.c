@@ -0,0 +1,98 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_canvas.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 32
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_CANVAS_WIDTH 4096
+#define EXAMPLE_CANVAS_HEIGHT 16
+
+#define EXAMPLE_PAN_SPEED 3.0
+#define EXAMPLE_TICKS 10000
+
+
+/**
+ * Pre-render a long banner onto a canvas much wider than the display,
+ * then pan across it.
+ */
+int main() {
+    printf("Konker's LED Matrix library\n");
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+
+    // Create a matrix
+    klm_matrix *example_matrix = klm_mat_create(stdout, example_config);
+
+    // Initialize a font
+    hexfont * const example_font = hexfont_load_data(hexfont_iso_8859_15, 16);
+    klm_mat_simple_init(example_matrix, example_font);
+
+    // Render a banner across the whole canvas, once
+    klm_canvas *example_canvas =
+            klm_canvas_create(EXAMPLE_CANVAS_WIDTH, EXAMPLE_CANVAS_HEIGHT);
+    int32_t x = 0;
+    while (x < EXAMPLE_CANVAS_WIDTH) {
+        x = klm_canvas_render_text(example_canvas, example_font,
+                                   "KONKER LED MATRIX - ", x, 0);
+    }
+
+    // Pan across it, wrapping around at the end
+    klm_mat_set_canvas(example_matrix, example_canvas, true);
+    klm_mat_set_viewport_speed(example_matrix, EXAMPLE_PAN_SPEED, 0);
+
+    int64_t micros_0, micros_1;
+    struct timespec now_t;
+    KLM_NOW_MICROSECS(micros_0, now_t);
+
+    int16_t j;
+    for (j=0; j<EXAMPLE_TICKS; j++) {
+        klm_mat_tick(example_matrix);
+    }
+
+    KLM_NOW_MICROSECS(micros_1, now_t);
+    printf("%d ticks in %lldus\n", EXAMPLE_TICKS, (long long)(micros_1 - micros_0));
+    klm_mat_dump_buffer(example_matrix);
+
+    // Clean up the matrix
+    klm_mat_destroy(example_matrix);
+    klm_canvas_destroy(example_canvas);
+    klm_config_destroy(example_config);
+
+    printf("Goodbye\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_control.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 96
+#define EXAMPLE_MATRIX_HEIGHT 32
+
+#define EXAMPLE_A 0
+#define EXAMPLE_B 2
+#define EXAMPLE_C 3
+#define EXAMPLE_D 1
+#define EXAMPLE_R1 4
+#define EXAMPLE_OE 21
+#define EXAMPLE_STB 22
+#define EXAMPLE_CLK 23
+
+#define EXAMPLE_SOCKET_PATH "/tmp/klm_example_control.sock"
+#define EXAMPLE_UPDATES 10000
+
+
+/**
+ * Drive a matrix through its control socket, as a separate content
+ * producer would: lay out two segments and fill them in with one message,
+ * then time a stream of single text updates.
+ */
+int main() {
+    printf("Konker's LED Matrix library\n");
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    klm_config_set_pin(example_config, 'a', EXAMPLE_A);
+    klm_config_set_pin(example_config, 'b', EXAMPLE_B);
+    klm_config_set_pin(example_config, 'c', EXAMPLE_C);
+    klm_config_set_pin(example_config, 'd', EXAMPLE_D);
+    klm_config_set_pin(example_config, 'o', EXAMPLE_OE);
+    klm_config_set_pin(example_config, 'r', EXAMPLE_R1);
+    klm_config_set_pin(example_config, 's', EXAMPLE_STB);
+    klm_config_set_pin(example_config, 'x', EXAMPLE_CLK);
+
+    // A matrix with fonts but no segments, those come over the socket
+    klm_matrix *example_matrix = klm_mat_create(stdout, example_config);
+    hexfont * const example_font = hexfont_load_data(hexfont_iso_8859_15, 16);
+    klm_mat_init(example_matrix, hexfont_list_create(example_font), NULL);
+
+    klm_control * const example_control = klm_control_create(example_matrix, EXAMPLE_SOCKET_PATH);
+    if (example_control == NULL) {
+        fprintf(stderr, "Could not create %s. Aborting", EXAMPLE_SOCKET_PATH);
+        exit(EXIT_FAILURE);
+    }
+
+    // The producer's end, which would normally be in another process
+    int example_fd = klm_control_connect(EXAMPLE_SOCKET_PATH);
+    if (example_fd < 0) {
+        fprintf(stderr, "Could not connect to %s. Aborting", EXAMPLE_SOCKET_PATH);
+        exit(EXIT_FAILURE);
+    }
+
+    // Everything in one message is applied in the same tick
+    klm_control_message example_message;
+    klm_control_message_init(&example_message);
+    klm_control_message_add_create(&example_message, 0, 0, EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT/2, 0);
+    klm_control_message_add_create(&example_message, 0, EXAMPLE_MATRIX_HEIGHT/2, EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT/2, 0);
+    klm_control_message_add_text(&example_message, 0, "PLATFORM 3");
+    klm_control_message_add_text(&example_message, 1, "12:45 HELSINKI");
+    klm_control_message_add_floats(&example_message, KLM_CONTROL_SET_TEXT_SPEED, 1, -1, 0);
+    klm_control_send(example_fd, &example_message);
+
+    klm_control_receive(example_control);
+    klm_mat_tick(example_matrix);
+    klm_mat_dump_buffer(example_matrix);
+
+    uint8_t reply;
+    if (recv(example_fd, &reply, sizeof(reply), 0) == sizeof(reply)) {
+        printf("Reply: %u, %u segments\n",
+               reply, klm_segment_list_get_length(example_matrix->segment_list));
+    }
+
+    // A stream of updates, one syscall each from the producer
+    int64_t start = klm_pacer_now_nanos();
+    char text[16];
+    int i;
+    for (i=0; i<EXAMPLE_UPDATES; i++) {
+        snprintf(text, sizeof(text), "%d", i);
+        klm_control_message_init(&example_message);
+        klm_control_message_add_text(&example_message, 0, text);
+        klm_control_send(example_fd, &example_message);
+
+        klm_control_receive(example_control);
+        klm_mat_tick(example_matrix);
+        recv(example_fd, &reply, sizeof(reply), 0);
+    }
+    int64_t elapsed = klm_pacer_now_nanos() - start;
+    printf("%8.2f us per update, including the tick and the reply\n",
+           elapsed / 1000.0 / EXAMPLE_UPDATES);
+    klm_mat_dump_buffer(example_matrix);
+
+    // Bad messages are rejected whole
+    const uint8_t example_bad[] = { 'K', 'L', KLM_CONTROL_VERSION, 2, KLM_CONTROL_SHOW, 0, 0, 0 };
+    printf("Short message: %d\n", klm_control_submit(example_control, example_bad, sizeof(example_bad)));
+
+    klm_control_message_init(&example_message);
+    klm_control_message_add_floats(&example_message, KLM_CONTROL_SET_TEXT_POSITION, 0, NAN, 0);
+    printf("Not a number: %d\n",
+           klm_control_submit(example_control, example_message.data, example_message.len));
+
+    klm_control_message_init(&example_message);
+    klm_control_message_add_text(&example_message, 0, "CAF\xc3");
+    printf("Truncated UTF-8: %d\n",
+           klm_control_submit(example_control, example_message.data, example_message.len));
+
+    // Clean up
+    close(example_fd);
+    klm_mat_destroy(example_matrix);
+    klm_control_destroy(example_control);
+    klm_config_destroy(example_config);
+
+    printf("Goodbye\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_counter.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 96
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_A 0
+#define EXAMPLE_B 2
+#define EXAMPLE_C 3
+#define EXAMPLE_D 1
+#define EXAMPLE_R1 4
+#define EXAMPLE_OE 21
+#define EXAMPLE_STB 22
+#define EXAMPLE_CLK 23
+
+#define EXAMPLE_SECONDS 86400
+
+
+/**
+ * Run a clock through a day's worth of seconds, first by setting the
+ * segment's text and then with a counter, and compare the cost of each
+ * update plus the tick which renders it.
+ */
+int main() {
+    printf("Konker's LED Matrix library\n");
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    klm_config_set_pin(example_config, 'a', EXAMPLE_A);
+    klm_config_set_pin(example_config, 'b', EXAMPLE_B);
+    klm_config_set_pin(example_config, 'c', EXAMPLE_C);
+    klm_config_set_pin(example_config, 'd', EXAMPLE_D);
+    klm_config_set_pin(example_config, 'o', EXAMPLE_OE);
+    klm_config_set_pin(example_config, 'r', EXAMPLE_R1);
+    klm_config_set_pin(example_config, 's', EXAMPLE_STB);
+    klm_config_set_pin(example_config, 'x', EXAMPLE_CLK);
+
+    // Create a matrix with a single full-screen segment
+    klm_matrix *example_matrix = klm_mat_create(stdout, example_config);
+    hexfont * const example_font = hexfont_load_data(hexfont_iso_8859_15, 16);
+    klm_mat_simple_init(example_matrix, example_font);
+
+    klm_segment * const example_segment =
+        klm_segment_list_get_nth(example_matrix->segment_list, 0);
+
+    // The plain text way
+    char text[16];
+    int64_t start = klm_pacer_now_nanos();
+    int32_t s;
+    for (s=0; s<EXAMPLE_SECONDS; s++) {
+        snprintf(text, sizeof(text), "%02d:%02d:%02d", s / 3600, (s / 60) % 60, s % 60);
+        klm_seg_set_text(example_segment, text);
+        klm_mat_tick(example_matrix);
+    }
+    int64_t elapsed = klm_pacer_now_nanos() - start;
+    printf("set_text %8.2f us/update\n", elapsed / 1000.0 / EXAMPLE_SECONDS);
+    klm_mat_dump_buffer(example_matrix);
+
+    // The same clock as a counter, which only redraws the digits that change
+    klm_counter * const example_counter = klm_counter_create(example_segment, 8);
+    klm_seg_center_text(example_segment, true, true);
+
+    start = klm_pacer_now_nanos();
+    for (s=0; s<EXAMPLE_SECONDS; s++) {
+        klm_counter_set_time(example_counter, s / 3600, (s / 60) % 60, s % 60);
+        klm_mat_tick(example_matrix);
+    }
+    elapsed = klm_pacer_now_nanos() - start;
+    printf("counter  %8.2f us/update, %.2f cells redrawn per update\n",
+           elapsed / 1000.0 / EXAMPLE_SECONDS,
+           (double)example_counter->cell_render_count / example_counter->update_count);
+    klm_mat_dump_buffer(example_matrix);
+
+    // Counters can count too
+    klm_counter_set_number(example_counter, -42, false);
+    klm_mat_tick(example_matrix);
+    klm_mat_dump_buffer(example_matrix);
+
+    // Clean up
+    klm_counter_destroy(example_counter);
+    klm_mat_destroy(example_matrix);
+    klm_config_destroy(example_config);
+
+    printf("Goodbye\n");
+    return EXIT_SUCCESS;
+}
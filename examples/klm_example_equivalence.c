@@ -0,0 +1,933 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_counter.h"
+#include "klm_dither.h"
+#include "klm_transition.h"
+#include "klm_timeline.h"
+#include "klm_canvas.h"
+#include "klm_alloc.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 64
+#define EXAMPLE_MATRIX_HEIGHT 32
+
+#define EXAMPLE_A 0
+#define EXAMPLE_B 2
+#define EXAMPLE_C 3
+#define EXAMPLE_D 1
+#define EXAMPLE_R1 4
+#define EXAMPLE_OE 21
+#define EXAMPLE_STB 22
+#define EXAMPLE_CLK 23
+
+#define EXAMPLE_CONFIGS 16
+#define EXAMPLE_TICKS 2000
+#define EXAMPLE_MAX_SEGMENTS 4
+#define EXAMPLE_MIN_SEGMENT_SIZE 8
+#define EXAMPLE_RENDER_AHEAD 4
+#define EXAMPLE_ARENA_SIZE (8 * 1024 * 1024)
+#define EXAMPLE_WINDOWS 200
+
+// The gap segments leave between characters
+#define EXAMPLE_CHARACTER_SPACING 1
+
+#ifdef KLM_STATIC
+static uint8_t example_arena[EXAMPLE_ARENA_SIZE];
+#endif
+
+static const char *example_texts[] = {
+    "HELLO",
+    "Konker's LED matrix",
+    "0123456789",
+    "The quick brown fox jumps over the lazy dog",
+    "\xc3\x84\xc3\x96\xc3\x9c \xe2\x82\xac 12:34",
+    "",
+};
+#define EXAMPLE_TEXT_COUNT (sizeof(example_texts) / sizeof(example_texts[0]))
+
+// Keep the driver's frame dumps and log messages out of the report
+static FILE *example_log;
+
+
+/** Xorshift, so that both sides of a comparison see the same sequence whatever libc does */
+static uint32_t example_rand(uint32_t * const state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return (*state = x);
+}
+
+/** Scroll speeds from -1.5 to 1.5 pixels per tick, including stopped and fractional */
+static float example_rand_speed(uint32_t * const state) {
+    return ((int)(example_rand(state) % 7) - 3) * 0.5f;
+}
+
+static klm_config * const example_create_config() {
+    klm_config * const config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    klm_config_set_pin(config, 'a', EXAMPLE_A);
+    klm_config_set_pin(config, 'b', EXAMPLE_B);
+    klm_config_set_pin(config, 'c', EXAMPLE_C);
+    klm_config_set_pin(config, 'd', EXAMPLE_D);
+    klm_config_set_pin(config, 'o', EXAMPLE_OE);
+    klm_config_set_pin(config, 'r', EXAMPLE_R1);
+    klm_config_set_pin(config, 's', EXAMPLE_STB);
+    klm_config_set_pin(config, 'x', EXAMPLE_CLK);
+
+    // Only the style check styles text, and makes its own config with a glyph cache
+    klm_config_set_glyph_cache(config, KLM_GLYPH_CACHE_OFF, 1);
+    return config;
+}
+
+/** Create a matrix with between 1 and segment_count randomly placed and animated segments */
+static klm_matrix * const example_create_matrix(klm_config * const config,
+                                                uint32_t seed,
+                                                uint8_t segment_count)
+{
+    uint32_t state = seed;
+    klm_matrix * const matrix = klm_mat_create(example_log, config);
+    klm_segment_list *segment_list = NULL;
+
+    uint8_t i;
+    for (i=0; i<segment_count; i++) {
+        int16_t x = example_rand(&state) % (EXAMPLE_MATRIX_WIDTH - EXAMPLE_MIN_SEGMENT_SIZE);
+        int16_t y = example_rand(&state) % (EXAMPLE_MATRIX_HEIGHT - EXAMPLE_MIN_SEGMENT_SIZE);
+        uint16_t w = EXAMPLE_MIN_SEGMENT_SIZE +
+                        example_rand(&state) % (EXAMPLE_MATRIX_WIDTH - x - EXAMPLE_MIN_SEGMENT_SIZE + 1);
+        uint16_t h = EXAMPLE_MIN_SEGMENT_SIZE +
+                        example_rand(&state) % (EXAMPLE_MATRIX_HEIGHT - y - EXAMPLE_MIN_SEGMENT_SIZE + 1);
+
+        klm_segment * const seg = klm_seg_create(matrix, x, y, w, h, 0);
+        if (segment_list == NULL) {
+            segment_list = klm_segment_list_create(seg);
+        }
+        else {
+            klm_segment_list_append(segment_list, seg);
+        }
+    }
+
+    hexfont * const font = hexfont_load_data(hexfont_iso_8859_15, 16);
+    klm_mat_init(matrix, hexfont_list_create(font), segment_list);
+
+    klm_segment_list *iter = segment_list;
+    while (iter) {
+        klm_segment * const seg = iter->item;
+        if (example_rand(&state) % 4 == 0) {
+            klm_seg_set_multiline(seg, true, example_rand(&state) % 3, example_rand(&state) % 3);
+            klm_seg_set_paging(seg, example_rand(&state) % 20);
+        }
+        klm_seg_set_text(seg, example_texts[example_rand(&state) % EXAMPLE_TEXT_COUNT]);
+        klm_seg_set_text_speed(seg, example_rand_speed(&state), example_rand_speed(&state));
+        if (example_rand(&state) % 4 == 0) {
+            klm_seg_reverse(seg);
+        }
+        iter = iter->next;
+    }
+
+    return matrix;
+}
+
+/** Make the same random change to a matrix as an application might */
+static void example_change(klm_matrix * const matrix, uint32_t seed) {
+    uint32_t state = seed;
+    klm_segment * const seg =
+        klm_segment_list_get_nth(matrix->segment_list,
+                                 example_rand(&state) % klm_segment_list_get_length(matrix->segment_list));
+
+    switch (example_rand(&state) % 7) {
+        case 0:
+            klm_seg_set_text(seg, example_texts[example_rand(&state) % EXAMPLE_TEXT_COUNT]);
+            break;
+        case 1:
+            klm_seg_set_text_speed(seg, example_rand_speed(&state), example_rand_speed(&state));
+            break;
+        case 2:
+            klm_seg_reverse(seg);
+            break;
+        case 3:
+            if (seg->visible) {
+                klm_seg_hide(seg);
+            }
+            else {
+                klm_seg_show(seg);
+            }
+            break;
+        case 4:
+            klm_seg_set_text_position(seg,
+                                      (int16_t)(example_rand(&state) % 64) - 32,
+                                      (int16_t)(example_rand(&state) % 32) - 16);
+            break;
+        case 5:
+            klm_mat_start_transition(matrix,
+                                     example_rand(&state) % (KLM_TRANSITION_DISSOLVE + 1),
+                                     example_rand(&state) % 32);
+            break;
+        default:
+            klm_seg_center_text(seg, true, true);
+            break;
+    }
+}
+
+/** Frames rendered ahead and popped later against frames rendered just in time */
+static uint32_t example_check_render_ahead(klm_config * const config, uint32_t *frames) {
+    uint32_t mismatches = 0;
+    uint32_t c, t;
+    for (c=0; c<EXAMPLE_CONFIGS; c++) {
+        uint32_t state = 0x9E3779B9 + c;
+        uint8_t segment_count = 1 + c % EXAMPLE_MAX_SEGMENTS;
+        klm_matrix * const reference = example_create_matrix(config, state, segment_count);
+        klm_matrix * const ahead = example_create_matrix(config, state, segment_count);
+        klm_mat_set_render_ahead(ahead, EXAMPLE_RENDER_AHEAD);
+
+        for (t=0; t<EXAMPLE_TICKS; t++) {
+            // Now and again the application changes something, dropping the frames ahead
+            if (example_rand(&state) % 16 == 0) {
+                uint32_t seed = example_rand(&state);
+                example_change(reference, seed);
+                example_change(ahead, seed);
+            }
+
+            uint32_t n = example_rand(&state) % (EXAMPLE_RENDER_AHEAD + 1);
+            while (n--) {
+                klm_mat_render_ahead(ahead);
+            }
+
+            klm_mat_tick(reference);
+            klm_mat_tick(ahead);
+            if (klm_mat_get_frame_hash(reference) != klm_mat_get_frame_hash(ahead)) {
+                mismatches++;
+            }
+            (*frames)++;
+        }
+
+        klm_mat_destroy(reference);
+        klm_mat_destroy(ahead);
+    }
+    return mismatches;
+}
+
+/** Give every segment the same random timeline, which changes its text between moves and scrolls */
+static void example_add_timelines(klm_matrix * const matrix, uint32_t seed, bool multiline) {
+    uint32_t state = seed;
+    klm_segment_list *iter = matrix->segment_list;
+    while (iter) {
+        klm_segment * const seg = iter->item;
+        if (multiline) {
+            klm_seg_set_multiline(seg, true, example_rand(&state) % 3, example_rand(&state) % 3);
+            klm_seg_set_paging(seg, example_rand(&state) % 20);
+        }
+
+        klm_timeline * const timeline = klm_timeline_create(seg, KLM_TIMELINE_LOOP);
+        uint8_t k;
+        for (k=0; k<4; k++) {
+            klm_timeline_text(timeline, example_texts[example_rand(&state) % EXAMPLE_TEXT_COUNT]);
+            klm_timeline_move(timeline, example_rand(&state) % 20,
+                              example_rand(&state) % (KLM_EASE_STEP + 1),
+                              example_rand(&state) % (KLM_ANCHOR_AFTER + 1), 0,
+                              example_rand(&state) % (KLM_ANCHOR_AFTER + 1), 0);
+            klm_timeline_scroll(timeline,
+                                example_rand_speed(&state),
+                                example_rand_speed(&state),
+                                example_rand(&state) % 30);
+            klm_timeline_reverse(timeline, example_rand(&state) % 2, example_rand(&state) % 10);
+        }
+        klm_seg_set_timeline(seg, timeline);
+        iter = iter->next;
+    }
+}
+
+static void example_destroy_timelines(klm_matrix * const matrix) {
+    klm_segment_list *iter = matrix->segment_list;
+    while (iter) {
+        klm_segment * const seg = iter->item;
+        if (seg->timeline) {
+            klm_timeline_destroy(seg->timeline);
+        }
+        iter = iter->next;
+    }
+}
+
+/** Frames rendered ahead of timelines, single and multiline, against frames rendered just in time */
+static uint32_t example_check_timeline(klm_config * const config, uint32_t *frames) {
+    uint32_t mismatches = 0;
+    uint32_t c, t;
+    for (c=0; c<EXAMPLE_CONFIGS; c++) {
+        uint32_t state = 0x7F4A7C15 + c;
+        uint8_t segment_count = 1 + c % EXAMPLE_MAX_SEGMENTS;
+        bool multiline = (c % 2 == 1);
+        klm_matrix * const reference = example_create_matrix(config, state, segment_count);
+        klm_matrix * const ahead = example_create_matrix(config, state, segment_count);
+        example_add_timelines(reference, state, multiline);
+        example_add_timelines(ahead, state, multiline);
+        klm_mat_set_render_ahead(ahead, EXAMPLE_RENDER_AHEAD);
+
+        for (t=0; t<EXAMPLE_TICKS; t++) {
+            // Now and again the application changes something, dropping the frames ahead
+            if (example_rand(&state) % 32 == 0) {
+                uint32_t seed = example_rand(&state);
+                example_change(reference, seed);
+                example_change(ahead, seed);
+            }
+
+            uint32_t n = example_rand(&state) % (EXAMPLE_RENDER_AHEAD + 1);
+            while (n--) {
+                klm_mat_render_ahead(ahead);
+            }
+
+            klm_mat_tick(reference);
+            klm_mat_tick(ahead);
+            if (klm_mat_get_frame_hash(reference) != klm_mat_get_frame_hash(ahead)) {
+                mismatches++;
+            }
+            (*frames)++;
+        }
+
+        example_destroy_timelines(reference);
+        example_destroy_timelines(ahead);
+        klm_mat_destroy(reference);
+        klm_mat_destroy(ahead);
+    }
+    return mismatches;
+}
+
+/** A counter's byte blits against the same characters as text, drawn glyph by glyph */
+static uint32_t example_check_counter(klm_config * const config, uint32_t *frames) {
+    uint32_t mismatches = 0;
+    uint32_t c, t;
+    for (c=0; c<EXAMPLE_CONFIGS; c++) {
+        uint32_t state = 0x85EBCA6B + c;
+        klm_matrix * const reference = example_create_matrix(config, state, 1);
+        klm_matrix * const fast = example_create_matrix(config, state, 1);
+        klm_segment * const reference_seg = klm_segment_list_get_nth(reference->segment_list, 0);
+        klm_segment * const fast_seg = klm_segment_list_get_nth(fast->segment_list, 0);
+
+        // The counter's cells are as wide as the font's monospaced digits,
+        // so plain single line text lines up with them
+        klm_seg_set_multiline(reference_seg, false, KLM_ALIGN_LEFT, 0);
+        klm_seg_set_paging(reference_seg, 0);
+        klm_seg_set_text_speed(reference_seg, 0, 0);
+        klm_seg_set_multiline(fast_seg, false, KLM_ALIGN_LEFT, 0);
+        klm_seg_set_paging(fast_seg, 0);
+        klm_seg_set_text_speed(fast_seg, 0, 0);
+        klm_counter * const counter =
+            klm_counter_create(fast_seg, 1 + example_rand(&state) % KLM_COUNTER_MAX_CELLS);
+
+        char text[KLM_COUNTER_MAX_CELLS + 1];
+        for (t=0; t<EXAMPLE_TICKS; t++) {
+            uint32_t r = example_rand(&state);
+            if (r % 3 == 0) {
+                klm_counter_set_time(counter, r % 24, (r >> 8) % 60, (r >> 16) % 60);
+            }
+            else {
+                klm_counter_set_number(counter, (int32_t)r >> (r % 32), r % 2);
+            }
+
+            uint8_t i;
+            for (i=0; i<counter->cell_count; i++) {
+                text[i] = counter->cells[i];
+            }
+            text[i] = '\0';
+            klm_seg_set_text(reference_seg, text);
+
+            // Anywhere in the segment, partly off the edges included
+            float hpos = (int16_t)(example_rand(&state) % (2*EXAMPLE_MATRIX_WIDTH)) - EXAMPLE_MATRIX_WIDTH;
+            float vpos = (int16_t)(example_rand(&state) % EXAMPLE_MATRIX_HEIGHT) - EXAMPLE_MATRIX_HEIGHT/2;
+            klm_seg_set_text_position(reference_seg, hpos, vpos);
+            klm_seg_set_text_position(fast_seg, hpos, vpos);
+
+            klm_mat_tick(reference);
+            klm_mat_tick(fast);
+            if (klm_mat_get_frame_hash(reference) != klm_mat_get_frame_hash(fast)) {
+                mismatches++;
+            }
+            (*frames)++;
+        }
+
+        klm_counter_destroy(counter);
+        klm_mat_destroy(reference);
+        klm_mat_destroy(fast);
+    }
+    return mismatches;
+}
+
+/** Turned and mirrored wire encoding against turning the frame a pixel at a time */
+static uint32_t example_check_orientation(klm_config * const config, uint32_t *frames) {
+    static uint8_t panel[KLM_BUFFER_LEN(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT)];
+    static uint8_t wire[KLM_BUFFER_LEN(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT)];
+    const uint16_t ticks = EXAMPLE_TICKS / 16;
+    uint32_t mismatches = 0;
+
+    uint8_t orientation;
+    for (orientation=0; orientation<16; orientation++) {
+        klm_rotation rotation = orientation % 4;
+        bool mirror_x = (orientation / 4) & 0x01;
+        bool mirror_y = (orientation / 8) & 0x01;
+
+        klm_config * const turned_config = example_create_config();
+        klm_config_set_orientation(turned_config, rotation, mirror_x, mirror_y);
+
+        uint32_t state = 0xC2B2AE35 + orientation;
+        klm_matrix * const reference = example_create_matrix(config, state, EXAMPLE_MAX_SEGMENTS);
+        klm_matrix * const turned = example_create_matrix(turned_config, state, EXAMPLE_MAX_SEGMENTS);
+
+        // Colour panels only mirror and turn half way, and ignore quarter turns
+        if (reference->bitplanes && (rotation == KLM_ROTATE_90 || rotation == KLM_ROTATE_270)) {
+            rotation = KLM_ROTATE_0;
+        }
+
+        // The panel is a quarter turn round from the frame for 90 and 270
+        const bool quarter = (rotation == KLM_ROTATE_90 || rotation == KLM_ROTATE_270);
+        const int16_t panel_width = quarter ? EXAMPLE_MATRIX_HEIGHT : EXAMPLE_MATRIX_WIDTH;
+        const int16_t panel_height = quarter ? EXAMPLE_MATRIX_WIDTH : EXAMPLE_MATRIX_HEIGHT;
+
+        uint16_t t;
+        for (t=0; t<ticks; t++) {
+            klm_mat_tick(reference);
+            klm_mat_tick(turned);
+
+            // Drawing doesn't know which way up the panel is
+            if (klm_mat_get_frame_hash(reference) != klm_mat_get_frame_hash(turned)) {
+                mismatches++;
+            }
+
+            int16_t px, py;
+            for (py=0; py<panel_height; py++) {
+                for (px=0; px<panel_width; px++) {
+                    // Mirroring is along the panel's axes, after turning
+                    int16_t qx = mirror_x ? (panel_width - 1 - px) : px;
+                    int16_t qy = mirror_y ? (panel_height - 1 - py) : py;
+                    int16_t x, y;
+                    switch (rotation) {
+                        case KLM_ROTATE_90:  x = qy; y = EXAMPLE_MATRIX_HEIGHT - 1 - qx; break;
+                        case KLM_ROTATE_180: x = EXAMPLE_MATRIX_WIDTH - 1 - qx; y = EXAMPLE_MATRIX_HEIGHT - 1 - qy; break;
+                        case KLM_ROTATE_270: x = EXAMPLE_MATRIX_WIDTH - 1 - qy; y = qx; break;
+                        default:             x = qx; y = qy; break;
+                    }
+
+                    uint8_t * const p = &panel[py*(panel_width/8) + px/8];
+                    if (klm_mat_is_pixel_set(reference, x, y)) {
+                        *p |= (1 << (px % 8));
+                    }
+                    else {
+                        *p &= ~(1 << (px % 8));
+                    }
+                }
+            }
+
+            // Then encode the turned frame with the panel's own wiring
+            uint64_t hash;
+            if (reference->bitplanes) {
+                klm_bitplanes * const bitplanes = reference->bitplanes;
+                klm_bitplanes_encode(bitplanes, &reference->wire_format, panel);
+                hash = klm_mat_hash_buffer(bitplanes->data, bitplanes->depth * bitplanes->plane_len);
+            }
+            else {
+                klm_wire_encode(&reference->wire_format, panel, wire, panel_width, panel_height);
+                hash = klm_mat_hash_buffer(wire, sizeof(wire));
+            }
+            if (hash != klm_mat_get_wire_hash(turned)) {
+                mismatches++;
+            }
+            (*frames)++;
+        }
+
+        klm_mat_destroy(reference);
+        klm_mat_destroy(turned);
+        klm_config_destroy(turned_config);
+    }
+    return mismatches;
+}
+
+/** Colour bitplanes with reversed bytes, bits and rows against the same frame moved pixel by pixel */
+static uint32_t example_check_bitplanes(klm_config * const config, uint32_t *frames) {
+    static uint8_t moved[KLM_BUFFER_LEN(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT)];
+    const uint16_t ticks = EXAMPLE_TICKS / 16;
+    const uint16_t row_width = EXAMPLE_MATRIX_WIDTH / 8;
+    uint32_t mismatches = 0;
+
+    klm_bitplanes * const expected =
+        klm_bitplanes_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT, KLM_BITPLANES_MAX_DEPTH);
+    klm_bitplanes * const actual =
+        klm_bitplanes_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT, KLM_BITPLANES_MAX_DEPTH);
+    const size_t len = expected->depth * expected->plane_len;
+
+    uint8_t flags;
+    for (flags=0; flags<8; flags++) {
+        klm_wire_format format = { 0 };
+        format.reverse_bytes = flags & 0x01;
+        format.reverse_bits = flags & 0x02;
+        format.reverse_rows = flags & 0x04;
+        format.interleave = 2;
+
+        // The same flags, except for the columns which are moved by hand
+        klm_wire_format plain = format;
+        plain.reverse_bytes = false;
+        plain.reverse_bits = false;
+
+        uint32_t state = 0x165667B1 + flags;
+        klm_matrix * const matrix = example_create_matrix(config, state, EXAMPLE_MAX_SEGMENTS);
+
+        uint16_t t;
+        for (t=0; t<ticks; t++) {
+            klm_mat_tick(matrix);
+
+            int16_t x, y;
+            memset(moved, 0, sizeof(moved));
+            for (y=0; y<EXAMPLE_MATRIX_HEIGHT; y++) {
+                for (x=0; x<EXAMPLE_MATRIX_WIDTH; x++) {
+                    if (!klm_mat_is_pixel_set(matrix, x, y)) {
+                        continue;
+                    }
+                    uint16_t x8 = format.reverse_bytes ? (row_width - 1 - x/8) : x/8;
+                    uint16_t bit = format.reverse_bits ? (7 - x%8) : x%8;
+                    moved[y*row_width + x8] |= (1 << bit);
+                }
+            }
+
+            klm_bitplanes_encode(expected, &plain, moved);
+            klm_bitplanes_encode(actual, &format, matrix->display_buffer1);
+            if (memcmp(expected->data, actual->data, len) != 0) {
+                mismatches++;
+            }
+            (*frames)++;
+        }
+
+        klm_mat_destroy(matrix);
+    }
+
+    klm_bitplanes_destroy(expected);
+    klm_bitplanes_destroy(actual);
+    return mismatches;
+}
+
+static bool example_get_bit(const uint8_t * const buffer, uint16_t width, int16_t x, int16_t y) {
+    return (buffer[y*(width/8) + x/8] >> (x % 8)) & 0x01;
+}
+
+/** Whether the given pixel comes from the frame being transitioned to, worked out one pixel at a time */
+static bool example_transition_pixel(klm_transition * const transition,
+                                     const uint8_t * const from,
+                                     const uint8_t * const to,
+                                     int16_t x, int16_t y,
+                                     uint16_t tick)
+{
+    const int16_t w = transition->width;
+    const int16_t h = transition->height;
+    const int16_t dx = w * tick / transition->duration;
+    const int16_t dy = h * tick / transition->duration;
+
+    switch (transition->type) {
+        case KLM_TRANSITION_SLIDE_LEFT:
+            return (x + dx < w) ? example_get_bit(from, w, x + dx, y) : example_get_bit(to, w, x + dx - w, y);
+        case KLM_TRANSITION_SLIDE_RIGHT:
+            return (x - dx >= 0) ? example_get_bit(from, w, x - dx, y) : example_get_bit(to, w, x - dx + w, y);
+        case KLM_TRANSITION_SLIDE_UP:
+            return (y + dy < h) ? example_get_bit(from, w, x, y + dy) : example_get_bit(to, w, x, y + dy - h);
+        case KLM_TRANSITION_SLIDE_DOWN:
+            return (y - dy >= 0) ? example_get_bit(from, w, x, y - dy) : example_get_bit(to, w, x, y - dy + h);
+        case KLM_TRANSITION_WIPE_LEFT:
+            return example_get_bit((x >= w - dx) ? to : from, w, x, y);
+        case KLM_TRANSITION_WIPE_RIGHT:
+            return example_get_bit((x < dx) ? to : from, w, x, y);
+        case KLM_TRANSITION_WIPE_UP:
+            return example_get_bit((y >= h - dy) ? to : from, w, x, y);
+        case KLM_TRANSITION_WIPE_DOWN:
+            return example_get_bit((y < dy) ? to : from, w, x, y);
+        default: {
+            // Read the pixel's level back out of the bitplanes
+            const size_t len = KLM_BUFFER_LEN(w, h);
+            uint16_t level = 0;
+            uint8_t b;
+            for (b=0; b<KLM_TRANSITION_DISSOLVE_BITS; b++) {
+                level |= example_get_bit(transition->_dissolve + b*len, w, x, y) << b;
+            }
+            const uint16_t threshold = KLM_TRANSITION_DISSOLVE_LEVELS * tick / transition->duration;
+            return example_get_bit((level < threshold) ? to : from, w, x, y);
+        }
+    }
+}
+
+/** Word-wide transition composing against picking each pixel, for rows which aren't a whole number of words too */
+static uint32_t example_check_transition(uint32_t *frames) {
+    static const uint16_t sizes[][2] = { { 64, 32 }, { 40, 24 }, { 8, 8 }, { 24, 16 }, { 200, 8 } };
+    static uint8_t from[KLM_BUFFER_LEN(200, 32)];
+    static uint8_t to[KLM_BUFFER_LEN(200, 32)];
+    static uint8_t dst[KLM_BUFFER_LEN(200, 32)];
+    static uint8_t reference[KLM_BUFFER_LEN(200, 32)];
+    uint32_t mismatches = 0;
+    uint32_t state = 0x165667B1;
+
+    uint8_t s;
+    for (s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++) {
+        const uint16_t w = sizes[s][0];
+        const uint16_t h = sizes[s][1];
+        const size_t len = KLM_BUFFER_LEN(w, h);
+        klm_transition * const transition = klm_transition_create(w, h);
+
+        uint8_t type;
+        for (type=0; type<=KLM_TRANSITION_DISSOLVE; type++) {
+            size_t i;
+            for (i=0; i<len; i++) {
+                from[i] = example_rand(&state);
+                to[i] = example_rand(&state);
+            }
+
+            const uint16_t duration = 1 + example_rand(&state) % 40;
+            klm_transition_start(transition, type, duration, from);
+
+            uint16_t tick;
+            for (tick=0; tick<=duration; tick++) {
+                klm_transition_compose(transition, from, to, dst, tick);
+
+                memset(reference, 0, len);
+                int16_t x, y;
+                for (y=0; y<h; y++) {
+                    for (x=0; x<w; x++) {
+                        if (tick >= duration ?
+                                example_get_bit(to, w, x, y) :
+                                example_transition_pixel(transition, from, to, x, y, tick))
+                        {
+                            reference[y*(w/8) + x/8] |= (1 << (x % 8));
+                        }
+                    }
+                }
+
+                if (klm_mat_hash_buffer(reference, len) != klm_mat_hash_buffer(dst, len)) {
+                    mismatches++;
+                }
+                (*frames)++;
+            }
+        }
+
+        klm_transition_destroy(transition);
+    }
+    return mismatches;
+}
+
+/** Word-wide canvas window copies against reading each pixel, at random positions on and off the canvas */
+static uint32_t example_check_canvas(uint32_t *frames) {
+    static const int32_t canvas_sizes[][2] = { { 256, 64 }, { 100, 40 }, { 37, 19 }, { 33, 7 }, { 8, 300 } };
+    static const uint16_t window_sizes[][2] = { { 64, 32 }, { 40, 24 }, { 8, 8 }, { 200, 8 } };
+    static uint8_t dst[KLM_BUFFER_LEN(200, 32)];
+    static uint8_t reference[KLM_BUFFER_LEN(200, 32)];
+    uint32_t mismatches = 0;
+    uint32_t state = 0x2545F491;
+
+    uint8_t c;
+    for (c=0; c<sizeof(canvas_sizes)/sizeof(canvas_sizes[0]); c++) {
+        const int32_t cw = canvas_sizes[c][0];
+        const int32_t ch = canvas_sizes[c][1];
+        klm_canvas * const canvas = klm_canvas_create(cw, ch);
+
+        int32_t x, y;
+        for (y=0; y<ch; y++) {
+            for (x=0; x<cw; x++) {
+                if (example_rand(&state) & 0x01) {
+                    klm_canvas_set_pixel(canvas, x, y);
+                }
+            }
+        }
+
+        uint8_t s;
+        for (s=0; s<sizeof(window_sizes)/sizeof(window_sizes[0]); s++) {
+            const uint16_t w = window_sizes[s][0];
+            const uint16_t h = window_sizes[s][1];
+            const size_t len = KLM_BUFFER_LEN(w, h);
+
+            uint16_t n;
+            for (n=0; n<EXAMPLE_WINDOWS; n++) {
+                // Anywhere from well off one edge to well off the other
+                const int32_t wx = (int32_t)(example_rand(&state) % (4*cw + 2*w)) - 2*cw - w;
+                const int32_t wy = (int32_t)(example_rand(&state) % (4*ch + 2*h)) - 2*ch - h;
+                const bool wrap = example_rand(&state) & 0x01;
+
+                klm_canvas_copy_window(canvas, wx, wy, wrap, dst, w, h);
+
+                memset(reference, 0, len);
+                int16_t i, j;
+                for (j=0; j<h; j++) {
+                    for (i=0; i<w; i++) {
+                        int32_t px = wx + i;
+                        int32_t py = wy + j;
+                        if (wrap) {
+                            px = ((px % cw) + cw) % cw;
+                            py = ((py % ch) + ch) % ch;
+                        }
+                        if (klm_canvas_is_pixel_set(canvas, px, py)) {
+                            reference[j*(w/8) + i/8] |= (1 << (i % 8));
+                        }
+                    }
+                }
+
+                if (klm_mat_hash_buffer(reference, len) != klm_mat_hash_buffer(dst, len)) {
+                    mismatches++;
+                }
+                (*frames)++;
+            }
+        }
+
+        klm_canvas_destroy(canvas);
+    }
+    return mismatches;
+}
+
+/** The vectorized threshold dither against comparing each pixel */
+static uint32_t example_check_dither(klm_config * const config, uint32_t *frames) {
+    static uint8_t image[EXAMPLE_MATRIX_WIDTH * EXAMPLE_MATRIX_HEIGHT];
+    uint32_t mismatches = 0;
+    uint32_t state = 0x27D4EB2F;
+
+    klm_matrix * const reference = klm_mat_create(example_log, config);
+    klm_matrix * const fast = klm_mat_create(example_log, config);
+    klm_mat_init(reference, NULL, NULL);
+    klm_mat_init(fast, NULL, NULL);
+    klm_dither * const dither =
+        klm_dither_create(EXAMPLE_MATRIX_WIDTH, KLM_PIXEL_GREY8, KLM_DITHER_THRESHOLD);
+
+    uint32_t t;
+    for (t=0; t<EXAMPLE_TICKS / 4; t++) {
+        uint8_t threshold = example_rand(&state);
+        size_t i;
+        for (i=0; i<sizeof(image); i++) {
+            image[i] = example_rand(&state);
+        }
+
+        klm_dither_set_threshold(dither, threshold);
+        klm_mat_show_image(fast, dither, image, EXAMPLE_MATRIX_WIDTH);
+
+        klm_mat_clear(reference);
+        int16_t x, y;
+        for (y=0; y<EXAMPLE_MATRIX_HEIGHT; y++) {
+            for (x=0; x<EXAMPLE_MATRIX_WIDTH; x++) {
+                if (image[y*EXAMPLE_MATRIX_WIDTH + x] > threshold) {
+                    klm_mat_set_pixel(reference, x, y);
+                }
+            }
+        }
+        klm_mat_swap_buffers(reference);
+
+        if (klm_mat_get_frame_hash(reference) != klm_mat_get_frame_hash(fast)) {
+            mismatches++;
+        }
+        (*frames)++;
+    }
+
+    klm_dither_destroy(dither);
+    klm_mat_destroy(reference);
+    klm_mat_destroy(fast);
+    return mismatches;
+}
+
+/**
+ * Drive randomized displays through each of the library's fast paths and
+ * through the plain per-pixel way of getting the same result, and check
+ * that every frame hashes the same.
+ *
+ * Exits with a failure status if any differ, so it can be run as part of the build.
+ */
+/** A pixel of a styled glyph, scaled up a block at a time and then styled one pixel at a time */
+static bool example_styled_pixel(hexfont_character * const c,
+                                 uint8_t scale,
+                                 uint8_t style,
+                                 int16_t x, int16_t y)
+{
+    if (x < 0 || y < 0 || x/scale >= c->width || y/scale >= c->height) {
+        return false;
+    }
+
+    int16_t sx = x/scale, sy = y/scale;
+    bool on = hexfont_character_get_pixel(c, sx, sy);
+    if ((style & KLM_GLYPH_BOLD) && sx > 0) {
+        on = on || hexfont_character_get_pixel(c, sx - 1, sy);
+    }
+    return on;
+}
+
+/** Styled glyphs from the cache against drawing each source pixel as a block */
+static uint32_t example_check_style(uint32_t *frames) {
+    static uint8_t expected[KLM_BUFFER_LEN(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT)];
+    const uint16_t ticks = EXAMPLE_TICKS / 4;
+    uint32_t mismatches = 0;
+
+    klm_config * const config = example_create_config();
+    klm_config_set_glyph_cache(config, KLM_GLYPH_CACHE_AUTO, KLM_GLYPH_CACHE_DEFAULT_MAX_SCALE);
+
+    uint32_t c, t;
+    for (c=0; c<EXAMPLE_CONFIGS; c++) {
+        uint32_t state = 0x27D4EB2F + c;
+        klm_matrix * const fast = example_create_matrix(config, state, 1);
+        klm_segment * const seg = klm_segment_list_get_nth(fast->segment_list, 0);
+        hexfont * const font = hexfont_list_get_nth(fast->font_list, 0);
+
+        klm_seg_set_multiline(seg, false, KLM_ALIGN_LEFT, 0);
+        klm_seg_set_paging(seg, 0);
+        klm_seg_set_text_speed(seg, 0, 0);
+        if (seg->reverse) {
+            klm_seg_reverse(seg);
+        }
+
+        for (t=0; t<ticks; t++) {
+            uint8_t scale = 1 + example_rand(&state) % KLM_GLYPH_CACHE_DEFAULT_MAX_SCALE;
+            uint8_t style = example_rand(&state) % 4;
+            klm_seg_set_text_style(seg, scale, style);
+            klm_seg_set_text(seg, example_texts[example_rand(&state) % EXAMPLE_TEXT_COUNT]);
+
+            float hpos = (int16_t)(example_rand(&state) % (2*EXAMPLE_MATRIX_WIDTH)) - EXAMPLE_MATRIX_WIDTH;
+            float vpos = (int16_t)(example_rand(&state) % EXAMPLE_MATRIX_HEIGHT) - EXAMPLE_MATRIX_HEIGHT/2;
+            klm_seg_set_text_position(seg, hpos, vpos);
+            klm_mat_tick(fast);
+
+            // Every glyph's box is drawn over, clipped to the segment
+            memset(expected, 0, sizeof(expected));
+            int16_t x0 = seg->x + (int16_t)hpos;
+            size_t i;
+            for (i=0; i<seg->text_len; i++) {
+                hexfont_character * const g = hexfont_get(font, seg->codepoints[i]);
+                if (g == NULL) {
+                    continue;
+                }
+
+                int16_t bx, by;
+                for (by=0; by<g->height*scale; by++) {
+                    for (bx=0; bx<g->width*scale; bx++) {
+                        int16_t _x = x0 + bx;
+                        int16_t _y = seg->y + (int16_t)vpos + by;
+                        if (_x < seg->x || _x >= seg->x + seg->width ||
+                            _y < seg->y || _y >= seg->y + seg->height)
+                        {
+                            continue;
+                        }
+
+                        bool on = example_styled_pixel(g, scale, style, bx, by);
+                        if (style & KLM_GLYPH_OUTLINE) {
+                            bool edge = false;
+                            int16_t dx, dy;
+                            for (dy=-1; dy<=1; dy++) {
+                                for (dx=-1; dx<=1; dx++) {
+                                    edge = edge || example_styled_pixel(g, scale, style, bx + dx, by + dy);
+                                }
+                            }
+                            on = !on && edge;
+                        }
+                        if (on) {
+                            expected[_y*(EXAMPLE_MATRIX_WIDTH/8) + _x/8] |= (1 << (_x % 8));
+                        }
+                    }
+                }
+                x0 += g->width*scale + EXAMPLE_CHARACTER_SPACING;
+            }
+
+            if (memcmp(expected, fast->display_buffer1, sizeof(expected)) != 0) {
+                mismatches++;
+            }
+            (*frames)++;
+        }
+
+        klm_mat_destroy(fast);
+    }
+
+    klm_config_destroy(config);
+    return mismatches;
+}
+
+int main() {
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+#ifdef KLM_STATIC
+    klm_alloc_set_arena(example_arena, sizeof(example_arena));
+#endif
+
+    example_log = fopen("/dev/null", "w");
+    if (example_log == NULL) {
+        example_log = stderr;
+    }
+    klm_config * const example_config = example_create_config();
+
+    uint32_t total = 0;
+    uint32_t frames, mismatches;
+
+    frames = 0;
+    mismatches = example_check_render_ahead(example_config, &frames);
+    printf("%-12s %6u frames, %u mismatches\n", "render ahead", frames, mismatches);
+    total += mismatches;
+
+    frames = 0;
+    mismatches = example_check_timeline(example_config, &frames);
+    printf("%-12s %6u frames, %u mismatches\n", "timeline", frames, mismatches);
+    total += mismatches;
+
+    frames = 0;
+    mismatches = example_check_counter(example_config, &frames);
+    printf("%-12s %6u frames, %u mismatches\n", "counter", frames, mismatches);
+    total += mismatches;
+
+    frames = 0;
+    mismatches = example_check_orientation(example_config, &frames);
+    printf("%-12s %6u frames, %u mismatches\n", "orientation", frames, mismatches);
+    total += mismatches;
+
+    frames = 0;
+    mismatches = example_check_bitplanes(example_config, &frames);
+    printf("%-12s %6u frames, %u mismatches\n", "bitplanes", frames, mismatches);
+    total += mismatches;
+
+    frames = 0;
+    mismatches = example_check_dither(example_config, &frames);
+    printf("%-12s %6u frames, %u mismatches\n", "dither", frames, mismatches);
+    total += mismatches;
+
+    frames = 0;
+    mismatches = example_check_transition(&frames);
+    printf("%-12s %6u frames, %u mismatches\n", "transition", frames, mismatches);
+    total += mismatches;
+
+    frames = 0;
+    mismatches = example_check_canvas(&frames);
+    printf("%-12s %6u frames, %u mismatches\n", "canvas", frames, mismatches);
+    total += mismatches;
+
+    frames = 0;
+    mismatches = example_check_style(&frames);
+    printf("%-12s %6u frames, %u mismatches\n", "style", frames, mismatches);
+    total += mismatches;
+
+    klm_config_destroy(example_config);
+
+    if (total > 0) {
+        fprintf(stderr, "FAIL: %u frames differ from the reference\n", total);
+        exit(EXIT_FAILURE);
+    }
+    printf("OK: every fast path matches the reference\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_layout.h"
+#include "klm_alloc.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 32
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_A 0
+#define EXAMPLE_B 2
+#define EXAMPLE_C 3
+#define EXAMPLE_D 1
+#define EXAMPLE_R1 4
+#define EXAMPLE_OE 21
+#define EXAMPLE_STB 22
+#define EXAMPLE_CLK 23
+
+#define EXAMPLE_TICKS 1000
+#define EXAMPLE_ARENA_SIZE (32 * 1024)
+
+#ifdef KLM_STATIC
+static uint8_t example_arena[EXAMPLE_ARENA_SIZE];
+#endif
+
+#define EXAMPLE_REPORT_SIZE(type) \
+        printf("  %-20s %6zu bytes\n", #type, sizeof(type))
+
+
+/**
+ * Report how much RAM the library uses for a typical two segment display
+ * in this build configuration, then check that once everything has been
+ * set up neither klm_mat_tick nor klm_mat_scan allocate or free anything.
+ *
+ * Exits with a failure status if they do, so it can be run as part of the build.
+ * Fonts are loaded by tinyhexfont, and aren't included in the totals.
+ */
+int main() {
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+#ifdef KLM_STATIC
+    klm_alloc_set_arena(example_arena, sizeof(example_arena));
+#endif
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    klm_config_set_pin(example_config, 'a', EXAMPLE_A);
+    klm_config_set_pin(example_config, 'b', EXAMPLE_B);
+    klm_config_set_pin(example_config, 'c', EXAMPLE_C);
+    klm_config_set_pin(example_config, 'd', EXAMPLE_D);
+    klm_config_set_pin(example_config, 'o', EXAMPLE_OE);
+    klm_config_set_pin(example_config, 'r', EXAMPLE_R1);
+    klm_config_set_pin(example_config, 's', EXAMPLE_STB);
+    klm_config_set_pin(example_config, 'x', EXAMPLE_CLK);
+
+    // Keep the driver's frame dumps out of the report
+    FILE *example_log = fopen("/dev/null", "w");
+    klm_matrix *example_matrix = klm_mat_create(example_log ? example_log : stderr, example_config);
+    hexfont * const example_font = hexfont_load_data(hexfont_iso_8859_15, 16);
+
+    // Two half height segments, one of them multi-line
+    klm_segment * const example_seg0 =
+        klm_seg_create(example_matrix, 0, 0, EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT/2, 0);
+    klm_segment * const example_seg1 =
+        klm_seg_create(example_matrix, 0, EXAMPLE_MATRIX_HEIGHT/2, EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT/2, 0);
+
+    klm_segment_list * const example_segment_list = klm_segment_list_create(example_seg0);
+    klm_segment_list_append(example_segment_list, example_seg1);
+    klm_mat_init(example_matrix, hexfont_list_create(example_font), example_segment_list);
+
+    klm_seg_set_text(example_seg0, "FOOTPRINT");
+    klm_seg_set_text_speed(example_seg0, -1, 0);
+    klm_seg_set_multiline(example_seg1, true, KLM_ALIGN_CENTER, 0);
+    klm_seg_set_text(example_seg1, "ONE TWO THREE FOUR");
+    klm_seg_set_text_speed(example_seg1, 0, 1);
+    klm_seg_set_paging(example_seg1, 10);
+
+    const klm_alloc_stats * const stats = klm_alloc_get_stats();
+
+#ifdef KLM_STATIC
+    printf("Static build, %d characters per segment\n", KLM_TEXT_LEN);
+#else
+    printf("Heap build, %d characters per segment\n", KLM_TEXT_LEN);
+#endif
+    printf("%dx%d matrix, 2 segments\n", EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    EXAMPLE_REPORT_SIZE(klm_matrix);
+    EXAMPLE_REPORT_SIZE(klm_config);
+    EXAMPLE_REPORT_SIZE(klm_segment);
+    EXAMPLE_REPORT_SIZE(klm_layout);
+    EXAMPLE_REPORT_SIZE(klm_pacer);
+    EXAMPLE_REPORT_SIZE(klm_cmdq);
+    EXAMPLE_REPORT_SIZE(klm_logger);
+    printf("  %-20s %6zu bytes\n", "log ring",
+           KLM_LOG_DEFAULT_CAPACITY * sizeof(__klm_log_slot_t));
+    printf("  %-20s %6zu bytes\n", "display buffers",
+           3 * KLM_BUFFER_LEN(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT));
+    printf("Total: %zu bytes in %u allocations\n", stats->alloc_bytes, stats->alloc_count);
+#ifdef KLM_STATIC
+    printf("Arena: %zu of %d bytes used\n", klm_alloc_get_arena_used(), EXAMPLE_ARENA_SIZE);
+#endif
+
+    if (stats->fail_count > 0) {
+        fprintf(stderr, "FAIL: %u allocations failed during setup\n", stats->fail_count);
+        exit(EXIT_FAILURE);
+    }
+
+    // From here on nothing should touch the allocator
+    klm_alloc_reset_stats();
+
+    // A whole frame of rows per tick. klm_mat_scan would block for the frame,
+    // and the dummy driver's sleeps a second, which the build shouldn't wait on
+    int16_t j, k;
+    for (j=0; j<EXAMPLE_TICKS; j++) {
+        klm_mat_tick(example_matrix);
+        for (k=0; k<EXAMPLE_MATRIX_HEIGHT; k++) {
+            klm_mat_scan_row(example_matrix);
+        }
+    }
+
+    if (stats->alloc_count > 0 || stats->free_count > 0) {
+        fprintf(stderr, "FAIL: %u allocations and %u frees in %d ticks\n",
+                stats->alloc_count, stats->free_count, EXAMPLE_TICKS);
+        exit(EXIT_FAILURE);
+    }
+    printf("OK: no allocations in %d ticks\n", EXAMPLE_TICKS);
+
+    klm_mat_destroy(example_matrix);
+    klm_config_destroy(example_config);
+    if (example_log) {
+        fclose(example_log);
+    }
+    return EXIT_SUCCESS;
+}
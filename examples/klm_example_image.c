@@ -0,0 +1,131 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "klm_matrix.h"
+#include "klm_dither.h"
+
+#define EXAMPLE_MATRIX_WIDTH 32
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_A 0
+#define EXAMPLE_B 2
+#define EXAMPLE_C 3
+#define EXAMPLE_D 1
+#define EXAMPLE_R1 4
+#define EXAMPLE_OE 21
+#define EXAMPLE_STB 22
+#define EXAMPLE_CLK 23
+
+#define EXAMPLE_FRAMES 10000
+
+static const char *example_mode_names[] = { "threshold", "ordered", "diffusion" };
+
+
+/** Draw one frame of a moving colour plasma */
+static void example_render_plasma(uint8_t * const rgb, int frame) {
+    int16_t x, y;
+    for (y=0; y<EXAMPLE_MATRIX_HEIGHT; y++) {
+        for (x=0; x<EXAMPLE_MATRIX_WIDTH; x++) {
+            float v = sinf(x*0.3f + frame*0.05f) + sinf((x + y)*0.2f - frame*0.03f);
+            uint8_t *p = rgb + (y*EXAMPLE_MATRIX_WIDTH + x)*KLM_PIXEL_RGB24;
+            p[0] = (uint8_t)(127.5f + 63.75f*v);
+            p[1] = (uint8_t)(127.5f + 127.5f*sinf(y*0.4f + frame*0.02f));
+            p[2] = (uint8_t)(255 - p[0]);
+        }
+    }
+}
+
+/**
+ * Push RGB frames straight onto the display with each dithering mode,
+ * and report how long the conversion takes per frame.
+ */
+int main() {
+    printf("Konker's LED Matrix library\n");
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    klm_config_set_pin(example_config, 'a', EXAMPLE_A);
+    klm_config_set_pin(example_config, 'b', EXAMPLE_B);
+    klm_config_set_pin(example_config, 'c', EXAMPLE_C);
+    klm_config_set_pin(example_config, 'd', EXAMPLE_D);
+    klm_config_set_pin(example_config, 'o', EXAMPLE_OE);
+    klm_config_set_pin(example_config, 'r', EXAMPLE_R1);
+    klm_config_set_pin(example_config, 's', EXAMPLE_STB);
+    klm_config_set_pin(example_config, 'x', EXAMPLE_CLK);
+
+    // Create a matrix, no fonts or segments are needed to show images
+    klm_matrix *example_matrix = klm_mat_create(stdout, example_config);
+    klm_mat_init(example_matrix, NULL, NULL);
+
+    klm_dither *example_dither =
+        klm_dither_create(EXAMPLE_MATRIX_WIDTH, KLM_PIXEL_RGB24, KLM_DITHER_THRESHOLD);
+
+    static uint8_t example_rgb[EXAMPLE_MATRIX_WIDTH * EXAMPLE_MATRIX_HEIGHT * KLM_PIXEL_RGB24];
+    example_render_plasma(example_rgb, 0);
+
+    klm_dither_mode mode;
+    for (mode=KLM_DITHER_THRESHOLD; mode<=KLM_DITHER_DIFFUSION; mode++) {
+        klm_dither_set_mode(example_dither, mode);
+
+        // Time the conversion alone, on the same frame each time
+        int64_t start = klm_pacer_now_nanos();
+        int j;
+        for (j=0; j<EXAMPLE_FRAMES; j++) {
+            klm_mat_show_image(example_matrix, example_dither, example_rgb,
+                               EXAMPLE_MATRIX_WIDTH*KLM_PIXEL_RGB24);
+        }
+        int64_t elapsed = klm_pacer_now_nanos() - start;
+
+        printf("%-10s %8.2f us/frame\n",
+               example_mode_names[mode], elapsed / 1000.0 / EXAMPLE_FRAMES);
+        klm_mat_dump_buffer(example_matrix);
+    }
+
+    // Then animate, a frame per scan
+    int16_t j, k;
+    for (j=0; j<1000; j++) {
+        example_render_plasma(example_rgb, j);
+        klm_mat_show_image(example_matrix, example_dither, example_rgb,
+                           EXAMPLE_MATRIX_WIDTH*KLM_PIXEL_RGB24);
+        for (k=0; k<EXAMPLE_MATRIX_HEIGHT; k++) {
+            klm_mat_scan_row(example_matrix);
+        }
+    }
+
+    // Clean up
+    klm_dither_destroy(example_dither);
+    klm_mat_destroy(example_matrix);
+    klm_config_destroy(example_config);
+
+    printf("Goodbye\n");
+    return EXIT_SUCCESS;
+}
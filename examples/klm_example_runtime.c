@@ -0,0 +1,134 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_runtime.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 32
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_A 0
+#define EXAMPLE_B 2
+#define EXAMPLE_C 3
+#define EXAMPLE_D 1
+#define EXAMPLE_R1 4
+#define EXAMPLE_OE 21
+#define EXAMPLE_STB 22
+#define EXAMPLE_CLK 23
+
+#define EXAMPLE_LINE_LEN 256
+
+
+/** Read a line from stdin and show it on the matrix */
+static void example_stdin_callback(klm_runtime * const runtime,
+                                   int fd,
+                                   uint32_t events,
+                                   void *user_data)
+{
+    klm_matrix *matrix = user_data;
+    char line[EXAMPLE_LINE_LEN];
+
+    ssize_t n = read(fd, line, sizeof(line) - 1);
+    if (n <= 0) {
+        klm_runtime_stop(runtime);
+        return;
+    }
+
+    // Strip the trailing newline
+    line[n] = '\0';
+    if (n > 0 && line[n - 1] == '\n') {
+        line[n - 1] = '\0';
+    }
+
+    klm_mat_simple_set_text(matrix, line);
+    klm_mat_simple_set_text_position(matrix, 0, 0);
+
+#ifdef KLM_NON_GPIO_MACHINE
+    klm_mat_tick(matrix);
+    klm_mat_dump_buffer(matrix);
+#endif
+}
+
+/**
+ * Drive a matrix from the runtime's event loop.
+ * Each line typed on stdin replaces the text; EOF exits.
+ */
+int main() {
+    printf("Konker's LED Matrix library\n");
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    klm_config_set_pin(example_config, 'a', EXAMPLE_A);
+    klm_config_set_pin(example_config, 'b', EXAMPLE_B);
+    klm_config_set_pin(example_config, 'c', EXAMPLE_C);
+    klm_config_set_pin(example_config, 'd', EXAMPLE_D);
+    klm_config_set_pin(example_config, 'o', EXAMPLE_OE);
+    klm_config_set_pin(example_config, 'r', EXAMPLE_R1);
+    klm_config_set_pin(example_config, 's', EXAMPLE_STB);
+    klm_config_set_pin(example_config, 'x', EXAMPLE_CLK);
+
+    // Create a matrix
+    klm_matrix *example_matrix = klm_mat_create(stdout, example_config);
+
+    // Initialize a font
+    hexfont * const example_font = hexfont_load_data(hexfont_iso_8859_15, 16);
+
+    klm_mat_simple_init(example_matrix, example_font);
+    klm_mat_simple_set_text(example_matrix, "READY");
+    klm_mat_simple_set_text_speed(example_matrix, -1, 0);
+
+    // Scrolling is deterministic, so let the runtime render frames ahead while idle
+    klm_mat_set_render_ahead(example_matrix, KLM_FRAMEQ_DEFAULT_CAPACITY);
+
+    // Hand the matrix over to a runtime, and watch stdin for new text
+    klm_runtime *runtime = klm_runtime_create();
+    if (runtime == NULL ||
+        !klm_runtime_add_matrix(runtime, example_matrix, KLM_TICK_PERIOD_MICROS) ||
+        !klm_runtime_add_fd(runtime, STDIN_FILENO, EPOLLIN,
+                            example_stdin_callback, example_matrix))
+    {
+        fprintf(stderr, "Could not create runtime. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_runtime_run(runtime);
+
+    // Clean up the runtime, and with it the matrix
+    klm_runtime_destroy(runtime);
+    klm_config_destroy(example_config);
+
+    printf("Goodbye\n");
+    return EXIT_SUCCESS;
+}
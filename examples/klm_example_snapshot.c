@@ -0,0 +1,143 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_snapshot.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 32
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_A 0
+#define EXAMPLE_B 2
+#define EXAMPLE_C 3
+#define EXAMPLE_D 1
+#define EXAMPLE_R1 4
+#define EXAMPLE_OE 21
+#define EXAMPLE_STB 22
+#define EXAMPLE_CLK 23
+
+#define EXAMPLE_DEFAULT_PATH "klm_snapshot.bin"
+#define EXAMPLE_MAX_SEGMENTS 4
+
+
+/**
+ * Keep the display state in a snapshot file, so that when restarted the
+ * text carries on scrolling from where it was, with the last frame shown
+ * before the fonts have even been loaded.
+ *
+ * With -w, act as a watchdog instead: keep scanning the last frame from
+ * the snapshot, e.g. while the main process is being restarted.
+ */
+int main(int argc, char **argv) {
+    bool watchdog = (argc > 1 && strcmp(argv[1], "-w") == 0);
+    const char *path = (argc > (watchdog ? 2 : 1)) ? argv[watchdog ? 2 : 1] : EXAMPLE_DEFAULT_PATH;
+
+    printf("Konker's LED Matrix library\n");
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_snapshot *example_snapshot =
+        klm_snapshot_open(path, EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT, EXAMPLE_MAX_SEGMENTS);
+    if (example_snapshot == NULL) {
+        fprintf(stderr, "Could not open snapshot %s. Aborting", path);
+        exit(EXIT_FAILURE);
+    }
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    klm_config_set_pin(example_config, 'a', EXAMPLE_A);
+    klm_config_set_pin(example_config, 'b', EXAMPLE_B);
+    klm_config_set_pin(example_config, 'c', EXAMPLE_C);
+    klm_config_set_pin(example_config, 'd', EXAMPLE_D);
+    klm_config_set_pin(example_config, 'o', EXAMPLE_OE);
+    klm_config_set_pin(example_config, 'r', EXAMPLE_R1);
+    klm_config_set_pin(example_config, 's', EXAMPLE_STB);
+    klm_config_set_pin(example_config, 'x', EXAMPLE_CLK);
+
+    // Create a matrix
+    klm_matrix *example_matrix = klm_mat_create(stdout, example_config);
+
+    // Show whatever was last on display straight away
+    bool restored = klm_snapshot_restore_frame(example_snapshot, example_matrix);
+
+    if (watchdog) {
+        // No fonts or segments, just keep scanning the latest saved frame
+        klm_mat_init(example_matrix, NULL, NULL);
+        for (;;) {
+            klm_snapshot_restore_frame(example_snapshot, example_matrix);
+
+            int16_t k;
+            for (k=0; k<EXAMPLE_MATRIX_HEIGHT; k++) {
+                klm_mat_scan_row(example_matrix);
+            }
+
+#ifdef KLM_NON_GPIO_MACHINE
+            klm_mat_dump_buffer(example_matrix);
+            sleep(1);
+#endif
+        }
+    }
+
+    // Initialize a font, then carry on from the saved segment state
+    hexfont * const example_font = hexfont_load_data(hexfont_iso_8859_15, 16);
+    klm_mat_simple_init(example_matrix, example_font);
+
+    if (restored && klm_snapshot_restore_segments(example_snapshot, example_matrix)) {
+        printf("Restored from %s\n", path);
+    }
+    else {
+        klm_mat_simple_set_text(example_matrix, "SNAPSHOT");
+        klm_mat_simple_set_text_speed(example_matrix, -1, 0);
+    }
+
+    klm_mat_set_snapshot(example_matrix, example_snapshot);
+
+    // Call the animation driver for a while
+    int16_t j = 0;
+    for (j=0; j<10000; j++) {
+        klm_mat_scan(example_matrix);
+
+#ifdef KLM_NON_GPIO_MACHINE
+        if (example_matrix->scan_row == 0) {
+            sleep(1);
+        }
+#endif
+    }
+
+    // Clean up the matrix, then the snapshot it was keeping up to date
+    klm_mat_destroy(example_matrix);
+    klm_snapshot_close(example_snapshot);
+
+    printf("Goodbye\n");
+    return EXIT_SUCCESS;
+}
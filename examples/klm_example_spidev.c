@@ -0,0 +1,197 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_spidev.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 32
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_DEFAULT_DEVICE "klm_spidev.out"
+#define EXAMPLE_FRAMES 1000
+#define EXAMPLE_TEXT_SPEED1 1.0
+
+
+/** Encode the displayed frame one pixel at a time, as the panel's wire format describes it */
+static void example_encode_pixels(klm_matrix * const matrix, uint8_t * const dst) {
+    const klm_wire_format * const format = &matrix->wire_format;
+    const uint16_t width = matrix->config->width;
+    const uint16_t height = matrix->config->height;
+    const uint16_t row_width = width / 8;
+    const uint16_t addresses = klm_wire_get_address_count(format, width, height);
+
+    // The example's matrix isn't turned, so buffer rows are panel rows
+    uint8_t *out = dst;
+    uint16_t address, k, x8;
+    int8_t bit;
+    for (address=0; address<addresses; address++) {
+        for (k=0; k<format->interleave; k++) {
+            uint16_t y = address + k*addresses;
+            if (format->reverse_rows) {
+                y = height - 1 - y;
+            }
+
+            for (x8=0; x8<row_width; x8++) {
+                uint16_t column = format->reverse_bytes ? (row_width - 1 - x8) : x8;
+                uint8_t byte = 0;
+                for (bit=7; bit>=0; bit--) {
+                    uint16_t x = column*8 + (format->reverse_bits ? 7 - bit : bit);
+                    if (klm_mat_is_pixel_set(matrix, x, y) != format->invert) {
+                        byte |= (1 << bit);
+                    }
+                }
+                *out++ = byte;
+            }
+        }
+    }
+}
+
+
+/**
+ * Send frames through the spidev backend and report the transfer rate.
+ *
+ * Usage: klm_example_spidev [/dev/spidevX.Y | -f file-or-pty]
+ *
+ * With -f, or no arguments at all, the bytes go to a stand-in. A plain
+ * file is read back afterwards and checked against the frame encoded a
+ * pixel at a time, to verify batching and byte order.
+ */
+int main(int argc, char **argv) {
+    bool stand_in = (argc < 2 || strcmp(argv[1], "-f") == 0);
+    const char *path = EXAMPLE_DEFAULT_DEVICE;
+    if (argc > 2) {
+        path = argv[2];
+    }
+    else if (argc == 2 && !stand_in) {
+        path = argv[1];
+    }
+    printf("Konker's LED Matrix library: spidev benchmark on %s\n", path);
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+
+    // Create a matrix
+    klm_matrix *example_matrix = klm_mat_create(stdout, example_config);
+
+    // Initialize a font
+    hexfont * const example_font = hexfont_load_data(hexfont_iso_8859_15, 16);
+
+    klm_mat_simple_init(example_matrix, example_font);
+    klm_mat_simple_set_text(example_matrix, "SPIDEV");
+    klm_mat_simple_set_text_speed(example_matrix, -EXAMPLE_TEXT_SPEED1, 0);
+
+    klm_spidev *spi = stand_in ?
+                        klm_spidev_create_stand_in(path) :
+                        klm_spidev_create(path, KLM_SPIDEV_DEFAULT_SPEED_HZ);
+    if (spi == NULL) {
+        fprintf(stderr, "Could not open %s as %s. Aborting\n",
+                path, stand_in ? "a stand-in" : "a spidev device");
+        exit(EXIT_FAILURE);
+    }
+
+    uint16_t addresses = klm_wire_get_address_count(&example_matrix->wire_format,
+                                                    EXAMPLE_MATRIX_WIDTH,
+                                                    EXAMPLE_MATRIX_HEIGHT);
+    size_t stride = klm_wire_get_address_stride(&example_matrix->wire_format,
+                                                EXAMPLE_MATRIX_WIDTH,
+                                                EXAMPLE_MATRIX_HEIGHT);
+
+    // One transfer per row, as the scan loop does
+    int64_t micros_0, micros_1;
+    struct timespec now_t;
+    KLM_NOW_MICROSECS(micros_0, now_t);
+
+    int16_t j, row;
+    for (j=0; j<EXAMPLE_FRAMES; j++) {
+        klm_mat_tick(example_matrix);
+        for (row=0; row<addresses; row++) {
+            klm_spidev_transfer(spi, example_matrix->wire_buffer + row*stride, stride);
+        }
+    }
+
+    KLM_NOW_MICROSECS(micros_1, now_t);
+    printf("per-row:   %d frames, %u transfers, %u bytes in %lldus (%.1f frames/s)\n",
+           EXAMPLE_FRAMES, spi->transfer_count, spi->byte_count,
+           (long long)(micros_1 - micros_0),
+           EXAMPLE_FRAMES * (double)KLM_ONE_MILLION / (micros_1 - micros_0));
+
+    // All the rows of a frame batched into one ioctl
+    uint32_t transfers_0 = spi->transfer_count;
+    KLM_NOW_MICROSECS(micros_0, now_t);
+
+    for (j=0; j<EXAMPLE_FRAMES; j++) {
+        klm_mat_tick(example_matrix);
+        klm_spidev_transfer_rows(spi, example_matrix->wire_buffer, stride, addresses);
+    }
+
+    KLM_NOW_MICROSECS(micros_1, now_t);
+    printf("per-frame: %d frames, %u transfers in %lldus (%.1f frames/s)\n",
+           EXAMPLE_FRAMES, spi->transfer_count - transfers_0,
+           (long long)(micros_1 - micros_0),
+           EXAMPLE_FRAMES * (double)KLM_ONE_MILLION / (micros_1 - micros_0));
+
+    // Check that the last frame landed on the wire in the right order
+    bool ok = true;
+    if (klm_spidev_is_fake(spi)) {
+        size_t len = addresses * stride;
+        uint8_t *check = malloc(len);
+        uint8_t *expected = malloc(len);
+        example_encode_pixels(example_matrix, expected);
+
+        FILE *fp = fopen(path, "rb");
+        if (fp != NULL &&
+            fseek(fp, -(long)len, SEEK_END) == 0 &&
+            fread(check, 1, len, fp) == len)
+        {
+            ok = (memcmp(check, expected, len) == 0);
+            printf("last frame %s\n",
+                   ok ? "matches the per-pixel encoding" : "DOES NOT MATCH the per-pixel encoding");
+        }
+        if (fp != NULL) {
+            fclose(fp);
+        }
+        free(expected);
+        free(check);
+    }
+
+    klm_spidev_destroy(spi);
+
+    // Clean up the matrix
+    klm_mat_destroy(example_matrix);
+    klm_config_destroy(example_config);
+
+    printf("Goodbye\n");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
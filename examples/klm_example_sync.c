@@ -0,0 +1,245 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_runtime.h"
+#include "klm_sync.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 32
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_A 0
+#define EXAMPLE_B 2
+#define EXAMPLE_C 3
+#define EXAMPLE_D 1
+#define EXAMPLE_R1 4
+#define EXAMPLE_OE 21
+#define EXAMPLE_STB 22
+#define EXAMPLE_CLK 23
+
+#define EXAMPLE_SYNC_PATH "/tmp/klm_example_sync"
+#define EXAMPLE_CONTROLLERS 3
+#define EXAMPLE_CANVAS_WIDTH (EXAMPLE_CONTROLLERS * EXAMPLE_MATRIX_WIDTH)
+#define EXAMPLE_TICK_PERIOD_MICROS 20000
+#define EXAMPLE_TEXT "Across three controllers"
+#define EXAMPLE_SPEED -1.0
+
+// Start recording a little way ahead, so every controller is running by then
+#define EXAMPLE_LEAD_FRAMES 25
+#define EXAMPLE_FRAMES 100
+
+#define EXAMPLE_BUFFER_LEN KLM_BUFFER_LEN(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT)
+
+// What each controller put on display, shared with the parent
+typedef struct example_results {
+    uint32_t first_frame;
+    uint8_t recorded[EXAMPLE_FRAMES][EXAMPLE_CONTROLLERS];
+    uint8_t buffers[EXAMPLE_FRAMES][EXAMPLE_CONTROLLERS][EXAMPLE_BUFFER_LEN];
+} example_results;
+
+static example_results *results;
+static int controller;
+
+
+static klm_matrix * example_create_matrix(uint16_t width) {
+    klm_config *example_config = klm_config_create(width, EXAMPLE_MATRIX_HEIGHT);
+    klm_config_set_pin(example_config, 'a', EXAMPLE_A);
+    klm_config_set_pin(example_config, 'b', EXAMPLE_B);
+    klm_config_set_pin(example_config, 'c', EXAMPLE_C);
+    klm_config_set_pin(example_config, 'd', EXAMPLE_D);
+    klm_config_set_pin(example_config, 'o', EXAMPLE_OE);
+    klm_config_set_pin(example_config, 'r', EXAMPLE_R1);
+    klm_config_set_pin(example_config, 's', EXAMPLE_STB);
+    klm_config_set_pin(example_config, 'x', EXAMPLE_CLK);
+
+    klm_matrix *matrix = klm_mat_create(stdout, example_config);
+    hexfont * const example_font = hexfont_load_data(hexfont_iso_8859_15, 16);
+    klm_mat_simple_init(matrix, example_font);
+    klm_mat_simple_set_text(matrix, EXAMPLE_TEXT);
+    return matrix;
+}
+
+/** One controller, driving its own part of the sign from a runtime */
+static int example_controller() {
+    klm_sync * const sync =
+        klm_sync_open(EXAMPLE_SYNC_PATH,
+                      EXAMPLE_CANVAS_WIDTH,
+                      EXAMPLE_TICK_PERIOD_MICROS,
+                      controller * EXAMPLE_MATRIX_WIDTH);
+    if (sync == NULL) {
+        fprintf(stderr, "Controller %d could not open %s\n", controller, EXAMPLE_SYNC_PATH);
+        return EXIT_FAILURE;
+    }
+
+    klm_matrix * const matrix = example_create_matrix(EXAMPLE_MATRIX_WIDTH);
+    klm_mat_simple_set_text_speed(matrix, EXAMPLE_SPEED, 0);
+    klm_mat_set_render_ahead(matrix, 2);
+    klm_mat_set_sync(matrix, sync);
+
+    klm_runtime * const runtime = klm_runtime_create();
+    klm_runtime_add_matrix(runtime, matrix, EXAMPLE_TICK_PERIOD_MICROS);
+
+    // Keep a copy of each frame in the recorded range as it goes on display
+    uint32_t last = 0;
+    while (last < results->first_frame + EXAMPLE_FRAMES) {
+        klm_runtime_run_once(runtime, -1);
+
+        uint32_t shown = matrix->frameq->shown.sync_frame;
+        if (klm_frameq_is_empty(matrix->frameq)) {
+            shown = matrix->_sync_frame;
+        }
+        if (shown != last &&
+            shown >= results->first_frame &&
+            shown < results->first_frame + EXAMPLE_FRAMES)
+        {
+            uint32_t i = shown - results->first_frame;
+            memcpy(results->buffers[i][controller], matrix->display_buffer1, EXAMPLE_BUFFER_LEN);
+            results->recorded[i][controller] = 1;
+        }
+        last = shown;
+    }
+
+    printf("Controller %d: %u frames, %u skipped\n",
+           controller, sync->frame_count, sync->skip_count);
+
+    klm_config * const config = matrix->config;
+    klm_runtime_destroy(runtime);
+    klm_config_destroy(config);
+    klm_sync_close(sync);
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * Run three controllers in separate processes, each driving a 32 pixel
+ * wide part of a 96 pixel sign, all kept in step by one sync file.
+ * Then join up the frames they showed and check them against the same
+ * text on one 96 pixel wide matrix.
+ */
+int main() {
+    printf("Konker's LED Matrix library\n");
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    // Start with a fresh epoch
+    unlink(EXAMPLE_SYNC_PATH);
+    klm_sync * const sync =
+        klm_sync_open(EXAMPLE_SYNC_PATH,
+                      EXAMPLE_CANVAS_WIDTH,
+                      EXAMPLE_TICK_PERIOD_MICROS,
+                      0);
+    if (sync == NULL) {
+        fprintf(stderr, "Could not create %s. Aborting", EXAMPLE_SYNC_PATH);
+        exit(EXIT_FAILURE);
+    }
+
+    results = mmap(NULL, sizeof(example_results),
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    memset(results, 0, sizeof(example_results));
+    results->first_frame = klm_sync_get_frame(sync) + EXAMPLE_LEAD_FRAMES;
+
+    fflush(stdout);
+    for (controller=0; controller<EXAMPLE_CONTROLLERS; controller++) {
+        if (fork() == 0) {
+            exit(example_controller());
+        }
+    }
+
+    int status;
+    bool ok = true;
+    while (wait(&status) > 0) {
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+    }
+
+    // The reference is one wide matrix, with the text put where the sync says
+    klm_matrix * const reference = example_create_matrix(EXAMPLE_CANVAS_WIDTH);
+    klm_segment * const seg = reference->segment_list->item;
+    uint8_t joined[KLM_BUFFER_LEN(EXAMPLE_CANVAS_WIDTH, EXAMPLE_MATRIX_HEIGHT)];
+
+    uint32_t missing = 0;
+    uint32_t seams = 0;
+    uint32_t i;
+    for (i=0; i<EXAMPLE_FRAMES; i++) {
+        bool complete = true;
+        int c;
+        for (c=0; c<EXAMPLE_CONTROLLERS; c++) {
+            complete = complete && results->recorded[i][c];
+        }
+        if (!complete) {
+            missing++;
+            continue;
+        }
+
+        klm_seg_set_text_position(seg,
+                                  klm_sync_get_text_hpos(sync,
+                                                         results->first_frame + i,
+                                                         EXAMPLE_SPEED,
+                                                         klm_seg_get_text_pixel_width(seg),
+                                                         0),
+                                  seg->text_vpos);
+        klm_mat_tick(reference);
+
+        // Each controller's rows sit side by side in the joined frame
+        uint16_t y;
+        for (y=0; y<EXAMPLE_MATRIX_HEIGHT; y++) {
+            for (c=0; c<EXAMPLE_CONTROLLERS; c++) {
+                memcpy(joined + y*(EXAMPLE_CANVAS_WIDTH/KLM_BYTE_WIDTH) + c*(EXAMPLE_MATRIX_WIDTH/KLM_BYTE_WIDTH),
+                       results->buffers[i][c] + y*(EXAMPLE_MATRIX_WIDTH/KLM_BYTE_WIDTH),
+                       EXAMPLE_MATRIX_WIDTH/KLM_BYTE_WIDTH);
+            }
+        }
+
+        if (memcmp(joined, reference->display_buffer1, sizeof(joined)) != 0) {
+            seams++;
+        }
+        if (i == EXAMPLE_FRAMES/2) {
+            klm_mat_dump_buffer(reference);
+        }
+    }
+
+    printf("%u frames: %u joined up, %u with a seam, %u not shown by every controller\n",
+           EXAMPLE_FRAMES, EXAMPLE_FRAMES - missing - seams, seams, missing);
+
+    // Clean up
+    klm_config * const config = reference->config;
+    klm_mat_destroy(reference);
+    klm_config_destroy(config);
+    klm_sync_close(sync);
+    unlink(EXAMPLE_SYNC_PATH);
+    munmap(results, sizeof(example_results));
+
+    printf("Goodbye\n");
+    return (ok && seams == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
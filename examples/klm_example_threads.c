@@ -0,0 +1,118 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_cmdq.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 32
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_FEED_THREADS 4
+#define EXAMPLE_FEED_UPDATES 10000
+#define EXAMPLE_TEXT_LEN 32
+
+
+static klm_matrix *example_matrix;
+static atomic_int example_feeds_done;
+
+/** A feed thread which keeps changing the text and speed of the segment */
+static void *example_feed(void *arg) {
+    intptr_t id = (intptr_t)arg;
+    klm_segment *seg = example_matrix->segment_list->item;
+
+    int i;
+    for (i=0; i<EXAMPLE_FEED_UPDATES; i++) {
+        char *text = malloc(EXAMPLE_TEXT_LEN);
+        snprintf(text, EXAMPLE_TEXT_LEN, "FEED %d: %d", (int)id, i);
+
+        // The queue owns the text from here on, unless it was full
+        if (!klm_cmdq_post_set_text(example_matrix->cmdq, seg, text)) {
+            free(text);
+        }
+        klm_cmdq_post_set_text_speed(example_matrix->cmdq, seg, -(float)id, 0);
+    }
+
+    atomic_fetch_add(&example_feeds_done, 1);
+    return NULL;
+}
+
+/**
+ * Several threads update the same segment through the command queue
+ * while the main thread ticks the matrix.
+ */
+int main() {
+    printf("Konker's LED Matrix library\n");
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+
+    // Create a matrix
+    example_matrix = klm_mat_create(stdout, example_config);
+
+    // Initialize a font
+    hexfont * const example_font = hexfont_load_data(hexfont_iso_8859_15, 16);
+    klm_mat_simple_init(example_matrix, example_font);
+
+    pthread_t threads[EXAMPLE_FEED_THREADS];
+    atomic_init(&example_feeds_done, 0);
+    intptr_t t;
+    for (t=0; t<EXAMPLE_FEED_THREADS; t++) {
+        pthread_create(&threads[t], NULL, example_feed, (void *)(t + 1));
+    }
+
+    // Tick until all the feeds are done
+    uint32_t ticks = 0;
+    while (atomic_load(&example_feeds_done) < EXAMPLE_FEED_THREADS) {
+        klm_mat_tick(example_matrix);
+        ticks++;
+    }
+    for (t=0; t<EXAMPLE_FEED_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    klm_mat_tick(example_matrix);
+
+    printf("%u ticks, %u commands dropped, final text: %s\n",
+           ticks, atomic_load(&example_matrix->cmdq->dropped_count),
+           example_matrix->segment_list->item->text);
+    klm_mat_dump_buffer(example_matrix);
+
+    // Clean up the matrix
+    klm_mat_destroy(example_matrix);
+    klm_config_destroy(example_config);
+
+    printf("Goodbye\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,127 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_timeline.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 64
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_A 0
+#define EXAMPLE_B 2
+#define EXAMPLE_C 3
+#define EXAMPLE_D 1
+#define EXAMPLE_R1 4
+#define EXAMPLE_OE 21
+#define EXAMPLE_STB 22
+#define EXAMPLE_CLK 23
+
+#define EXAMPLE_TICKS 400
+#define EXAMPLE_DUMP_PERIOD 20
+
+
+/**
+ * Scroll a message in, hold it in the centre, blink it, swap in a second
+ * message from below, scroll that away and start again, all driven by a
+ * timeline from inside klm_mat_tick.
+ */
+int main() {
+    printf("Konker's LED Matrix library\n");
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    klm_config_set_pin(example_config, 'a', EXAMPLE_A);
+    klm_config_set_pin(example_config, 'b', EXAMPLE_B);
+    klm_config_set_pin(example_config, 'c', EXAMPLE_C);
+    klm_config_set_pin(example_config, 'd', EXAMPLE_D);
+    klm_config_set_pin(example_config, 'o', EXAMPLE_OE);
+    klm_config_set_pin(example_config, 'r', EXAMPLE_R1);
+    klm_config_set_pin(example_config, 's', EXAMPLE_STB);
+    klm_config_set_pin(example_config, 'x', EXAMPLE_CLK);
+
+    // Create a matrix with a single full-screen segment
+    klm_matrix *example_matrix = klm_mat_create(stdout, example_config);
+    hexfont * const example_font = hexfont_load_data(hexfont_iso_8859_15, 16);
+    klm_mat_simple_init(example_matrix, example_font);
+    klm_mat_simple_set_text(example_matrix, "Hello");
+
+    klm_segment * const example_segment =
+        klm_segment_list_get_nth(example_matrix->segment_list, 0);
+
+    klm_timeline * const example_timeline =
+        klm_timeline_create(example_segment, KLM_TIMELINE_LOOP);
+
+    // Slide in from the right and slow down into the centre
+    klm_timeline_text(example_timeline, "Hello");
+    klm_timeline_move(example_timeline, 0, KLM_EASE_LINEAR,
+                      KLM_ANCHOR_AFTER, 0, KLM_ANCHOR_START, 0);
+    klm_timeline_move(example_timeline, 40, KLM_EASE_OUT,
+                      KLM_ANCHOR_CENTRE, 0, KLM_ANCHOR_START, 0);
+    klm_timeline_hold(example_timeline, 30);
+
+    // Blink twice
+    klm_timeline_reverse(example_timeline, true, 10);
+    klm_timeline_reverse(example_timeline, false, 10);
+    klm_timeline_reverse(example_timeline, true, 10);
+    klm_timeline_reverse(example_timeline, false, 10);
+
+    // Swap in a new message from below, then scroll it off to the left
+    klm_timeline_text(example_timeline, "World!");
+    klm_timeline_move(example_timeline, 0, KLM_EASE_LINEAR,
+                      KLM_ANCHOR_CENTRE, 0, KLM_ANCHOR_AFTER, 0);
+    klm_timeline_move(example_timeline, 20, KLM_EASE_IN_OUT,
+                      KLM_ANCHOR_CENTRE, 0, KLM_ANCHOR_START, 0);
+    klm_timeline_hold(example_timeline, 20);
+    klm_timeline_scroll(example_timeline, -1, 0, 60);
+    klm_timeline_scroll(example_timeline, 0, 0, 0);
+
+    klm_seg_set_timeline(example_segment, example_timeline);
+
+    // Nothing else to do but tick
+    int j;
+    for (j=0; j<EXAMPLE_TICKS; j++) {
+        klm_mat_tick(example_matrix);
+        if (j % EXAMPLE_DUMP_PERIOD == 0) {
+            printf("tick %d, keyframe %u\n", j, example_timeline->state.key);
+            klm_mat_dump_buffer(example_matrix);
+        }
+    }
+
+    // Clean up
+    klm_timeline_destroy(example_timeline);
+    klm_mat_destroy(example_matrix);
+    klm_config_destroy(example_config);
+
+    printf("Goodbye\n");
+    return EXIT_SUCCESS;
+}
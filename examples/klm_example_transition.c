@@ -0,0 +1,132 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_transition.h"
+#include "hexfont_iso-8859-15.h"
+
+#define EXAMPLE_MATRIX_WIDTH 96
+#define EXAMPLE_MATRIX_HEIGHT 16
+
+#define EXAMPLE_A 0
+#define EXAMPLE_B 2
+#define EXAMPLE_C 3
+#define EXAMPLE_D 1
+#define EXAMPLE_R1 4
+#define EXAMPLE_OE 21
+#define EXAMPLE_STB 22
+#define EXAMPLE_CLK 23
+
+#define EXAMPLE_DURATION 8
+#define EXAMPLE_REPEATS 10000
+
+static const char *example_names[] = {
+    "slide left", "slide right", "slide up", "slide down",
+    "wipe left", "wipe right", "wipe up", "wipe down",
+    "dissolve"
+};
+
+
+/**
+ * Change the text of a segment with each kind of transition in turn,
+ * showing the halfway frame, then time how long each one takes to
+ * compose a frame.
+ */
+int main() {
+    printf("Konker's LED Matrix library\n");
+
+    if (!klm_mat_begin()) {
+        fprintf(stderr, "Could not initialize matrix system. Aborting");
+        exit(EXIT_FAILURE);
+    }
+
+    klm_config *example_config =
+            klm_config_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    klm_config_set_pin(example_config, 'a', EXAMPLE_A);
+    klm_config_set_pin(example_config, 'b', EXAMPLE_B);
+    klm_config_set_pin(example_config, 'c', EXAMPLE_C);
+    klm_config_set_pin(example_config, 'd', EXAMPLE_D);
+    klm_config_set_pin(example_config, 'o', EXAMPLE_OE);
+    klm_config_set_pin(example_config, 'r', EXAMPLE_R1);
+    klm_config_set_pin(example_config, 's', EXAMPLE_STB);
+    klm_config_set_pin(example_config, 'x', EXAMPLE_CLK);
+
+    // Create a matrix with a single full-screen segment
+    klm_matrix *example_matrix = klm_mat_create(stdout, example_config);
+    hexfont * const example_font = hexfont_load_data(hexfont_iso_8859_15, 16);
+    klm_mat_simple_init(example_matrix, example_font);
+    klm_mat_simple_set_text(example_matrix, "BEFORE");
+    klm_mat_tick(example_matrix);
+
+    // Start the transition from what's on display, then change it
+    int type;
+    for (type=0; type<=KLM_TRANSITION_DISSOLVE; type++) {
+        klm_mat_start_transition(example_matrix, type, EXAMPLE_DURATION);
+        klm_mat_simple_set_text(example_matrix, (type % 2) ? "BEFORE" : "AFTER");
+
+        int t;
+        for (t=0; t<EXAMPLE_DURATION; t++) {
+            klm_mat_tick(example_matrix);
+            if (t == EXAMPLE_DURATION/2 - 1) {
+                printf("%s, halfway\n", example_names[type]);
+                klm_mat_dump_buffer(example_matrix);
+            }
+        }
+    }
+
+    // Cost of composing a frame, between two frames which differ everywhere
+    klm_transition * const example_transition =
+        klm_transition_create(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    size_t len = KLM_BUFFER_LEN(EXAMPLE_MATRIX_WIDTH, EXAMPLE_MATRIX_HEIGHT);
+    uint8_t *from = calloc(len, 1);
+    uint8_t *to = malloc(len);
+    uint8_t *dst = malloc(len);
+    memset(to, 0xFF, len);
+
+    for (type=0; type<=KLM_TRANSITION_DISSOLVE; type++) {
+        klm_transition_start(example_transition, type, EXAMPLE_DURATION, from);
+
+        int64_t start = klm_pacer_now_nanos();
+        int r;
+        for (r=0; r<EXAMPLE_REPEATS; r++) {
+            klm_transition_compose(example_transition, from, to, dst, 1 + r % (EXAMPLE_DURATION - 1));
+        }
+        int64_t elapsed = klm_pacer_now_nanos() - start;
+        printf("%-12s %8.3f us/frame\n", example_names[type], elapsed / 1000.0 / EXAMPLE_REPEATS);
+    }
+
+    // Clean up
+    free(dst);
+    free(to);
+    free(from);
+    klm_transition_destroy(example_transition);
+    klm_mat_destroy(example_matrix);
+    klm_config_destroy(example_config);
+
+    printf("Goodbye\n");
+    return EXIT_SUCCESS;
+}
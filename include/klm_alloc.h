@@ -0,0 +1,81 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_ALLOC_H__
+#define __KONKER_LED_ALLOC_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * All of the library's memory goes through these functions.
+ *
+ * Normally they are thin wrappers around the heap. A KLM_STATIC build never
+ * touches the heap: objects are carved out of an arena which the caller
+ * provides up front, and freeing is a no-op.
+ *
+ * Either way every call is counted, so that a program can check that
+ * nothing is allocated once it has been set up, e.g. in klm_mat_tick.
+ */
+
+// Allocations from the arena are aligned to this many bytes
+#define KLM_ALLOC_ALIGN sizeof(void *)
+
+typedef struct klm_alloc_stats {
+    uint32_t alloc_count;
+    uint32_t free_count;
+    uint32_t fail_count;
+    size_t   alloc_bytes;
+
+} klm_alloc_stats;
+
+
+void *klm_malloc(size_t size);
+void *klm_calloc(size_t count, size_t size);
+void klm_free(void *ptr);
+char *klm_strdup(const char *s);
+
+/** Running totals of the library's allocations. The counters are not thread safe */
+const klm_alloc_stats * const klm_alloc_get_stats(void);
+
+/** Set all the counters back to zero */
+void klm_alloc_reset_stats(void);
+
+#ifdef KLM_STATIC
+/** Give the library the memory to create all of its objects in. Call before creating anything */
+void klm_alloc_set_arena(void * const buffer, size_t size);
+
+/** Bytes of the arena used so far */
+size_t klm_alloc_get_arena_used(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_ALLOC_H__
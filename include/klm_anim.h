@@ -0,0 +1,181 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_ANIM_H__
+#define __KONKER_LED_ANIM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define KLM_ANIM_MAGIC 0x414d4c4b
+#define KLM_ANIM_VERSION 1
+
+#define KLM_ANIM_FRAME_KEY 0x01
+#define KLM_ANIM_FRAME_DELTA 0x02
+
+#define KLM_ANIM_DEFAULT_KEY_INTERVAL 32
+
+/*
+ * An animation file is a header, then the frames, then a seek index with an
+ * entry for each keyframe. All values are in the machine's byte order.
+ *
+ * Each frame's payload is the XOR of the frame with the previous one (or with
+ * a blank frame, for a keyframe), run length encoded as a series of tokens:
+ *   0x00-0x7F  the next (token + 1) bytes are literal
+ *   0x80-0xFF  (token - 0x80 + 1) zero bytes, i.e. unchanged
+ */
+typedef struct __klm_anim_header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint16_t width;
+    uint16_t height;
+    uint32_t frame_count;
+    uint32_t total_ticks;
+    uint32_t index_offset;
+    uint32_t index_count;
+
+} __klm_anim_header_t;
+
+typedef struct __klm_anim_frame_t {
+    uint8_t type;
+    uint8_t _pad;
+
+    // How many ticks the frame stays on display
+    uint16_t duration;
+
+    // Bytes of encoded payload which follow
+    uint32_t length;
+
+} __klm_anim_frame_t;
+
+typedef struct __klm_anim_index_t {
+    uint32_t frame;
+    uint32_t offset;
+    uint32_t tick;
+
+} __klm_anim_index_t;
+
+/**
+ * Plays an animation file into a matrix, beneath the segments.
+ *
+ * The file is memory mapped for sequential access, so the kernel reads ahead
+ * and drops pages once played, and only the current frame is kept in RAM.
+ * Each frame is decoded in place over the previous one.
+ */
+typedef struct klm_anim_player
+{
+    __klm_anim_header_t header;
+    bool loop;
+
+    // The frame on display, its position, and how many more ticks it stays
+    uint8_t *frame;
+    size_t buffer_len;
+    uint32_t frame_index;
+    uint16_t hold;
+
+    // Statistics
+    uint32_t decode_count;
+    uint32_t seek_count;
+
+    // Internal vars
+    int _fd;
+    const uint8_t *_map;
+    size_t _map_len;
+    const __klm_anim_index_t *_index;
+    size_t _offset;
+
+} klm_anim_player;
+
+/**
+ * Writes an animation file a frame at a time.
+ *
+ * Frames identical to the one before just extend its duration, and a
+ * keyframe is written every key_interval frames, or whenever it would be
+ * smaller than the delta.
+ */
+typedef struct klm_anim_encoder
+{
+    __klm_anim_header_t header;
+    uint16_t key_interval;
+
+    // Statistics
+    uint32_t key_count;
+    uint32_t bytes_written;
+
+    // Internal vars
+    FILE *_fp;
+    bool _failed;
+    size_t _buffer_len;
+    uint8_t *_current;
+    uint8_t *_scratch;
+    uint8_t *_payload;
+    __klm_anim_frame_t _pending;
+    bool _has_pending;
+    uint16_t _since_key;
+    __klm_anim_index_t *_index;
+    uint32_t _index_capacity;
+
+} klm_anim_encoder;
+
+
+/** Open an animation file for playback, or NULL if it can't be read */
+klm_anim_player * const klm_anim_player_open(const char *path);
+
+/** Close an animation file */
+void klm_anim_player_close(klm_anim_player * const player);
+
+/** Go back to the first frame at the end, rather than staying on the last */
+void klm_anim_player_set_loop(klm_anim_player * const player, bool loop);
+
+/** Jump to the given frame, decoding forward from the keyframe before it */
+bool klm_anim_player_seek(klm_anim_player * const player, uint32_t frame);
+
+/** Count down the current frame's duration, and decode the next frame when it is up */
+void klm_anim_player_tick(klm_anim_player * const player);
+
+/** Create an animation file for frames of the given size */
+klm_anim_encoder * const klm_anim_encoder_create(const char *path,
+                                                 uint16_t width,
+                                                 uint16_t height,
+                                                 uint16_t key_interval);
+
+/** Add a 1bpp frame, to be shown for the given number of ticks */
+bool klm_anim_encoder_add_frame(klm_anim_encoder * const encoder,
+                                const uint8_t * const buffer,
+                                uint16_t duration);
+
+/** Write out the index and header, close the file and clean up. Returns false if anything failed to write */
+bool klm_anim_encoder_finish(klm_anim_encoder * const encoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_ANIM_H__
@@ -0,0 +1,137 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_BITPLANES_H__
+#define __KONKER_LED_BITPLANES_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "klm_colour.h"
+#include "klm_wire_format.h"
+
+#define KLM_BITPLANES_MAX_DEPTH 8
+
+#ifndef KLM_BITPLANES_DEFAULT_DEPTH
+#  define KLM_BITPLANES_DEFAULT_DEPTH 4
+#endif
+
+#ifndef KLM_BITPLANES_MAX_COLOURS
+#  define KLM_BITPLANES_MAX_COLOURS 32
+#endif
+
+// Palette index 0 is always black, 1 is the colour of anything not otherwise coloured
+#define KLM_BITPLANES_BLACK 0
+#define KLM_BITPLANES_DEFAULT 1
+
+// Bits of each wire byte, one per HUB75 data line
+#define KLM_HUB75_R1 0x01
+#define KLM_HUB75_G1 0x02
+#define KLM_HUB75_B1 0x04
+#define KLM_HUB75_R2 0x08
+#define KLM_HUB75_G2 0x10
+#define KLM_HUB75_B2 0x20
+#define KLM_HUB75_MASK 0x3F
+
+
+/**
+ * Binary coded modulation bitplanes for a HUB75 RGB panel.
+ *
+ * Segments still render into the 1bpp display buffers. Each pixel also has
+ * an attribute, an index into a small palette, and encoding combines the two.
+ *
+ * Each row address drives two rows at once, row `address` on the R1/G1/B1
+ * lines and row `address + height/2` on R2/G2/B2. The encoded data holds one
+ * byte per column, with the six data bits for one clock edge, laid out as
+ * data[plane][address][column] so each plane's row is shifted out in order.
+ * Plane n is displayed for 2^n periods.
+ */
+typedef struct klm_bitplanes
+{
+    uint16_t width;
+    uint16_t height;
+    uint16_t address_count;
+    uint8_t depth;
+
+    // Bytes in each plane
+    size_t plane_len;
+
+    uint8_t *data;
+
+    // Palette index for each pixel
+    uint8_t *attributes;
+
+    klm_colour palette[KLM_BITPLANES_MAX_COLOURS];
+    uint8_t palette_len;
+
+    // Gamma corrected R1/G1/B1 bits of each palette colour for every plane, a byte per plane
+    uint64_t _lanes[KLM_BITPLANES_MAX_COLOURS];
+
+} klm_bitplanes;
+
+
+/** Create bitplanes for a panel of the given size, with the given number of bits per channel */
+klm_bitplanes * const klm_bitplanes_create(uint16_t width, uint16_t height, uint8_t depth);
+
+/** Clean up bitplanes */
+void klm_bitplanes_destroy(klm_bitplanes * const bitplanes);
+
+/** Palette index for the given colour, adding it if need be. Returns the nearest colour if the palette is full */
+uint8_t klm_bitplanes_add_colour(klm_bitplanes * const bitplanes, klm_colour colour);
+
+/** Change the colour of anything which hasn't been given one */
+void klm_bitplanes_set_default_colour(klm_bitplanes * const bitplanes, klm_colour colour);
+
+/** Give a rectangle of pixels the given palette index */
+void klm_bitplanes_fill(klm_bitplanes * const bitplanes,
+                        int16_t x, int16_t y,
+                        uint16_t w, uint16_t h,
+                        uint8_t index);
+
+/** Encode a 1bpp frame buffer into the bitplanes, using the pixel attributes for colour */
+void klm_bitplanes_encode(klm_bitplanes * const bitplanes,
+                          const klm_wire_format * const format,
+                          const uint8_t * const src);
+
+/** Total number of periods in one row address' worth of planes */
+static inline uint16_t klm_bitplanes_get_period_count(const klm_bitplanes * const bitplanes) {
+    return (uint16_t)((1 << bitplanes->depth) - 1);
+}
+
+/** The bytes to shift out for the given plane of the given row address */
+static inline const uint8_t * klm_bitplanes_get_row(const klm_bitplanes * const bitplanes,
+                                                    uint8_t plane,
+                                                    uint16_t address)
+{
+    return bitplanes->data + plane*bitplanes->plane_len + (size_t)address*bitplanes->width;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_BITPLANES_H__
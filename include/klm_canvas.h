@@ -0,0 +1,142 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_CANVAS_H__
+#define __KONKER_LED_CANVAS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <hexfont.h>
+
+#define KLM_CANVAS_WORD_WIDTH 32
+
+
+/**
+ * An offscreen 1bpp canvas which can be much larger than the display.
+ *
+ * Pixels are packed 32 to a word, with pixel x at bit (x % 32) of word (x / 32),
+ * which is the same bit order as the display buffers. Each row has one extra
+ * zero word of padding so that shifted reads never run off the end of a row.
+ */
+typedef struct klm_canvas
+{
+    int32_t width;
+    int32_t height;
+
+    uint32_t *buffer;
+
+    // Internal vars
+    uint32_t _row_words;
+
+} klm_canvas;
+
+/**
+ * A camera onto a canvas, which is copied into a matrix's back buffer on each tick.
+ */
+typedef struct klm_viewport
+{
+    klm_canvas *canvas;
+
+    // Position of the top left of the display within the canvas
+    float x;
+    float y;
+
+    // Panning speed in pixels per tick
+    float hspeed;
+    float vspeed;
+
+    // Wrap around the edges of the canvas rather than showing blank space
+    bool wrap;
+
+} klm_viewport;
+
+
+/** Create a blank canvas */
+klm_canvas * const klm_canvas_create(int32_t width, int32_t height);
+
+/** Clean up a canvas */
+void klm_canvas_destroy(klm_canvas * const canvas);
+
+/** Clear the entire canvas */
+void klm_canvas_clear(klm_canvas * const canvas);
+
+/** Draw a sprite onto the canvas */
+void klm_canvas_render_sprite(klm_canvas * const canvas,
+                              hexfont_character * const sprite,
+                              int32_t x, int32_t y);
+
+/** Draw UTF-8 text onto the canvas, returns the x coordinate after the last character */
+int32_t klm_canvas_render_text(klm_canvas * const canvas,
+                               hexfont * const font,
+                               const char * const text,
+                               int32_t x, int32_t y);
+
+/** Copy a width x height window at (x, y) of the canvas into a 1bpp buffer */
+void klm_canvas_copy_window(klm_canvas * const canvas,
+                            int32_t x, int32_t y,
+                            bool wrap,
+                            uint8_t * const dst,
+                            uint16_t width, uint16_t height);
+
+/** Advance a viewport by its speed */
+void klm_viewport_tick(klm_viewport * const viewport);
+
+// Inline funtions
+// ----------------------------------------------------------------------------
+/** Set a pixel of the canvas */
+static inline void klm_canvas_set_pixel(klm_canvas * const canvas, int32_t x, int32_t y) {
+    if (x < 0 || x >= canvas->width || y < 0 || y >= canvas->height) {
+        return;
+    }
+    canvas->buffer[y*canvas->_row_words + x/KLM_CANVAS_WORD_WIDTH] |=
+        (1UL << (x % KLM_CANVAS_WORD_WIDTH));
+}
+
+/** Clear a pixel of the canvas */
+static inline void klm_canvas_clear_pixel(klm_canvas * const canvas, int32_t x, int32_t y) {
+    if (x < 0 || x >= canvas->width || y < 0 || y >= canvas->height) {
+        return;
+    }
+    canvas->buffer[y*canvas->_row_words + x/KLM_CANVAS_WORD_WIDTH] &=
+        ~(1UL << (x % KLM_CANVAS_WORD_WIDTH));
+}
+
+/** Query whether or not the given pixel of the canvas has been set */
+static inline bool klm_canvas_is_pixel_set(klm_canvas * const canvas, int32_t x, int32_t y) {
+    if (x < 0 || x >= canvas->width || y < 0 || y >= canvas->height) {
+        return false;
+    }
+    return (canvas->buffer[y*canvas->_row_words + x/KLM_CANVAS_WORD_WIDTH] >>
+                (x % KLM_CANVAS_WORD_WIDTH)) & 0x01;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_CANVAS_H__
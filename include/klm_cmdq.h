@@ -0,0 +1,146 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_CMDQ_H__
+#define __KONKER_LED_CMDQ_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "klm_segment.h"
+
+// Must be a power of two
+#ifndef KLM_CMDQ_DEFAULT_CAPACITY
+#define KLM_CMDQ_DEFAULT_CAPACITY 64
+#endif
+
+typedef enum {
+    KLM_CMD_SET_TEXT,
+    KLM_CMD_SET_TEXT_SPEED,
+    KLM_CMD_SET_TEXT_POSITION,
+    KLM_CMD_CLEAR_TEXT,
+    KLM_CMD_SHOW,
+    KLM_CMD_HIDE,
+    KLM_CMD_START,
+    KLM_CMD_STOP,
+    KLM_CMD_REVERSE,
+    KLM_CMD_CALL
+} klm_command_type;
+
+/** Run at the next tick with apply set, or without it if the queue is destroyed first, to release data */
+typedef void (*klm_command_fn)(void *data, bool apply);
+
+/** A deferred segment mutation */
+typedef struct klm_command
+{
+    klm_command_type type;
+    klm_segment *seg;
+
+    // Heap allocated text, owned by the queue once posted
+    char *text;
+
+    // Speed or position
+    float h;
+    float v;
+
+    // Function to call, and its argument
+    klm_command_fn fn;
+    void *data;
+
+} klm_command;
+
+// One preallocated slot of the ring
+typedef struct __klm_cmdq_slot_t {
+    atomic_size_t sequence;
+    klm_command command;
+
+} __klm_cmdq_slot_t;
+
+/**
+ * A bounded lock-free multi-producer/single-consumer queue of commands.
+ *
+ * Any thread may post; posting never blocks, and fails if the queue is full.
+ * The commands are applied by the rendering thread at the start of each tick.
+ */
+typedef struct klm_cmdq
+{
+    __klm_cmdq_slot_t *slots;
+    size_t mask;
+
+    // Next slot to be claimed by a producer
+    atomic_size_t tail;
+
+    // Next slot to be consumed, only touched by the consumer
+    size_t head;
+
+    // Statistics
+    atomic_uint dropped_count;
+
+} klm_cmdq;
+
+
+/** Create a command queue with the given capacity, which must be a power of two. Returns NULL if it isn't */
+klm_cmdq * const klm_cmdq_create(size_t capacity);
+
+/** Clean up a command queue, freeing any text which was never applied */
+void klm_cmdq_destroy(klm_cmdq * const q);
+
+/** Post a command, returns false if the queue is full */
+bool klm_cmdq_post(klm_cmdq * const q, const klm_command * const cmd);
+
+/** Apply all pending commands, returns the number applied. Must only be called by one thread */
+uint16_t klm_cmdq_apply(klm_cmdq * const q);
+
+/** Drop the pending commands for a segment which is being destroyed. Must only be called by the applying thread */
+void klm_cmdq_cancel_segment(klm_cmdq * const q, klm_segment * const seg);
+
+/**
+ * Post a new text for a segment. On success the queue takes ownership of the
+ * heap allocated text and hands it straight over to the segment; on failure
+ * the caller keeps ownership. In a KLM_STATIC build the text is copied when
+ * the command is applied, so it must stay valid until then.
+ */
+bool klm_cmdq_post_set_text(klm_cmdq * const q, klm_segment * const seg, char * const text);
+
+/** Post a new text scroll speed for a segment */
+bool klm_cmdq_post_set_text_speed(klm_cmdq * const q, klm_segment * const seg, float hspeed, float vspeed);
+
+/** Post a new text position for a segment */
+bool klm_cmdq_post_set_text_position(klm_cmdq * const q, klm_segment * const seg, float text_hpos, float text_vpos);
+
+/** Post a command which takes no arguments (show, hide, start, stop, reverse, clear text) */
+bool klm_cmdq_post_simple(klm_cmdq * const q, klm_segment * const seg, klm_command_type type);
+
+/** Post a function to be called by the rendering thread, e.g. to apply several changes in the same tick */
+bool klm_cmdq_post_call(klm_cmdq * const q, klm_command_fn fn, void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_CMDQ_H__
@@ -0,0 +1,65 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_COLOUR_H__
+#define __KONKER_LED_COLOUR_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/** A 24-bit RGB colour */
+typedef struct klm_colour
+{
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+
+} klm_colour;
+
+#define KLM_COLOUR(r, g, b) ((klm_colour){ (r), (g), (b) })
+
+#define KLM_COLOUR_BLACK   KLM_COLOUR(0x00, 0x00, 0x00)
+#define KLM_COLOUR_WHITE   KLM_COLOUR(0xFF, 0xFF, 0xFF)
+#define KLM_COLOUR_RED     KLM_COLOUR(0xFF, 0x00, 0x00)
+#define KLM_COLOUR_GREEN   KLM_COLOUR(0x00, 0xFF, 0x00)
+#define KLM_COLOUR_BLUE    KLM_COLOUR(0x00, 0x00, 0xFF)
+#define KLM_COLOUR_YELLOW  KLM_COLOUR(0xFF, 0xFF, 0x00)
+#define KLM_COLOUR_CYAN    KLM_COLOUR(0x00, 0xFF, 0xFF)
+#define KLM_COLOUR_MAGENTA KLM_COLOUR(0xFF, 0x00, 0xFF)
+
+
+/** Whether two colours are the same */
+static inline bool klm_colour_equals(klm_colour a, klm_colour b) {
+    return (a.r == b.r && a.g == b.g && a.b == b.b);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_COLOUR_H__
@@ -30,17 +30,44 @@ extern "C" {
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include "klm_pin_list.h"
+#include "klm_wire_format.h"
 
+// Pin names of the HUB75 colour data lines. R1 is the usual data pin,
+// and 'b' is already taken by row address B, so blue is 'u'
+#define KLM_PIN_R1 'r'
+#define KLM_PIN_G1 'g'
+#define KLM_PIN_B1 'u'
+#define KLM_PIN_R2 'R'
+#define KLM_PIN_G2 'G'
+#define KLM_PIN_B2 'U'
 
 typedef struct {
     // Data structure for holding GPIO control pins
     klm_pin_list * pin_list;
 
-    // Physical dimensions of the display
+    // Dimensions of the display as it is drawn on, whichever way up the panel is
     uint16_t width;
     uint16_t height;
 
+    // How the panel is mounted, applied when the frame is encoded for the wire
+    klm_rotation rotation;
+    bool mirror_x;
+    bool mirror_y;
+
+    // Optional spidev device used to send pixel data, NULL for bit-banging
+    char * spi_device;
+    uint32_t spi_speed_hz;
+
+    // GPIO character device used by the libgpiod backend
+    char * gpio_chip;
+
+    // Size of the cache of scaled and styled glyphs, made when the matrix is initialized.
+    // Without one text is always drawn plain. Static builds have none unless asked
+    uint16_t glyph_cache_capacity;
+    uint8_t glyph_cache_max_scale;
+
 } klm_config;
 
 klm_config * const klm_config_create(int16_t width, int16_t height);
@@ -48,6 +75,12 @@ void klm_config_destroy(klm_config * const config);
 
 void klm_config_set_pin(klm_config * const config, char pin_name, uint8_t pin_number);
 uint8_t klm_config_get_pin(klm_config * const config, char pin_name);
+bool klm_config_has_pin(klm_config * const config, char pin_name);
+
+void klm_config_set_spi_device(klm_config * const config, const char * const path, uint32_t speed_hz);
+void klm_config_set_gpio_chip(klm_config * const config, const char * const path);
+void klm_config_set_orientation(klm_config * const config, klm_rotation rotation, bool mirror_x, bool mirror_y);
+void klm_config_set_glyph_cache(klm_config * const config, uint16_t capacity, uint8_t max_scale);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,217 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_CONTROL_H__
+#define __KONKER_LED_CONTROL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "klm_matrix.h"
+#include "klm_runtime.h"
+
+// Largest message, which is one datagram
+#define KLM_CONTROL_MAX_MESSAGE 4096
+
+// Most commands in one message
+#define KLM_CONTROL_MAX_COMMANDS 64
+
+// Messages which can be waiting for a tick at once
+#ifndef KLM_CONTROL_BATCHES
+#define KLM_CONTROL_BATCHES 4
+#endif
+
+#define KLM_CONTROL_MAGIC_0 'K'
+#define KLM_CONTROL_MAGIC_1 'L'
+#define KLM_CONTROL_VERSION 1
+#define KLM_CONTROL_HEADER_LEN 4
+#define KLM_CONTROL_COMMAND_HEADER_LEN 4
+
+
+/**
+ * Each message is a 4 byte header: 'K', 'L', the version and the number
+ * of commands. Each command is its op, the index of the segment in the
+ * matrix's list, and the length of its payload as a little endian uint16,
+ * followed by the payload. Numbers in payloads are little endian.
+ */
+typedef enum klm_control_op {
+    // Well-formed UTF-8 text, not terminated
+    KLM_CONTROL_SET_TEXT = 0x01,
+
+    // Two finite float32: horizontal and vertical
+    KLM_CONTROL_SET_TEXT_SPEED = 0x02,
+    KLM_CONTROL_SET_TEXT_POSITION = 0x03,
+
+    // No payload
+    KLM_CONTROL_CLEAR_TEXT = 0x04,
+    KLM_CONTROL_SHOW = 0x05,
+    KLM_CONTROL_HIDE = 0x06,
+    KLM_CONTROL_START = 0x07,
+    KLM_CONTROL_STOP = 0x08,
+    KLM_CONTROL_REVERSE = 0x09,
+
+    // int16 x, int16 y, uint16 width, uint16 height, uint8 font index.
+    // The segment index is ignored, and the new segment goes on the end of the list.
+    // Neither this nor DESTROY_SEGMENT is accepted by a KLM_STATIC build
+    KLM_CONTROL_CREATE_SEGMENT = 0x10,
+
+    // No payload. Later segments move down one place in the list. Only segments
+    // created by CREATE_SEGMENT can be destroyed, and never the last one
+    KLM_CONTROL_DESTROY_SEGMENT = 0x11
+
+} klm_control_op;
+
+/** The one byte reply to a client which has bound an address of its own */
+typedef enum klm_control_status {
+    KLM_CONTROL_OK = 0,
+    KLM_CONTROL_BAD_MESSAGE,
+    KLM_CONTROL_BAD_COMMAND,
+    KLM_CONTROL_BUSY
+
+} klm_control_status;
+
+// A parsed command, waiting to be applied
+typedef struct __klm_control_command_t {
+    klm_control_op op;
+    uint8_t segment;
+    float h;
+    float v;
+    int16_t x;
+    int16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint8_t font_index;
+    const char *text;
+
+} __klm_control_command_t;
+
+// A message's commands, applied together at a tick
+typedef struct __klm_control_batch_t {
+    atomic_bool busy;
+    klm_matrix *matrix;
+    uint8_t count;
+    __klm_control_command_t commands[KLM_CONTROL_MAX_COMMANDS];
+
+    // The commands' text, terminated
+    char text[KLM_CONTROL_MAX_MESSAGE];
+
+} __klm_control_batch_t;
+
+/**
+ * Takes commands for a matrix from other processes, as datagrams on a
+ * UNIX domain socket.
+ *
+ * All of a message's commands are checked when it is received, and then
+ * applied together at the start of the next tick through the matrix's
+ * command queue, so a message is atomic. Batches are preallocated.
+ *
+ * Receive from one thread at a time. Destroy the matrix first, or let it
+ * tick once after the last receive, before destroying the control.
+ */
+typedef struct klm_control
+{
+    klm_matrix *matrix;
+    int fd;
+    char *path;
+
+    // Statistics, only touched by the receiving thread
+    uint32_t batch_count;
+    uint32_t command_count;
+    uint32_t rejected_count;
+
+    // Internal vars
+    uint8_t *_message;
+    __klm_control_batch_t *_batches;
+
+} klm_control;
+
+/** A message being built by a client */
+typedef struct klm_control_message
+{
+    uint8_t data[KLM_CONTROL_MAX_MESSAGE];
+    size_t len;
+
+} klm_control_message;
+
+
+/** Create a control socket for the matrix at the given path, replacing anything already there. NULL on failure */
+klm_control * const klm_control_create(klm_matrix * const matrix, const char * const path);
+
+/** Close and remove the control socket */
+void klm_control_destroy(klm_control * const control);
+
+/** Read every waiting message, queueing those which are valid. Returns the number queued */
+uint16_t klm_control_receive(klm_control * const control);
+
+/** Check a message and queue it for the next tick */
+klm_control_status klm_control_submit(klm_control * const control,
+                                      const uint8_t * const message,
+                                      size_t len);
+
+/** Receive whenever the socket is readable, from the runtime's thread */
+bool klm_control_add_to_runtime(klm_control * const control, klm_runtime * const runtime);
+
+
+// Client functions
+// ----------------------------------------------------------------------------
+/** Start a new, empty, message */
+void klm_control_message_init(klm_control_message * const message);
+
+/** Add a command with the given payload. Returns false if it won't fit */
+bool klm_control_message_add(klm_control_message * const message,
+                             klm_control_op op,
+                             uint8_t segment,
+                             const void * const payload,
+                             uint16_t payload_len);
+
+/** Add a set text command */
+bool klm_control_message_add_text(klm_control_message * const message, uint8_t segment, const char * const text);
+
+/** Add a set speed or position command */
+bool klm_control_message_add_floats(klm_control_message * const message,
+                                    klm_control_op op,
+                                    uint8_t segment,
+                                    float h, float v);
+
+/** Add a create segment command */
+bool klm_control_message_add_create(klm_control_message * const message,
+                                    int16_t x, int16_t y,
+                                    uint16_t width, uint16_t height,
+                                    uint8_t font_index);
+
+/** Open a socket to the control socket at the given path. Replies come back on it. -1 on failure */
+int klm_control_connect(const char * const path);
+
+/** Send a message in one syscall */
+bool klm_control_send(int fd, const klm_control_message * const message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_CONTROL_H__
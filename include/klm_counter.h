@@ -0,0 +1,107 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_COUNTER_H__
+#define __KONKER_LED_COUNTER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define KLM_COUNTER_MAX_CELLS 16
+
+// Characters which get a pre-rendered glyph, anything else shows as a blank cell
+#define KLM_COUNTER_CHARSET "0123456789:.-+/%"
+
+// Forward declare klm_segment because of circular refs
+typedef struct klm_segment klm_segment;
+
+/**
+ * A row of fixed width character cells for clocks and counters.
+ *
+ * The glyphs for the digits and separators are rendered once, when the
+ * counter is created. Setting a new value only redraws the cells whose
+ * character has changed into the counter's own bitmap, which the segment
+ * then copies into the display buffer a byte at a time on each tick,
+ * instead of going through the segment's text.
+ */
+typedef struct klm_counter
+{
+    klm_segment *segment;
+
+    uint8_t cell_count;
+    uint8_t cell_width;
+    uint8_t cell_height;
+
+    // The character currently drawn in each cell
+    char cells[KLM_COUNTER_MAX_CELLS];
+
+    // Statistics
+    uint32_t update_count;
+    uint32_t cell_render_count;
+
+    // Internal vars
+    uint8_t _glyph_index[128];
+    uint8_t *_glyphs;
+    uint8_t *_bitmap;
+    size_t _glyph_stride;
+    size_t _row_stride;
+
+} klm_counter;
+
+
+/** Create a counter of cell_count cells, drawn by the given segment in its font */
+klm_counter * const klm_counter_create(klm_segment * const seg, uint8_t cell_count);
+
+/** Clean up a counter, and detach it from its segment */
+void klm_counter_destroy(klm_counter * const counter);
+
+/** Show the given ASCII text from the first cell, blanking any cells after it */
+void klm_counter_set_text(klm_counter * const counter, const char * const text);
+
+/** Show a number right aligned, padded with zeros or blanks */
+void klm_counter_set_number(klm_counter * const counter, int32_t value, bool zero_pad);
+
+/** Show a time as HH:MM:SS, or HH:MM if the counter has fewer than 8 cells */
+void klm_counter_set_time(klm_counter * const counter, uint8_t hours, uint8_t minutes, uint8_t seconds);
+
+/** Render the glyphs again, e.g. after the segment's font has changed */
+void klm_counter_refresh(klm_counter * const counter);
+
+/** Copy the counter into the display buffer at the segment's text position */
+void klm_counter_render(klm_counter * const counter);
+
+/** Helpers */
+static inline uint16_t klm_counter_get_pixel_width(klm_counter * const counter) {
+    return counter->cell_count * counter->cell_width;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_COUNTER_H__
@@ -0,0 +1,104 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_DITHER_H__
+#define __KONKER_LED_DITHER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define KLM_DITHER_DEFAULT_THRESHOLD 128
+
+// Size of the ordered dither pattern
+#define KLM_DITHER_BAYER_ORDER 8
+
+
+/** Layout of the source image, the value is the number of bytes per pixel */
+typedef enum klm_pixel_format {
+    KLM_PIXEL_GREY8 = 1,
+    KLM_PIXEL_RGB24 = 3
+
+} klm_pixel_format;
+
+typedef enum klm_dither_mode {
+    // Just compare each pixel to the threshold, the fastest
+    KLM_DITHER_THRESHOLD,
+
+    // Compare against an 8x8 Bayer pattern centred on the threshold
+    KLM_DITHER_ORDERED,
+
+    // Floyd-Steinberg error diffusion, the best looking but serial along each row
+    KLM_DITHER_DIFFUSION
+
+} klm_dither_mode;
+
+/**
+ * Converts rows of 8-bit greyscale or RGB pixels to 1bpp, packed LSB first
+ * the same as the display buffers.
+ *
+ * Threshold and ordered dithering both compare each row against a row of
+ * per-column thresholds, so share one vectorized compare and pack kernel.
+ */
+typedef struct klm_dither
+{
+    uint16_t width;
+    klm_pixel_format format;
+    klm_dither_mode mode;
+    uint8_t threshold;
+
+    // Internal vars
+    uint8_t *_grey;
+    uint8_t *_thresholds;
+    int16_t *_error;
+
+} klm_dither;
+
+
+/** Create a ditherer for rows of the given width */
+klm_dither * const klm_dither_create(uint16_t width, klm_pixel_format format, klm_dither_mode mode);
+
+/** Clean up a ditherer */
+void klm_dither_destroy(klm_dither * const dither);
+
+/** Change the dithering mode */
+void klm_dither_set_mode(klm_dither * const dither, klm_dither_mode mode);
+
+/** Change the grey level above which pixels are lit */
+void klm_dither_set_threshold(klm_dither * const dither, uint8_t threshold);
+
+/** Convert row y of an image into width/8 bytes at dst. Rows must be given in order, starting from 0 */
+void klm_dither_row(klm_dither * const dither,
+                    const uint8_t * const src,
+                    uint16_t y,
+                    uint8_t * const dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_DITHER_H__
@@ -0,0 +1,105 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_FONT_CHAIN_H__
+#define __KONKER_LED_FONT_CHAIN_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <hexfont.h>
+#include <hexfont_list.h>
+
+#define KLM_FONT_CHAIN_MAX_FONTS 8
+
+// Must be powers of two. Static builds never grow past the initial size
+#define KLM_FONT_CHAIN_INITIAL_CACHE 64
+#define KLM_FONT_CHAIN_MAX_CACHE 1024
+
+// Memo entry for one resolved codepoint
+typedef struct __klm_font_chain_entry_t {
+    uint32_t codepoint;
+    hexfont_character *glyph;
+    uint8_t font_index;
+    bool used;
+
+} __klm_font_chain_entry_t;
+
+/**
+ * An ordered list of fonts to try in turn for each codepoint,
+ * e.g. a Latin font, then a symbol font, then a CJK font.
+ *
+ * Lookups are memoized, including misses, so each codepoint is only
+ * searched for across the fonts once. Once the memo table is as big as
+ * it may get, further codepoints are looked up but not remembered.
+ */
+typedef struct klm_font_chain
+{
+    hexfont_list *font_list;
+
+    // Indexes into font_list, in the order they are tried
+    uint8_t font_indices[KLM_FONT_CHAIN_MAX_FONTS];
+    uint8_t length;
+
+    // Statistics
+    uint32_t hit_count;
+    uint32_t miss_count;
+
+    // Internal vars
+    __klm_font_chain_entry_t *_cache;
+    size_t _cache_mask;
+    size_t _cache_count;
+
+} klm_font_chain;
+
+
+/** Create an empty chain over the fonts in the given list */
+klm_font_chain * const klm_font_chain_create(hexfont_list * const font_list);
+
+/** Clean up a chain. The fonts themselves belong to the font list */
+void klm_font_chain_destroy(klm_font_chain * const chain);
+
+/**
+ * Add the font at the given index of the font list to the end of the chain.
+ * Segments already using the chain keep the glyphs they have until their
+ * text or font chain is set again.
+ */
+bool klm_font_chain_append(klm_font_chain * const chain, uint8_t font_index);
+
+/** Find the glyph for a codepoint in the first font which has it, or NULL */
+hexfont_character * const klm_font_chain_get(klm_font_chain * const chain,
+                                             uint32_t codepoint,
+                                             uint8_t * const font_index);
+
+/** Forget all memoized lookups, e.g. after the fonts have changed */
+void klm_font_chain_clear_cache(klm_font_chain * const chain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_FONT_CHAIN_H__
@@ -0,0 +1,138 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_FRAMEQ_H__
+#define __KONKER_LED_FRAMEQ_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "klm_timeline.h"
+
+#define KLM_FRAMEQ_DEFAULT_CAPACITY 8
+
+// The animation state of a segment, enough to rewind it to a given frame
+typedef struct klm_frame_seg_state {
+    float text_hpos;
+    float text_vpos;
+    float page_vpos;
+    uint16_t page;
+    uint16_t page_hold;
+
+    // Timelines also change these as they play
+    float text_hspeed;
+    float text_vspeed;
+    bool visible;
+    bool reverse;
+    bool paused;
+    klm_timeline_state timeline;
+
+} klm_frame_seg_state;
+
+// A rendered frame, and the state the segments were left in after rendering it
+typedef struct klm_frame {
+    uint8_t *buffer;
+
+    klm_frame_seg_state *seg_states;
+    float viewport_x;
+    float viewport_y;
+    uint32_t anim_frame;
+    uint16_t anim_hold;
+    uint16_t transition_tick;
+
+    // The shared frame number, when the matrix is synchronized with others
+    uint32_t sync_frame;
+
+} klm_frame;
+
+/**
+ * A bounded ring of frames rendered ahead of time.
+ *
+ * Frames are pushed by rendering into the buffer at the tail, and popped
+ * by swapping the head's buffer with the display buffer, so neither end
+ * copies any pixels.
+ */
+typedef struct klm_frameq
+{
+    size_t capacity;
+    size_t count;
+    size_t buffer_len;
+    uint16_t segment_count;
+
+    // The state of the frame currently on display
+    klm_frame shown;
+
+    // Statistics
+    uint32_t hit_count;
+    uint32_t miss_count;
+    uint32_t invalidate_count;
+
+    // Internal vars
+    klm_frame *_frames;
+    size_t _head;
+    uint16_t _segment_capacity;
+
+} klm_frameq;
+
+
+/** Create a queue of up to capacity frames of buffer_len bytes each */
+klm_frameq * const klm_frameq_create(size_t capacity, size_t buffer_len, uint16_t segment_count);
+
+/** Clean up a frame queue */
+void klm_frameq_destroy(klm_frameq * const frameq);
+
+/** Drop all queued frames */
+void klm_frameq_clear(klm_frameq * const frameq);
+
+/** Hold the state of a different number of segments. Drops all queued frames, and the shown state */
+void klm_frameq_set_segment_count(klm_frameq * const frameq, uint16_t segment_count);
+
+/** The slot the next frame should be rendered into, or NULL if the queue is full */
+klm_frame * const klm_frameq_get_tail(klm_frameq * const frameq);
+
+/** Add the frame rendered into the tail slot to the queue */
+void klm_frameq_push(klm_frameq * const frameq);
+
+/** Remove the oldest frame, or NULL if the queue is empty. Valid until the next push */
+klm_frame * const klm_frameq_pop(klm_frameq * const frameq);
+
+/** The oldest frame without removing it, or NULL if the queue is empty */
+klm_frame * const klm_frameq_get_head(klm_frameq * const frameq);
+
+static inline bool klm_frameq_is_full(klm_frameq * const frameq) {
+    return (frameq->count == frameq->capacity);
+}
+
+static inline bool klm_frameq_is_empty(klm_frameq * const frameq) {
+    return (frameq->count == 0);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_FRAMEQ_H__
@@ -0,0 +1,130 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_GLYPH_CACHE_H__
+#define __KONKER_LED_GLYPH_CACHE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <hexfont.h>
+
+// Capacities for the matrix's cache: none at all, or room for every character of every segment
+#define KLM_GLYPH_CACHE_OFF 0
+#define KLM_GLYPH_CACHE_AUTO UINT16_MAX
+#define KLM_GLYPH_CACHE_DEFAULT_MAX_SCALE 3
+#define KLM_GLYPH_CACHE_NONE -1
+
+// Synthetic styles, which can be combined
+typedef enum {
+    KLM_GLYPH_PLAIN = 0x00,
+    KLM_GLYPH_BOLD = 0x01,
+    KLM_GLYPH_OUTLINE = 0x02
+} klm_glyph_style;
+
+// One derived glyph
+typedef struct __klm_glyph_entry_t {
+    // The variant itself, its data is this entry's slot in the cache
+    hexfont_character glyph;
+
+    // What it was derived from, NULL while the entry is unused
+    hexfont_character *source;
+    uint8_t scale;
+    uint8_t style;
+
+    // Number of users, an entry can only be evicted once this is back to 0
+    uint16_t refs;
+
+    // Next in the hash bucket, and neighbours in the least recently used order
+    int16_t next;
+    int16_t lru_prev;
+    int16_t lru_next;
+
+} __klm_glyph_entry_t;
+
+/**
+ * Scaled, bold and outlined variants of font glyphs, derived the first
+ * time each one is asked for.
+ *
+ * Each variant is a hexfont_character in the same layout as the glyph it
+ * came from, so it is drawn exactly like any other glyph. The data lives
+ * in fixed size slots allocated up front, and the least recently used of
+ * the variants no longer in use is evicted to make room for a new one.
+ * Bold and outline pixels stay within the glyph's cell, in the margin the
+ * font leaves around each character.
+ */
+typedef struct klm_glyph_cache
+{
+    size_t capacity;
+
+    // The largest variant a slot has room for is max_width by max_height source pixels, max_scale times over
+    uint8_t max_scale;
+    uint16_t max_width;
+    uint16_t max_height;
+
+    // Statistics
+    uint32_t hit_count;
+    uint32_t miss_count;
+    uint32_t evict_count;
+
+    // Internal vars
+    __klm_glyph_entry_t *_entries;
+    int16_t *_buckets;
+    size_t _bucket_mask;
+    uint8_t *_data;
+    size_t _slot_size;
+    int16_t _unused;
+    int16_t _lru_head;
+    int16_t _lru_tail;
+
+} klm_glyph_cache;
+
+
+/** Create a cache of up to capacity variants of glyphs up to max_width by max_height, scaled up to max_scale times */
+klm_glyph_cache * const klm_glyph_cache_create(size_t capacity,
+                                               uint8_t max_scale,
+                                               uint16_t max_width,
+                                               uint16_t max_height);
+
+/** Clean up a glyph cache */
+void klm_glyph_cache_destroy(klm_glyph_cache * const cache);
+
+/** Get the variant of source at the given scale and style, deriving it if need be, and hold on to it until released.
+    Returns NULL if it is too big for the cache, or every variant is in use */
+hexfont_character * const klm_glyph_cache_get(klm_glyph_cache * const cache,
+                                              hexfont_character * const source,
+                                              uint8_t scale,
+                                              uint8_t style);
+
+/** Let go of a variant from klm_glyph_cache_get, so it can be evicted. Other glyphs are ignored */
+void klm_glyph_cache_release(klm_glyph_cache * const cache, hexfont_character * const glyph);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_GLYPH_CACHE_H__
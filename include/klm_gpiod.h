@@ -0,0 +1,114 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_GPIOD_H__
+#define __KONKER_LED_GPIOD_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "klm_config.h"
+
+#define KLM_GPIOD_DEFAULT_CHIP "/dev/gpiochip0"
+#define KLM_GPIOD_CONSUMER "klm"
+
+// Index of each control line within the line request
+#define KLM_GPIOD_A 0
+#define KLM_GPIOD_B 1
+#define KLM_GPIOD_C 2
+#define KLM_GPIOD_D 3
+#define KLM_GPIOD_OE 4
+#define KLM_GPIOD_STB 5
+#define KLM_GPIOD_NUM_CONTROL_LINES 6
+
+// The data and clock lines, left out if something else drives them
+#define KLM_GPIOD_CLK 6
+#define KLM_GPIOD_R 7
+#define KLM_GPIOD_NUM_LINES 8
+
+// The extra colour data lines, requested if the config has a G1 pin
+#define KLM_GPIOD_G1 8
+#define KLM_GPIOD_B1 9
+#define KLM_GPIOD_R2 10
+#define KLM_GPIOD_G2 11
+#define KLM_GPIOD_B2 12
+#define KLM_GPIOD_NUM_RGB_LINES 13
+
+// Forward declare the libgpiod types so that users don't need gpiod.h
+struct gpiod_chip;
+struct gpiod_line_request;
+
+
+/**
+ * A GPIO backend using the libgpiod v2 character device API.
+ *
+ * All of the panel's control lines are requested together as one line set,
+ * so that several of them can be changed with a single set_values call.
+ */
+typedef struct klm_gpiod
+{
+    struct gpiod_chip *chip;
+    struct gpiod_line_request *request;
+
+    // Line offsets on the chip, in request order
+    unsigned int offsets[KLM_GPIOD_NUM_RGB_LINES];
+    uint8_t num_lines;
+
+    // Statistics
+    uint32_t set_count;
+
+} klm_gpiod;
+
+
+/**
+ * Request the control lines given by the config's pins from the given chip.
+ * The data and clock lines are only requested if data_lines is true.
+ */
+klm_gpiod * const klm_gpiod_create(const char * const chip_path,
+                                   klm_config * const config,
+                                   bool data_lines);
+
+/** Release the lines and clean up */
+void klm_gpiod_destroy(klm_gpiod * const gpio);
+
+/** Bit-bang a buffer out MSB first on the data and clock lines */
+void klm_gpiod_shift_out(klm_gpiod * const gpio, const uint8_t * const buf, size_t len);
+
+/** Clock out one HUB75 byte per column, each setting all six colour data lines at once */
+void klm_gpiod_shift_out_rgb(klm_gpiod * const gpio, const uint8_t * const buf, size_t len);
+
+/** Blank the display, select the given row address and latch the shifted data, then unblank */
+void klm_gpiod_latch_row(klm_gpiod * const gpio, uint16_t address);
+
+/** Set the output enable line (true blanks the display) */
+void klm_gpiod_set_oe(klm_gpiod * const gpio, bool high);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_GPIOD_H__
@@ -0,0 +1,83 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_LAYOUT_H__
+#define __KONKER_LED_LAYOUT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <hexfont.h>
+#include "klm_segment.h"
+
+// A glyph and its position relative to the top left of the text
+typedef struct klm_layout_glyph {
+    hexfont_character *c;
+    int16_t x;
+    int16_t y;
+
+} klm_layout_glyph;
+
+/**
+ * The result of breaking a segment's text into lines.
+ * Computed once when the text changes, and reused for every tick.
+ */
+typedef struct klm_layout
+{
+    // One entry per codepoint; c is NULL for anything which isn't drawn
+    klm_layout_glyph glyphs[KLM_TEXT_LEN];
+    uint16_t glyph_count;
+
+    // Each line is the range of glyphs [line_start, line_end)
+    uint16_t line_start[KLM_TEXT_LEN + 1];
+    uint16_t line_end[KLM_TEXT_LEN + 1];
+    uint16_t line_count;
+
+    // Distance between the tops of consecutive lines
+    uint16_t line_height;
+
+    uint16_t pixel_width;
+    uint16_t pixel_height;
+
+} klm_layout;
+
+
+/** Break the given codepoints into lines no wider than wrap_width, and position their resolved glyphs */
+void klm_layout_compute(klm_layout * const layout,
+                        hexfont_character * const * const glyphs,
+                        uint16_t glyph_height,
+                        const klm_codepoint * const codepoints,
+                        size_t text_len,
+                        uint16_t wrap_width,
+                        klm_text_align align,
+                        uint8_t line_spacing,
+                        uint8_t character_spacing);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_LAYOUT_H__
@@ -0,0 +1,120 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_LOG_H__
+#define __KONKER_LED_LOG_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifndef ARDUINO
+#  include <pthread.h>
+#endif
+
+// Log levels, anything above KLM_LOG_LEVEL is compiled out
+#define KLM_LOG_LEVEL_ERROR 0
+#define KLM_LOG_LEVEL_WARN 1
+#define KLM_LOG_LEVEL_INFO 2
+#define KLM_LOG_LEVEL_DEBUG 3
+
+#ifndef KLM_LOG_LEVEL
+#define KLM_LOG_LEVEL KLM_LOG_LEVEL_INFO
+#endif
+
+// Must be a power of two
+#define KLM_LOG_DEFAULT_CAPACITY 64
+
+// Longer messages are truncated
+#define KLM_LOG_RECORD_LEN 128
+
+// One preallocated slot of the ring
+typedef struct __klm_log_slot_t {
+    atomic_size_t sequence;
+    uint16_t len;
+    char text[KLM_LOG_RECORD_LEN];
+
+} __klm_log_slot_t;
+
+/**
+ * A logger which never blocks the caller on I/O.
+ *
+ * Messages are formatted into a bounded lock-free ring by any thread, and
+ * written out in batches, with one flush per batch, by a background thread.
+ * The thread sleeps on a condition variable when the ring is empty, and is
+ * only signalled by a producer which finds it asleep. If the ring is full
+ * the message is dropped and counted.
+ */
+typedef struct klm_logger
+{
+    FILE *fp;
+
+    __klm_log_slot_t *slots;
+    size_t mask;
+
+    // Next slot to be claimed by a producer
+    atomic_size_t tail;
+
+    // Next slot to be written out, only touched by whoever holds _draining
+    size_t head;
+
+    // Statistics
+    atomic_uint dropped_count;
+
+    // Internal vars
+    atomic_bool _running;
+    atomic_flag _draining;
+#ifndef ARDUINO
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t _wake;
+    atomic_bool _sleeping;
+#endif
+    bool _threaded;
+
+} klm_logger;
+
+
+/** Create a logger writing to fp, with room for capacity messages, which must be a power of two */
+klm_logger * const klm_logger_create(FILE *fp, size_t capacity);
+
+/** Stop the background thread, write out anything still queued, and clean up */
+void klm_logger_destroy(klm_logger * const logger);
+
+/** Queue a formatted message, returns false if it was dropped */
+bool klm_logger_printf(klm_logger * const logger, const char *format, ...);
+
+/** Write a block of text straight out with a single call, e.g. a whole frame dump */
+void klm_logger_write_now(klm_logger * const logger, const char *text, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_LOG_H__
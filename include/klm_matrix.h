@@ -46,7 +46,7 @@ extern "C" {
 #  define bitWrite(value, bit, bitvalue) (bitvalue ? bitSet(value, bit) : bitClear(value, bit))
 #endif
 
-#if !defined(ARDUINO) && !defined(KLM_WIRING_PI)
+#if !defined(ARDUINO) && !defined(KLM_WIRING_PI) && !defined(KLM_GPIOD)
 #define KLM_NON_GPIO_MACHINE
 #endif
 
@@ -56,6 +56,21 @@ extern "C" {
 #include "klm_segment.h"
 #include "klm_segment_list.h"
 #include "klm_config.h"
+#include "klm_wire_format.h"
+#include "klm_bitplanes.h"
+#include "klm_spidev.h"
+#include "klm_gpiod.h"
+#include "klm_pacer.h"
+#include "klm_cmdq.h"
+#include "klm_canvas.h"
+#include "klm_frameq.h"
+#include "klm_log.h"
+#include "klm_snapshot.h"
+#include "klm_dither.h"
+#include "klm_anim.h"
+#include "klm_transition.h"
+#include "klm_sync.h"
+#include "klm_glyph_cache.h"
 
 // Symbolic constants
 #define KLM_BYTE_WIDTH 8
@@ -67,8 +82,28 @@ extern "C" {
 #define KLM_BUFFER_LEN(w, h) (size_t)(h * (w/KLM_BYTE_WIDTH))
 #define KLM_ROW_OFFSET(matrix, y) (matrix->_row_width*y)
 #define KLM_BUF_OFFSET(matrix, x, y) (size_t)(KLM_ROW_OFFSET(matrix, y)+x/KLM_BYTE_WIDTH)
-#define KLM_LOG(matrix, ...) fprintf(matrix->logfp, __VA_ARGS__); \
-                             fflush(matrix->logfp);
+#define KLM_LOG(matrix, ...) KLM_LOG_INFO(matrix, __VA_ARGS__)
+
+// Levels above KLM_LOG_LEVEL cost nothing, not even formatting the arguments
+#define KLM_LOG_ERROR(matrix, ...) klm_logger_printf(matrix->logger, __VA_ARGS__)
+
+#if KLM_LOG_LEVEL >= KLM_LOG_LEVEL_WARN
+#  define KLM_LOG_WARN(matrix, ...) klm_logger_printf(matrix->logger, __VA_ARGS__)
+#else
+#  define KLM_LOG_WARN(matrix, ...) do {} while (0)
+#endif
+
+#if KLM_LOG_LEVEL >= KLM_LOG_LEVEL_INFO
+#  define KLM_LOG_INFO(matrix, ...) klm_logger_printf(matrix->logger, __VA_ARGS__)
+#else
+#  define KLM_LOG_INFO(matrix, ...) do {} while (0)
+#endif
+
+#if KLM_LOG_LEVEL >= KLM_LOG_LEVEL_DEBUG
+#  define KLM_LOG_DEBUG(matrix, ...) klm_logger_printf(matrix->logger, __VA_ARGS__)
+#else
+#  define KLM_LOG_DEBUG(matrix, ...) do {} while (0)
+#endif
 #define KLM_LOCK(lock) if (lock != NULL) { *lock = true; }
 #define KLM_UNLOCK(lock) if (lock != NULL) { *lock = false; }
 
@@ -90,6 +125,9 @@ typedef struct klm_matrix
     // Log file pointer
     FILE *logfp;
 
+    // Writes to logfp from a background thread
+    klm_logger *logger;
+
     klm_config *config;
 
     // A buffer to hold the current frame
@@ -101,9 +139,27 @@ typedef struct klm_matrix
     // Whether the display buffer(s) were dynamically allocated
     bool _dynamic_buffer;
 
+    // The driver's description of the panel's wire format
+    klm_wire_format wire_format;
+
+    // The current frame for display, pre-encoded in the wire format
+    uint8_t *wire_buffer;
+
+    // Colour bitplanes for RGB panels, encoded instead of the wire buffer. NULL for mono panels
+    klm_bitplanes *bitplanes;
+
+    // Bulk output backend for the pixel data, if configured
+    klm_spidev *spidev;
+
+    // libgpiod backend for the control lines, if built with KLM_GPIOD
+    klm_gpiod *gpiod;
+
     // A list of available fonts and associated font-metrics
     hexfont_list *font_list;
 
+    // Scaled and styled variants of the fonts' glyphs, sized by the config when initialized
+    klm_glyph_cache *glyph_cache;
+
     // Global matrix state flags
     bool on;
 
@@ -113,11 +169,43 @@ typedef struct klm_matrix
     // A list of virtual segments which make up the display
     klm_segment_list *segment_list;
 
+    // Segment mutations posted from other threads, applied at each tick
+    klm_cmdq *cmdq;
+
+    // Optional camera onto a large offscreen canvas, drawn beneath the segments
+    klm_viewport *viewport;
+
+    // Optional animation played beneath the segments, when there is no viewport (not owned)
+    klm_anim_player *animation;
+
+    // Transition from an earlier frame to the rendered frames, created when first used
+    klm_transition *transition;
+
+    // Optional queue of frames rendered ahead of time, popped at each tick
+    klm_frameq *frameq;
+
+    // Optional persistent copy of the display state, updated each tick (not owned)
+    klm_snapshot *snapshot;
+
+    // Optional shared clock which keeps this matrix in step with other controllers (not owned)
+    klm_sync *sync;
+
     // Keep track of the current scan row
     uint16_t scan_row;
 
+    // Schedules the rows of the scan loop to hit the target refresh rate
+    klm_pacer *pacer;
+
+    // Anything the driver needs to keep between calls
+    void *_driver_data;
+
     // Internal vars
     uint16_t _row_width;
+    bool _wire_dirty;
+    uint32_t _sync_frame;
+    int _scan_timer_fd;
+    char *_dump_buffer;
+    size_t _dump_buffer_len;
     struct timespec now_t;
     int64_t micros_0;
     int64_t micros_1;
@@ -179,12 +267,82 @@ void klm_mat_off(klm_matrix * const matrix);
 /** Set the scan loop modulation */
 void klm_mat_set_scan_modulation(klm_matrix * const matrix, uint16_t scan_modulation);
 
+/** Show a window onto the given canvas beneath the segments (NULL to remove). The canvas is not owned by the matrix */
+void klm_mat_set_canvas(klm_matrix * const matrix, klm_canvas * const canvas, bool wrap);
+
+/** Move the viewport to the given canvas coordinates */
+void klm_mat_set_viewport_position(klm_matrix * const matrix, float x, float y);
+
+/** Set the viewport panning speed in pixels per tick */
+void klm_mat_set_viewport_speed(klm_matrix * const matrix, float hspeed, float vspeed);
+
+/**
+ * Keep up to the given number of future frames rendered ahead (0 to render each tick just in time).
+ * Segments appended to the list are picked up at the next tick or render. Call
+ * klm_mat_invalidate_frames before removing a segment, while the states still line up
+ */
+void klm_mat_set_render_ahead(klm_matrix * const matrix, size_t frames);
+
+/** Render one more frame ahead if there is room in the queue, e.g. when otherwise idle */
+bool klm_mat_render_ahead(klm_matrix * const matrix);
+
+/** Drop any frames rendered ahead, and rewind the segments to the frame on display.
+    Segment setters do this themselves, call it directly after drawing on the canvas */
+void klm_mat_invalidate_frames(klm_matrix * const matrix);
+
+/** Play the given animation beneath the segments, or NULL to stop. Returns false if it is the wrong size */
+bool klm_mat_set_animation(klm_matrix * const matrix, klm_anim_player * const player);
+
+/** Slide, wipe or dissolve from the frame on display to the frames which follow it, over duration ticks */
+void klm_mat_start_transition(klm_matrix * const matrix, klm_transition_type type, uint16_t duration);
+
+/** Dither an 8-bit greyscale or RGB image straight onto the display, in place of the segments until the next tick */
+bool klm_mat_show_image(klm_matrix * const matrix,
+                        klm_dither * const dither,
+                        const uint8_t * const pixels,
+                        size_t stride);
+
+/** Keep the given snapshot up to date with the display, or NULL to stop */
+void klm_mat_set_snapshot(klm_matrix * const matrix, klm_snapshot * const snapshot);
+
+/** Show the frames due on the given shared clock, and scroll text across its whole canvas, or NULL to stop.
+    Set this before handing the matrix to a runtime, so its ticks land on the shared frame boundaries */
+void klm_mat_set_sync(klm_matrix * const matrix, klm_sync * const sync);
+
+/** Get a scaled and styled variant of a font glyph, to hand back with klm_mat_release_glyph.
+    Returns the glyph itself if it is plain, or the variant can't be had */
+hexfont_character * const klm_mat_get_styled_glyph(klm_matrix * const matrix,
+                                                   hexfont_character * const glyph,
+                                                   uint8_t scale,
+                                                   uint8_t style);
+
+/** Hand back a glyph from klm_mat_get_styled_glyph */
+void klm_mat_release_glyph(klm_matrix * const matrix, hexfont_character * const glyph);
+
+/** Set the target refresh rate of the scan loop in Hz */
+void klm_mat_set_refresh_rate(klm_matrix * const matrix, uint32_t refresh_hz);
+
+/** Encode the display frame into the wire buffer, if it has changed */
+void klm_mat_encode_wire(klm_matrix * const matrix);
+
+/** 64-bit FNV-1a hash of a buffer */
+uint64_t klm_mat_hash_buffer(const uint8_t * const buffer, size_t len);
+
+/** Hash of the frame on display, to check that different ways of drawing it agree */
+uint64_t klm_mat_get_frame_hash(klm_matrix * const matrix);
+
+/** Hash of the frame as encoded for the panel, bitplanes included */
+uint64_t klm_mat_get_wire_hash(klm_matrix * const matrix);
+
 
 // Driver functions
 // ----------------------------------------------------------------------------
 /** Drive the matrix hardware */
 extern void klm_mat_scan(klm_matrix * const matrix);
 
+/** Drive the matrix hardware for a single row, without pacing, for use from a timer */
+extern void klm_mat_scan_row(klm_matrix * const matrix);
+
 /** Set a pixel */
 extern void klm_mat_set_pixel(klm_matrix * const matrix, int16_t x, int16_t y);
 
@@ -204,15 +362,19 @@ extern bool klm_mat_is_pixel_set(klm_matrix * const matrix, int16_t x, int16_t y
 extern void klm_mat_dump_buffer(klm_matrix * const matrix);
 
 extern void klm_mat_init_hardware(klm_matrix * const matrix);
+extern void klm_mat_destroy_hardware(klm_matrix * const matrix);
 extern void klm_mat_init_display_buffer(klm_matrix * const matrix);
+extern void klm_mat_init_wire_format(klm_matrix * const matrix);
 
 // Inline funtions
 // ----------------------------------------------------------------------------
-/** Copy the buffer0 to buffer1 */
+/** Copy the buffer0 to buffer1 and encode it for the wire */
 static inline void klm_mat_swap_buffers(klm_matrix * const matrix) {
     uint8_t *tmp = matrix->display_buffer1;
     matrix->display_buffer1 = matrix->display_buffer0;
     matrix->display_buffer0 = tmp;
+
+    klm_mat_encode_wire(matrix);
 }
 
 /** Clear a region of the matrix */
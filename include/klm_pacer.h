@@ -0,0 +1,111 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_PACER_H__
+#define __KONKER_LED_PACER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define KLM_PACER_DEFAULT_REFRESH_HZ 150
+#define KLM_PACER_DEFAULT_SPIN_NANOS 20000
+
+#define KLM_ONE_BILLION 1000000000LL
+
+
+/**
+ * Paces the scan loop against absolute CLOCK_MONOTONIC deadlines,
+ * so that each row gets the same on-time whatever the shift-out took.
+ */
+typedef struct klm_pacer
+{
+    // Target refresh rate, and the number of row slots in one refresh
+    uint32_t refresh_hz;
+    uint16_t rows;
+
+    // Busy-wait for this long before each deadline instead of sleeping
+    uint32_t spin_nanos;
+
+    // Statistics
+    uint32_t row_count;
+    uint32_t overrun_count;
+    int64_t max_error_nanos;
+
+    // Internal vars
+    int64_t _row_period_nanos;
+    int64_t _deadline_nanos;
+    int64_t _last_nanos;
+    int64_t _start_nanos;
+    int64_t _error_sum_nanos;
+    uint16_t _periods;
+
+} klm_pacer;
+
+
+/** Create a pacer for the given refresh rate and number of rows per refresh */
+klm_pacer * const klm_pacer_create(uint32_t refresh_hz, uint16_t rows);
+
+/** Clean up a pacer */
+void klm_pacer_destroy(klm_pacer * const pacer);
+
+/** Change the target refresh rate. A rate of zero is taken as 1Hz */
+void klm_pacer_set_refresh_rate(klm_pacer * const pacer, uint32_t refresh_hz);
+
+/** Block until the deadline for the next row */
+void klm_pacer_wait_row(klm_pacer * const pacer);
+
+/** Block until the next deadline, then set the one after the given number of row periods later */
+void klm_pacer_wait_periods(klm_pacer * const pacer, uint16_t periods);
+
+/** Forget the current deadline and statistics */
+void klm_pacer_reset(klm_pacer * const pacer);
+
+/** Achieved refresh rate in Hz since the last reset */
+float klm_pacer_get_refresh_rate(klm_pacer * const pacer);
+
+/** Mean deviation of row on-time from the nominal row period, as a fraction of it */
+float klm_pacer_get_duty_error(klm_pacer * const pacer);
+
+/** Nominal time between row deadlines */
+static inline int64_t klm_pacer_get_row_period_nanos(klm_pacer * const pacer) {
+    return pacer->_row_period_nanos;
+}
+
+/** Current CLOCK_MONOTONIC time in nanoseconds */
+static inline int64_t klm_pacer_now_nanos() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * KLM_ONE_BILLION + t.tv_nsec;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_PACER_H__
@@ -32,6 +32,7 @@ void klm_pin_list_destroy(klm_pin_list * const list);
 
 void klm_pin_list_put(klm_pin_list * const list, const char pin_name, uint8_t pin_number);
 uint8_t klm_pin_list_get(klm_pin_list * const list, const char pin_name);
+bool klm_pin_list_has(klm_pin_list * const list, const char pin_name);
 
 #ifdef __cplusplus
 }
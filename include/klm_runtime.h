@@ -0,0 +1,120 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_RUNTIME_H__
+#define __KONKER_LED_RUNTIME_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "klm_matrix.h"
+
+#define KLM_RUNTIME_MAX_EVENTS 16
+
+// Forward declare klm_runtime because of circular refs
+typedef struct klm_runtime klm_runtime;
+
+/** Called when a user file descriptor becomes ready */
+typedef void (*klm_runtime_callback)(klm_runtime * const runtime,
+                                     int fd,
+                                     uint32_t events,
+                                     void *user_data);
+
+typedef enum {
+    KLM_RUNTIME_SOURCE_TICK,
+    KLM_RUNTIME_SOURCE_SCAN,
+    KLM_RUNTIME_SOURCE_USER
+} klm_runtime_source_type;
+
+// Linked list node for each file descriptor watched by the runtime
+typedef struct __klm_runtime_source_t {
+    klm_runtime_source_type type;
+    int fd;
+
+    // For tick and scan timers
+    klm_matrix *matrix;
+    int64_t period_nanos;
+
+    // For user file descriptors
+    klm_runtime_callback callback;
+    void *user_data;
+
+    // Removed sources are freed once the current batch has been dispatched
+    bool _removed;
+
+    struct __klm_runtime_source_t * next;
+
+} __klm_runtime_source_t;
+
+/**
+ * An event loop which drives the tick and scan of one or more matrices
+ * from timerfds, together with any user file descriptors, in one epoll set.
+ */
+typedef struct klm_runtime
+{
+    int epoll_fd;
+    bool running;
+
+    __klm_runtime_source_t *sources;
+
+} klm_runtime;
+
+
+/** Create a runtime */
+klm_runtime * const klm_runtime_create();
+
+/** Clean up a runtime, including any matrices it owns */
+void klm_runtime_destroy(klm_runtime * const runtime);
+
+/** Hand a matrix over to the runtime, ticking it every tick_period_micros */
+bool klm_runtime_add_matrix(klm_runtime * const runtime,
+                            klm_matrix * const matrix,
+                            uint32_t tick_period_micros);
+
+/** Watch a user file descriptor for the given epoll events */
+bool klm_runtime_add_fd(klm_runtime * const runtime,
+                        int fd,
+                        uint32_t events,
+                        klm_runtime_callback callback,
+                        void *user_data);
+
+/** Stop watching a user file descriptor */
+void klm_runtime_remove_fd(klm_runtime * const runtime, int fd);
+
+/** Wait for and dispatch one batch of events, or time out after timeout_ms (-1 to wait forever) */
+bool klm_runtime_run_once(klm_runtime * const runtime, int timeout_ms);
+
+/** Dispatch events until klm_runtime_stop is called */
+bool klm_runtime_run(klm_runtime * const runtime);
+
+/** Make klm_runtime_run return after the current batch of events */
+void klm_runtime_stop(klm_runtime * const runtime);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_RUNTIME_H__
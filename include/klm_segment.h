@@ -30,12 +30,44 @@ extern "C" {
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <hexfont.h>
+#include "klm_colour.h"
 
+#ifndef KLM_TEXT_LEN
 #define KLM_TEXT_LEN 64
+#endif
+
+#ifdef KLM_STATIC
+// Static builds keep the text in the segment, with room for
+// KLM_TEXT_LEN characters from the Basic Multilingual Plane. Any
+// others are shown as U+FFFD, and longer text is cut at a whole character
+#define KLM_TEXT_BYTES (KLM_TEXT_LEN * 3 + 1)
+typedef uint16_t klm_codepoint;
+#else
+typedef uint32_t klm_codepoint;
+#endif
 
 // Forward declare klm_matrix because of circular refs
 typedef struct klm_matrix klm_matrix;
 
+// Forward declare klm_layout because of circular refs
+typedef struct klm_layout klm_layout;
+
+// Forward declare klm_font_chain because of circular refs
+typedef struct klm_font_chain klm_font_chain;
+
+// Forward declare klm_counter because of circular refs
+typedef struct klm_counter klm_counter;
+
+// Forward declare klm_timeline because of circular refs
+typedef struct klm_timeline klm_timeline;
+
+typedef enum {
+    KLM_ALIGN_LEFT,
+    KLM_ALIGN_CENTER,
+    KLM_ALIGN_RIGHT
+} klm_text_align;
+
 typedef struct klm_segment
 {
     klm_matrix * matrix;
@@ -46,11 +78,17 @@ typedef struct klm_segment
     uint16_t height;
 
     uint8_t  font_index;
+    klm_font_chain * font_chain;
+
+    // Integer scale factor and klm_glyph_style flags applied to every glyph
+    uint8_t  text_scale;
+    uint8_t  text_style;
+    klm_colour colour;
     bool     visible;
     bool     paused;
     bool     reverse;
 
-    uint32_t codepoints[KLM_TEXT_LEN];
+    klm_codepoint codepoints[KLM_TEXT_LEN];
     size_t   text_len;
     char     const * text;
     float    text_hspeed;
@@ -58,18 +96,49 @@ typedef struct klm_segment
     float    text_hpos;
     float    text_vpos;
 
+    // Multi-line text, wrapped to the segment width
+    bool           multiline;
+    klm_text_align text_align;
+    uint8_t        line_spacing;
+
+    // Vertical paging of multi-line text
+    uint16_t page;
+    uint16_t page_hold_ticks;
+
+    // Drawn instead of the text, if set
+    klm_counter * counter;
+
+    // Keyframes played from the segment's tick, if set
+    klm_timeline * timeline;
+
+    // Glyph for each codepoint, resolved when the text or font changes
+    hexfont_character * _glyphs[KLM_TEXT_LEN];
+
     uint16_t _row_width;
     uint16_t _text_pixel_width;
     uint16_t _text_pixel_height;
     bool     _dirty;
+#ifdef KLM_STATIC
+    char     _text_buffer[KLM_TEXT_BYTES];
+#else
+    // The heap copy to free, text may point elsewhere after klm_seg_set_text_ref
+    char   * _text_owned;
+#endif
+
+    klm_layout * _layout;
+    float    _page_vpos;
+    uint16_t _page_hold;
+
+    // Created through a control socket, so a client may also destroy it
+    bool     _remote;
 
 } klm_segment;
 
-/** Create a virtual segment object */
+/** Create a virtual segment object. Returns NULL if out of memory */
 klm_segment * const klm_seg_create(
                                 klm_matrix * const matrix,
-                                uint8_t x,
-                                uint8_t y,
+                                int16_t x,
+                                int16_t y,
                                 uint16_t width,
                                 uint16_t height,
                                 uint8_t font_index);
@@ -98,6 +167,27 @@ void klm_seg_stop(klm_segment * const seg);
 /** Set the segment's text content */
 void klm_seg_set_text(klm_segment * const seg, const char *text);
 
+/** Set the segment's text content, taking ownership of the given heap allocated string.
+    A KLM_STATIC build copies the text instead, and the caller keeps ownership */
+void klm_seg_take_text(klm_segment * const seg, char * const text);
+
+/** Show the given text without copying it or dropping frames rendered ahead, e.g. from inside the tick.
+    Unless this is a KLM_STATIC build the text must stay put until it is replaced */
+void klm_seg_set_text_ref(klm_segment * const seg, const char * const text);
+
+/** Drive the segment from the given timeline, starting at its first keyframe (NULL to stop) */
+void klm_seg_set_timeline(klm_segment * const seg, klm_timeline * const timeline);
+
+/** Look up glyphs in the given fallback chain rather than the single font_index (NULL to go back) */
+void klm_seg_set_font_chain(klm_segment * const seg, klm_font_chain * const chain);
+
+/** Draw the text scaled up by an integer factor, up to the config's glyph_cache_max_scale,
+    and in any combination of klm_glyph_style. Without a glyph cache it stays plain */
+void klm_seg_set_text_style(klm_segment * const seg, uint8_t scale, uint8_t style);
+
+/** Set the colour of the segment's pixels, on panels which have colour */
+void klm_seg_set_colour(klm_segment * const seg, klm_colour colour);
+
 /** Clear the buffer of a particular segment */
 void klm_seg_clear_text(klm_segment * const seg);
 
@@ -119,6 +209,18 @@ void klm_seg_reverse(klm_segment * const seg);
 /** Render the segment's text */
 void klm_seg_render_text(klm_segment * const seg);
 
+/** Wrap the segment's text over multiple lines, or go back to a single line */
+void klm_seg_set_multiline(klm_segment * const seg, bool multiline, klm_text_align align, uint8_t line_spacing);
+
+/** Show the given page of multi-line text, scrolling to it at the vertical text speed if animate is set */
+void klm_seg_set_page(klm_segment * const seg, uint16_t page, bool animate);
+
+/** Automatically advance to the next page after holding each one for hold_ticks (0 to disable) */
+void klm_seg_set_paging(klm_segment * const seg, uint16_t hold_ticks);
+
+/** Number of pages the segment's multi-line text fills */
+uint16_t klm_seg_get_page_count(klm_segment * const seg);
+
 /** Helpers */
 uint16_t klm_seg_get_text_pixel_width(klm_segment * const seg);
 uint16_t klm_seg_get_text_pixel_height(klm_segment * const seg);
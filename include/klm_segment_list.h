@@ -47,6 +47,7 @@ typedef struct klm_segment_list
 klm_segment_list * const klm_segment_list_create(klm_segment * const item);
 void klm_segment_list_destroy(klm_segment_list * const head);
 void klm_segment_list_append(klm_segment_list * const head, klm_segment * const new_item);
+klm_segment_list * const klm_segment_list_remove(klm_segment_list * const head, klm_segment * const item);
 
 uint16_t klm_segment_list_get_length(klm_segment_list * const head);
 klm_segment * const klm_segment_list_get_nth(klm_segment_list * const head, int16_t n);
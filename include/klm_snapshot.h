@@ -0,0 +1,153 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_SNAPSHOT_H__
+#define __KONKER_LED_SNAPSHOT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "klm_segment.h"
+
+#define KLM_SNAPSHOT_MAGIC 0x534d4c4b
+#define KLM_SNAPSHOT_VERSION 1
+
+// Room for KLM_TEXT_LEN characters of any length in UTF-8
+#define KLM_SNAPSHOT_TEXT_BYTES (KLM_TEXT_LEN * 4 + 1)
+
+// Forward declare klm_matrix because of circular refs
+typedef struct klm_matrix klm_matrix;
+
+// The saved state of one segment
+typedef struct __klm_snapshot_seg_t {
+    int16_t x;
+    int16_t y;
+    uint16_t width;
+    uint16_t height;
+
+    uint8_t font_index;
+    uint8_t visible;
+    uint8_t paused;
+    uint8_t reverse;
+    uint8_t multiline;
+    uint8_t text_align;
+    uint8_t line_spacing;
+    uint8_t _pad;
+
+    uint16_t page;
+    uint16_t page_hold_ticks;
+
+    float text_hspeed;
+    float text_vspeed;
+    float text_hpos;
+    float text_vpos;
+
+    char text[KLM_SNAPSHOT_TEXT_BYTES];
+
+} __klm_snapshot_seg_t;
+
+// One complete copy of the state, followed in the file by its segments and front buffer
+typedef struct __klm_snapshot_slot_t {
+    // Odd while the slot is being written
+    atomic_uint sequence;
+    uint16_t segment_count;
+    uint16_t _pad;
+
+} __klm_snapshot_slot_t;
+
+// The start of the file
+typedef struct __klm_snapshot_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint16_t width;
+    uint16_t height;
+    uint16_t max_segments;
+    uint16_t _pad;
+    uint32_t slot_size;
+
+    // Which slot holds the last complete snapshot, -1 if none yet
+    atomic_int current;
+
+} __klm_snapshot_header_t;
+
+/**
+ * The display state of a matrix, kept in a small memory mapped file.
+ *
+ * There are two copies of the state in the file. Each update is written
+ * over the older copy, and only then made current, so a crash part way
+ * through an update leaves the previous snapshot intact. Another process,
+ * e.g. a watchdog, can read the file at any time.
+ */
+typedef struct klm_snapshot
+{
+    int fd;
+    size_t size;
+
+    // Statistics
+    uint32_t update_count;
+    uint32_t write_count;
+
+    // Internal vars
+    __klm_snapshot_header_t *_header;
+    size_t _buffer_len;
+
+} klm_snapshot;
+
+
+/** Open the snapshot file at path, starting a fresh one if it doesn't match the given dimensions */
+klm_snapshot * const klm_snapshot_open(const char *path,
+                                       uint16_t width,
+                                       uint16_t height,
+                                       uint16_t max_segments);
+
+/** Flush the snapshot to disk and close it */
+void klm_snapshot_close(klm_snapshot * const snapshot);
+
+/** Whether the file holds a complete snapshot to restore from */
+bool klm_snapshot_is_valid(klm_snapshot * const snapshot);
+
+/** Save any of the matrix's state which differs from the snapshot */
+void klm_snapshot_update(klm_snapshot * const snapshot, klm_matrix * const matrix);
+
+/** Copy the saved front buffer into buffer, returns false if there is no snapshot or the writer holds it */
+bool klm_snapshot_read_frame(klm_snapshot * const snapshot, uint8_t * const buffer);
+
+/** Put the saved frame on display straight away, before any fonts or segments exist */
+bool klm_snapshot_restore_frame(klm_snapshot * const snapshot, klm_matrix * const matrix);
+
+/**
+ * Restore the saved segments, once the matrix has its fonts. If the matrix
+ * has no segments they are created, otherwise the existing ones are updated in order.
+ */
+bool klm_snapshot_restore_segments(klm_snapshot * const snapshot, klm_matrix * const matrix);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_SNAPSHOT_H__
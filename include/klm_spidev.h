@@ -0,0 +1,90 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_SPIDEV_H__
+#define __KONKER_LED_SPIDEV_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Maximum number of transfers batched into a single ioctl
+#define KLM_SPIDEV_MAX_TRANSFERS 32
+
+#define KLM_SPIDEV_DEFAULT_SPEED_HZ 8000000
+
+
+/**
+ * An output backend which sends bulk data via the Linux spidev interface.
+ *
+ * A stand-in, e.g. a plain file or a pty, can be asked for instead, and
+ * the data is written to it as-is, so that transfers can be inspected
+ * and benchmarked on machines without SPI hardware.
+ */
+typedef struct klm_spidev
+{
+    int fd;
+    uint32_t speed_hz;
+
+    // Statistics
+    uint32_t transfer_count;
+    uint32_t byte_count;
+
+    // Internal vars
+    bool _fake;
+
+} klm_spidev;
+
+
+/** Open the given spidev device. Returns NULL if it isn't one */
+klm_spidev * const klm_spidev_create(const char * const path, uint32_t speed_hz);
+
+/** Open a stand-in which receives the bytes as-is, creating or emptying path if it is a plain file */
+klm_spidev * const klm_spidev_create_stand_in(const char * const path);
+
+/** Close the device and clean up */
+void klm_spidev_destroy(klm_spidev * const spi);
+
+/** Send a buffer in a single transfer */
+bool klm_spidev_transfer(klm_spidev * const spi, const uint8_t * const buf, size_t len);
+
+/** Send a number of rows of stride bytes each, with one transfer per row batched into one ioctl */
+bool klm_spidev_transfer_rows(klm_spidev * const spi,
+                              const uint8_t * const buf,
+                              size_t stride,
+                              uint16_t n_rows);
+
+/** Query whether the device is a stand-in rather than a real spidev device */
+static inline bool klm_spidev_is_fake(klm_spidev * const spi) {
+    return spi->_fake;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_SPIDEV_H__
@@ -0,0 +1,146 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_SYNC_H__
+#define __KONKER_LED_SYNC_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define KLM_SYNC_MAGIC 0x59534c4b
+#define KLM_SYNC_VERSION 2
+
+// How long to wait for another controller to finish creating the file
+#define KLM_SYNC_JOIN_TIMEOUT_MILLIS 1000
+
+// How far the heartbeat may run ahead of the clock before the file is taken to be stale
+#define KLM_SYNC_MAX_LEAD_FRAMES 2
+
+// Room for the kernel's boot id, a UUID, and a terminator
+#define KLM_SYNC_BOOT_ID_LEN 40
+
+// The file shared by all the controllers of one sign
+typedef struct __klm_sync_shared_t {
+    uint32_t magic;
+    uint32_t version;
+
+    // Frame 0 started at this CLOCK_MONOTONIC time, and each frame lasts period_nanos
+    int64_t epoch_nanos;
+    int64_t period_nanos;
+
+    // Width in pixels of the whole sign, across all the controllers
+    uint16_t canvas_width;
+    uint16_t _pad;
+
+    // The boot the epoch belongs to, CLOCK_MONOTONIC starts again at each one
+    char boot_id[KLM_SYNC_BOOT_ID_LEN];
+
+    // The latest frame put on display by any of the controllers
+    atomic_uint heartbeat;
+
+    // Set once the fields above have been filled in by the first controller
+    atomic_uint ready;
+
+} __klm_sync_shared_t;
+
+/**
+ * Keeps the controllers of one wide sign in step.
+ *
+ * Each controller drives its own panels, which show a window onto one
+ * logical canvas starting offset_x pixels from the canvas' left edge. All
+ * of them open the same small memory mapped file, e.g. under /dev/shm,
+ * which holds a shared epoch and frame period on CLOCK_MONOTONIC. Frame
+ * numbers are counted from the epoch rather than from each controller's
+ * own ticks, and scrolling text positions are worked out from the frame
+ * number rather than accumulated, so text crosses from one controller to
+ * the next without a seam and never drifts. A file left over from an
+ * earlier boot is started again by the first controller to join it.
+ */
+typedef struct klm_sync
+{
+    int fd;
+
+    // Where this controller's panels start on the logical canvas
+    int16_t offset_x;
+
+    // Statistics, the number of frames asked for and how many went by unseen
+    uint32_t frame_count;
+    uint32_t skip_count;
+
+    // Internal vars
+    __klm_sync_shared_t *_shared;
+    uint32_t _last_frame;
+
+} klm_sync;
+
+
+/** Join the sign's sync file at path, creating it with the given canvas width and frame period if this is the first controller */
+klm_sync * const klm_sync_open(const char *path,
+                               uint16_t canvas_width,
+                               uint32_t tick_period_micros,
+                               int16_t offset_x);
+
+/** Leave the sync file. The file is left for the other controllers */
+void klm_sync_close(klm_sync * const sync);
+
+/** The frame due on display now, or the latest frame any controller has shown if that is later */
+uint32_t klm_sync_get_frame(klm_sync * const sync);
+
+/** CLOCK_MONOTONIC time at which the given frame is due */
+int64_t klm_sync_get_frame_nanos(klm_sync * const sync, uint32_t frame);
+
+/** CLOCK_MONOTONIC time at which the next frame is due */
+int64_t klm_sync_get_next_frame_nanos(klm_sync * const sync);
+
+/** Block until the start of the next frame, and return its number */
+uint32_t klm_sync_wait_frame(klm_sync * const sync);
+
+/** Let the other controllers know that the given frame is on display */
+void klm_sync_beat(klm_sync * const sync, uint32_t frame);
+
+/** Where text scrolling at hspeed should be in the given frame, relative to a segment at seg_x */
+float klm_sync_get_text_hpos(klm_sync * const sync,
+                             uint32_t frame,
+                             float hspeed,
+                             int16_t text_width,
+                             int16_t seg_x);
+
+static inline int64_t klm_sync_get_period_nanos(klm_sync * const sync) {
+    return sync->_shared->period_nanos;
+}
+
+static inline uint16_t klm_sync_get_canvas_width(klm_sync * const sync) {
+    return sync->_shared->canvas_width;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_SYNC_H__
@@ -0,0 +1,198 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_TIMELINE_H__
+#define __KONKER_LED_TIMELINE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define KLM_TIMELINE_INITIAL_KEYS 8
+
+// Which properties a keyframe changes
+#define KLM_KEY_POSITION 0x01
+#define KLM_KEY_SPEED    0x02
+#define KLM_KEY_VISIBLE  0x04
+#define KLM_KEY_REVERSE  0x08
+#define KLM_KEY_PAUSED   0x10
+#define KLM_KEY_TEXT     0x20
+
+// Repeat the timeline for ever
+#define KLM_TIMELINE_LOOP 0
+
+// Forward declare klm_segment because of circular refs
+typedef struct klm_segment klm_segment;
+
+/** How a move progresses over its duration */
+typedef enum klm_easing {
+    KLM_EASE_LINEAR,
+    KLM_EASE_IN,
+    KLM_EASE_OUT,
+    KLM_EASE_IN_OUT,
+
+    // Stay put, then jump at the end
+    KLM_EASE_STEP
+
+} klm_easing;
+
+/** What a keyframe's text position is measured from, resolved when the keyframe starts */
+typedef enum klm_anchor {
+    // The segment's top left corner
+    KLM_ANCHOR_START,
+
+    // Wherever the text is when the keyframe starts
+    KLM_ANCHOR_CURRENT,
+
+    // Where the text would be centred in the segment
+    KLM_ANCHOR_CENTRE,
+
+    // Just out of sight before the start of the segment
+    KLM_ANCHOR_BEFORE,
+
+    // Just out of sight after the end of the segment
+    KLM_ANCHOR_AFTER
+
+} klm_anchor;
+
+/**
+ * One step of a timeline. When it starts, everything in flags except the
+ * position is applied at once. The position then moves to the target over
+ * duration ticks, and the timeline goes on to the next keyframe.
+ */
+typedef struct klm_keyframe {
+    uint16_t duration;
+    uint8_t flags;
+    klm_easing easing;
+
+    klm_anchor h_anchor;
+    klm_anchor v_anchor;
+    float hpos;
+    float vpos;
+
+    float hspeed;
+    float vspeed;
+    bool visible;
+    bool reverse;
+    bool paused;
+    char *text;
+
+} klm_keyframe;
+
+/** Where a timeline has got to, enough to rewind it to a given frame */
+typedef struct klm_timeline_state {
+    uint16_t key;
+    uint16_t tick;
+    uint16_t loop;
+    int16_t text_key;
+    bool finished;
+
+    // The move in progress
+    float from_hpos;
+    float from_vpos;
+    float to_hpos;
+    float to_vpos;
+
+} klm_timeline_state;
+
+/**
+ * A sequence of keyframes which drives a segment from inside klm_mat_tick,
+ * e.g. scroll in, hold in the centre, then blink, with no calls from the
+ * application once it has started.
+ *
+ * Each tick only steps the current keyframe, and text is decoded when a
+ * text keyframe starts rather than on every tick.
+ */
+typedef struct klm_timeline
+{
+    klm_segment *segment;
+
+    // Number of times to play the keyframes, or KLM_TIMELINE_LOOP
+    uint16_t repeat;
+
+    klm_timeline_state state;
+
+    // Internal vars
+    klm_keyframe *_keys;
+    uint16_t _key_count;
+    uint16_t _key_capacity;
+    char *_base_text;
+
+} klm_timeline;
+
+
+/** Create an empty timeline for the given segment, played repeat times or KLM_TIMELINE_LOOP */
+klm_timeline * const klm_timeline_create(klm_segment * const seg, uint16_t repeat);
+
+/** Clean up a timeline, and detach it from its segment */
+void klm_timeline_destroy(klm_timeline * const timeline);
+
+/** Add a keyframe. Any text is copied */
+void klm_timeline_add_key(klm_timeline * const timeline, const klm_keyframe * const key);
+
+/** Add a keyframe which moves the text to the given position over duration ticks */
+void klm_timeline_move(klm_timeline * const timeline,
+                       uint16_t duration,
+                       klm_easing easing,
+                       klm_anchor h_anchor, float hpos,
+                       klm_anchor v_anchor, float vpos);
+
+/** Add a keyframe which leaves everything as it is for duration ticks */
+void klm_timeline_hold(klm_timeline * const timeline, uint16_t duration);
+
+/** Add a keyframe which shows or hides the segment, then holds for duration ticks */
+void klm_timeline_show(klm_timeline * const timeline, bool visible, uint16_t duration);
+
+/** Add a keyframe which reverses the segment or not, then holds for duration ticks */
+void klm_timeline_reverse(klm_timeline * const timeline, bool reverse, uint16_t duration);
+
+/** Add a keyframe which sets the scroll speed and unpauses the segment, then runs for duration ticks */
+void klm_timeline_scroll(klm_timeline * const timeline, float hspeed, float vspeed, uint16_t duration);
+
+/** Add a keyframe which pauses or unpauses the segment's scrolling */
+void klm_timeline_pause(klm_timeline * const timeline, bool paused);
+
+/** Add a keyframe which changes the segment's text */
+void klm_timeline_text(klm_timeline * const timeline, const char * const text);
+
+/** Go back to the first keyframe */
+void klm_timeline_reset(klm_timeline * const timeline);
+
+/** Advance by one tick, called by the segment's tick */
+void klm_timeline_tick(klm_timeline * const timeline);
+
+/** The segment's text was set from outside, keep a copy to rewind to until the next text keyframe */
+void klm_timeline_set_base_text(klm_timeline * const timeline, const char * const text);
+
+/** Rewind to a saved state, called when frames rendered ahead are dropped */
+void klm_timeline_restore(klm_timeline * const timeline, const klm_timeline_state * const state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_TIMELINE_H__
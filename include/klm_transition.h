@@ -0,0 +1,125 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_TRANSITION_H__
+#define __KONKER_LED_TRANSITION_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Number of levels in the dissolve order, one bitplane per bit
+#define KLM_TRANSITION_DISSOLVE_BITS 8
+#define KLM_TRANSITION_DISSOLVE_LEVELS (1 << KLM_TRANSITION_DISSOLVE_BITS)
+
+// Seed for the dissolve order, so that a dissolve looks the same every time
+#define KLM_TRANSITION_DISSOLVE_SEED 0x2545F491
+
+
+typedef enum klm_transition_type {
+    // The new frame pushes the old one out, in the given direction
+    KLM_TRANSITION_SLIDE_LEFT,
+    KLM_TRANSITION_SLIDE_RIGHT,
+    KLM_TRANSITION_SLIDE_UP,
+    KLM_TRANSITION_SLIDE_DOWN,
+
+    // An edge moving in the given direction uncovers the new frame
+    KLM_TRANSITION_WIPE_LEFT,
+    KLM_TRANSITION_WIPE_RIGHT,
+    KLM_TRANSITION_WIPE_UP,
+    KLM_TRANSITION_WIPE_DOWN,
+
+    // Pixels change over in a fixed pseudo-random order
+    KLM_TRANSITION_DISSOLVE
+
+} klm_transition_type;
+
+/**
+ * Composes an outgoing and an incoming frame, both packed LSB first the
+ * same as the display buffers, 32 pixels at a time.
+ *
+ * Slides shift whole words of each row, wipes mask rows with a row mask
+ * built once per frame, and the dissolve compares a per-pixel rank against
+ * the progress, bit-sliced across 8 precomputed bitplanes. Each frame is at
+ * most one pass over each input and the output, plus the bitplanes for a
+ * dissolve.
+ */
+typedef struct klm_transition
+{
+    uint16_t width;
+    uint16_t height;
+    klm_transition_type type;
+
+    // Length in ticks, and how far through it is
+    uint16_t duration;
+    uint16_t tick;
+
+    // A copy of the frame being transitioned from
+    uint8_t *from;
+
+    // Internal vars
+    uint16_t _row_width;
+    size_t _buffer_len;
+    uint8_t *_frame;
+    uint8_t *_row_mask;
+    uint8_t *_dissolve;
+
+} klm_transition;
+
+
+/** Create a transition between frames of the given size */
+klm_transition * const klm_transition_create(uint16_t width, uint16_t height);
+
+/** Clean up a transition */
+void klm_transition_destroy(klm_transition * const transition);
+
+/** Start a transition away from a copy of the given frame, lasting duration ticks */
+void klm_transition_start(klm_transition * const transition,
+                          klm_transition_type type,
+                          uint16_t duration,
+                          const uint8_t * const from);
+
+/** Compose the frame tick ticks into the transition from one frame to another into dst, which mustn't be either of them */
+void klm_transition_compose(klm_transition * const transition,
+                            const uint8_t * const from,
+                            const uint8_t * const to,
+                            uint8_t * const dst,
+                            uint16_t tick);
+
+/** Advance the transition, and compose its next frame in place of *frame, by swapping buffers */
+void klm_transition_tick(klm_transition * const transition, uint8_t ** const frame);
+
+/** Whether or not there is more of the transition to show */
+static inline bool klm_transition_is_active(klm_transition * const transition) {
+    return (transition->tick < transition->duration);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_TRANSITION_H__
@@ -0,0 +1,115 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KONKER_LED_WIRE_FORMAT_H__
+#define __KONKER_LED_WIRE_FORMAT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/** How far the picture is turned clockwise on its way to the panel */
+typedef enum klm_rotation {
+    KLM_ROTATE_0,
+    KLM_ROTATE_90,
+    KLM_ROTATE_180,
+    KLM_ROTATE_270
+
+} klm_rotation;
+
+/**
+ * Describes how a panel expects its pixel data to be shifted out.
+ *
+ * The encoded wire buffer holds, for each row address in turn,
+ * the bytes to be shifted out for that address in send order.
+ * Each byte is always sent most significant bit first.
+ */
+typedef struct klm_wire_format
+{
+    // Flip all bits (e.g. the panel's LEDs are active low)
+    bool invert;
+
+    // Send the bytes of a row starting from the right hand end
+    bool reverse_bytes;
+
+    // Reverse the pixels within each byte
+    bool reverse_bits;
+
+    // Map the first buffer row to the last row address
+    bool reverse_rows;
+
+    // Number of rows shifted out per row address (1 for a 1/height scan panel)
+    uint8_t interleave;
+
+    // Send the buffer's columns as the panel's rows, for a panel turned a
+    // quarter turn, so the panel is height pixels wide and width pixels high
+    bool transpose;
+
+} klm_wire_format;
+
+
+/** Encode a 1bpp frame buffer into the given wire format */
+void klm_wire_encode(const klm_wire_format * const format,
+                     const uint8_t * const src,
+                     uint8_t * const dst,
+                     uint16_t width,
+                     uint16_t height);
+
+/**
+ * Turn and mirror the picture to suit how the panel is mounted, on top of
+ * the panel's own wiring. Mirroring is along the panel's axes, after turning.
+ * Returns false, and leaves the format as it was, if a quarter turn is asked
+ * for and the height isn't a whole number of bytes
+ */
+bool klm_wire_set_orientation(klm_wire_format * const format,
+                              klm_rotation rotation,
+                              bool mirror_x,
+                              bool mirror_y,
+                              uint16_t height);
+
+/** Number of row addresses which need to be scanned for a width x height frame buffer */
+static inline uint16_t klm_wire_get_address_count(const klm_wire_format * const format,
+                                                  uint16_t width,
+                                                  uint16_t height)
+{
+    return (format->transpose ? width : height) / format->interleave;
+}
+
+/** Number of bytes shifted out per row address for a width x height frame buffer */
+static inline size_t klm_wire_get_address_stride(const klm_wire_format * const format,
+                                                 uint16_t width,
+                                                 uint16_t height)
+{
+    return (size_t)format->interleave * ((format->transpose ? height : width) / 8);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __KONKER_LED_WIRE_FORMAT_H__
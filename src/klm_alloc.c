@@ -0,0 +1,109 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "klm_alloc.h"
+
+static klm_alloc_stats _klm_alloc_stats = { 0, 0, 0, 0 };
+
+#ifdef KLM_STATIC
+static uint8_t *_klm_arena = NULL;
+static size_t _klm_arena_size = 0;
+static size_t _klm_arena_used = 0;
+
+/** Give the library the memory to create all of its objects in. Call before creating anything */
+void klm_alloc_set_arena(void * const buffer, size_t size) {
+    _klm_arena = buffer;
+    _klm_arena_size = size;
+    _klm_arena_used = 0;
+}
+
+/** Bytes of the arena used so far */
+size_t klm_alloc_get_arena_used(void) {
+    return _klm_arena_used;
+}
+#endif
+
+void *klm_malloc(size_t size) {
+    void *ptr;
+
+#ifdef KLM_STATIC
+    // Bump allocate, nothing is ever given back
+    size_t start = (_klm_arena_used + KLM_ALLOC_ALIGN - 1) & ~(KLM_ALLOC_ALIGN - 1);
+    if (_klm_arena == NULL || start + size > _klm_arena_size) {
+        _klm_alloc_stats.fail_count++;
+        return NULL;
+    }
+    ptr = _klm_arena + start;
+    _klm_arena_used = start + size;
+#else
+    ptr = malloc(size);
+    if (ptr == NULL) {
+        _klm_alloc_stats.fail_count++;
+        return NULL;
+    }
+#endif
+
+    _klm_alloc_stats.alloc_count++;
+    _klm_alloc_stats.alloc_bytes += size;
+    return ptr;
+}
+
+void *klm_calloc(size_t count, size_t size) {
+    void *ptr = klm_malloc(count * size);
+    if (ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void klm_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    _klm_alloc_stats.free_count++;
+#ifndef KLM_STATIC
+    free(ptr);
+#endif
+}
+
+char *klm_strdup(const char *s) {
+    size_t len = strlen(s) + 1;
+    char *ret = klm_malloc(len);
+    if (ret != NULL) {
+        memcpy(ret, s, len);
+    }
+    return ret;
+}
+
+/** Running totals of the library's allocations. The counters are not thread safe */
+const klm_alloc_stats * const klm_alloc_get_stats(void) {
+    return &_klm_alloc_stats;
+}
+
+/** Set all the counters back to zero */
+void klm_alloc_reset_stats(void) {
+    memset(&_klm_alloc_stats, 0, sizeof(_klm_alloc_stats));
+}
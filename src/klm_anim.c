@@ -0,0 +1,415 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "klm_anim.h"
+#include "klm_alloc.h"
+
+// Symbolic constants
+#define KLM_BYTE_WIDTH 8
+#define KLM_ANIM_RUN_MAX 128
+#define KLM_ANIM_RUN_TOKEN 0x80
+
+// Worst case encoded size, every byte literal
+#define KLM_ANIM_MAX_PAYLOAD(len) ((len) + (len)/KLM_ANIM_RUN_MAX + 1)
+
+static bool _klm_anim_player_decode(klm_anim_player * const player);
+static bool _klm_anim_apply(uint8_t * const frame, size_t frame_len, const uint8_t *src, size_t len);
+static void _klm_anim_get_index(klm_anim_player * const player, uint32_t i, __klm_anim_index_t * const entry);
+static size_t _klm_anim_encode(const uint8_t * const src, size_t len, uint8_t * const dst);
+static void _klm_anim_encoder_flush(klm_anim_encoder * const encoder);
+static void _klm_anim_encoder_write(klm_anim_encoder * const encoder, const void * const data, size_t len);
+
+
+/** Open an animation file for playback, or NULL if it can't be read */
+klm_anim_player * const klm_anim_player_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(__klm_anim_header_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    // Let the kernel read ahead, and drop pages which have been played
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    __klm_anim_header_t header;
+    memcpy(&header, map, sizeof(header));
+    if (header.magic != KLM_ANIM_MAGIC ||
+        header.version != KLM_ANIM_VERSION ||
+        header.frame_count == 0 ||
+        header.index_count == 0 ||
+        header.index_offset < sizeof(header) ||
+        header.index_offset + (size_t)header.index_count*sizeof(__klm_anim_index_t) > (size_t)st.st_size)
+    {
+        munmap(map, st.st_size);
+        close(fd);
+        return NULL;
+    }
+
+    // Allocate memory for the player structure and initialize all members
+    klm_anim_player * const player = klm_malloc(sizeof(klm_anim_player));
+    player->header = header;
+    player->loop = true;
+    player->buffer_len = (size_t)(header.width / KLM_BYTE_WIDTH) * header.height;
+    player->frame = klm_calloc(player->buffer_len, sizeof(*player->frame));
+    player->frame_index = 0;
+    player->hold = 1;
+    player->decode_count = 0;
+    player->seek_count = 0;
+
+    player->_fd = fd;
+    player->_map = map;
+    player->_map_len = st.st_size;
+    player->_offset = sizeof(header);
+
+    if (!klm_anim_player_seek(player, 0)) {
+        klm_anim_player_close(player);
+        return NULL;
+    }
+    return player;
+}
+
+/** Close an animation file */
+void klm_anim_player_close(klm_anim_player * const player) {
+    munmap((void *)player->_map, player->_map_len);
+    close(player->_fd);
+    klm_free(player->frame);
+    klm_free(player);
+}
+
+/** Go back to the first frame at the end, rather than staying on the last */
+void klm_anim_player_set_loop(klm_anim_player * const player, bool loop) {
+    player->loop = loop;
+}
+
+/** Jump to the given frame, decoding forward from the keyframe before it */
+bool klm_anim_player_seek(klm_anim_player * const player, uint32_t frame) {
+    if (frame >= player->header.frame_count) {
+        return false;
+    }
+    player->seek_count++;
+
+    // Find the last keyframe at or before the frame
+    __klm_anim_index_t entry;
+    uint32_t lo = 0, hi = player->header.index_count;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        _klm_anim_get_index(player, mid, &entry);
+        if (entry.frame <= frame) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    _klm_anim_get_index(player, lo, &entry);
+
+    player->_offset = entry.offset;
+    player->frame_index = entry.frame;
+    if (!_klm_anim_player_decode(player)) {
+        return false;
+    }
+
+    // Then apply the deltas up to the frame
+    while (player->frame_index < frame) {
+        player->frame_index++;
+        if (!_klm_anim_player_decode(player)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Count down the current frame's duration, and decode the next frame when it is up */
+void klm_anim_player_tick(klm_anim_player * const player) {
+    if (player->hold > 1) {
+        player->hold--;
+        return;
+    }
+
+    if (player->frame_index + 1 < player->header.frame_count) {
+        player->frame_index++;
+        _klm_anim_player_decode(player);
+    }
+    else if (player->loop) {
+        klm_anim_player_seek(player, 0);
+    }
+}
+
+/** Create an animation file for frames of the given size */
+klm_anim_encoder * const klm_anim_encoder_create(const char *path,
+                                                 uint16_t width,
+                                                 uint16_t height,
+                                                 uint16_t key_interval)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    // Allocate memory for the encoder structure and initialize all members
+    klm_anim_encoder * const encoder = klm_malloc(sizeof(klm_anim_encoder));
+    memset(&encoder->header, 0, sizeof(encoder->header));
+    encoder->header.magic = KLM_ANIM_MAGIC;
+    encoder->header.version = KLM_ANIM_VERSION;
+    encoder->header.width = width;
+    encoder->header.height = height;
+    encoder->key_interval = (key_interval == 0) ? 1 : key_interval;
+    encoder->key_count = 0;
+    encoder->bytes_written = 0;
+
+    encoder->_fp = fp;
+    encoder->_failed = false;
+    encoder->_buffer_len = (size_t)(width / KLM_BYTE_WIDTH) * height;
+    encoder->_current = klm_calloc(encoder->_buffer_len, 1);
+    encoder->_scratch = klm_malloc(encoder->_buffer_len);
+    encoder->_payload = klm_malloc(2 * KLM_ANIM_MAX_PAYLOAD(encoder->_buffer_len));
+    encoder->_has_pending = false;
+    encoder->_since_key = encoder->key_interval;
+    encoder->_index_capacity = 16;
+    encoder->_index = klm_malloc(encoder->_index_capacity * sizeof(*encoder->_index));
+
+    // Leave room for the header, which is written last
+    _klm_anim_encoder_write(encoder, &encoder->header, sizeof(encoder->header));
+    return encoder;
+}
+
+/** Add a 1bpp frame, to be shown for the given number of ticks */
+bool klm_anim_encoder_add_frame(klm_anim_encoder * const encoder,
+                                const uint8_t * const buffer,
+                                uint16_t duration)
+{
+    if (duration == 0) {
+        duration = 1;
+    }
+
+    // An unchanged frame just stays on display for longer
+    if (encoder->_has_pending &&
+        (uint32_t)encoder->_pending.duration + duration <= UINT16_MAX &&
+        memcmp(buffer, encoder->_current, encoder->_buffer_len) == 0)
+    {
+        encoder->_pending.duration += duration;
+        return !encoder->_failed;
+    }
+    _klm_anim_encoder_flush(encoder);
+
+    // Encode both the change from the previous frame and the whole frame
+    size_t i;
+    for (i=0; i<encoder->_buffer_len; i++) {
+        encoder->_scratch[i] = buffer[i] ^ encoder->_current[i];
+    }
+    uint8_t * const key_payload = encoder->_payload + KLM_ANIM_MAX_PAYLOAD(encoder->_buffer_len);
+    size_t delta_len = _klm_anim_encode(encoder->_scratch, encoder->_buffer_len, encoder->_payload);
+    size_t key_len = _klm_anim_encode(buffer, encoder->_buffer_len, key_payload);
+
+    // Keyframes when seeking needs one, or when they are no bigger anyway
+    bool key = (encoder->_since_key >= encoder->key_interval || key_len <= delta_len);
+    if (key) {
+        memcpy(encoder->_payload, key_payload, key_len);
+        encoder->_since_key = 1;
+    }
+    else {
+        encoder->_since_key++;
+    }
+
+    encoder->_pending.type = key ? KLM_ANIM_FRAME_KEY : KLM_ANIM_FRAME_DELTA;
+    encoder->_pending._pad = 0;
+    encoder->_pending.duration = duration;
+    encoder->_pending.length = (uint32_t)(key ? key_len : delta_len);
+    encoder->_has_pending = true;
+
+    memcpy(encoder->_current, buffer, encoder->_buffer_len);
+    return !encoder->_failed;
+}
+
+/** Write out the index and header, close the file and clean up. Returns false if anything failed to write */
+bool klm_anim_encoder_finish(klm_anim_encoder * const encoder) {
+    _klm_anim_encoder_flush(encoder);
+
+    encoder->header.index_offset = encoder->bytes_written;
+    encoder->header.index_count = encoder->key_count;
+    _klm_anim_encoder_write(encoder,
+                            encoder->_index,
+                            encoder->key_count * sizeof(*encoder->_index));
+
+    if (fseek(encoder->_fp, 0, SEEK_SET) != 0 ||
+        fwrite(&encoder->header, sizeof(encoder->header), 1, encoder->_fp) != 1)
+    {
+        encoder->_failed = true;
+    }
+    if (fclose(encoder->_fp) != 0) {
+        encoder->_failed = true;
+    }
+
+    bool ok = !encoder->_failed;
+    klm_free(encoder->_index);
+    klm_free(encoder->_payload);
+    klm_free(encoder->_scratch);
+    klm_free(encoder->_current);
+    klm_free(encoder);
+    return ok;
+}
+
+static bool _klm_anim_player_decode(klm_anim_player * const player) {
+    __klm_anim_frame_t record;
+    if (player->_offset + sizeof(record) > player->header.index_offset) {
+        return false;
+    }
+    memcpy(&record, player->_map + player->_offset, sizeof(record));
+
+    const size_t payload = player->_offset + sizeof(record);
+    if (payload + record.length > player->header.index_offset) {
+        return false;
+    }
+
+    // A keyframe is a delta from a blank frame
+    if (record.type == KLM_ANIM_FRAME_KEY) {
+        memset(player->frame, 0, player->buffer_len);
+    }
+    if (!_klm_anim_apply(player->frame, player->buffer_len, player->_map + payload, record.length)) {
+        return false;
+    }
+
+    player->_offset = payload + record.length;
+    player->hold = (record.duration == 0) ? 1 : record.duration;
+    player->decode_count++;
+    return true;
+}
+
+static bool _klm_anim_apply(uint8_t * const frame, size_t frame_len, const uint8_t *src, size_t len) {
+    const uint8_t * const end = src + len;
+    uint8_t *out = frame;
+    uint8_t * const out_end = frame + frame_len;
+
+    while (src < end) {
+        uint8_t token = *src++;
+        if (token & KLM_ANIM_RUN_TOKEN) {
+            // Unchanged bytes
+            out += (token & ~KLM_ANIM_RUN_TOKEN) + 1;
+            if (out > out_end) {
+                return false;
+            }
+            continue;
+        }
+
+        size_t n = (size_t)token + 1;
+        if (src + n > end || out + n > out_end) {
+            return false;
+        }
+        while (n--) {
+            *out++ ^= *src++;
+        }
+    }
+    return true;
+}
+
+static void _klm_anim_get_index(klm_anim_player * const player, uint32_t i, __klm_anim_index_t * const entry) {
+    // The index may not be aligned in the file
+    memcpy(entry,
+           player->_map + player->header.index_offset + (size_t)i*sizeof(*entry),
+           sizeof(*entry));
+}
+
+static size_t _klm_anim_encode(const uint8_t * const src, size_t len, uint8_t * const dst) {
+    size_t i = 0, n = 0;
+    while (i < len) {
+        // A run of two or more zero bytes is cheaper as a single token
+        size_t run = 0;
+        while (i + run < len && src[i + run] == 0 && run < KLM_ANIM_RUN_MAX) {
+            run++;
+        }
+        if (run >= 2 || (run == 1 && i + 1 == len)) {
+            dst[n++] = (uint8_t)(KLM_ANIM_RUN_TOKEN | (run - 1));
+            i += run;
+            continue;
+        }
+
+        // Otherwise literal bytes, up to the next such run
+        size_t start = i;
+        while (i < len && i - start < KLM_ANIM_RUN_MAX &&
+               !(src[i] == 0 && i + 1 < len && src[i + 1] == 0))
+        {
+            i++;
+        }
+        if (i == start) {
+            i++;
+        }
+        dst[n++] = (uint8_t)(i - start - 1);
+        memcpy(dst + n, src + start, i - start);
+        n += i - start;
+    }
+    return n;
+}
+
+static void _klm_anim_encoder_flush(klm_anim_encoder * const encoder) {
+    if (!encoder->_has_pending) {
+        return;
+    }
+
+    if (encoder->_pending.type == KLM_ANIM_FRAME_KEY) {
+        // Grow the index if need be
+        if (encoder->key_count == encoder->_index_capacity) {
+            __klm_anim_index_t *index =
+                klm_malloc(2 * encoder->_index_capacity * sizeof(*index));
+            memcpy(index, encoder->_index, encoder->key_count * sizeof(*index));
+            klm_free(encoder->_index);
+            encoder->_index = index;
+            encoder->_index_capacity *= 2;
+        }
+
+        __klm_anim_index_t * const entry = &encoder->_index[encoder->key_count++];
+        entry->frame = encoder->header.frame_count;
+        entry->offset = encoder->bytes_written;
+        entry->tick = encoder->header.total_ticks;
+    }
+
+    _klm_anim_encoder_write(encoder, &encoder->_pending, sizeof(encoder->_pending));
+    _klm_anim_encoder_write(encoder, encoder->_payload, encoder->_pending.length);
+
+    encoder->header.frame_count++;
+    encoder->header.total_ticks += encoder->_pending.duration;
+    encoder->_has_pending = false;
+}
+
+static void _klm_anim_encoder_write(klm_anim_encoder * const encoder, const void * const data, size_t len) {
+    if (len > 0 && fwrite(data, len, 1, encoder->_fp) != 1) {
+        encoder->_failed = true;
+    }
+    encoder->bytes_written += len;
+}
@@ -0,0 +1,219 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "klm_bitplanes.h"
+#include "klm_alloc.h"
+
+// Symbolic constants
+#define KLM_BYTE_WIDTH 8
+#define KLM_BITPLANES_GAMMA 2.2f
+
+static void _klm_bitplanes_update_lanes(klm_bitplanes * const bitplanes, uint8_t index);
+static uint8_t _klm_bitplanes_gamma(uint8_t c, uint8_t depth);
+
+
+/** Create bitplanes for a panel of the given size, with the given number of bits per channel */
+klm_bitplanes * const klm_bitplanes_create(uint16_t width, uint16_t height, uint8_t depth) {
+    // Allocate memory for the bitplanes structure and initialize all members
+    klm_bitplanes * const bitplanes = klm_malloc(sizeof(klm_bitplanes));
+
+    if (depth < 1) {
+        depth = 1;
+    }
+    if (depth > KLM_BITPLANES_MAX_DEPTH) {
+        depth = KLM_BITPLANES_MAX_DEPTH;
+    }
+
+    bitplanes->width = width;
+    bitplanes->height = height;
+    bitplanes->address_count = height / 2;
+    bitplanes->depth = depth;
+    bitplanes->plane_len = (size_t)bitplanes->address_count * width;
+
+    bitplanes->data = klm_calloc(depth * bitplanes->plane_len, sizeof(*bitplanes->data));
+    bitplanes->attributes = klm_malloc((size_t)width * height);
+    memset(bitplanes->attributes, KLM_BITPLANES_DEFAULT, (size_t)width * height);
+
+    bitplanes->palette_len = 0;
+    klm_bitplanes_add_colour(bitplanes, KLM_COLOUR_BLACK);
+    klm_bitplanes_set_default_colour(bitplanes, KLM_COLOUR_WHITE);
+
+    return bitplanes;
+}
+
+/** Clean up bitplanes */
+void klm_bitplanes_destroy(klm_bitplanes * const bitplanes) {
+    klm_free(bitplanes->attributes);
+    klm_free(bitplanes->data);
+    klm_free(bitplanes);
+}
+
+/** Palette index for the given colour, adding it if need be. Returns the nearest colour if the palette is full */
+uint8_t klm_bitplanes_add_colour(klm_bitplanes * const bitplanes, klm_colour colour) {
+    uint8_t i;
+    for (i=0; i<bitplanes->palette_len; i++) {
+        if (klm_colour_equals(bitplanes->palette[i], colour)) {
+            return i;
+        }
+    }
+
+    if (bitplanes->palette_len < KLM_BITPLANES_MAX_COLOURS) {
+        i = bitplanes->palette_len++;
+        bitplanes->palette[i] = colour;
+        _klm_bitplanes_update_lanes(bitplanes, i);
+        return i;
+    }
+
+    // Full, so make do with whatever is closest
+    uint8_t nearest = 0;
+    int32_t nearest_distance = INT32_MAX;
+    for (i=0; i<bitplanes->palette_len; i++) {
+        int32_t dr = (int32_t)bitplanes->palette[i].r - colour.r;
+        int32_t dg = (int32_t)bitplanes->palette[i].g - colour.g;
+        int32_t db = (int32_t)bitplanes->palette[i].b - colour.b;
+        int32_t distance = dr*dr + dg*dg + db*db;
+        if (distance < nearest_distance) {
+            nearest = i;
+            nearest_distance = distance;
+        }
+    }
+    return nearest;
+}
+
+/** Change the colour of anything which hasn't been given one */
+void klm_bitplanes_set_default_colour(klm_bitplanes * const bitplanes, klm_colour colour) {
+    if (bitplanes->palette_len <= KLM_BITPLANES_DEFAULT) {
+        bitplanes->palette_len = KLM_BITPLANES_DEFAULT + 1;
+    }
+    bitplanes->palette[KLM_BITPLANES_DEFAULT] = colour;
+    _klm_bitplanes_update_lanes(bitplanes, KLM_BITPLANES_DEFAULT);
+}
+
+/** Give a rectangle of pixels the given palette index */
+void klm_bitplanes_fill(klm_bitplanes * const bitplanes,
+                        int16_t x, int16_t y,
+                        uint16_t w, uint16_t h,
+                        uint8_t index)
+{
+    // Clip to the panel
+    int32_t x0 = (x < 0) ? 0 : x;
+    int32_t y0 = (y < 0) ? 0 : y;
+    int32_t x1 = ((int32_t)x + w > bitplanes->width) ? bitplanes->width : (int32_t)x + w;
+    int32_t y1 = ((int32_t)y + h > bitplanes->height) ? bitplanes->height : (int32_t)y + h;
+    if (x1 <= x0) {
+        return;
+    }
+
+    int32_t row;
+    for (row=y0; row<y1; row++) {
+        memset(bitplanes->attributes + (size_t)row*bitplanes->width + x0, index, x1 - x0);
+    }
+}
+
+/** Encode a 1bpp frame buffer into the bitplanes, using the pixel attributes for colour */
+void klm_bitplanes_encode(klm_bitplanes * const bitplanes,
+                          const klm_wire_format * const format,
+                          const uint8_t * const src)
+{
+    const uint16_t width = bitplanes->width;
+    const uint16_t row_width = width / KLM_BYTE_WIDTH;
+    const uint8_t depth = bitplanes->depth;
+    const size_t plane_len = bitplanes->plane_len;
+    const uint8_t xor_mask = format->invert ? KLM_HUB75_MASK : 0x00;
+    const uint64_t * const lanes = bitplanes->_lanes;
+
+    uint16_t address, x8;
+    uint8_t bit, plane;
+    for (address=0; address<bitplanes->address_count; address++) {
+        // Work out which two buffer rows are shifted out together
+        uint16_t row1 = address;
+        uint16_t row2 = address + bitplanes->address_count;
+        if (format->reverse_rows) {
+            row1 = bitplanes->height - 1 - row1;
+            row2 = bitplanes->height - 1 - row2;
+        }
+        const uint8_t *in1 = src + row1*row_width;
+        const uint8_t *in2 = src + row2*row_width;
+        const uint8_t *attr1 = bitplanes->attributes + (size_t)row1*width;
+        const uint8_t *attr2 = bitplanes->attributes + (size_t)row2*width;
+        uint8_t *out = bitplanes->data + (size_t)address*width;
+
+        for (x8=0; x8<row_width; x8++) {
+            const uint8_t pixel8_1 = in1[x8];
+            const uint8_t pixel8_2 = in2[x8];
+            const uint16_t x = x8*KLM_BYTE_WIDTH;
+
+            // As on the mono wire, reversing bytes swaps groups of eight
+            // columns, reversing bits swaps the columns within each group
+            const uint16_t group = format->reverse_bytes ? (width - KLM_BYTE_WIDTH - x) : x;
+
+            // Most of a text display is dark, so blank whole bytes at a time
+            if ((pixel8_1 | pixel8_2) == 0) {
+                for (plane=0; plane<depth; plane++) {
+                    memset(out + plane*plane_len + group, xor_mask, KLM_BYTE_WIDTH);
+                }
+                continue;
+            }
+
+            for (bit=0; bit<KLM_BYTE_WIDTH; bit++) {
+                // Look up the wire bits for every plane at once, for both rows
+                uint64_t value =
+                    lanes[((pixel8_1 >> bit) & 0x01) ? attr1[x + bit] : KLM_BITPLANES_BLACK] |
+                    (lanes[((pixel8_2 >> bit) & 0x01) ? attr2[x + bit] : KLM_BITPLANES_BLACK] << 3);
+
+                const uint16_t column = group + (format->reverse_bits ? (KLM_BYTE_WIDTH - 1 - bit) : bit);
+                for (plane=0; plane<depth; plane++) {
+                    out[plane*plane_len + column] = (uint8_t)(value >> (plane*8)) ^ xor_mask;
+                }
+            }
+        }
+    }
+}
+
+static void _klm_bitplanes_update_lanes(klm_bitplanes * const bitplanes, uint8_t index) {
+    const klm_colour colour = bitplanes->palette[index];
+    const uint8_t r = _klm_bitplanes_gamma(colour.r, bitplanes->depth);
+    const uint8_t g = _klm_bitplanes_gamma(colour.g, bitplanes->depth);
+    const uint8_t b = _klm_bitplanes_gamma(colour.b, bitplanes->depth);
+
+    // Bit n of each channel goes in the byte for plane n
+    uint64_t lanes = 0;
+    uint8_t plane;
+    for (plane=0; plane<bitplanes->depth; plane++) {
+        uint8_t bits = 0;
+        if ((r >> plane) & 0x01) bits |= KLM_HUB75_R1;
+        if ((g >> plane) & 0x01) bits |= KLM_HUB75_G1;
+        if ((b >> plane) & 0x01) bits |= KLM_HUB75_B1;
+        lanes |= (uint64_t)bits << (plane*8);
+    }
+    bitplanes->_lanes[index] = lanes;
+}
+
+static uint8_t _klm_bitplanes_gamma(uint8_t c, uint8_t depth) {
+    // Map a 0-255 channel value onto the 0-(2^depth - 1) levels, perceptually
+    const float levels = (float)((1 << depth) - 1);
+    return (uint8_t)(powf(c / 255.0f, KLM_BITPLANES_GAMMA) * levels + 0.5f);
+}
@@ -0,0 +1,210 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <tinyutf8.h>
+#include "klm_canvas.h"
+#include "klm_alloc.h"
+
+// Symbolic constants
+#define KLM_BYTE_WIDTH 8
+#define KLM_CHARACTER_SPACING 1
+
+static inline uint32_t _klm_canvas_read_word(klm_canvas * const canvas,
+                                             const uint32_t * const row,
+                                             int32_t bit);
+static inline uint32_t _klm_canvas_read_word_wrapped(klm_canvas * const canvas,
+                                                     const uint32_t * const row,
+                                                     int32_t bit);
+
+
+/** Create a blank canvas */
+klm_canvas * const klm_canvas_create(int32_t width, int32_t height) {
+    // Allocate memory for the canvas structure and its pixels
+    klm_canvas * const canvas = klm_malloc(sizeof(klm_canvas));
+
+    canvas->width = width;
+    canvas->height = height;
+    canvas->_row_words = (width + KLM_CANVAS_WORD_WIDTH - 1) / KLM_CANVAS_WORD_WIDTH + 1;
+    canvas->buffer = klm_calloc((size_t)canvas->_row_words * height, sizeof(*canvas->buffer));
+
+    return canvas;
+}
+
+/** Clean up a canvas */
+void klm_canvas_destroy(klm_canvas * const canvas) {
+    klm_free(canvas->buffer);
+    klm_free(canvas);
+}
+
+/** Clear the entire canvas */
+void klm_canvas_clear(klm_canvas * const canvas) {
+    memset(canvas->buffer, 0,
+           (size_t)canvas->_row_words * canvas->height * sizeof(*canvas->buffer));
+}
+
+/** Draw a sprite onto the canvas */
+void klm_canvas_render_sprite(klm_canvas * const canvas,
+                              hexfont_character * const sprite,
+                              int32_t x, int32_t y)
+{
+    int16_t by, bx;
+    for (by=0; by<sprite->height; by++) {
+        for (bx=0; bx<sprite->width; bx++) {
+            if (hexfont_character_get_pixel(sprite, bx, by)) {
+                klm_canvas_set_pixel(canvas, x + bx, y + by);
+            }
+            else {
+                klm_canvas_clear_pixel(canvas, x + bx, y + by);
+            }
+        }
+    }
+}
+
+/** Draw UTF-8 text onto the canvas, returns the x coordinate after the last character */
+int32_t klm_canvas_render_text(klm_canvas * const canvas,
+                               hexfont * const font,
+                               const char * const text,
+                               int32_t x, int32_t y)
+{
+    size_t len = tinyutf8_strlen(text);
+    size_t i=0, cnt;
+    for (cnt=0; cnt<len; cnt++) {
+        hexfont_character * const c =
+            hexfont_get(font, tinyutf8_next_codepoint(text, &i));
+        if (c == NULL) {
+            continue;
+        }
+
+        klm_canvas_render_sprite(canvas, c, x, y);
+        x += c->width + KLM_CHARACTER_SPACING;
+    }
+    return x;
+}
+
+/** Copy a width x height window at (x, y) of the canvas into a 1bpp buffer */
+void klm_canvas_copy_window(klm_canvas * const canvas,
+                            int32_t x, int32_t y,
+                            bool wrap,
+                            uint8_t * const dst,
+                            uint16_t width, uint16_t height)
+{
+    const uint16_t dst_row_width = width / KLM_BYTE_WIDTH;
+
+    if (wrap) {
+        x %= canvas->width;
+        if (x < 0) {
+            x += canvas->width;
+        }
+    }
+
+    uint16_t row;
+    for (row=0; row<height; row++) {
+        uint8_t *out = dst + row*dst_row_width;
+
+        int32_t src_y = y + row;
+        if (wrap) {
+            src_y %= canvas->height;
+            if (src_y < 0) {
+                src_y += canvas->height;
+            }
+        }
+        else if (src_y < 0 || src_y >= canvas->height) {
+            memset(out, 0, dst_row_width);
+            continue;
+        }
+
+        // Produce the row a shifted word at a time
+        const uint32_t *src = canvas->buffer + (size_t)src_y*canvas->_row_words;
+        uint16_t x8;
+        for (x8=0; x8<dst_row_width; x8+=sizeof(uint32_t)) {
+            int32_t bit = x + x8*KLM_BYTE_WIDTH;
+            uint32_t word = wrap ?
+                                _klm_canvas_read_word_wrapped(canvas, src, bit) :
+                                _klm_canvas_read_word(canvas, src, bit);
+
+            uint16_t n = dst_row_width - x8;
+            if (n > sizeof(uint32_t)) {
+                n = sizeof(uint32_t);
+            }
+
+            uint16_t b;
+            for (b=0; b<n; b++) {
+                out[x8 + b] = (uint8_t)(word >> (b*KLM_BYTE_WIDTH));
+            }
+        }
+    }
+}
+
+/** Advance a viewport by its speed */
+void klm_viewport_tick(klm_viewport * const viewport) {
+    viewport->x += viewport->hspeed;
+    viewport->y += viewport->vspeed;
+
+    // Keep the position small so that float precision doesn't run out
+    if (viewport->wrap) {
+        viewport->x = fmodf(viewport->x, viewport->canvas->width);
+        viewport->y = fmodf(viewport->y, viewport->canvas->height);
+    }
+}
+
+/** Read the 32 pixels starting at the given bit of a row, blank outside the canvas */
+static inline uint32_t _klm_canvas_read_word(klm_canvas * const canvas,
+                                             const uint32_t * const row,
+                                             int32_t bit)
+{
+    if (bit <= -KLM_CANVAS_WORD_WIDTH || bit >= canvas->width) {
+        return 0;
+    }
+    if (bit < 0) {
+        return _klm_canvas_read_word(canvas, row, 0) << (-bit);
+    }
+
+    // The padding word keeps row[w + 1] in bounds
+    int32_t w = bit / KLM_CANVAS_WORD_WIDTH;
+    int32_t s = bit % KLM_CANVAS_WORD_WIDTH;
+    uint32_t lo = row[w] >> s;
+    uint32_t hi = (s == 0) ? 0 : (row[w + 1] << (KLM_CANVAS_WORD_WIDTH - s));
+    return lo | hi;
+}
+
+/** Read the 32 pixels starting at the given bit of a row, wrapping around at the end */
+static inline uint32_t _klm_canvas_read_word_wrapped(klm_canvas * const canvas,
+                                                     const uint32_t * const row,
+                                                     int32_t bit)
+{
+    bit %= canvas->width;
+
+    // Splice the start of the row on after the end, as many times as needed
+    uint32_t word = 0;
+    int32_t filled = 0;
+    while (filled < KLM_CANVAS_WORD_WIDTH) {
+        word |= _klm_canvas_read_word(canvas, row, bit) << filled;
+        filled += canvas->width - bit;
+        bit = 0;
+    }
+    return word;
+}
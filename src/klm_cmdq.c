@@ -0,0 +1,225 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "klm_cmdq.h"
+#include "klm_segment.h"
+#include "klm_alloc.h"
+
+static bool _klm_cmdq_take(klm_cmdq * const q, klm_command * const cmd);
+static void _klm_cmdq_execute(klm_command * const cmd);
+
+
+/** Create a command queue with the given capacity, which must be a power of two. Returns NULL if it isn't */
+klm_cmdq * const klm_cmdq_create(size_t capacity) {
+    // Slots are picked by masking the position, which needs a power of two
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return NULL;
+    }
+
+    // Allocate memory for the queue and all of its slots up front
+    klm_cmdq * const q = klm_malloc(sizeof(klm_cmdq));
+    q->slots = klm_malloc(capacity * sizeof(__klm_cmdq_slot_t));
+    q->mask = capacity - 1;
+    q->head = 0;
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->dropped_count, 0);
+
+    // Each slot's sequence says which position may next be written to it
+    size_t i;
+    for (i=0; i<capacity; i++) {
+        atomic_init(&q->slots[i].sequence, i);
+    }
+
+    return q;
+}
+
+/** Clean up a command queue, freeing any text which was never applied */
+void klm_cmdq_destroy(klm_cmdq * const q) {
+    klm_command cmd;
+    while (_klm_cmdq_take(q, &cmd)) {
+        if (cmd.type == KLM_CMD_CALL) {
+            cmd.fn(cmd.data, false);
+        }
+        klm_free(cmd.text);
+    }
+
+    klm_free(q->slots);
+    klm_free(q);
+}
+
+/** Post a command, returns false if the queue is full */
+bool klm_cmdq_post(klm_cmdq * const q, const klm_command * const cmd) {
+    __klm_cmdq_slot_t *slot;
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    for (;;) {
+        slot = &q->slots[pos & q->mask];
+        size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            // The slot is free, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // The consumer hasn't got this far yet: the queue is full
+            atomic_fetch_add_explicit(&q->dropped_count, 1, memory_order_relaxed);
+            return false;
+        }
+        else {
+            // Another producer claimed the slot first
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+
+    // Fill the slot, then publish it to the consumer
+    slot->command = *cmd;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+/** Apply all pending commands, returns the number applied. Must only be called by one thread */
+uint16_t klm_cmdq_apply(klm_cmdq * const q) {
+    klm_command cmd;
+    uint16_t count = 0;
+
+    // Don't chase producers forever, anything later waits for the next tick
+    while (count <= q->mask && _klm_cmdq_take(q, &cmd)) {
+        _klm_cmdq_execute(&cmd);
+        count++;
+    }
+    return count;
+}
+
+/** Drop the pending commands for a segment which is being destroyed. Must only be called by the applying thread */
+void klm_cmdq_cancel_segment(klm_cmdq * const q, klm_segment * const seg) {
+    // Every published slot from the head on belongs to the consumer until it is taken
+    size_t pos;
+    for (pos=q->head; pos<=q->head + q->mask; pos++) {
+        __klm_cmdq_slot_t * const slot = &q->slots[pos & q->mask];
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != pos + 1) {
+            break;
+        }
+
+        klm_command * const cmd = &slot->command;
+        if (cmd->type != KLM_CMD_CALL && cmd->seg == seg) {
+            klm_free(cmd->text);
+            cmd->text = NULL;
+            cmd->seg = NULL;
+        }
+    }
+}
+
+/** Post a new text for a segment */
+bool klm_cmdq_post_set_text(klm_cmdq * const q, klm_segment * const seg, char * const text) {
+    klm_command cmd = { .type = KLM_CMD_SET_TEXT, .seg = seg, .text = text };
+    return klm_cmdq_post(q, &cmd);
+}
+
+/** Post a new text scroll speed for a segment */
+bool klm_cmdq_post_set_text_speed(klm_cmdq * const q, klm_segment * const seg, float hspeed, float vspeed) {
+    klm_command cmd = { .type = KLM_CMD_SET_TEXT_SPEED, .seg = seg, .h = hspeed, .v = vspeed };
+    return klm_cmdq_post(q, &cmd);
+}
+
+/** Post a new text position for a segment */
+bool klm_cmdq_post_set_text_position(klm_cmdq * const q, klm_segment * const seg, float text_hpos, float text_vpos) {
+    klm_command cmd = { .type = KLM_CMD_SET_TEXT_POSITION, .seg = seg, .h = text_hpos, .v = text_vpos };
+    return klm_cmdq_post(q, &cmd);
+}
+
+/** Post a command which takes no arguments (show, hide, start, stop, reverse, clear text) */
+bool klm_cmdq_post_simple(klm_cmdq * const q, klm_segment * const seg, klm_command_type type) {
+    klm_command cmd = { .type = type, .seg = seg };
+    return klm_cmdq_post(q, &cmd);
+}
+
+/** Post a function to be called by the rendering thread, e.g. to apply several changes in the same tick */
+bool klm_cmdq_post_call(klm_cmdq * const q, klm_command_fn fn, void *data) {
+    klm_command cmd = { .type = KLM_CMD_CALL, .fn = fn, .data = data };
+    return klm_cmdq_post(q, &cmd);
+}
+
+static bool _klm_cmdq_take(klm_cmdq * const q, klm_command * const cmd) {
+    __klm_cmdq_slot_t *slot = &q->slots[q->head & q->mask];
+    size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+    // Empty, or the next producer hasn't finished filling its slot yet
+    if (seq != q->head + 1) {
+        return false;
+    }
+
+    *cmd = slot->command;
+
+    // Hand the slot back to the producers for the next lap
+    atomic_store_explicit(&slot->sequence, q->head + q->mask + 1, memory_order_release);
+    q->head++;
+    return true;
+}
+
+static void _klm_cmdq_execute(klm_command * const cmd) {
+    // Cancelled, its segment is gone
+    if (cmd->type != KLM_CMD_CALL && cmd->seg == NULL) {
+        return;
+    }
+
+    switch (cmd->type) {
+        case KLM_CMD_SET_TEXT:
+            klm_seg_take_text(cmd->seg, cmd->text);
+            break;
+        case KLM_CMD_SET_TEXT_SPEED:
+            klm_seg_set_text_speed(cmd->seg, cmd->h, cmd->v);
+            break;
+        case KLM_CMD_SET_TEXT_POSITION:
+            klm_seg_set_text_position(cmd->seg, cmd->h, cmd->v);
+            break;
+        case KLM_CMD_CLEAR_TEXT:
+            klm_seg_clear_text(cmd->seg);
+            break;
+        case KLM_CMD_SHOW:
+            klm_seg_show(cmd->seg);
+            break;
+        case KLM_CMD_HIDE:
+            klm_seg_hide(cmd->seg);
+            break;
+        case KLM_CMD_START:
+            klm_seg_start(cmd->seg);
+            break;
+        case KLM_CMD_STOP:
+            klm_seg_stop(cmd->seg);
+            break;
+        case KLM_CMD_REVERSE:
+            klm_seg_reverse(cmd->seg);
+            break;
+        case KLM_CMD_CALL:
+            cmd->fn(cmd->data, true);
+            break;
+    }
+}
@@ -21,23 +21,40 @@
  * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include "klm_config.h"
+#include "klm_glyph_cache.h"
+#include "klm_alloc.h"
 
 
 klm_config * const klm_config_create(int16_t width, int16_t height) {
     // Allocate memory for the config structure
-    klm_config * const config = malloc(sizeof(klm_config));
+    klm_config * const config = klm_malloc(sizeof(klm_config));
 
     config->pin_list = klm_pin_list_create();
     config->width = width;
     config->height = height;
+    config->spi_device = NULL;
+    config->spi_speed_hz = 0;
+    config->gpio_chip = NULL;
+    config->rotation = KLM_ROTATE_0;
+    config->mirror_x = false;
+    config->mirror_y = false;
+#ifdef KLM_STATIC
+    config->glyph_cache_capacity = KLM_GLYPH_CACHE_OFF;
+#else
+    config->glyph_cache_capacity = KLM_GLYPH_CACHE_AUTO;
+#endif
+    config->glyph_cache_max_scale = KLM_GLYPH_CACHE_DEFAULT_MAX_SCALE;
 
     return config;
 }
 
 void klm_config_destroy(klm_config * const config) {
     klm_pin_list_destroy(config->pin_list);
-    free(config);
+    klm_free(config->spi_device);
+    klm_free(config->gpio_chip);
+    klm_free(config);
 }
 
 void klm_config_set_pin(klm_config * const config, char pin_name, uint8_t pin_number) {
@@ -48,3 +65,29 @@ uint8_t klm_config_get_pin(klm_config * const config, char pin_name) {
     return klm_pin_list_get(config->pin_list, pin_name);
 }
 
+bool klm_config_has_pin(klm_config * const config, char pin_name) {
+    return klm_pin_list_has(config->pin_list, pin_name);
+}
+
+void klm_config_set_spi_device(klm_config * const config, const char * const path, uint32_t speed_hz) {
+    klm_free(config->spi_device);
+    config->spi_device = (path == NULL) ? NULL : klm_strdup(path);
+    config->spi_speed_hz = speed_hz;
+}
+
+void klm_config_set_gpio_chip(klm_config * const config, const char * const path) {
+    klm_free(config->gpio_chip);
+    config->gpio_chip = (path == NULL) ? NULL : klm_strdup(path);
+}
+
+void klm_config_set_orientation(klm_config * const config, klm_rotation rotation, bool mirror_x, bool mirror_y) {
+    config->rotation = rotation;
+    config->mirror_x = mirror_x;
+    config->mirror_y = mirror_y;
+}
+
+void klm_config_set_glyph_cache(klm_config * const config, uint16_t capacity, uint8_t max_scale) {
+    config->glyph_cache_capacity = capacity;
+    config->glyph_cache_max_scale = (max_scale > 0) ? max_scale : 1;
+}
+
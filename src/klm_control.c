@@ -0,0 +1,601 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+#include "klm_control.h"
+#include "klm_segment.h"
+#include "klm_alloc.h"
+
+static __klm_control_batch_t * const _klm_control_get_batch(klm_control * const control);
+static klm_control_status _klm_control_parse_command(klm_control * const control,
+                                                     __klm_control_command_t * const cmd,
+                                                     const uint8_t * const payload,
+                                                     uint16_t payload_len,
+                                                     char ** const text);
+static void _klm_control_apply(void *data, bool apply);
+static void _klm_control_execute(klm_matrix * const matrix, __klm_control_command_t * const cmd);
+static void _klm_control_on_ready(klm_runtime * const runtime, int fd, uint32_t events, void *user_data);
+static bool _klm_control_is_utf8(const uint8_t * const p, uint16_t len);
+static uint16_t _klm_control_get_u16(const uint8_t * const p);
+static void _klm_control_put_u16(uint8_t * const p, uint16_t v);
+static float _klm_control_get_f32(const uint8_t * const p);
+static void _klm_control_put_f32(uint8_t * const p, float f);
+
+
+/** Create a control socket for the matrix at the given path, replacing anything already there. NULL on failure */
+klm_control * const klm_control_create(klm_matrix * const matrix, const char * const path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return NULL;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    // A socket left behind by an earlier run would stop the bind
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // Allocate memory for the control structure and initialize all members
+    klm_control * const control = klm_malloc(sizeof(klm_control));
+    control->matrix = matrix;
+    control->fd = fd;
+    control->path = klm_strdup(path);
+    control->batch_count = 0;
+    control->command_count = 0;
+    control->rejected_count = 0;
+
+    control->_message = klm_malloc(KLM_CONTROL_MAX_MESSAGE);
+    control->_batches = klm_calloc(KLM_CONTROL_BATCHES, sizeof(__klm_control_batch_t));
+    uint8_t i;
+    for (i=0; i<KLM_CONTROL_BATCHES; i++) {
+        atomic_init(&control->_batches[i].busy, false);
+    }
+
+    return control;
+}
+
+/** Close and remove the control socket */
+void klm_control_destroy(klm_control * const control) {
+    close(control->fd);
+    unlink(control->path);
+
+    klm_free(control->_batches);
+    klm_free(control->_message);
+    klm_free(control->path);
+    klm_free(control);
+}
+
+/** Read every waiting message, queueing those which are valid. Returns the number queued */
+uint16_t klm_control_receive(klm_control * const control) {
+    uint16_t queued = 0;
+
+    for (;;) {
+        struct sockaddr_un from;
+        socklen_t from_len = sizeof(from);
+
+        // Ask for the real length, so that a message which was cut short is rejected
+        ssize_t n = recvfrom(control->fd,
+                             control->_message, KLM_CONTROL_MAX_MESSAGE,
+                             MSG_TRUNC,
+                             (struct sockaddr *)&from, &from_len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        klm_control_status status = KLM_CONTROL_BAD_MESSAGE;
+        if (n <= KLM_CONTROL_MAX_MESSAGE) {
+            status = klm_control_submit(control, control->_message, n);
+        }
+
+        if (status == KLM_CONTROL_OK) {
+            queued++;
+        }
+        else {
+            control->rejected_count++;
+        }
+
+        // Only clients which have an address of their own can be replied to
+        if (from_len > sizeof(sa_family_t)) {
+            uint8_t reply = status;
+            sendto(control->fd, &reply, sizeof(reply), MSG_DONTWAIT,
+                   (struct sockaddr *)&from, from_len);
+        }
+    }
+    return queued;
+}
+
+/** Check a message and queue it for the next tick */
+klm_control_status klm_control_submit(klm_control * const control,
+                                      const uint8_t * const message,
+                                      size_t len)
+{
+    if (len < KLM_CONTROL_HEADER_LEN ||
+        len > KLM_CONTROL_MAX_MESSAGE ||
+        message[0] != KLM_CONTROL_MAGIC_0 ||
+        message[1] != KLM_CONTROL_MAGIC_1 ||
+        message[2] != KLM_CONTROL_VERSION ||
+        message[3] > KLM_CONTROL_MAX_COMMANDS)
+    {
+        return KLM_CONTROL_BAD_MESSAGE;
+    }
+
+    // An empty message just checks that the socket is there
+    const uint8_t count = message[3];
+    if (count == 0) {
+        return (len == KLM_CONTROL_HEADER_LEN) ? KLM_CONTROL_OK : KLM_CONTROL_BAD_MESSAGE;
+    }
+
+    __klm_control_batch_t * const batch = _klm_control_get_batch(control);
+    if (batch == NULL) {
+        return KLM_CONTROL_BUSY;
+    }
+
+    // Check the whole message before any of it is queued
+    klm_control_status status = KLM_CONTROL_OK;
+    char *text = batch->text;
+    size_t p = KLM_CONTROL_HEADER_LEN;
+    uint8_t i;
+    for (i=0; i<count && status==KLM_CONTROL_OK; i++) {
+        if (p + KLM_CONTROL_COMMAND_HEADER_LEN > len) {
+            status = KLM_CONTROL_BAD_MESSAGE;
+            break;
+        }
+
+        __klm_control_command_t * const cmd = &batch->commands[i];
+        cmd->op = message[p];
+        cmd->segment = message[p + 1];
+        uint16_t payload_len = _klm_control_get_u16(message + p + 2);
+        p += KLM_CONTROL_COMMAND_HEADER_LEN;
+
+        if (p + payload_len > len) {
+            status = KLM_CONTROL_BAD_MESSAGE;
+            break;
+        }
+        status = _klm_control_parse_command(control, cmd, message + p, payload_len, &text);
+        p += payload_len;
+    }
+    if (status == KLM_CONTROL_OK && p != len) {
+        status = KLM_CONTROL_BAD_MESSAGE;
+    }
+
+    if (status == KLM_CONTROL_OK) {
+        batch->matrix = control->matrix;
+        batch->count = count;
+        if (!klm_cmdq_post_call(control->matrix->cmdq, _klm_control_apply, batch)) {
+            status = KLM_CONTROL_BUSY;
+        }
+    }
+
+    if (status != KLM_CONTROL_OK) {
+        atomic_store_explicit(&batch->busy, false, memory_order_relaxed);
+        return status;
+    }
+
+    control->batch_count++;
+    control->command_count += count;
+    return KLM_CONTROL_OK;
+}
+
+/** Receive whenever the socket is readable, from the runtime's thread */
+bool klm_control_add_to_runtime(klm_control * const control, klm_runtime * const runtime) {
+    return klm_runtime_add_fd(runtime, control->fd, EPOLLIN, _klm_control_on_ready, control);
+}
+
+/** Start a new, empty, message */
+void klm_control_message_init(klm_control_message * const message) {
+    message->data[0] = KLM_CONTROL_MAGIC_0;
+    message->data[1] = KLM_CONTROL_MAGIC_1;
+    message->data[2] = KLM_CONTROL_VERSION;
+    message->data[3] = 0;
+    message->len = KLM_CONTROL_HEADER_LEN;
+}
+
+/** Add a command with the given payload. Returns false if it won't fit */
+bool klm_control_message_add(klm_control_message * const message,
+                             klm_control_op op,
+                             uint8_t segment,
+                             const void * const payload,
+                             uint16_t payload_len)
+{
+    if (message->data[3] >= KLM_CONTROL_MAX_COMMANDS ||
+        message->len + KLM_CONTROL_COMMAND_HEADER_LEN + payload_len > KLM_CONTROL_MAX_MESSAGE)
+    {
+        return false;
+    }
+
+    uint8_t * const p = message->data + message->len;
+    p[0] = op;
+    p[1] = segment;
+    _klm_control_put_u16(p + 2, payload_len);
+    if (payload_len > 0) {
+        memcpy(p + KLM_CONTROL_COMMAND_HEADER_LEN, payload, payload_len);
+    }
+
+    message->len += KLM_CONTROL_COMMAND_HEADER_LEN + payload_len;
+    message->data[3]++;
+    return true;
+}
+
+/** Add a set text command */
+bool klm_control_message_add_text(klm_control_message * const message, uint8_t segment, const char * const text) {
+    size_t len = strlen(text);
+    if (len > KLM_CONTROL_MAX_MESSAGE) {
+        return false;
+    }
+    return klm_control_message_add(message, KLM_CONTROL_SET_TEXT, segment, text, len);
+}
+
+/** Add a set speed or position command */
+bool klm_control_message_add_floats(klm_control_message * const message,
+                                    klm_control_op op,
+                                    uint8_t segment,
+                                    float h, float v)
+{
+    uint8_t payload[8];
+    _klm_control_put_f32(payload, h);
+    _klm_control_put_f32(payload + 4, v);
+    return klm_control_message_add(message, op, segment, payload, sizeof(payload));
+}
+
+/** Add a create segment command */
+bool klm_control_message_add_create(klm_control_message * const message,
+                                    int16_t x, int16_t y,
+                                    uint16_t width, uint16_t height,
+                                    uint8_t font_index)
+{
+    uint8_t payload[9];
+    _klm_control_put_u16(payload, (uint16_t)x);
+    _klm_control_put_u16(payload + 2, (uint16_t)y);
+    _klm_control_put_u16(payload + 4, width);
+    _klm_control_put_u16(payload + 6, height);
+    payload[8] = font_index;
+    return klm_control_message_add(message, KLM_CONTROL_CREATE_SEGMENT, 0, payload, sizeof(payload));
+}
+
+/** Open a socket to the control socket at the given path. Replies come back on it. -1 on failure */
+int klm_control_connect(const char * const path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // Binding just the family gets an address picked for us, so replies can be sent back
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(sa_family_t)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** Send a message in one syscall */
+bool klm_control_send(int fd, const klm_control_message * const message) {
+    return (send(fd, message->data, message->len, 0) == (ssize_t)message->len);
+}
+
+static __klm_control_batch_t * const _klm_control_get_batch(klm_control * const control) {
+    uint8_t i;
+    for (i=0; i<KLM_CONTROL_BATCHES; i++) {
+        __klm_control_batch_t * const batch = &control->_batches[i];
+
+        // Only the rendering thread frees a batch, once it has been applied
+        if (!atomic_load_explicit(&batch->busy, memory_order_acquire)) {
+            atomic_store_explicit(&batch->busy, true, memory_order_relaxed);
+            return batch;
+        }
+    }
+    return NULL;
+}
+
+static klm_control_status _klm_control_parse_command(klm_control * const control,
+                                                     __klm_control_command_t * const cmd,
+                                                     const uint8_t * const payload,
+                                                     uint16_t payload_len,
+                                                     char ** const text)
+{
+    switch (cmd->op) {
+        case KLM_CONTROL_SET_TEXT:
+            // The decoder trusts each lead byte's length
+            if (!_klm_control_is_utf8(payload, payload_len)) {
+                return KLM_CONTROL_BAD_COMMAND;
+            }
+
+            // Each command header is longer than a terminator, so the text always fits
+            memcpy(*text, payload, payload_len);
+            (*text)[payload_len] = '\0';
+            cmd->text = *text;
+            *text += payload_len + 1;
+            return KLM_CONTROL_OK;
+
+        case KLM_CONTROL_SET_TEXT_SPEED:
+        case KLM_CONTROL_SET_TEXT_POSITION:
+            if (payload_len != 8) {
+                return KLM_CONTROL_BAD_COMMAND;
+            }
+            cmd->h = _klm_control_get_f32(payload);
+            cmd->v = _klm_control_get_f32(payload + 4);
+
+            // A NaN or infinity would stick to the segment for good
+            if (!isfinite(cmd->h) || !isfinite(cmd->v)) {
+                return KLM_CONTROL_BAD_COMMAND;
+            }
+            return KLM_CONTROL_OK;
+
+        case KLM_CONTROL_CLEAR_TEXT:
+        case KLM_CONTROL_SHOW:
+        case KLM_CONTROL_HIDE:
+        case KLM_CONTROL_START:
+        case KLM_CONTROL_STOP:
+        case KLM_CONTROL_REVERSE:
+            return (payload_len == 0) ? KLM_CONTROL_OK : KLM_CONTROL_BAD_COMMAND;
+
+#ifdef KLM_STATIC
+        // Every change to the segments takes more of the arena, which is never given back
+        case KLM_CONTROL_CREATE_SEGMENT:
+        case KLM_CONTROL_DESTROY_SEGMENT:
+            return KLM_CONTROL_BAD_COMMAND;
+#else
+        case KLM_CONTROL_DESTROY_SEGMENT:
+            return (payload_len == 0) ? KLM_CONTROL_OK : KLM_CONTROL_BAD_COMMAND;
+
+        case KLM_CONTROL_CREATE_SEGMENT:
+            if (payload_len != 9) {
+                return KLM_CONTROL_BAD_COMMAND;
+            }
+            cmd->x = (int16_t)_klm_control_get_u16(payload);
+            cmd->y = (int16_t)_klm_control_get_u16(payload + 2);
+            cmd->width = _klm_control_get_u16(payload + 4);
+            cmd->height = _klm_control_get_u16(payload + 6);
+            cmd->font_index = payload[8];
+
+            // It must be on the display
+            if (cmd->x < 0 || cmd->y < 0 || cmd->width == 0 || cmd->height == 0 ||
+                cmd->x + cmd->width > control->matrix->config->width ||
+                cmd->y + cmd->height > control->matrix->config->height)
+            {
+                return KLM_CONTROL_BAD_COMMAND;
+            }
+            return KLM_CONTROL_OK;
+#endif
+    }
+    return KLM_CONTROL_BAD_COMMAND;
+}
+
+static void _klm_control_apply(void *data, bool apply) {
+    __klm_control_batch_t * const batch = data;
+
+    if (apply) {
+        klm_matrix * const matrix = batch->matrix;
+
+        // The matrix resizes the states it saves for render-ahead itself
+        uint8_t i;
+        for (i=0; i<batch->count; i++) {
+            _klm_control_execute(matrix, &batch->commands[i]);
+        }
+    }
+
+    // Hand the batch back to the receiving thread
+    atomic_store_explicit(&batch->busy, false, memory_order_release);
+}
+
+static void _klm_control_execute(klm_matrix * const matrix, __klm_control_command_t * const cmd) {
+    if (cmd->op == KLM_CONTROL_CREATE_SEGMENT) {
+        if (matrix->font_list == NULL ||
+            hexfont_list_get_nth(matrix->font_list, cmd->font_index) == NULL)
+        {
+            KLM_LOG_WARN(matrix, "Control: no font %u\n", cmd->font_index);
+            return;
+        }
+
+        // The frames rendered ahead don't have the new segment
+        klm_mat_invalidate_frames(matrix);
+
+        klm_segment * const seg =
+            klm_seg_create(matrix, cmd->x, cmd->y, cmd->width, cmd->height, cmd->font_index);
+        if (seg == NULL) {
+            KLM_LOG_WARN(matrix, "Control: out of memory creating a segment\n");
+            return;
+        }
+
+        uint16_t segment_count = klm_segment_list_get_length(matrix->segment_list);
+        if (matrix->segment_list == NULL) {
+            matrix->segment_list = klm_segment_list_create(seg);
+        }
+        else {
+            klm_segment_list_append(matrix->segment_list, seg);
+        }
+        if (klm_segment_list_get_length(matrix->segment_list) == segment_count) {
+            KLM_LOG_WARN(matrix, "Control: out of memory creating a segment\n");
+            klm_seg_destroy(seg);
+            return;
+        }
+        seg->_remote = true;
+        return;
+    }
+
+    klm_segment * const seg = klm_segment_list_get_nth(matrix->segment_list, cmd->segment);
+    if (seg == NULL) {
+        KLM_LOG_WARN(matrix, "Control: no segment %u\n", cmd->segment);
+        return;
+    }
+
+    switch (cmd->op) {
+        case KLM_CONTROL_SET_TEXT:
+            klm_seg_set_text(seg, cmd->text);
+            break;
+        case KLM_CONTROL_SET_TEXT_SPEED:
+            klm_seg_set_text_speed(seg, cmd->h, cmd->v);
+            break;
+        case KLM_CONTROL_SET_TEXT_POSITION:
+            klm_seg_set_text_position(seg, cmd->h, cmd->v);
+            break;
+        case KLM_CONTROL_CLEAR_TEXT:
+            klm_seg_clear_text(seg);
+            break;
+        case KLM_CONTROL_SHOW:
+            klm_seg_show(seg);
+            break;
+        case KLM_CONTROL_HIDE:
+            klm_seg_hide(seg);
+            break;
+        case KLM_CONTROL_START:
+            klm_seg_start(seg);
+            break;
+        case KLM_CONTROL_STOP:
+            klm_seg_stop(seg);
+            break;
+        case KLM_CONTROL_REVERSE:
+            klm_seg_reverse(seg);
+            break;
+        case KLM_CONTROL_DESTROY_SEGMENT:
+            // The application still points at its own segments, and at any counter or timeline
+            if (!seg->_remote || seg->counter || seg->timeline) {
+                KLM_LOG_WARN(matrix, "Control: segment %u is in use\n", cmd->segment);
+                break;
+            }
+
+            // The simple API and the renderer expect at least one segment
+            if (matrix->segment_list->next == NULL) {
+                KLM_LOG_WARN(matrix, "Control: segment %u is the last one\n", cmd->segment);
+                break;
+            }
+
+            // Rewind while the saved states still line up with the segments
+            klm_mat_invalidate_frames(matrix);
+            klm_cmdq_cancel_segment(matrix->cmdq, seg);
+            matrix->segment_list = klm_segment_list_remove(matrix->segment_list, seg);
+            klm_seg_destroy(seg);
+            break;
+        default:
+            break;
+    }
+}
+
+static void _klm_control_on_ready(klm_runtime * const runtime, int fd, uint32_t events, void *user_data) {
+    klm_control_receive(user_data);
+}
+
+static bool _klm_control_is_utf8(const uint8_t * const p, uint16_t len) {
+    uint16_t i = 0;
+    while (i < len) {
+        uint8_t c = p[i];
+        uint8_t n;
+        uint8_t lo = 0x80;
+        uint8_t hi = 0xbf;
+
+        // Reject overlong forms, surrogates and anything past U+10FFFF
+        if (c < 0x80) {
+            n = 0;
+        }
+        else if (c >= 0xc2 && c <= 0xdf) {
+            n = 1;
+        }
+        else if (c >= 0xe0 && c <= 0xef) {
+            n = 2;
+            if (c == 0xe0) lo = 0xa0;
+            if (c == 0xed) hi = 0x9f;
+        }
+        else if (c >= 0xf0 && c <= 0xf4) {
+            n = 3;
+            if (c == 0xf0) lo = 0x90;
+            if (c == 0xf4) hi = 0x8f;
+        }
+        else {
+            return false;
+        }
+
+        if (n > len - i - 1) {
+            return false;
+        }
+
+        uint8_t k;
+        for (k=1; k<=n; k++) {
+            uint8_t b = p[i + k];
+            if (b < ((k == 1) ? lo : 0x80) || b > ((k == 1) ? hi : 0xbf)) {
+                return false;
+            }
+        }
+        i += n + 1;
+    }
+    return true;
+}
+
+static uint16_t _klm_control_get_u16(const uint8_t * const p) {
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static void _klm_control_put_u16(uint8_t * const p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static float _klm_control_get_f32(const uint8_t * const p) {
+    uint32_t u = (uint32_t)p[0] |
+                 ((uint32_t)p[1] << 8) |
+                 ((uint32_t)p[2] << 16) |
+                 ((uint32_t)p[3] << 24);
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static void _klm_control_put_f32(uint8_t * const p, float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    p[0] = (uint8_t)u;
+    p[1] = (uint8_t)(u >> 8);
+    p[2] = (uint8_t)(u >> 16);
+    p[3] = (uint8_t)(u >> 24);
+}
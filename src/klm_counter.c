@@ -0,0 +1,340 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <hexfont.h>
+#include <hexfont_list.h>
+#include "klm_counter.h"
+#include "klm_segment.h"
+#include "klm_matrix.h"
+#include "klm_font_chain.h"
+#include "klm_alloc.h"
+
+// Symbolic constants
+#define KLM_BYTE_WIDTH 8
+#define KLM_CHARACTER_SPACING 1
+#define KLM_COUNTER_CHARSET_LEN (sizeof(KLM_COUNTER_CHARSET) - 1)
+
+static hexfont_character * const _klm_counter_get_glyph(klm_counter * const counter, char c);
+static void _klm_counter_render_glyphs(klm_counter * const counter);
+static void _klm_counter_render_cell(klm_counter * const counter, uint8_t cell);
+static void _klm_counter_copy_bits(uint8_t * const dst, size_t dst_bit,
+                                   const uint8_t * const src, size_t src_bit,
+                                   size_t nbits);
+
+
+/** Create a counter of cell_count cells, drawn by the given segment in its font */
+klm_counter * const klm_counter_create(klm_segment * const seg, uint8_t cell_count) {
+    if (cell_count == 0 || cell_count > KLM_COUNTER_MAX_CELLS) {
+        return NULL;
+    }
+
+    klm_counter * const counter = klm_malloc(sizeof(klm_counter));
+
+    counter->segment = seg;
+    counter->cell_count = cell_count;
+    counter->update_count = 0;
+    counter->cell_render_count = 0;
+    counter->_glyphs = NULL;
+    counter->_bitmap = NULL;
+
+    // Every cell starts out blank, which is what the cleared bitmap shows
+    memset(counter->cells, ' ', sizeof(counter->cells));
+
+    // Anything outside the charset maps to the blank glyph after the last one
+    memset(counter->_glyph_index, KLM_COUNTER_CHARSET_LEN, sizeof(counter->_glyph_index));
+    uint8_t i;
+    for (i=0; i<KLM_COUNTER_CHARSET_LEN; i++) {
+        counter->_glyph_index[(uint8_t)KLM_COUNTER_CHARSET[i]] = i;
+    }
+
+    _klm_counter_render_glyphs(counter);
+
+    // The segment now draws the counter instead of its text
+    klm_mat_invalidate_frames(seg->matrix);
+    seg->counter = counter;
+    seg->_text_pixel_width = klm_seg_get_text_pixel_width(seg);
+    seg->_text_pixel_height = klm_seg_get_text_pixel_height(seg);
+    seg->_dirty = true;
+
+    return counter;
+}
+
+/** Clean up a counter, and detach it from its segment */
+void klm_counter_destroy(klm_counter * const counter) {
+    klm_segment * const seg = counter->segment;
+    if (seg->counter == counter) {
+        klm_mat_invalidate_frames(seg->matrix);
+        seg->counter = NULL;
+        seg->_text_pixel_width = klm_seg_get_text_pixel_width(seg);
+        seg->_text_pixel_height = klm_seg_get_text_pixel_height(seg);
+        seg->_dirty = true;
+    }
+
+    klm_free(counter->_glyphs);
+    klm_free(counter->_bitmap);
+    klm_free(counter);
+}
+
+/** Show the given ASCII text from the first cell, blanking any cells after it */
+void klm_counter_set_text(klm_counter * const counter, const char * const text) {
+    bool changed = false;
+    bool ended = false;
+
+    counter->update_count++;
+
+    uint8_t i;
+    for (i=0; i<counter->cell_count; i++) {
+        if (!ended && text[i] == '\0') {
+            ended = true;
+        }
+
+        char c = ended ? ' ' : text[i];
+        if (c == counter->cells[i]) {
+            continue;
+        }
+
+        // Frames rendered ahead show the old value
+        if (!changed) {
+            klm_mat_invalidate_frames(counter->segment->matrix);
+            changed = true;
+        }
+
+        counter->cells[i] = c;
+        _klm_counter_render_cell(counter, i);
+    }
+}
+
+/** Show a number right aligned, padded with zeros or blanks */
+void klm_counter_set_number(klm_counter * const counter, int32_t value, bool zero_pad) {
+    char text[KLM_COUNTER_MAX_CELLS + 1];
+    uint32_t magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+
+    // Fill in the digits from the right, dropping any which don't fit
+    int8_t i = counter->cell_count;
+    text[i] = '\0';
+    do {
+        text[--i] = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0 && i > 0);
+
+    // The sign goes in the first cell when zero padded, otherwise next to the number
+    uint8_t first = 0;
+    if (value < 0) {
+        if (zero_pad || i == 0) {
+            text[0] = '-';
+            first = 1;
+        }
+        else {
+            text[--i] = '-';
+        }
+    }
+
+    while (i > first) {
+        text[--i] = zero_pad ? '0' : ' ';
+    }
+
+    klm_counter_set_text(counter, text);
+}
+
+/** Show a time as HH:MM:SS, or HH:MM if the counter has fewer than 8 cells */
+void klm_counter_set_time(klm_counter * const counter, uint8_t hours, uint8_t minutes, uint8_t seconds) {
+    char text[9] = {
+        '0' + (hours / 10) % 10, '0' + hours % 10, ':',
+        '0' + minutes / 10, '0' + minutes % 10, ':',
+        '0' + seconds / 10, '0' + seconds % 10, '\0'
+    };
+
+    if (counter->cell_count < 8) {
+        text[5] = '\0';
+    }
+    klm_counter_set_text(counter, text);
+}
+
+/** Render the glyphs again, e.g. after the segment's font has changed */
+void klm_counter_refresh(klm_counter * const counter) {
+    klm_segment * const seg = counter->segment;
+
+    klm_mat_invalidate_frames(seg->matrix);
+    _klm_counter_render_glyphs(counter);
+    seg->_text_pixel_width = klm_seg_get_text_pixel_width(seg);
+    seg->_text_pixel_height = klm_seg_get_text_pixel_height(seg);
+    seg->_dirty = true;
+}
+
+/** Copy the counter into the display buffer at the segment's text position */
+void klm_counter_render(klm_counter * const counter) {
+    klm_segment * const seg = counter->segment;
+    klm_matrix * const matrix = seg->matrix;
+
+    int16_t x = seg->x + (int16_t)seg->text_hpos;
+    int16_t y = seg->y + (int16_t)seg->text_vpos;
+
+    // Clip to the segment, and to the display
+    int16_t x0 = x, y0 = y;
+    int16_t x1 = x + klm_counter_get_pixel_width(counter);
+    int16_t y1 = y + counter->cell_height;
+    if (x0 < seg->x) x0 = seg->x;
+    if (x0 < 0) x0 = 0;
+    if (y0 < seg->y) y0 = seg->y;
+    if (y0 < 0) y0 = 0;
+    if (x1 > seg->x + seg->width) x1 = seg->x + seg->width;
+    if (x1 > matrix->config->width) x1 = matrix->config->width;
+    if (y1 > seg->y + seg->height) y1 = seg->y + seg->height;
+    if (y1 > matrix->config->height) y1 = matrix->config->height;
+
+    if (x1 <= x0 || y1 <= y0) {
+        return;
+    }
+
+    int16_t _y;
+    for (_y=y0; _y<y1; _y++) {
+        _klm_counter_copy_bits(matrix->display_buffer0 + KLM_ROW_OFFSET(matrix, _y), x0,
+                               counter->_bitmap + (_y - y)*counter->_row_stride, x0 - x,
+                               x1 - x0);
+    }
+}
+
+static hexfont_character * const _klm_counter_get_glyph(klm_counter * const counter, char c) {
+    klm_segment * const seg = counter->segment;
+    hexfont_character *glyph = NULL;
+    if (seg->font_chain) {
+        glyph = klm_font_chain_get(seg->font_chain, (uint8_t)c, NULL);
+    }
+    else {
+        hexfont * const font =
+            hexfont_list_get_nth(seg->matrix->font_list, seg->font_index);
+        glyph = hexfont_get(font, (uint8_t)c);
+    }
+
+    // In the segment's text style, to hand back once it has been copied
+    return klm_mat_get_styled_glyph(seg->matrix, glyph, seg->text_scale, seg->text_style);
+}
+
+static void _klm_counter_render_glyphs(klm_counter * const counter) {
+    // Every cell is as wide as the widest glyph, so a number doesn't shift
+    // about as its digits change
+    uint8_t width = 0, height = 0;
+    uint8_t i;
+    for (i=0; i<KLM_COUNTER_CHARSET_LEN; i++) {
+        hexfont_character * const c = _klm_counter_get_glyph(counter, KLM_COUNTER_CHARSET[i]);
+        if (c == NULL) {
+            continue;
+        }
+        if (c->width > width) width = c->width;
+        if (c->height > height) height = c->height;
+        klm_mat_release_glyph(counter->segment->matrix, c);
+    }
+
+    counter->cell_width = width + KLM_CHARACTER_SPACING;
+    counter->cell_height = height;
+    counter->_glyph_stride = (counter->cell_width + KLM_BYTE_WIDTH - 1) / KLM_BYTE_WIDTH;
+    counter->_row_stride =
+        (klm_counter_get_pixel_width(counter) + KLM_BYTE_WIDTH - 1) / KLM_BYTE_WIDTH;
+
+    // One extra, blank, glyph for characters outside the charset
+    klm_free(counter->_glyphs);
+    counter->_glyphs =
+        klm_calloc((KLM_COUNTER_CHARSET_LEN + 1) * height, counter->_glyph_stride);
+
+    for (i=0; i<KLM_COUNTER_CHARSET_LEN; i++) {
+        hexfont_character * const c = _klm_counter_get_glyph(counter, KLM_COUNTER_CHARSET[i]);
+        if (c == NULL) {
+            continue;
+        }
+
+        // Centre narrow glyphs, such as the colon, in the cell
+        uint8_t *glyph = counter->_glyphs + i*height*counter->_glyph_stride;
+        uint8_t offset = (width - c->width) / 2;
+        int16_t bx, by;
+        for (by=0; by<c->height; by++) {
+            for (bx=0; bx<c->width; bx++) {
+                if (hexfont_character_get_pixel(c, bx, by)) {
+                    uint8_t _x = offset + bx;
+                    glyph[by*counter->_glyph_stride + _x/KLM_BYTE_WIDTH] |=
+                        (1 << (_x % KLM_BYTE_WIDTH));
+                }
+            }
+        }
+        klm_mat_release_glyph(counter->segment->matrix, c);
+    }
+
+    // Draw whatever the cells held in the new glyphs
+    klm_free(counter->_bitmap);
+    counter->_bitmap = klm_calloc(height, counter->_row_stride);
+    for (i=0; i<counter->cell_count; i++) {
+        _klm_counter_render_cell(counter, i);
+    }
+}
+
+static void _klm_counter_render_cell(klm_counter * const counter, uint8_t cell) {
+    uint8_t c = (uint8_t)counter->cells[cell];
+    uint8_t index = (c < sizeof(counter->_glyph_index)) ?
+                        counter->_glyph_index[c] : KLM_COUNTER_CHARSET_LEN;
+    const uint8_t *glyph =
+        counter->_glyphs + index*counter->cell_height*counter->_glyph_stride;
+
+    uint8_t y;
+    for (y=0; y<counter->cell_height; y++) {
+        _klm_counter_copy_bits(counter->_bitmap + y*counter->_row_stride,
+                               cell*counter->cell_width,
+                               glyph + y*counter->_glyph_stride, 0,
+                               counter->cell_width);
+    }
+    counter->cell_render_count++;
+}
+
+/** Copy a run of LSB first bits, up to a byte at a time */
+static void _klm_counter_copy_bits(uint8_t * const dst, size_t dst_bit,
+                                   const uint8_t * const src, size_t src_bit,
+                                   size_t nbits)
+{
+    while (nbits > 0) {
+        uint8_t n = (nbits < KLM_BYTE_WIDTH) ? nbits : KLM_BYTE_WIDTH;
+        uint16_t bits = (1 << n) - 1;
+
+        // Gather the bits, which may straddle two source bytes...
+        size_t s = src_bit / KLM_BYTE_WIDTH;
+        uint8_t s_shift = src_bit % KLM_BYTE_WIDTH;
+        uint16_t v = src[s] >> s_shift;
+        if (s_shift + n > KLM_BYTE_WIDTH) {
+            v |= (uint16_t)src[s + 1] << (KLM_BYTE_WIDTH - s_shift);
+        }
+
+        // ...and merge them in, over up to two destination bytes
+        size_t d = dst_bit / KLM_BYTE_WIDTH;
+        uint8_t d_shift = dst_bit % KLM_BYTE_WIDTH;
+        uint16_t mask = bits << d_shift;
+        v = (v & bits) << d_shift;
+        dst[d] = (dst[d] & ~mask) | (v & 0xFF);
+        if (d_shift + n > KLM_BYTE_WIDTH) {
+            dst[d + 1] = (dst[d + 1] & ~(mask >> KLM_BYTE_WIDTH)) | (v >> KLM_BYTE_WIDTH);
+        }
+
+        src_bit += n;
+        dst_bit += n;
+        nbits -= n;
+    }
+}
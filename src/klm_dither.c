@@ -0,0 +1,232 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "klm_dither.h"
+#include "klm_alloc.h"
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif
+
+// Symbolic constants
+#define KLM_BYTE_WIDTH 8
+#define KLM_DITHER_VECTOR_WIDTH 16
+
+// Classic 8x8 ordered dither index matrix
+static const uint8_t _klm_dither_bayer[KLM_DITHER_BAYER_ORDER][KLM_DITHER_BAYER_ORDER] = {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+static void _klm_dither_update_thresholds(klm_dither * const dither);
+static const uint8_t * _klm_dither_to_grey(klm_dither * const dither, const uint8_t * const src);
+static void _klm_dither_pack(const uint8_t * const grey,
+                             const uint8_t * const thresholds,
+                             uint8_t * const dst,
+                             uint16_t width);
+static void _klm_dither_diffuse(klm_dither * const dither,
+                                const uint8_t * const grey,
+                                uint16_t y,
+                                uint8_t * const dst);
+
+
+/** Create a ditherer for rows of the given width */
+klm_dither * const klm_dither_create(uint16_t width, klm_pixel_format format, klm_dither_mode mode) {
+    // Allocate memory for the dither structure and initialize all members
+    klm_dither * const dither = klm_malloc(sizeof(klm_dither));
+
+    dither->width = width;
+    dither->format = format;
+    dither->mode = mode;
+    dither->threshold = KLM_DITHER_DEFAULT_THRESHOLD;
+
+    dither->_grey = klm_malloc(width);
+    dither->_thresholds = klm_malloc((size_t)KLM_DITHER_BAYER_ORDER * width);
+    dither->_error = klm_calloc(2 * (width + 2), sizeof(*dither->_error));
+    _klm_dither_update_thresholds(dither);
+
+    return dither;
+}
+
+/** Clean up a ditherer */
+void klm_dither_destroy(klm_dither * const dither) {
+    klm_free(dither->_error);
+    klm_free(dither->_thresholds);
+    klm_free(dither->_grey);
+    klm_free(dither);
+}
+
+/** Change the dithering mode */
+void klm_dither_set_mode(klm_dither * const dither, klm_dither_mode mode) {
+    dither->mode = mode;
+    _klm_dither_update_thresholds(dither);
+}
+
+/** Change the grey level above which pixels are lit */
+void klm_dither_set_threshold(klm_dither * const dither, uint8_t threshold) {
+    dither->threshold = threshold;
+    _klm_dither_update_thresholds(dither);
+}
+
+/** Convert row y of an image into width/8 bytes at dst. Rows must be given in order, starting from 0 */
+void klm_dither_row(klm_dither * const dither,
+                    const uint8_t * const src,
+                    uint16_t y,
+                    uint8_t * const dst)
+{
+    const uint8_t * const grey = _klm_dither_to_grey(dither, src);
+
+    if (dither->mode == KLM_DITHER_DIFFUSION) {
+        _klm_dither_diffuse(dither, grey, y, dst);
+        return;
+    }
+
+    _klm_dither_pack(grey,
+                     dither->_thresholds + (size_t)(y % KLM_DITHER_BAYER_ORDER)*dither->width,
+                     dst,
+                     dither->width);
+}
+
+static void _klm_dither_update_thresholds(klm_dither * const dither) {
+    // The Bayer pattern is centred on the threshold, so it still works as a brightness control
+    const int16_t bias = (int16_t)dither->threshold - KLM_DITHER_DEFAULT_THRESHOLD;
+
+    uint16_t y, x;
+    for (y=0; y<KLM_DITHER_BAYER_ORDER; y++) {
+        uint8_t *row = dither->_thresholds + (size_t)y*dither->width;
+        if (dither->mode != KLM_DITHER_ORDERED) {
+            memset(row, dither->threshold, dither->width);
+            continue;
+        }
+
+        for (x=0; x<dither->width; x++) {
+            int16_t t = _klm_dither_bayer[y][x % KLM_DITHER_BAYER_ORDER]*4 + 2 + bias;
+            row[x] = (t < 0) ? 0 : (t > 255) ? 255 : (uint8_t)t;
+        }
+    }
+}
+
+static const uint8_t * _klm_dither_to_grey(klm_dither * const dither, const uint8_t * const src) {
+    if (dither->format == KLM_PIXEL_GREY8) {
+        return src;
+    }
+
+    // Rec. 601 luma in 8-bit fixed point, simple enough for the compiler to vectorize
+    uint8_t * const grey = dither->_grey;
+    uint16_t x;
+    for (x=0; x<dither->width; x++) {
+        const uint8_t *rgb = src + x*KLM_PIXEL_RGB24;
+        grey[x] = (uint8_t)((77*rgb[0] + 150*rgb[1] + 29*rgb[2]) >> 8);
+    }
+    return grey;
+}
+
+static void _klm_dither_pack(const uint8_t * const grey,
+                             const uint8_t * const thresholds,
+                             uint8_t * const dst,
+                             uint16_t width)
+{
+    uint16_t x = 0;
+
+#if defined(__SSE2__)
+    // There is no unsigned byte compare, so flip the sign bits and compare signed.
+    // movemask then gives pixel n in bit n, which is exactly the display buffer packing.
+    const __m128i sign = _mm_set1_epi8((char)0x80);
+    for (; x + KLM_DITHER_VECTOR_WIDTH <= width; x += KLM_DITHER_VECTOR_WIDTH) {
+        __m128i g = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(grey + x)), sign);
+        __m128i t = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(thresholds + x)), sign);
+        uint32_t bits = (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(g, t));
+
+        dst[x/KLM_BYTE_WIDTH] = (uint8_t)bits;
+        dst[x/KLM_BYTE_WIDTH + 1] = (uint8_t)(bits >> 8);
+    }
+#elif defined(__ARM_NEON)
+    // Give each lit lane its bit's weight, then add across each half with pairwise adds
+    static const uint8_t weights[KLM_DITHER_VECTOR_WIDTH] =
+        { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t w = vld1q_u8(weights);
+    for (; x + KLM_DITHER_VECTOR_WIDTH <= width; x += KLM_DITHER_VECTOR_WIDTH) {
+        uint8x16_t lit = vandq_u8(vcgtq_u8(vld1q_u8(grey + x), vld1q_u8(thresholds + x)), w);
+        uint8x8_t sum = vpadd_u8(vget_low_u8(lit), vget_high_u8(lit));
+        sum = vpadd_u8(sum, sum);
+        sum = vpadd_u8(sum, sum);
+
+        dst[x/KLM_BYTE_WIDTH] = vget_lane_u8(sum, 0);
+        dst[x/KLM_BYTE_WIDTH + 1] = vget_lane_u8(sum, 1);
+    }
+#endif
+
+    // Whatever is left, a byte at a time
+    for (; x < width; x += KLM_BYTE_WIDTH) {
+        uint8_t pixel8 = 0;
+        uint8_t bit;
+        for (bit=0; bit<KLM_BYTE_WIDTH && x + bit < width; bit++) {
+            pixel8 |= (uint8_t)((grey[x + bit] > thresholds[x + bit]) << bit);
+        }
+        dst[x/KLM_BYTE_WIDTH] = pixel8;
+    }
+}
+
+static void _klm_dither_diffuse(klm_dither * const dither,
+                                const uint8_t * const grey,
+                                uint16_t y,
+                                uint8_t * const dst)
+{
+    // Two rows of error in 16ths, with a column of padding at either end
+    const uint16_t error_width = dither->width + 2;
+    if (y == 0) {
+        memset(dither->_error, 0, 2 * error_width * sizeof(*dither->_error));
+    }
+    int16_t * const error = dither->_error + (y % 2)*error_width;
+    int16_t * const next = dither->_error + ((y + 1) % 2)*error_width;
+    memset(next, 0, error_width * sizeof(*next));
+
+    uint16_t x;
+    uint8_t pixel8 = 0;
+    for (x=0; x<dither->width; x++) {
+        int16_t value = grey[x] + error[x + 1]/16;
+        bool lit = (value > dither->threshold);
+        int16_t e = value - (lit ? 255 : 0);
+
+        error[x + 2] += e*7;
+        next[x] += e*3;
+        next[x + 1] += e*5;
+        next[x + 2] += e;
+
+        pixel8 |= (uint8_t)(lit << (x % KLM_BYTE_WIDTH));
+        if (x % KLM_BYTE_WIDTH == KLM_BYTE_WIDTH - 1 || x == dither->width - 1) {
+            dst[x/KLM_BYTE_WIDTH] = pixel8;
+            pixel8 = 0;
+        }
+    }
+}
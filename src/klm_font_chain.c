@@ -0,0 +1,190 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "klm_font_chain.h"
+#include "klm_alloc.h"
+
+#define KLM_FONT_CHAIN_NO_FONT 0xFF
+
+static inline size_t _klm_font_chain_hash(uint32_t codepoint);
+static __klm_font_chain_entry_t * const _klm_font_chain_find_slot(
+                                            __klm_font_chain_entry_t * const cache,
+                                            size_t mask,
+                                            uint32_t codepoint);
+static bool _klm_font_chain_grow(klm_font_chain * const chain);
+
+
+/** Create an empty chain over the fonts in the given list */
+klm_font_chain * const klm_font_chain_create(hexfont_list * const font_list) {
+    // Allocate memory for the chain structure and initialize all members
+    klm_font_chain * const chain = klm_malloc(sizeof(klm_font_chain));
+
+    chain->font_list = font_list;
+    chain->length = 0;
+    chain->hit_count = 0;
+    chain->miss_count = 0;
+
+    chain->_cache = klm_calloc(KLM_FONT_CHAIN_INITIAL_CACHE, sizeof(__klm_font_chain_entry_t));
+    chain->_cache_mask = KLM_FONT_CHAIN_INITIAL_CACHE - 1;
+    chain->_cache_count = 0;
+
+    return chain;
+}
+
+/** Clean up a chain. The fonts themselves belong to the font list */
+void klm_font_chain_destroy(klm_font_chain * const chain) {
+    klm_free(chain->_cache);
+    klm_free(chain);
+}
+
+/**
+ * Add the font at the given index of the font list to the end of the chain.
+ * Segments already using the chain keep the glyphs they have until their
+ * text or font chain is set again.
+ */
+bool klm_font_chain_append(klm_font_chain * const chain, uint8_t font_index) {
+    if (chain->length >= KLM_FONT_CHAIN_MAX_FONTS ||
+        hexfont_list_get_nth(chain->font_list, font_index) == NULL)
+    {
+        return false;
+    }
+
+    chain->font_indices[chain->length++] = font_index;
+
+    // Earlier misses may now resolve to the new font
+    klm_font_chain_clear_cache(chain);
+    return true;
+}
+
+/** Find the glyph for a codepoint in the first font which has it, or NULL */
+hexfont_character * const klm_font_chain_get(klm_font_chain * const chain,
+                                             uint32_t codepoint,
+                                             uint8_t * const font_index)
+{
+    __klm_font_chain_entry_t *entry =
+        _klm_font_chain_find_slot(chain->_cache, chain->_cache_mask, codepoint);
+
+    if (!entry->used) {
+        // Not seen before, search the fonts in order
+        chain->miss_count++;
+
+        hexfont_character *glyph = NULL;
+        uint8_t found = KLM_FONT_CHAIN_NO_FONT;
+
+        uint8_t i;
+        for (i=0; i<chain->length && glyph == NULL; i++) {
+            hexfont * const font =
+                hexfont_list_get_nth(chain->font_list, chain->font_indices[i]);
+            glyph = hexfont_get(font, codepoint);
+            if (glyph != NULL) {
+                found = chain->font_indices[i];
+            }
+        }
+
+        // Keep the table at most half full. If it can't grow, stop memoizing
+        if ((chain->_cache_count + 1) * 2 > chain->_cache_mask + 1) {
+            if (!_klm_font_chain_grow(chain)) {
+                if (font_index != NULL) {
+                    *font_index = found;
+                }
+                return glyph;
+            }
+            entry = _klm_font_chain_find_slot(chain->_cache, chain->_cache_mask, codepoint);
+        }
+
+        entry->codepoint = codepoint;
+        entry->glyph = glyph;
+        entry->font_index = found;
+        entry->used = true;
+        chain->_cache_count++;
+    }
+    else {
+        chain->hit_count++;
+    }
+
+    if (font_index != NULL) {
+        *font_index = entry->font_index;
+    }
+    return entry->glyph;
+}
+
+/** Forget all memoized lookups, e.g. after the fonts have changed */
+void klm_font_chain_clear_cache(klm_font_chain * const chain) {
+    memset(chain->_cache, 0, (chain->_cache_mask + 1) * sizeof(__klm_font_chain_entry_t));
+    chain->_cache_count = 0;
+}
+
+static inline size_t _klm_font_chain_hash(uint32_t codepoint) {
+    // Multiplicative hash, codepoints in a script tend to be contiguous
+    return (size_t)(codepoint * 2654435761u);
+}
+
+static __klm_font_chain_entry_t * const _klm_font_chain_find_slot(
+                                            __klm_font_chain_entry_t * const cache,
+                                            size_t mask,
+                                            uint32_t codepoint)
+{
+    // Linear probing, finds either the codepoint's entry or the empty slot for it
+    size_t i = _klm_font_chain_hash(codepoint) & mask;
+    while (cache[i].used && cache[i].codepoint != codepoint) {
+        i = (i + 1) & mask;
+    }
+    return &cache[i];
+}
+
+static bool _klm_font_chain_grow(klm_font_chain * const chain) {
+    size_t old_size = chain->_cache_mask + 1;
+
+    // The arena can't take back the old table, so static builds don't grow
+#ifdef KLM_STATIC
+    const size_t max_size = KLM_FONT_CHAIN_INITIAL_CACHE;
+#else
+    const size_t max_size = KLM_FONT_CHAIN_MAX_CACHE;
+#endif
+    if (old_size >= max_size) {
+        return false;
+    }
+
+    size_t new_mask = old_size * 2 - 1;
+    __klm_font_chain_entry_t *old_cache = chain->_cache;
+    __klm_font_chain_entry_t *new_cache =
+        klm_calloc(new_mask + 1, sizeof(__klm_font_chain_entry_t));
+    if (new_cache == NULL) {
+        return false;
+    }
+
+    size_t i;
+    for (i=0; i<old_size; i++) {
+        if (old_cache[i].used) {
+            *_klm_font_chain_find_slot(new_cache, new_mask, old_cache[i].codepoint) =
+                old_cache[i];
+        }
+    }
+
+    klm_free(old_cache);
+    chain->_cache = new_cache;
+    chain->_cache_mask = new_mask;
+    return true;
+}
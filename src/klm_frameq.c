@@ -0,0 +1,160 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "klm_frameq.h"
+#include "klm_alloc.h"
+
+static void _klm_frame_init(klm_frame * const frame, size_t buffer_len, uint16_t segment_count);
+
+
+/** Create a queue of up to capacity frames of buffer_len bytes each */
+klm_frameq * const klm_frameq_create(size_t capacity, size_t buffer_len, uint16_t segment_count) {
+    // Allocate memory for the queue structure and initialize all members
+    klm_frameq * const frameq = klm_malloc(sizeof(klm_frameq));
+
+    frameq->capacity = capacity;
+    frameq->count = 0;
+    frameq->buffer_len = buffer_len;
+    frameq->segment_count = segment_count;
+    frameq->_segment_capacity = segment_count;
+
+    frameq->hit_count = 0;
+    frameq->miss_count = 0;
+    frameq->invalidate_count = 0;
+
+    // The shown frame only holds state, its pixels are the display buffer
+    _klm_frame_init(&frameq->shown, 0, segment_count);
+
+    frameq->_frames = klm_malloc(capacity * sizeof(klm_frame));
+    frameq->_head = 0;
+
+    size_t i;
+    for (i=0; i<capacity; i++) {
+        _klm_frame_init(&frameq->_frames[i], buffer_len, segment_count);
+    }
+
+    return frameq;
+}
+
+/** Clean up a frame queue */
+void klm_frameq_destroy(klm_frameq * const frameq) {
+    size_t i;
+    for (i=0; i<frameq->capacity; i++) {
+        klm_free(frameq->_frames[i].buffer);
+        klm_free(frameq->_frames[i].seg_states);
+    }
+    klm_free(frameq->_frames);
+    klm_free(frameq->shown.seg_states);
+    klm_free(frameq);
+}
+
+/** Drop all queued frames */
+void klm_frameq_clear(klm_frameq * const frameq) {
+    if (frameq->count > 0) {
+        frameq->invalidate_count++;
+    }
+    frameq->count = 0;
+}
+
+/** Hold the state of a different number of segments. Drops all queued frames, and the shown state */
+void klm_frameq_set_segment_count(klm_frameq * const frameq, uint16_t segment_count) {
+    klm_frameq_clear(frameq);
+    frameq->segment_count = segment_count;
+
+    // Only ever grow, a KLM_STATIC build can't give the old states back
+    if (segment_count <= frameq->_segment_capacity) {
+        return;
+    }
+
+    klm_free(frameq->shown.seg_states);
+    frameq->shown.seg_states = klm_calloc(segment_count, sizeof(klm_frame_seg_state));
+
+    size_t i;
+    for (i=0; i<frameq->capacity; i++) {
+        klm_free(frameq->_frames[i].seg_states);
+        frameq->_frames[i].seg_states = klm_calloc(segment_count, sizeof(klm_frame_seg_state));
+    }
+    frameq->_segment_capacity = segment_count;
+}
+
+/** The slot the next frame should be rendered into, or NULL if the queue is full */
+klm_frame * const klm_frameq_get_tail(klm_frameq * const frameq) {
+    if (klm_frameq_is_full(frameq)) {
+        return NULL;
+    }
+    return &frameq->_frames[(frameq->_head + frameq->count) % frameq->capacity];
+}
+
+/** Add the frame rendered into the tail slot to the queue */
+void klm_frameq_push(klm_frameq * const frameq) {
+    if (!klm_frameq_is_full(frameq)) {
+        frameq->count++;
+    }
+}
+
+/** Remove the oldest frame, or NULL if the queue is empty. Valid until the next push */
+klm_frame * const klm_frameq_pop(klm_frameq * const frameq) {
+    if (klm_frameq_is_empty(frameq)) {
+        frameq->miss_count++;
+        return NULL;
+    }
+
+    klm_frame * const frame = &frameq->_frames[frameq->_head];
+    frameq->_head = (frameq->_head + 1) % frameq->capacity;
+    frameq->count--;
+    frameq->hit_count++;
+
+    // Remember where the segments were left by the frame going on display
+    memcpy(frameq->shown.seg_states,
+           frame->seg_states,
+           frameq->segment_count * sizeof(klm_frame_seg_state));
+    frameq->shown.viewport_x = frame->viewport_x;
+    frameq->shown.viewport_y = frame->viewport_y;
+    frameq->shown.anim_frame = frame->anim_frame;
+    frameq->shown.anim_hold = frame->anim_hold;
+    frameq->shown.transition_tick = frame->transition_tick;
+    frameq->shown.sync_frame = frame->sync_frame;
+
+    return frame;
+}
+
+/** The oldest frame without removing it, or NULL if the queue is empty */
+klm_frame * const klm_frameq_get_head(klm_frameq * const frameq) {
+    if (klm_frameq_is_empty(frameq)) {
+        return NULL;
+    }
+    return &frameq->_frames[frameq->_head];
+}
+
+static void _klm_frame_init(klm_frame * const frame, size_t buffer_len, uint16_t segment_count) {
+    frame->buffer = (buffer_len > 0) ? klm_calloc(buffer_len, sizeof(uint8_t)) : NULL;
+    frame->seg_states = klm_calloc(segment_count, sizeof(klm_frame_seg_state));
+    frame->viewport_x = 0;
+    frame->viewport_y = 0;
+    frame->anim_frame = 0;
+    frame->anim_hold = 0;
+    frame->transition_tick = 0;
+    frame->sync_frame = 0;
+}
@@ -0,0 +1,287 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "klm_glyph_cache.h"
+#include "klm_matrix.h"
+#include "klm_alloc.h"
+
+static inline size_t _klm_glyph_cache_hash(hexfont_character * const source, uint8_t scale, uint8_t style);
+static void _klm_glyph_cache_lru_remove(klm_glyph_cache * const cache, int16_t index);
+static void _klm_glyph_cache_lru_append(klm_glyph_cache * const cache, int16_t index);
+static void _klm_glyph_cache_unlink(klm_glyph_cache * const cache, int16_t index);
+static bool _klm_glyph_cache_get_source_pixel(hexfont_character * const source, uint8_t style, int16_t x, int16_t y);
+static bool _klm_glyph_cache_get_scaled_pixel(hexfont_character * const source, uint8_t scale, uint8_t style, int16_t x, int16_t y);
+static void _klm_glyph_cache_derive(__klm_glyph_entry_t * const entry);
+
+
+/** Create a cache of up to capacity variants of glyphs up to max_width by max_height, scaled up to max_scale times */
+klm_glyph_cache * const klm_glyph_cache_create(size_t capacity,
+                                               uint8_t max_scale,
+                                               uint16_t max_width,
+                                               uint16_t max_height)
+{
+    // Allocate memory for the cache structure and initialize all members
+    klm_glyph_cache * const cache = klm_malloc(sizeof(klm_glyph_cache));
+
+    cache->capacity = capacity;
+    cache->max_scale = max_scale;
+    cache->max_width = max_width;
+    cache->max_height = max_height;
+
+    cache->hit_count = 0;
+    cache->miss_count = 0;
+    cache->evict_count = 0;
+
+    // Room for the largest variant in every slot, so evicting never allocates
+    cache->_slot_size =
+        ((max_width*max_scale + KLM_BYTE_WIDTH - 1) / KLM_BYTE_WIDTH) * max_height*max_scale;
+    cache->_data = klm_calloc(capacity, cache->_slot_size);
+
+    // Around two entries per bucket at most
+    size_t buckets = 1;
+    while (buckets * 2 < capacity) {
+        buckets *= 2;
+    }
+    cache->_buckets = klm_malloc(buckets * sizeof(int16_t));
+    cache->_bucket_mask = buckets - 1;
+
+    size_t i;
+    for (i=0; i<buckets; i++) {
+        cache->_buckets[i] = KLM_GLYPH_CACHE_NONE;
+    }
+
+    // Every entry starts out on the unused list
+    cache->_entries = klm_calloc(capacity, sizeof(__klm_glyph_entry_t));
+    for (i=0; i<capacity; i++) {
+        __klm_glyph_entry_t * const entry = &cache->_entries[i];
+        entry->glyph.data = cache->_data + i*cache->_slot_size;
+        entry->source = NULL;
+        entry->next = (i + 1 < capacity) ? (int16_t)(i + 1) : KLM_GLYPH_CACHE_NONE;
+        entry->lru_prev = KLM_GLYPH_CACHE_NONE;
+        entry->lru_next = KLM_GLYPH_CACHE_NONE;
+    }
+    cache->_unused = (capacity > 0) ? 0 : KLM_GLYPH_CACHE_NONE;
+    cache->_lru_head = KLM_GLYPH_CACHE_NONE;
+    cache->_lru_tail = KLM_GLYPH_CACHE_NONE;
+
+    return cache;
+}
+
+/** Clean up a glyph cache */
+void klm_glyph_cache_destroy(klm_glyph_cache * const cache) {
+    klm_free(cache->_entries);
+    klm_free(cache->_buckets);
+    klm_free(cache->_data);
+    klm_free(cache);
+}
+
+/** Get the variant of source at the given scale and style, deriving it if need be, and hold on to it until released.
+    Returns NULL if it is too big for the cache, or every variant is in use */
+hexfont_character * const klm_glyph_cache_get(klm_glyph_cache * const cache,
+                                              hexfont_character * const source,
+                                              uint8_t scale,
+                                              uint8_t style)
+{
+    if (source == NULL ||
+        scale == 0 || scale > cache->max_scale ||
+        source->width > cache->max_width ||
+        source->height > cache->max_height ||
+        source->width * scale > UINT8_MAX ||
+        source->height * scale > UINT8_MAX)
+    {
+        return NULL;
+    }
+
+    size_t bucket = _klm_glyph_cache_hash(source, scale, style) & cache->_bucket_mask;
+    int16_t index = cache->_buckets[bucket];
+    while (index != KLM_GLYPH_CACHE_NONE) {
+        __klm_glyph_entry_t * const entry = &cache->_entries[index];
+        if (entry->source == source && entry->scale == scale && entry->style == style) {
+            // No longer a candidate for eviction while it is in use
+            if (entry->refs == 0) {
+                _klm_glyph_cache_lru_remove(cache, index);
+            }
+            entry->refs++;
+            cache->hit_count++;
+            return &entry->glyph;
+        }
+        index = entry->next;
+    }
+
+    // Not seen before, so take an unused entry, or else evict the
+    // variant which has gone longest without being used
+    cache->miss_count++;
+    if (cache->_unused != KLM_GLYPH_CACHE_NONE) {
+        index = cache->_unused;
+        cache->_unused = cache->_entries[index].next;
+    }
+    else if (cache->_lru_head != KLM_GLYPH_CACHE_NONE) {
+        index = cache->_lru_head;
+        _klm_glyph_cache_lru_remove(cache, index);
+        _klm_glyph_cache_unlink(cache, index);
+        cache->evict_count++;
+    }
+    else {
+        return NULL;
+    }
+
+    __klm_glyph_entry_t * const entry = &cache->_entries[index];
+    entry->source = source;
+    entry->scale = scale;
+    entry->style = style;
+    entry->refs = 1;
+    _klm_glyph_cache_derive(entry);
+
+    entry->next = cache->_buckets[bucket];
+    cache->_buckets[bucket] = index;
+
+    return &entry->glyph;
+}
+
+/** Let go of a variant from klm_glyph_cache_get, so it can be evicted. Other glyphs are ignored */
+void klm_glyph_cache_release(klm_glyph_cache * const cache, hexfont_character * const glyph) {
+    // The glyph is the first member of its entry
+    __klm_glyph_entry_t * const entry = (__klm_glyph_entry_t *)glyph;
+    if (entry < cache->_entries ||
+        entry >= cache->_entries + cache->capacity ||
+        entry->refs == 0)
+    {
+        return;
+    }
+
+    entry->refs--;
+    if (entry->refs == 0) {
+        _klm_glyph_cache_lru_append(cache, (int16_t)(entry - cache->_entries));
+    }
+}
+
+static inline size_t _klm_glyph_cache_hash(hexfont_character * const source, uint8_t scale, uint8_t style) {
+    // Glyphs are allocated some way apart, so drop the low bits of the address
+    return (size_t)((((uintptr_t)source >> 4) ^ (scale << 2) ^ style) * 2654435761u);
+}
+
+static void _klm_glyph_cache_lru_remove(klm_glyph_cache * const cache, int16_t index) {
+    __klm_glyph_entry_t * const entry = &cache->_entries[index];
+
+    if (entry->lru_prev != KLM_GLYPH_CACHE_NONE) {
+        cache->_entries[entry->lru_prev].lru_next = entry->lru_next;
+    }
+    else {
+        cache->_lru_head = entry->lru_next;
+    }
+
+    if (entry->lru_next != KLM_GLYPH_CACHE_NONE) {
+        cache->_entries[entry->lru_next].lru_prev = entry->lru_prev;
+    }
+    else {
+        cache->_lru_tail = entry->lru_prev;
+    }
+
+    entry->lru_prev = KLM_GLYPH_CACHE_NONE;
+    entry->lru_next = KLM_GLYPH_CACHE_NONE;
+}
+
+static void _klm_glyph_cache_lru_append(klm_glyph_cache * const cache, int16_t index) {
+    __klm_glyph_entry_t * const entry = &cache->_entries[index];
+
+    entry->lru_prev = cache->_lru_tail;
+    entry->lru_next = KLM_GLYPH_CACHE_NONE;
+    if (cache->_lru_tail != KLM_GLYPH_CACHE_NONE) {
+        cache->_entries[cache->_lru_tail].lru_next = index;
+    }
+    else {
+        cache->_lru_head = index;
+    }
+    cache->_lru_tail = index;
+}
+
+static void _klm_glyph_cache_unlink(klm_glyph_cache * const cache, int16_t index) {
+    __klm_glyph_entry_t * const entry = &cache->_entries[index];
+    size_t bucket =
+        _klm_glyph_cache_hash(entry->source, entry->scale, entry->style) & cache->_bucket_mask;
+
+    int16_t *link = &cache->_buckets[bucket];
+    while (*link != index) {
+        link = &cache->_entries[*link].next;
+    }
+    *link = entry->next;
+}
+
+static bool _klm_glyph_cache_get_source_pixel(hexfont_character * const source, uint8_t style, int16_t x, int16_t y) {
+    if (x < 0 || x >= source->width || y < 0 || y >= source->height) {
+        return false;
+    }
+
+    // Bold doubles up each stroke with a copy one pixel to the right
+    return hexfont_character_get_pixel(source, x, y) ||
+           ((style & KLM_GLYPH_BOLD) && x > 0 && hexfont_character_get_pixel(source, x - 1, y));
+}
+
+static bool _klm_glyph_cache_get_scaled_pixel(hexfont_character * const source, uint8_t scale, uint8_t style, int16_t x, int16_t y) {
+    if (x < 0 || y < 0) {
+        return false;
+    }
+    return _klm_glyph_cache_get_source_pixel(source, style, x / scale, y / scale);
+}
+
+static void _klm_glyph_cache_derive(__klm_glyph_entry_t * const entry) {
+    hexfont_character * const source = entry->source;
+    hexfont_character * const glyph = &entry->glyph;
+    uint8_t scale = entry->scale;
+    uint8_t style = entry->style;
+
+    glyph->codepoint = source->codepoint;
+    glyph->width = source->width * scale;
+    glyph->height = source->height * scale;
+
+    // The same layout as the font's own glyphs: whole bytes per row, most significant bit first
+    size_t stride = glyph->width / KLM_BYTE_WIDTH;
+    memset(glyph->data, 0, stride * glyph->height);
+
+    // Bold is applied before scaling, so strokes thicken in proportion,
+    // and the outline after, so it is always one pixel wide
+    int16_t x, y;
+    for (y=0; y<glyph->height; y++) {
+        for (x=0; x<glyph->width; x++) {
+            bool on = _klm_glyph_cache_get_scaled_pixel(source, scale, style, x, y);
+
+            if (style & KLM_GLYPH_OUTLINE) {
+                bool edge = false;
+                int16_t dx, dy;
+                for (dy=-1; dy<=1 && !on && !edge; dy++) {
+                    for (dx=-1; dx<=1 && !edge; dx++) {
+                        edge = _klm_glyph_cache_get_scaled_pixel(source, scale, style, x + dx, y + dy);
+                    }
+                }
+                on = !on && edge;
+            }
+
+            if (on) {
+                glyph->data[y*stride + x/KLM_BYTE_WIDTH] |= (0x80 >> (x % KLM_BYTE_WIDTH));
+            }
+        }
+    }
+}
+
@@ -0,0 +1,227 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef KLM_GPIOD
+
+#include <stdlib.h>
+#include <string.h>
+#include <gpiod.h>
+
+#include "klm_gpiod.h"
+#include "klm_alloc.h"
+
+#define KLM_GPIOD_HIGH GPIOD_LINE_VALUE_ACTIVE
+#define KLM_GPIOD_LOW GPIOD_LINE_VALUE_INACTIVE
+#define KLM_GPIOD_LEVEL(v) ((v) ? KLM_GPIOD_HIGH : KLM_GPIOD_LOW)
+
+static const char _klm_gpiod_pin_names[KLM_GPIOD_NUM_RGB_LINES] =
+    { 'a', 'b', 'c', 'd', 'o', 's', 'x', 'r',
+      KLM_PIN_G1, KLM_PIN_B1, KLM_PIN_R2, KLM_PIN_G2, KLM_PIN_B2 };
+
+static inline void _klm_gpiod_set(klm_gpiod * const gpio,
+                                  size_t n,
+                                  const unsigned int * const offsets,
+                                  const enum gpiod_line_value * const values);
+
+
+/**
+ * Request the control lines given by the config's pins from the given chip.
+ * The data and clock lines are only requested if data_lines is true.
+ */
+klm_gpiod * const klm_gpiod_create(const char * const chip_path,
+                                   klm_config * const config,
+                                   bool data_lines)
+{
+    struct gpiod_chip *chip = gpiod_chip_open(chip_path);
+    if (chip == NULL) {
+        return NULL;
+    }
+
+    // Allocate memory for the gpiod structure and initialize all members
+    klm_gpiod * const gpio = klm_malloc(sizeof(klm_gpiod));
+    gpio->chip = chip;
+    gpio->request = NULL;
+    gpio->set_count = 0;
+    gpio->num_lines = KLM_GPIOD_NUM_CONTROL_LINES;
+    if (data_lines) {
+        gpio->num_lines = klm_config_has_pin(config, KLM_PIN_G1) ?
+                                KLM_GPIOD_NUM_RGB_LINES : KLM_GPIOD_NUM_LINES;
+    }
+
+    int i;
+    for (i=0; i<gpio->num_lines; i++) {
+        gpio->offsets[i] = klm_config_get_pin(config, _klm_gpiod_pin_names[i]);
+    }
+
+    // All lines are outputs, initially low except OE which blanks the display
+    enum gpiod_line_value values[KLM_GPIOD_NUM_RGB_LINES];
+    for (i=0; i<gpio->num_lines; i++) {
+        values[i] = KLM_GPIOD_LOW;
+    }
+    values[KLM_GPIOD_OE] = KLM_GPIOD_HIGH;
+
+    struct gpiod_line_settings *settings = gpiod_line_settings_new();
+    struct gpiod_line_config *line_config = gpiod_line_config_new();
+    struct gpiod_request_config *request_config = gpiod_request_config_new();
+
+    if (settings && line_config && request_config) {
+        gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT);
+        gpiod_request_config_set_consumer(request_config, KLM_GPIOD_CONSUMER);
+
+        if (gpiod_line_config_add_line_settings(line_config,
+                                                gpio->offsets,
+                                                gpio->num_lines,
+                                                settings) == 0 &&
+            gpiod_line_config_set_output_values(line_config,
+                                                values,
+                                                gpio->num_lines) == 0)
+        {
+            gpio->request = gpiod_chip_request_lines(chip, request_config, line_config);
+        }
+    }
+
+    gpiod_request_config_free(request_config);
+    gpiod_line_config_free(line_config);
+    gpiod_line_settings_free(settings);
+
+    if (gpio->request == NULL) {
+        klm_gpiod_destroy(gpio);
+        return NULL;
+    }
+    return gpio;
+}
+
+/** Release the lines and clean up */
+void klm_gpiod_destroy(klm_gpiod * const gpio) {
+    if (gpio->request) {
+        gpiod_line_request_release(gpio->request);
+    }
+    gpiod_chip_close(gpio->chip);
+    klm_free(gpio);
+}
+
+/** Bit-bang a buffer out MSB first on the data and clock lines */
+void klm_gpiod_shift_out(klm_gpiod * const gpio, const uint8_t * const buf, size_t len) {
+    if (gpio->num_lines < KLM_GPIOD_NUM_LINES) {
+        return;
+    }
+
+    const unsigned int data_clk[2] =
+        { gpio->offsets[KLM_GPIOD_R], gpio->offsets[KLM_GPIOD_CLK] };
+    const enum gpiod_line_value clk_high[1] = { KLM_GPIOD_HIGH };
+
+    size_t i;
+    int8_t bit;
+    for (i=0; i<len; i++) {
+        for (bit=7; bit>=0; bit--) {
+            // Present the data bit with the clock low, then clock it in
+            const enum gpiod_line_value values[2] =
+                { KLM_GPIOD_LEVEL((buf[i] >> bit) & 0x01), KLM_GPIOD_LOW };
+            _klm_gpiod_set(gpio, 2, data_clk, values);
+            _klm_gpiod_set(gpio, 1, &data_clk[1], clk_high);
+        }
+    }
+}
+
+/** Clock out one HUB75 byte per column, each setting all six colour data lines at once */
+void klm_gpiod_shift_out_rgb(klm_gpiod * const gpio, const uint8_t * const buf, size_t len) {
+    if (gpio->num_lines < KLM_GPIOD_NUM_RGB_LINES) {
+        return;
+    }
+
+    // The data lines in HUB75 bit order, then the clock
+    const unsigned int data_clk[7] = {
+        gpio->offsets[KLM_GPIOD_R],
+        gpio->offsets[KLM_GPIOD_G1],
+        gpio->offsets[KLM_GPIOD_B1],
+        gpio->offsets[KLM_GPIOD_R2],
+        gpio->offsets[KLM_GPIOD_G2],
+        gpio->offsets[KLM_GPIOD_B2],
+        gpio->offsets[KLM_GPIOD_CLK]
+    };
+    const enum gpiod_line_value clk_high[1] = { KLM_GPIOD_HIGH };
+
+    size_t i;
+    int8_t bit;
+    for (i=0; i<len; i++) {
+        // Present all six data bits with the clock low, then clock them in
+        enum gpiod_line_value values[7];
+        for (bit=0; bit<6; bit++) {
+            values[bit] = KLM_GPIOD_LEVEL((buf[i] >> bit) & 0x01);
+        }
+        values[6] = KLM_GPIOD_LOW;
+        _klm_gpiod_set(gpio, 7, data_clk, values);
+        _klm_gpiod_set(gpio, 1, &data_clk[6], clk_high);
+    }
+}
+
+/** Blank the display, select the given row address and latch the shifted data, then unblank */
+void klm_gpiod_latch_row(klm_gpiod * const gpio, uint16_t address) {
+    const unsigned int select[6] = {
+        gpio->offsets[KLM_GPIOD_OE],
+        gpio->offsets[KLM_GPIOD_A],
+        gpio->offsets[KLM_GPIOD_B],
+        gpio->offsets[KLM_GPIOD_C],
+        gpio->offsets[KLM_GPIOD_D],
+        gpio->offsets[KLM_GPIOD_STB]
+    };
+    const enum gpiod_line_value select_values[6] = {
+        KLM_GPIOD_HIGH,
+        KLM_GPIOD_LEVEL(address & 0x01),
+        KLM_GPIOD_LEVEL(address & 0x02),
+        KLM_GPIOD_LEVEL(address & 0x04),
+        KLM_GPIOD_LEVEL(address & 0x08),
+        KLM_GPIOD_HIGH
+    };
+
+    // Disable display, select row and raise the latch in one go
+    _klm_gpiod_set(gpio, 6, select, select_values);
+
+    // Drop the latch and enable display in one go
+    const unsigned int enable[2] = {
+        gpio->offsets[KLM_GPIOD_STB],
+        gpio->offsets[KLM_GPIOD_OE]
+    };
+    const enum gpiod_line_value enable_values[2] = { KLM_GPIOD_LOW, KLM_GPIOD_LOW };
+    _klm_gpiod_set(gpio, 2, enable, enable_values);
+}
+
+/** Set the output enable line (true blanks the display) */
+void klm_gpiod_set_oe(klm_gpiod * const gpio, bool high) {
+    const enum gpiod_line_value value[1] = { KLM_GPIOD_LEVEL(high) };
+    _klm_gpiod_set(gpio, 1, &gpio->offsets[KLM_GPIOD_OE], value);
+}
+
+static inline void _klm_gpiod_set(klm_gpiod * const gpio,
+                                  size_t n,
+                                  const unsigned int * const offsets,
+                                  const enum gpiod_line_value * const values)
+{
+    gpiod_line_request_set_values_subset(gpio->request,
+                                         n,
+                                         offsets,
+                                         values);
+    gpio->set_count++;
+}
+
+#endif // KLM_GPIOD
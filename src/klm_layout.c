@@ -0,0 +1,168 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include "klm_layout.h"
+
+#define KLM_LAYOUT_SPACE 0x20
+#define KLM_LAYOUT_NEWLINE 0x0A
+
+static void _klm_layout_end_line(klm_layout * const layout, uint16_t start, uint16_t end);
+static uint16_t _klm_layout_advance(klm_layout * const layout,
+                                    uint16_t start, uint16_t end,
+                                    uint8_t character_spacing);
+
+
+/** Break the given codepoints into lines no wider than wrap_width, and position their resolved glyphs */
+void klm_layout_compute(klm_layout * const layout,
+                        hexfont_character * const * const glyphs,
+                        uint16_t glyph_height,
+                        const klm_codepoint * const codepoints,
+                        size_t text_len,
+                        uint16_t wrap_width,
+                        klm_text_align align,
+                        uint8_t line_spacing,
+                        uint8_t character_spacing)
+{
+    uint16_t i, l;
+
+    layout->glyph_count = text_len;
+    for (i=0; i<text_len; i++) {
+        layout->glyphs[i].c =
+            (codepoints[i] == KLM_LAYOUT_NEWLINE) ? NULL : glyphs[i];
+        layout->glyphs[i].x = 0;
+        layout->glyphs[i].y = 0;
+    }
+
+    // Find the line breaks, preferring to break at spaces
+    layout->line_count = 0;
+    uint16_t line_start = 0;
+    uint16_t x = 0;
+    int16_t last_space = -1;
+
+    for (i=0; i<text_len; i++) {
+        if (codepoints[i] == KLM_LAYOUT_NEWLINE) {
+            _klm_layout_end_line(layout, line_start, i);
+            line_start = i + 1;
+            x = 0;
+            last_space = -1;
+            continue;
+        }
+
+        hexfont_character * const c = layout->glyphs[i].c;
+        uint16_t w = (c == NULL) ? 0 : c->width;
+
+        if (x > 0 && x + w > wrap_width) {
+            if (codepoints[i] == KLM_LAYOUT_SPACE) {
+                // Break here and swallow the space
+                _klm_layout_end_line(layout, line_start, i);
+                line_start = i + 1;
+                x = 0;
+                last_space = -1;
+                layout->glyphs[i].c = NULL;
+                continue;
+            }
+            else if (last_space >= 0) {
+                // Break at the last space, carrying the word over
+                _klm_layout_end_line(layout, line_start, last_space);
+                layout->glyphs[last_space].c = NULL;
+                line_start = last_space + 1;
+                x = _klm_layout_advance(layout, line_start, i, character_spacing);
+            }
+            else {
+                // A single word wider than the line, break it anywhere
+                _klm_layout_end_line(layout, line_start, i);
+                line_start = i;
+                x = 0;
+            }
+            last_space = -1;
+        }
+
+        if (codepoints[i] == KLM_LAYOUT_SPACE) {
+            last_space = i;
+        }
+        if (c != NULL) {
+            x += w + character_spacing;
+        }
+    }
+    _klm_layout_end_line(layout, line_start, text_len);
+
+    // Position each glyph according to its line and the alignment
+    layout->line_height = glyph_height + line_spacing;
+    layout->pixel_width = 0;
+    layout->pixel_height = layout->line_count * layout->line_height - line_spacing;
+
+    for (l=0; l<layout->line_count; l++) {
+        uint16_t start = layout->line_start[l];
+        uint16_t end = layout->line_end[l];
+
+        // Trailing spaces don't count towards the width for alignment
+        while (end > start && codepoints[end - 1] == KLM_LAYOUT_SPACE) {
+            end--;
+        }
+
+        uint16_t line_width = _klm_layout_advance(layout, start, end, character_spacing);
+        if (line_width > 0) {
+            line_width -= character_spacing;
+        }
+        if (line_width > layout->pixel_width) {
+            layout->pixel_width = line_width;
+        }
+
+        int16_t lx = 0;
+        if (align == KLM_ALIGN_CENTER) {
+            lx = ((int16_t)wrap_width - line_width) / 2;
+        }
+        else if (align == KLM_ALIGN_RIGHT) {
+            lx = (int16_t)wrap_width - line_width;
+        }
+
+        for (i=layout->line_start[l]; i<layout->line_end[l]; i++) {
+            layout->glyphs[i].x = lx;
+            layout->glyphs[i].y = l * layout->line_height;
+            if (layout->glyphs[i].c != NULL) {
+                lx += layout->glyphs[i].c->width + character_spacing;
+            }
+        }
+    }
+}
+
+static void _klm_layout_end_line(klm_layout * const layout, uint16_t start, uint16_t end) {
+    layout->line_start[layout->line_count] = start;
+    layout->line_end[layout->line_count] = end;
+    layout->line_count++;
+}
+
+static uint16_t _klm_layout_advance(klm_layout * const layout,
+                                    uint16_t start, uint16_t end,
+                                    uint8_t character_spacing)
+{
+    uint16_t ret = 0;
+    uint16_t i;
+    for (i=start; i<end; i++) {
+        if (layout->glyphs[i].c != NULL) {
+            ret += layout->glyphs[i].c->width + character_spacing;
+        }
+    }
+    return ret;
+}
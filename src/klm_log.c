@@ -0,0 +1,237 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include "klm_log.h"
+#include "klm_alloc.h"
+
+static size_t _klm_logger_drain(klm_logger * const logger);
+static void _klm_logger_drain_shared(klm_logger * const logger);
+static inline bool _klm_logger_is_published(klm_logger * const logger, size_t pos);
+#ifndef ARDUINO
+static void *_klm_logger_thread(void *arg);
+static void _klm_logger_wake(klm_logger * const logger);
+#endif
+
+
+/** Create a logger writing to fp, with room for capacity messages, which must be a power of two */
+klm_logger * const klm_logger_create(FILE *fp, size_t capacity) {
+    // Allocate memory for the logger and all of its slots up front
+    klm_logger * const logger = klm_malloc(sizeof(klm_logger));
+    logger->fp = fp;
+    logger->slots = klm_malloc(capacity * sizeof(__klm_log_slot_t));
+    logger->mask = capacity - 1;
+    logger->head = 0;
+    atomic_init(&logger->tail, 0);
+    atomic_init(&logger->dropped_count, 0);
+    atomic_init(&logger->_running, true);
+    atomic_flag_clear(&logger->_draining);
+
+    // Each slot's sequence says which position may next be written to it
+    size_t i;
+    for (i=0; i<capacity; i++) {
+        atomic_init(&logger->slots[i].sequence, i);
+    }
+
+    // Without a thread, messages are written out as they are logged
+    logger->_threaded = false;
+#ifndef ARDUINO
+    pthread_mutex_init(&logger->_lock, NULL);
+    pthread_cond_init(&logger->_wake, NULL);
+    atomic_init(&logger->_sleeping, false);
+    if (pthread_create(&logger->_thread, NULL, _klm_logger_thread, logger) == 0) {
+        logger->_threaded = true;
+    }
+#endif
+
+    return logger;
+}
+
+/** Stop the background thread, write out anything still queued, and clean up */
+void klm_logger_destroy(klm_logger * const logger) {
+    atomic_store(&logger->_running, false);
+#ifndef ARDUINO
+    if (logger->_threaded) {
+        pthread_mutex_lock(&logger->_lock);
+        pthread_cond_signal(&logger->_wake);
+        pthread_mutex_unlock(&logger->_lock);
+        pthread_join(logger->_thread, NULL);
+    }
+    pthread_cond_destroy(&logger->_wake);
+    pthread_mutex_destroy(&logger->_lock);
+#endif
+
+    if (_klm_logger_drain(logger) > 0) {
+        fflush(logger->fp);
+    }
+
+    klm_free(logger->slots);
+    klm_free(logger);
+}
+
+/** Queue a formatted message, returns false if it was dropped */
+bool klm_logger_printf(klm_logger * const logger, const char *format, ...) {
+    __klm_log_slot_t *slot;
+    size_t pos = atomic_load_explicit(&logger->tail, memory_order_relaxed);
+
+    for (;;) {
+        slot = &logger->slots[pos & logger->mask];
+        size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            // The slot is free, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&logger->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // The background thread hasn't caught up: the ring is full
+            atomic_fetch_add_explicit(&logger->dropped_count, 1, memory_order_relaxed);
+            return false;
+        }
+        else {
+            // Another producer claimed the slot first
+            pos = atomic_load_explicit(&logger->tail, memory_order_relaxed);
+        }
+    }
+
+    // Format straight into the slot, then publish it
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(slot->text, KLM_LOG_RECORD_LEN, format, args);
+    va_end(args);
+
+    if (len < 0) {
+        len = 0;
+    }
+    slot->len = (len < KLM_LOG_RECORD_LEN) ? len : KLM_LOG_RECORD_LEN - 1;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+    if (!logger->_threaded) {
+        _klm_logger_drain_shared(logger);
+    }
+#ifndef ARDUINO
+    else {
+        _klm_logger_wake(logger);
+    }
+#endif
+    return true;
+}
+
+/** Write a block of text straight out with a single call, e.g. a whole frame dump */
+void klm_logger_write_now(klm_logger * const logger, const char *text, size_t len) {
+    fwrite(text, 1, len, logger->fp);
+    fflush(logger->fp);
+}
+
+static size_t _klm_logger_drain(klm_logger * const logger) {
+    size_t count = 0;
+
+    for (;;) {
+        __klm_log_slot_t *slot = &logger->slots[logger->head & logger->mask];
+
+        // Not yet published
+        if (!_klm_logger_is_published(logger, logger->head)) {
+            return count;
+        }
+
+        fwrite(slot->text, 1, slot->len, logger->fp);
+
+        // Hand the slot back to the producers for the next lap
+        atomic_store_explicit(&slot->sequence, logger->head + logger->mask + 1, memory_order_release);
+        logger->head++;
+        count++;
+    }
+}
+
+/**
+ * Without a background thread every producer drains, so only one may at a
+ * time. Anyone who finds the ring being drained leaves their message to the
+ * drainer, who looks again for late arrivals after letting go.
+ */
+static void _klm_logger_drain_shared(klm_logger * const logger) {
+    size_t head;
+    do {
+        // Order our publish before the test, and a drainer's release before its look
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_flag_test_and_set(&logger->_draining)) {
+            return;
+        }
+        if (_klm_logger_drain(logger) > 0) {
+            fflush(logger->fp);
+        }
+        head = logger->head;
+        atomic_flag_clear(&logger->_draining);
+        atomic_thread_fence(memory_order_seq_cst);
+    } while (_klm_logger_is_published(logger, head));
+}
+
+static inline bool _klm_logger_is_published(klm_logger * const logger, size_t pos) {
+    size_t seq = atomic_load_explicit(&logger->slots[pos & logger->mask].sequence,
+                                      memory_order_acquire);
+    return (intptr_t)seq - (intptr_t)(pos + 1) >= 0;
+}
+
+#ifndef ARDUINO
+static void *_klm_logger_thread(void *arg) {
+    klm_logger * const logger = arg;
+
+    while (atomic_load(&logger->_running)) {
+        // One flush for the whole batch
+        if (_klm_logger_drain(logger) > 0) {
+            fflush(logger->fp);
+            continue;
+        }
+
+        // Say we're going to sleep before the last look, so that a message
+        // published meanwhile either gets seen here or has its producer wake us
+        pthread_mutex_lock(&logger->_lock);
+        atomic_store(&logger->_sleeping, true);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load(&logger->_running) && !_klm_logger_is_published(logger, logger->head)) {
+            pthread_cond_wait(&logger->_wake, &logger->_lock);
+        }
+        atomic_store(&logger->_sleeping, false);
+        pthread_mutex_unlock(&logger->_lock);
+    }
+    return NULL;
+}
+
+static void _klm_logger_wake(klm_logger * const logger) {
+    // Order the publish before the test, the mirror of the thread's fence
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&logger->_sleeping, memory_order_relaxed)) {
+        pthread_mutex_lock(&logger->_lock);
+        pthread_cond_signal(&logger->_wake);
+        pthread_mutex_unlock(&logger->_lock);
+    }
+}
+#endif
@@ -25,11 +25,27 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#ifndef ARDUINO
+#  include <sys/timerfd.h>
+#endif
 
 #include "klm_matrix.h"
 #include "klm_segment.h"
+#include "klm_alloc.h"
+
+// Symbolic constants
+#define KLM_FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define KLM_FNV_PRIME 0x100000001B3ULL
 
 static void _klm_mat_sanity_check(klm_matrix * const matrix);
+static void _klm_mat_render_frame(klm_matrix * const matrix);
+static void _klm_mat_show_frame(klm_matrix * const matrix, klm_frame * const frame);
+static void _klm_mat_save_state(klm_matrix * const matrix, klm_frame * const frame);
+static void _klm_mat_restore_state(klm_matrix * const matrix, klm_frame * const frame);
+static void _klm_mat_sync_frames(klm_matrix * const matrix, uint32_t due);
+static void _klm_mat_sync_segment_count(klm_matrix * const matrix);
+static void _klm_mat_init_glyph_cache(klm_matrix * const matrix);
+static void _klm_mat_arm_scan_timer(klm_matrix * const matrix);
 
 static inline void klm_mat_clear_region(klm_matrix * const matrix, int16_t x, int16_t y, uint16_t w, uint16_t h);
 static inline void klm_mat_mask_region(klm_matrix * const matrix, int16_t x, int16_t y, uint16_t w, uint16_t h, bool reverse);
@@ -58,15 +74,71 @@ bool klm_mat_begin() {
 
 klm_matrix * const klm_mat_create(FILE *logfp, klm_config * const config) {
     // Allocate memory for a klm_matrix structure and initialize all members
-    klm_matrix * const matrix = malloc(sizeof(klm_matrix));
+    klm_matrix * const matrix = klm_malloc(sizeof(klm_matrix));
 
     matrix->config = config;
     matrix->logfp = logfp;
+    matrix->logger = klm_logger_create(logfp, KLM_LOG_DEFAULT_CAPACITY);
     matrix->_row_width = (uint16_t)(matrix->config->width / KLM_BYTE_WIDTH);
 
+    // Room for a frame dump: each byte in hex, then two characters per pixel
+    size_t buffer_len = KLM_BUFFER_LEN(matrix->config->width, matrix->config->height);
+    matrix->_dump_buffer_len =
+        buffer_len*3 + 1 +
+        matrix->config->height*(matrix->config->width*2 + 1) + 1;
+    matrix->_dump_buffer = klm_malloc(matrix->_dump_buffer_len);
+
     klm_mat_init_display_buffer(matrix);
     matrix->_dynamic_buffer = true;
 
+    // Ask the driver how the panel expects its data, and encode the blank frame
+    matrix->bitplanes = NULL;
+    klm_mat_init_wire_format(matrix);
+
+    // Then turn and flip the picture to suit how the panel is mounted
+    klm_rotation rotation = config->rotation;
+    if (matrix->bitplanes && (rotation == KLM_ROTATE_90 || rotation == KLM_ROTATE_270)) {
+        KLM_LOG(matrix, "Colour panels can't be turned a quarter turn, ignoring the rotation\n");
+        rotation = KLM_ROTATE_0;
+    }
+    if (!klm_wire_set_orientation(&matrix->wire_format,
+                                  rotation,
+                                  config->mirror_x,
+                                  config->mirror_y,
+                                  config->height))
+    {
+        KLM_LOG(matrix, "The height must be a multiple of 8 to turn the panel a quarter turn\n");
+    }
+    matrix->wire_buffer =
+        klm_calloc(KLM_BUFFER_LEN(matrix->config->width, matrix->config->height),
+               sizeof(*matrix->wire_buffer));
+    matrix->_wire_dirty = true;
+    klm_mat_encode_wire(matrix);
+
+    // Pace one slot per row address, or per period of each address' bitplanes
+    uint16_t slots =
+        klm_wire_get_address_count(&matrix->wire_format,
+                                   matrix->config->width, matrix->config->height);
+    if (matrix->bitplanes) {
+        slots *= klm_bitplanes_get_period_count(matrix->bitplanes);
+    }
+    matrix->pacer = klm_pacer_create(KLM_PACER_DEFAULT_REFRESH_HZ, slots);
+
+    matrix->spidev = NULL;
+    matrix->gpiod = NULL;
+    matrix->_driver_data = NULL;
+
+    matrix->cmdq = klm_cmdq_create(KLM_CMDQ_DEFAULT_CAPACITY);
+    matrix->viewport = NULL;
+    matrix->animation = NULL;
+    matrix->transition = NULL;
+    matrix->frameq = NULL;
+    matrix->snapshot = NULL;
+    matrix->sync = NULL;
+    matrix->_sync_frame = 0;
+    matrix->_scan_timer_fd = -1;
+    matrix->glyph_cache = NULL;
+
     matrix->on = true;
     matrix->scan_modulation = 0;
     matrix->scan_row = 0;
@@ -82,17 +154,51 @@ void klm_mat_destroy(klm_matrix * const matrix) {
     // Clean up the font list
     hexfont_list_destroy(matrix->font_list);
 
-    // Clean up the font list
+    // Clean up the segment list, and any commands still destined for it
+    klm_cmdq_destroy(matrix->cmdq);
     klm_segment_list_destroy(matrix->segment_list);
 
+    // After the segments, which hand back their glyphs
+    if (matrix->glyph_cache) {
+        klm_glyph_cache_destroy(matrix->glyph_cache);
+    }
+
+    klm_pacer_destroy(matrix->pacer);
+    klm_free(matrix->viewport);
+    if (matrix->bitplanes) {
+        klm_bitplanes_destroy(matrix->bitplanes);
+    }
+    if (matrix->transition) {
+        klm_transition_destroy(matrix->transition);
+    }
+    if (matrix->frameq) {
+        klm_frameq_destroy(matrix->frameq);
+    }
+
+    // Let the driver clean up, then close the output backend, if any
+    klm_mat_destroy_hardware(matrix);
+    if (matrix->spidev) {
+        klm_spidev_destroy(matrix->spidev);
+    }
+#ifdef KLM_GPIOD
+    if (matrix->gpiod) {
+        klm_gpiod_destroy(matrix->gpiod);
+    }
+#endif
+
     // If display buffer(s) are dynamically allocated, free them
     if (matrix->_dynamic_buffer) {
-        free(matrix->display_buffer0);
-        free(matrix->display_buffer1);
+        klm_free(matrix->display_buffer0);
+        klm_free(matrix->display_buffer1);
+        klm_free(matrix->wire_buffer);
     }
 
+    // Write out anything still waiting to be logged
+    klm_logger_destroy(matrix->logger);
+    klm_free(matrix->_dump_buffer);
+
     // Free dynamically allocated memory for the matrix itself
-    free(matrix);
+    klm_free(matrix);
 }
 
 /** Initialize a matrix object with a set of fonts and a set of segments */
@@ -103,6 +209,9 @@ void klm_mat_init(klm_matrix * const matrix,
     matrix->font_list = font_list;
     matrix->segment_list = segment_list;
 
+    // Now that the fonts and segments are known, so that styling text never allocates
+    _klm_mat_init_glyph_cache(matrix);
+
     klm_mat_init_hardware(matrix);
 
     klm_mat_clear(matrix);
@@ -168,25 +277,57 @@ void klm_mat_simple_reverse(klm_matrix * const matrix) {
 
 /** Drive animation */
 void klm_mat_tick(klm_matrix *matrix) {
-    klm_mat_clear(matrix);
+    // Apply any segment changes posted from other threads
+    klm_cmdq_apply(matrix->cmdq);
+    _klm_mat_sync_segment_count(matrix);
+
+    // Show whichever frame the shared clock says is due, however
+    // early or late this tick is
+    uint32_t due = 0;
+    if (matrix->sync) {
+        due = klm_sync_get_frame(matrix->sync);
+        _klm_mat_sync_frames(matrix, due);
+    }
 
-    klm_segment_list *iter = matrix->segment_list;
-    while (iter) {
-        klm_seg_tick(iter->item);
-        iter = iter->next;
+    // If the frame has already been rendered, just put it on display
+    klm_frame *frame = NULL;
+    if (matrix->frameq) {
+        frame = klm_frameq_pop(matrix->frameq);
+    }
+
+    if (frame) {
+        _klm_mat_show_frame(matrix, frame);
+    }
+    else {
+        _klm_mat_render_frame(matrix);
+        klm_mat_swap_buffers(matrix);
+    }
+
+    if (matrix->sync) {
+        klm_sync_beat(matrix->sync, due);
+    }
+
+    // Persist anything that changed, so a restart can pick up from here
+    if (matrix->snapshot) {
+        klm_snapshot_update(matrix->snapshot, matrix);
     }
-    klm_mat_swap_buffers(matrix);
 }
 
 /** Switch off matrix display altogether */
 void klm_mat_on(klm_matrix *matrix) {
     matrix->on = true;
+    _klm_mat_arm_scan_timer(matrix);
 }
 
 /** Switch on matrix display */
 void klm_mat_off(klm_matrix *matrix) {
     matrix->on = false;
-#ifndef KLM_NON_GPIO_MACHINE
+    _klm_mat_arm_scan_timer(matrix);
+#if defined(KLM_GPIOD)
+    if (matrix->gpiod) {
+        klm_gpiod_set_oe(matrix->gpiod, true);
+    }
+#elif !defined(KLM_NON_GPIO_MACHINE)
     digitalWrite(klm_config_get_pin(matrix->config, 'o'), HIGH);
 #endif
 }
@@ -196,6 +337,254 @@ void klm_mat_set_scan_modulation(klm_matrix * const matrix, uint16_t scan_modula
     matrix->scan_modulation = scan_modulation;
 }
 
+/** Show a window onto the given canvas beneath the segments (NULL to remove) */
+void klm_mat_set_canvas(klm_matrix * const matrix, klm_canvas * const canvas, bool wrap) {
+    klm_mat_invalidate_frames(matrix);
+
+    if (canvas == NULL) {
+        klm_free(matrix->viewport);
+        matrix->viewport = NULL;
+        return;
+    }
+
+    if (matrix->viewport == NULL) {
+        matrix->viewport = klm_malloc(sizeof(klm_viewport));
+        matrix->viewport->x = 0;
+        matrix->viewport->y = 0;
+        matrix->viewport->hspeed = 0;
+        matrix->viewport->vspeed = 0;
+    }
+    matrix->viewport->canvas = canvas;
+    matrix->viewport->wrap = wrap;
+}
+
+/** Move the viewport to the given canvas coordinates */
+void klm_mat_set_viewport_position(klm_matrix * const matrix, float x, float y) {
+    klm_mat_invalidate_frames(matrix);
+    if (matrix->viewport) {
+        matrix->viewport->x = x;
+        matrix->viewport->y = y;
+    }
+}
+
+/** Set the viewport panning speed in pixels per tick */
+void klm_mat_set_viewport_speed(klm_matrix * const matrix, float hspeed, float vspeed) {
+    klm_mat_invalidate_frames(matrix);
+    if (matrix->viewport) {
+        matrix->viewport->hspeed = hspeed;
+        matrix->viewport->vspeed = vspeed;
+    }
+}
+
+/** Keep up to the given number of future frames rendered ahead (0 to render each tick just in time) */
+void klm_mat_set_render_ahead(klm_matrix * const matrix, size_t frames) {
+    if (matrix->frameq) {
+        klm_mat_invalidate_frames(matrix);
+        klm_frameq_destroy(matrix->frameq);
+        matrix->frameq = NULL;
+    }
+
+    if (frames > 0) {
+        matrix->frameq =
+            klm_frameq_create(frames,
+                              KLM_BUFFER_LEN(matrix->config->width, matrix->config->height),
+                              klm_segment_list_get_length(matrix->segment_list));
+    }
+}
+
+/** Render one more frame ahead if there is room in the queue, e.g. when otherwise idle */
+bool klm_mat_render_ahead(klm_matrix * const matrix) {
+    if (matrix->frameq == NULL) {
+        return false;
+    }
+    _klm_mat_sync_segment_count(matrix);
+
+    klm_frame * const frame = klm_frameq_get_tail(matrix->frameq);
+    if (frame == NULL) {
+        return false;
+    }
+
+    // With nothing queued the segments are in step with the display,
+    // so this is the state to rewind to if the queue is invalidated
+    if (klm_frameq_is_empty(matrix->frameq)) {
+        _klm_mat_save_state(matrix, &matrix->frameq->shown);
+    }
+
+    // Render as if it were the next tick, then swap the result into the
+    // queue; the slot's old buffer becomes the back buffer
+    _klm_mat_render_frame(matrix);
+
+    uint8_t *tmp = frame->buffer;
+    frame->buffer = matrix->display_buffer0;
+    matrix->display_buffer0 = tmp;
+
+    _klm_mat_save_state(matrix, frame);
+    klm_frameq_push(matrix->frameq);
+    return true;
+}
+
+/** Drop any frames rendered ahead, and rewind the segments to the frame on display.
+    Segment setters do this themselves, call it directly after drawing on the canvas */
+void klm_mat_invalidate_frames(klm_matrix * const matrix) {
+    if (matrix->frameq == NULL || klm_frameq_is_empty(matrix->frameq)) {
+        // Nothing has been rendered ahead, so the segments are already in step
+        return;
+    }
+
+    _klm_mat_restore_state(matrix, &matrix->frameq->shown);
+    klm_frameq_clear(matrix->frameq);
+}
+
+/** Play the given animation beneath the segments, or NULL to stop. Returns false if it is the wrong size */
+bool klm_mat_set_animation(klm_matrix * const matrix, klm_anim_player * const player) {
+    if (player &&
+        (player->header.width != matrix->config->width ||
+         player->header.height != matrix->config->height))
+    {
+        return false;
+    }
+
+    klm_mat_invalidate_frames(matrix);
+    matrix->animation = player;
+    return true;
+}
+
+/** Slide, wipe or dissolve from the frame on display to the frames which follow it, over duration ticks */
+void klm_mat_start_transition(klm_matrix * const matrix, klm_transition_type type, uint16_t duration) {
+    // Frames rendered ahead would skip the transition, and rewinding
+    // leaves the frame on display as the one to move away from
+    klm_mat_invalidate_frames(matrix);
+
+    if (matrix->transition == NULL) {
+        matrix->transition =
+            klm_transition_create(matrix->config->width, matrix->config->height);
+    }
+    klm_transition_start(matrix->transition, type, duration, matrix->display_buffer1);
+}
+
+/** Dither an 8-bit greyscale or RGB image straight onto the display, in place of the segments until the next tick */
+bool klm_mat_show_image(klm_matrix * const matrix,
+                        klm_dither * const dither,
+                        const uint8_t * const pixels,
+                        size_t stride)
+{
+    if (dither->width != matrix->config->width) {
+        return false;
+    }
+
+    // Any frames rendered ahead would replace the image, and the
+    // segments need to carry on from the frame which was on display
+    klm_mat_invalidate_frames(matrix);
+
+    uint16_t y;
+    for (y=0; y<matrix->config->height; y++) {
+        klm_dither_row(dither,
+                       pixels + y*stride,
+                       y,
+                       matrix->display_buffer0 + y*matrix->_row_width);
+    }
+    klm_mat_swap_buffers(matrix);
+    return true;
+}
+
+/** Keep the given snapshot up to date with the display, or NULL to stop */
+void klm_mat_set_snapshot(klm_matrix * const matrix, klm_snapshot * const snapshot) {
+    matrix->snapshot = snapshot;
+}
+
+/** Show the frames due on the given shared clock, and scroll text across its whole canvas, or NULL to stop.
+    Set this before handing the matrix to a runtime, so its ticks land on the shared frame boundaries */
+void klm_mat_set_sync(klm_matrix * const matrix, klm_sync * const sync) {
+    // Frames rendered ahead were numbered on the old clock, if any
+    klm_mat_invalidate_frames(matrix);
+    matrix->sync = sync;
+}
+
+/** Get a scaled and styled variant of a font glyph, to hand back with klm_mat_release_glyph.
+    Returns the glyph itself if it is plain, or the variant can't be had */
+hexfont_character * const klm_mat_get_styled_glyph(klm_matrix * const matrix,
+                                                   hexfont_character * const glyph,
+                                                   uint8_t scale,
+                                                   uint8_t style)
+{
+    if (glyph == NULL || (scale <= 1 && style == KLM_GLYPH_PLAIN) || matrix->glyph_cache == NULL) {
+        return glyph;
+    }
+
+    hexfont_character * const variant =
+        klm_glyph_cache_get(matrix->glyph_cache, glyph, (scale > 0) ? scale : 1, style);
+    if (variant == NULL) {
+        KLM_LOG(matrix, "No room in the glyph cache for U+%04X, drawing it plain\n", glyph->codepoint);
+        return glyph;
+    }
+    return variant;
+}
+
+/** Hand back a glyph from klm_mat_get_styled_glyph */
+void klm_mat_release_glyph(klm_matrix * const matrix, hexfont_character * const glyph) {
+    if (matrix->glyph_cache && glyph) {
+        klm_glyph_cache_release(matrix->glyph_cache, glyph);
+    }
+}
+
+/** Set the target refresh rate of the scan loop in Hz */
+void klm_mat_set_refresh_rate(klm_matrix * const matrix, uint32_t refresh_hz) {
+    klm_pacer_set_refresh_rate(matrix->pacer, refresh_hz);
+}
+
+/** Encode the display frame into the wire buffer, if it has changed */
+void klm_mat_encode_wire(klm_matrix * const matrix) {
+    // After a swap buffer0 still holds the previous frame, so if the two
+    // are identical the wire buffer is already up to date
+    if (!matrix->_wire_dirty &&
+        memcmp(matrix->display_buffer1,
+               matrix->display_buffer0,
+               KLM_BUFFER_LEN(matrix->config->width, matrix->config->height)) == 0)
+    {
+        return;
+    }
+
+    if (matrix->bitplanes) {
+        klm_bitplanes_encode(matrix->bitplanes,
+                             &matrix->wire_format,
+                             matrix->display_buffer1);
+    }
+    else {
+        klm_wire_encode(&matrix->wire_format,
+                        matrix->display_buffer1,
+                        matrix->wire_buffer,
+                        matrix->config->width,
+                        matrix->config->height);
+    }
+    matrix->_wire_dirty = false;
+}
+
+/** 64-bit FNV-1a hash of a buffer */
+uint64_t klm_mat_hash_buffer(const uint8_t * const buffer, size_t len) {
+    uint64_t hash = KLM_FNV_OFFSET_BASIS;
+    size_t i;
+    for (i=0; i<len; i++) {
+        hash = (hash ^ buffer[i]) * KLM_FNV_PRIME;
+    }
+    return hash;
+}
+
+/** Hash of the frame on display, to check that different ways of drawing it agree */
+uint64_t klm_mat_get_frame_hash(klm_matrix * const matrix) {
+    return klm_mat_hash_buffer(matrix->display_buffer1,
+                               KLM_BUFFER_LEN(matrix->config->width, matrix->config->height));
+}
+
+/** Hash of the frame as encoded for the panel, bitplanes included */
+uint64_t klm_mat_get_wire_hash(klm_matrix * const matrix) {
+    if (matrix->bitplanes) {
+        return klm_mat_hash_buffer(matrix->bitplanes->data,
+                                   matrix->bitplanes->depth * matrix->bitplanes->plane_len);
+    }
+    return klm_mat_hash_buffer(matrix->wire_buffer,
+                               KLM_BUFFER_LEN(matrix->config->width, matrix->config->height));
+}
+
 /** Clear the entire matrix */
 void klm_mat_clear(klm_matrix *matrix) {
     int16_t x, y;
@@ -216,25 +605,268 @@ void klm_mat_clear_text(klm_matrix * const matrix) {
 }
 
 void klm_mat_dump_buffer(klm_matrix * const matrix) {
+    static const char hex[] = "0123456789abcdef";
+    char *p = matrix->_dump_buffer;
+
+    // Format the whole frame, then write it out in one go
     int16_t i;
     for (i=0; i<matrix->config->height*matrix->_row_width; i++) {
-        KLM_LOG(matrix, "%02x ", matrix->display_buffer1[i]);
+        *p++ = hex[matrix->display_buffer1[i] >> 4];
+        *p++ = hex[matrix->display_buffer1[i] & 0x0F];
+        *p++ = ' ';
     }
-    KLM_LOG(matrix, "\n");
+    *p++ = '\n';
 
     int16_t x, y;
     for (y=0; y<matrix->config->height; y++) {
         for (x=0; x<matrix->config->width; x++) {
-            if (klm_mat_is_pixel_set(matrix, x, y)) {
-                KLM_LOG(matrix, "# ");
-            }
-            else {
-                KLM_LOG(matrix, ". ");
-            }
+            *p++ = klm_mat_is_pixel_set(matrix, x, y) ? '#' : '.';
+            *p++ = ' ';
         }
-        KLM_LOG(matrix, "\n");
+        *p++ = '\n';
+    }
+    *p++ = '\n';
+
+    klm_logger_write_now(matrix->logger, matrix->_dump_buffer, p - matrix->_dump_buffer);
+}
+
+static void _klm_mat_render_frame(klm_matrix * const matrix) {
+    // Synchronized segments are positioned for this frame number
+    if (matrix->sync) {
+        matrix->_sync_frame++;
+    }
+
+    if (matrix->viewport) {
+        // The visible window of the canvas replaces the whole back buffer
+        klm_viewport * const viewport = matrix->viewport;
+        klm_viewport_tick(viewport);
+        klm_canvas_copy_window(viewport->canvas,
+                               (int32_t)floorf(viewport->x),
+                               (int32_t)floorf(viewport->y),
+                               viewport->wrap,
+                               matrix->display_buffer0,
+                               matrix->config->width,
+                               matrix->config->height);
+    }
+    else if (matrix->animation) {
+        // The back buffer holds the frame before last, so the player decodes
+        // into its own frame and that replaces the whole back buffer
+        memcpy(matrix->display_buffer0,
+               matrix->animation->frame,
+               matrix->animation->buffer_len);
+        klm_anim_player_tick(matrix->animation);
+    }
+    else {
+        klm_mat_clear(matrix);
+    }
+
+    klm_segment_list *iter = matrix->segment_list;
+    while (iter) {
+        klm_seg_tick(iter->item);
+        iter = iter->next;
+    }
+
+    // Mix in the frame being transitioned from, if any
+    if (matrix->transition) {
+        klm_transition_tick(matrix->transition, &matrix->display_buffer0);
+    }
+}
+
+static void _klm_mat_show_frame(klm_matrix * const matrix, klm_frame * const frame) {
+    // Swap the queued frame onto the display, and recycle the old one
+    uint8_t *tmp = matrix->display_buffer1;
+    matrix->display_buffer1 = frame->buffer;
+    frame->buffer = tmp;
+
+    // Colour changes and snapshot restores mark the wire without touching the pixels
+    if (matrix->_wire_dirty ||
+        memcmp(matrix->display_buffer1,
+               frame->buffer,
+               KLM_BUFFER_LEN(matrix->config->width, matrix->config->height)) != 0)
+    {
+        matrix->_wire_dirty = true;
+        klm_mat_encode_wire(matrix);
+    }
+}
+
+static void _klm_mat_save_state(klm_matrix * const matrix, klm_frame * const frame) {
+    uint16_t i = 0;
+    klm_segment_list *iter = matrix->segment_list;
+    while (iter && i < matrix->frameq->segment_count) {
+        klm_segment * const seg = iter->item;
+        klm_frame_seg_state * const state = &frame->seg_states[i++];
+
+        state->text_hpos = seg->text_hpos;
+        state->text_vpos = seg->text_vpos;
+        state->page_vpos = seg->_page_vpos;
+        state->page = seg->page;
+        state->page_hold = seg->_page_hold;
+        state->text_hspeed = seg->text_hspeed;
+        state->text_vspeed = seg->text_vspeed;
+        state->visible = seg->visible;
+        state->reverse = seg->reverse;
+        state->paused = seg->paused;
+        if (seg->timeline) {
+            state->timeline = seg->timeline->state;
+        }
+        iter = iter->next;
+    }
+
+    if (matrix->viewport) {
+        frame->viewport_x = matrix->viewport->x;
+        frame->viewport_y = matrix->viewport->y;
+    }
+
+    if (matrix->animation) {
+        frame->anim_frame = matrix->animation->frame_index;
+        frame->anim_hold = matrix->animation->hold;
+    }
+
+    if (matrix->transition) {
+        frame->transition_tick = matrix->transition->tick;
     }
-    KLM_LOG(matrix, "\n");
+
+    frame->sync_frame = matrix->_sync_frame;
+}
+
+static void _klm_mat_restore_state(klm_matrix * const matrix, klm_frame * const frame) {
+    uint16_t i = 0;
+    klm_segment_list *iter = matrix->segment_list;
+    while (iter && i < matrix->frameq->segment_count) {
+        klm_segment * const seg = iter->item;
+        klm_frame_seg_state * const state = &frame->seg_states[i++];
+
+        // Putting the text back lays it out again, so it goes before the fields it resets
+        if (seg->timeline) {
+            klm_timeline_restore(seg->timeline, &state->timeline);
+        }
+
+        seg->text_hpos = state->text_hpos;
+        seg->text_vpos = state->text_vpos;
+        seg->_page_vpos = state->page_vpos;
+        seg->page = state->page;
+        seg->_page_hold = state->page_hold;
+        seg->text_hspeed = state->text_hspeed;
+        seg->text_vspeed = state->text_vspeed;
+        seg->visible = state->visible;
+        seg->reverse = state->reverse;
+        seg->paused = state->paused;
+        iter = iter->next;
+    }
+
+    if (matrix->viewport) {
+        matrix->viewport->x = frame->viewport_x;
+        matrix->viewport->y = frame->viewport_y;
+    }
+
+    if (matrix->animation) {
+        // Decoding only goes forwards, so rewinding means seeking
+        if (matrix->animation->frame_index != frame->anim_frame) {
+            klm_anim_player_seek(matrix->animation, frame->anim_frame);
+        }
+        matrix->animation->hold = frame->anim_hold;
+    }
+
+    if (matrix->transition) {
+        matrix->transition->tick = frame->transition_tick;
+    }
+
+    matrix->_sync_frame = frame->sync_frame;
+}
+
+static void _klm_mat_sync_frames(klm_matrix * const matrix, uint32_t due) {
+    if (matrix->frameq) {
+        // Drop any frames rendered ahead which are already late...
+        klm_frame *frame = klm_frameq_get_head(matrix->frameq);
+        while (frame && frame->sync_frame < due) {
+            klm_frameq_pop(matrix->frameq);
+            frame = klm_frameq_get_head(matrix->frameq);
+        }
+
+        if (frame && frame->sync_frame == due) {
+            return;
+        }
+
+        // ...or not due yet, which leaves the queue out of step
+        klm_mat_invalidate_frames(matrix);
+    }
+
+    // Render the frame due just in time, from the state on display
+    matrix->_sync_frame = due - 1;
+}
+
+static void _klm_mat_sync_segment_count(klm_matrix * const matrix) {
+    uint16_t segment_count = klm_segment_list_get_length(matrix->segment_list);
+    if (matrix->frameq == NULL || matrix->frameq->segment_count == segment_count) {
+        return;
+    }
+
+    // The frames rendered ahead are missing a segment appended since. Rewind
+    // the segments they do have, then save states for all of them from here on
+    klm_mat_invalidate_frames(matrix);
+    klm_frameq_set_segment_count(matrix->frameq, segment_count);
+}
+
+static void _klm_mat_init_glyph_cache(klm_matrix * const matrix) {
+    if (matrix->glyph_cache ||
+        matrix->font_list == NULL ||
+        matrix->config->glyph_cache_capacity == KLM_GLYPH_CACHE_OFF)
+    {
+        return;
+    }
+
+    // Slots big enough for any glyph of the loaded fonts, which are
+    // at most two cells wide
+    uint16_t height = 0;
+    uint16_t i;
+    for (i=0; i<hexfont_list_get_length(matrix->font_list); i++) {
+        hexfont * const font = hexfont_list_get_nth(matrix->font_list, i);
+        if (font && font->glyph_height > height) {
+            height = font->glyph_height;
+        }
+    }
+
+    // A variant for every character of every segment, and one more for
+    // a counter to borrow while it draws, so text never falls back to plain
+    size_t capacity = matrix->config->glyph_cache_capacity;
+    if (capacity == KLM_GLYPH_CACHE_AUTO) {
+        capacity = (size_t)klm_segment_list_get_length(matrix->segment_list) * KLM_TEXT_LEN + 1;
+    }
+    if (capacity > INT16_MAX) {
+        capacity = INT16_MAX;
+    }
+
+    matrix->glyph_cache =
+        klm_glyph_cache_create(capacity,
+                               matrix->config->glyph_cache_max_scale,
+                               2*KLM_BYTE_WIDTH,
+                               height);
+
+    // Any text styled before now was drawn plain
+    klm_segment_list *iter = matrix->segment_list;
+    while (iter) {
+        klm_segment * const seg = iter->item;
+        if (seg && (seg->text_scale > 1 || seg->text_style != KLM_GLYPH_PLAIN)) {
+            klm_seg_set_text_style(seg, seg->text_scale, seg->text_style);
+        }
+        iter = iter->next;
+    }
+}
+
+static void _klm_mat_arm_scan_timer(klm_matrix * const matrix) {
+#ifndef ARDUINO
+    if (matrix->_scan_timer_fd < 0) {
+        return;
+    }
+
+    // There is nothing to scan while the display is off, so don't wake the runtime for it
+    int64_t period = matrix->on ? klm_pacer_get_row_period_nanos(matrix->pacer) : 0;
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = period / KLM_ONE_BILLION;
+    spec.it_interval.tv_nsec = period % KLM_ONE_BILLION;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(matrix->_scan_timer_fd, 0, &spec, NULL);
+#endif
 }
 
 static void _klm_mat_sanity_check(klm_matrix * const matrix) {
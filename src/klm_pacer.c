@@ -0,0 +1,148 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include "klm_pacer.h"
+#include "klm_alloc.h"
+
+static void _klm_pacer_sleep_until(int64_t nanos);
+
+
+/** Create a pacer for the given refresh rate and number of rows per refresh */
+klm_pacer * const klm_pacer_create(uint32_t refresh_hz, uint16_t rows) {
+    // Allocate memory for the pacer structure and initialize all members
+    klm_pacer * const pacer = klm_malloc(sizeof(klm_pacer));
+
+    // A pacer always has at least one row slot to schedule
+    pacer->rows = (rows > 0) ? rows : 1;
+    pacer->spin_nanos = KLM_PACER_DEFAULT_SPIN_NANOS;
+    klm_pacer_set_refresh_rate(pacer, refresh_hz);
+
+    return pacer;
+}
+
+/** Clean up a pacer */
+void klm_pacer_destroy(klm_pacer * const pacer) {
+    klm_free(pacer);
+}
+
+/** Change the target refresh rate. A rate of zero is taken as 1Hz */
+void klm_pacer_set_refresh_rate(klm_pacer * const pacer, uint32_t refresh_hz) {
+    pacer->refresh_hz = (refresh_hz > 0) ? refresh_hz : 1;
+    pacer->_row_period_nanos = KLM_ONE_BILLION / ((int64_t)pacer->refresh_hz * pacer->rows);
+
+    // Rates beyond a row per nanosecond just run flat out
+    if (pacer->_row_period_nanos < 1) {
+        pacer->_row_period_nanos = 1;
+    }
+    klm_pacer_reset(pacer);
+}
+
+/** Forget the current deadline and statistics */
+void klm_pacer_reset(klm_pacer * const pacer) {
+    pacer->row_count = 0;
+    pacer->overrun_count = 0;
+    pacer->max_error_nanos = 0;
+
+    pacer->_deadline_nanos = 0;
+    pacer->_last_nanos = 0;
+    pacer->_start_nanos = 0;
+    pacer->_error_sum_nanos = 0;
+    pacer->_periods = 1;
+}
+
+/** Block until the deadline for the next row */
+void klm_pacer_wait_row(klm_pacer * const pacer) {
+    klm_pacer_wait_periods(pacer, 1);
+}
+
+/** Block until the next deadline, then set the one after the given number of row periods later */
+void klm_pacer_wait_periods(klm_pacer * const pacer, uint16_t periods) {
+    int64_t now = klm_pacer_now_nanos();
+    const int64_t slot_nanos = periods * pacer->_row_period_nanos;
+
+    // The first row just starts the clock
+    if (pacer->_deadline_nanos == 0) {
+        pacer->_start_nanos = now;
+        pacer->_last_nanos = now;
+        pacer->_deadline_nanos = now + slot_nanos;
+        pacer->_periods = periods;
+        return;
+    }
+
+    // Sleep until shortly before the deadline, then spin for the rest
+    if (pacer->_deadline_nanos - now > pacer->spin_nanos) {
+        _klm_pacer_sleep_until(pacer->_deadline_nanos - pacer->spin_nanos);
+    }
+    do {
+        now = klm_pacer_now_nanos();
+    } while (now < pacer->_deadline_nanos);
+
+    // Keep track of how far this row's on-time was from the nominal period
+    int64_t error = (now - pacer->_last_nanos) - pacer->_periods*pacer->_row_period_nanos;
+    if (error < 0) {
+        error = -error;
+    }
+    if (error > pacer->max_error_nanos) {
+        pacer->max_error_nanos = error;
+    }
+    pacer->_error_sum_nanos += error;
+    pacer->row_count += pacer->_periods;
+    pacer->_last_nanos = now;
+
+    // Schedule the next row. If we have fallen more than a whole
+    // period behind, don't try to catch up with a burst of short rows.
+    pacer->_deadline_nanos += slot_nanos;
+    if (pacer->_deadline_nanos < now) {
+        pacer->_deadline_nanos = now + slot_nanos;
+        pacer->overrun_count++;
+    }
+    pacer->_periods = periods;
+}
+
+/** Achieved refresh rate in Hz since the last reset */
+float klm_pacer_get_refresh_rate(klm_pacer * const pacer) {
+    int64_t elapsed = pacer->_last_nanos - pacer->_start_nanos;
+    if (elapsed <= 0) {
+        return 0;
+    }
+    return ((float)pacer->row_count / pacer->rows) * KLM_ONE_BILLION / elapsed;
+}
+
+/** Mean deviation of row on-time from the nominal row period, as a fraction of it */
+float klm_pacer_get_duty_error(klm_pacer * const pacer) {
+    if (pacer->row_count == 0) {
+        return 0;
+    }
+    return ((float)pacer->_error_sum_nanos / pacer->row_count) / pacer->_row_period_nanos;
+}
+
+static void _klm_pacer_sleep_until(int64_t nanos) {
+    struct timespec t;
+    t.tv_sec = nanos / KLM_ONE_BILLION;
+    t.tv_nsec = nanos % KLM_ONE_BILLION;
+
+    // Restart the sleep if interrupted by a signal
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR);
+}
@@ -4,11 +4,12 @@
 #include <string.h>
 #include <math.h>
 #include "klm_pin_list.h"
+#include "klm_alloc.h"
 
 
 klm_pin_list * const klm_pin_list_create() {
     // Allocate memory for the pin list structure
-    klm_pin_list * const list = malloc(sizeof(klm_pin_list));
+    klm_pin_list * const list = klm_malloc(sizeof(klm_pin_list));
     list->head = NULL;
 
     return list;
@@ -21,11 +22,11 @@ void klm_pin_list_destroy(klm_pin_list * const list) {
     while (last != NULL) {
         prev = last;
         last = last->next;
-        free(prev);
+        klm_free(prev);
     }
 
     // Free the list structure itself
-    free(list);
+    klm_free(list);
 }
 
 uint8_t klm_pin_list_get(klm_pin_list * const list, const char pin_name) {
@@ -38,10 +39,19 @@ uint8_t klm_pin_list_get(klm_pin_list * const list, const char pin_name) {
     return last->value;
 }
 
+bool klm_pin_list_has(klm_pin_list * const list, const char pin_name) {
+    __klm_pin_list_node_t * last = list->head;
+    while (last != NULL && last->key != pin_name) {
+        last = last->next;
+    }
+
+    return (last != NULL);
+}
+
 void klm_pin_list_put(klm_pin_list * const list, char pin_name, uint8_t pin_number) {
     // First node case
     if (list->head == NULL) {
-        list->head = malloc(sizeof(__klm_pin_list_node_t));
+        list->head = klm_malloc(sizeof(__klm_pin_list_node_t));
         list->head->key = pin_name;
         list->head->value = pin_number;
         list->head->next = NULL;
@@ -57,7 +67,7 @@ void klm_pin_list_put(klm_pin_list * const list, char pin_name, uint8_t pin_numb
     }
 
     // Create the new node and wire up the linked list
-    last = malloc(sizeof(__klm_pin_list_node_t));
+    last = klm_malloc(sizeof(__klm_pin_list_node_t));
     last->key = pin_name;
     last->value = pin_number;
     last->next = NULL;
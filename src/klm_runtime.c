@@ -0,0 +1,353 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "klm_runtime.h"
+#include "klm_alloc.h"
+
+static __klm_runtime_source_t * const _klm_runtime_add_source(
+                                            klm_runtime * const runtime,
+                                            klm_runtime_source_type type,
+                                            int fd,
+                                            uint32_t events);
+static bool _klm_runtime_render_ahead(klm_runtime * const runtime);
+static void _klm_runtime_purge_sources(klm_runtime * const runtime);
+static int _klm_runtime_create_timer(int64_t period_nanos);
+static bool _klm_runtime_arm_timer(int fd, int64_t period_nanos);
+static bool _klm_runtime_align_timer(int fd, int64_t start_nanos, int64_t period_nanos);
+static void _klm_runtime_dispatch(klm_runtime * const runtime,
+                                  __klm_runtime_source_t * const source,
+                                  uint32_t events);
+
+
+/** Create a runtime */
+klm_runtime * const klm_runtime_create() {
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        return NULL;
+    }
+
+    // Allocate memory for the runtime structure and initialize all members
+    klm_runtime * const runtime = klm_malloc(sizeof(klm_runtime));
+    runtime->epoll_fd = epoll_fd;
+    runtime->running = false;
+    runtime->sources = NULL;
+
+    return runtime;
+}
+
+/** Clean up a runtime, including any matrices it owns */
+void klm_runtime_destroy(klm_runtime * const runtime) {
+    // Traverse linked list and free each node.
+    // Each matrix has exactly one tick source, which owns it.
+    __klm_runtime_source_t * prev = runtime->sources;
+    __klm_runtime_source_t * last = runtime->sources;
+    while (last != NULL) {
+        prev = last;
+        last = last->next;
+
+        if (prev->type != KLM_RUNTIME_SOURCE_USER) {
+            close(prev->fd);
+        }
+        if (prev->type == KLM_RUNTIME_SOURCE_TICK) {
+            klm_mat_destroy(prev->matrix);
+        }
+        klm_free(prev);
+    }
+
+    close(runtime->epoll_fd);
+    klm_free(runtime);
+}
+
+/** Hand a matrix over to the runtime, ticking it every tick_period_micros */
+bool klm_runtime_add_matrix(klm_runtime * const runtime,
+                            klm_matrix * const matrix,
+                            uint32_t tick_period_micros)
+{
+    int64_t tick_period = (int64_t)tick_period_micros * KLM_ONE_THOUSAND;
+    int64_t scan_period = klm_pacer_get_row_period_nanos(matrix->pacer);
+
+    // A synchronized matrix ticks on the shared frame boundaries instead,
+    // so that all the controllers swap frames together
+    if (matrix->sync) {
+        tick_period = klm_sync_get_period_nanos(matrix->sync);
+    }
+
+    int tick_fd = _klm_runtime_create_timer(tick_period);
+    if (tick_fd < 0) {
+        return false;
+    }
+
+    if (matrix->sync &&
+        !_klm_runtime_align_timer(tick_fd,
+                                  klm_sync_get_next_frame_nanos(matrix->sync),
+                                  tick_period))
+    {
+        close(tick_fd);
+        return false;
+    }
+
+    int scan_fd = _klm_runtime_create_timer(scan_period);
+    if (scan_fd < 0) {
+        close(tick_fd);
+        return false;
+    }
+
+    __klm_runtime_source_t *tick =
+        _klm_runtime_add_source(runtime, KLM_RUNTIME_SOURCE_TICK, tick_fd, EPOLLIN);
+    if (tick == NULL) {
+        close(tick_fd);
+        close(scan_fd);
+        return false;
+    }
+
+    __klm_runtime_source_t *scan =
+        _klm_runtime_add_source(runtime, KLM_RUNTIME_SOURCE_SCAN, scan_fd, EPOLLIN);
+    if (scan == NULL) {
+        // Unwind the tick source, which is at the head of the list
+        epoll_ctl(runtime->epoll_fd, EPOLL_CTL_DEL, tick_fd, NULL);
+        runtime->sources = tick->next;
+        klm_free(tick);
+        close(tick_fd);
+        close(scan_fd);
+        return false;
+    }
+
+    tick->matrix = matrix;
+    tick->period_nanos = tick_period;
+    scan->matrix = matrix;
+    scan->period_nanos = scan_period;
+
+    // The matrix disarms the scan timer while it is off, and arms it again when switched on
+    matrix->_scan_timer_fd = scan_fd;
+    if (!matrix->on) {
+        _klm_runtime_arm_timer(scan_fd, 0);
+    }
+
+    return true;
+}
+
+/** Watch a user file descriptor for the given epoll events */
+bool klm_runtime_add_fd(klm_runtime * const runtime,
+                        int fd,
+                        uint32_t events,
+                        klm_runtime_callback callback,
+                        void *user_data)
+{
+    __klm_runtime_source_t *source =
+        _klm_runtime_add_source(runtime, KLM_RUNTIME_SOURCE_USER, fd, events);
+    if (source == NULL) {
+        return false;
+    }
+
+    source->callback = callback;
+    source->user_data = user_data;
+    return true;
+}
+
+/** Stop watching a user file descriptor */
+void klm_runtime_remove_fd(klm_runtime * const runtime, int fd) {
+    __klm_runtime_source_t *iter;
+    for (iter=runtime->sources; iter!=NULL; iter=iter->next) {
+        if (iter->type == KLM_RUNTIME_SOURCE_USER && iter->fd == fd && !iter->_removed) {
+            // The node may still be referenced by the batch being dispatched
+            epoll_ctl(runtime->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            iter->_removed = true;
+            return;
+        }
+    }
+}
+
+/** Wait for and dispatch one batch of events, or time out after timeout_ms (-1 to wait forever) */
+bool klm_runtime_run_once(klm_runtime * const runtime, int timeout_ms) {
+    struct epoll_event events[KLM_RUNTIME_MAX_EVENTS];
+
+    int n = epoll_wait(runtime->epoll_fd, events, KLM_RUNTIME_MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+        return (errno == EINTR);
+    }
+
+    // Scan timers are dispatched first, as they are the most timing sensitive
+    int i;
+    for (i=0; i<n; i++) {
+        __klm_runtime_source_t *source = events[i].data.ptr;
+        if (source->type == KLM_RUNTIME_SOURCE_SCAN) {
+            _klm_runtime_dispatch(runtime, source, events[i].events);
+        }
+    }
+    for (i=0; i<n; i++) {
+        __klm_runtime_source_t *source = events[i].data.ptr;
+        if (source->type != KLM_RUNTIME_SOURCE_SCAN && !source->_removed) {
+            _klm_runtime_dispatch(runtime, source, events[i].events);
+        }
+    }
+
+    _klm_runtime_purge_sources(runtime);
+    return true;
+}
+
+/** Dispatch events until klm_runtime_stop is called */
+bool klm_runtime_run(klm_runtime * const runtime) {
+    runtime->running = true;
+    while (runtime->running) {
+        // Spend idle time rendering frames ahead, checking for events
+        // between each one, and only block once every queue is full
+        int timeout_ms = _klm_runtime_render_ahead(runtime) ? 0 : -1;
+
+        if (!klm_runtime_run_once(runtime, timeout_ms)) {
+            runtime->running = false;
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Make klm_runtime_run return after the current batch of events */
+void klm_runtime_stop(klm_runtime * const runtime) {
+    runtime->running = false;
+}
+
+static __klm_runtime_source_t * const _klm_runtime_add_source(
+                                            klm_runtime * const runtime,
+                                            klm_runtime_source_type type,
+                                            int fd,
+                                            uint32_t events)
+{
+    __klm_runtime_source_t * const source = klm_malloc(sizeof(__klm_runtime_source_t));
+    source->type = type;
+    source->fd = fd;
+    source->matrix = NULL;
+    source->period_nanos = 0;
+    source->callback = NULL;
+    source->user_data = NULL;
+    source->_removed = false;
+
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = source;
+    if (epoll_ctl(runtime->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        klm_free(source);
+        return NULL;
+    }
+
+    // Prepend the new node
+    source->next = runtime->sources;
+    runtime->sources = source;
+    return source;
+}
+
+static bool _klm_runtime_render_ahead(klm_runtime * const runtime) {
+    bool rendered = false;
+
+    __klm_runtime_source_t *iter;
+    for (iter=runtime->sources; iter!=NULL; iter=iter->next) {
+        if (iter->type == KLM_RUNTIME_SOURCE_TICK && !iter->_removed) {
+            rendered |= klm_mat_render_ahead(iter->matrix);
+        }
+    }
+    return rendered;
+}
+
+static void _klm_runtime_purge_sources(klm_runtime * const runtime) {
+    __klm_runtime_source_t **link = &runtime->sources;
+    while (*link != NULL) {
+        __klm_runtime_source_t *source = *link;
+        if (source->_removed) {
+            *link = source->next;
+            klm_free(source);
+        }
+        else {
+            link = &source->next;
+        }
+    }
+}
+
+static int _klm_runtime_create_timer(int64_t period_nanos) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (!_klm_runtime_arm_timer(fd, period_nanos)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool _klm_runtime_arm_timer(int fd, int64_t period_nanos) {
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = period_nanos / KLM_ONE_BILLION;
+    spec.it_interval.tv_nsec = period_nanos % KLM_ONE_BILLION;
+    spec.it_value = spec.it_interval;
+
+    return (timerfd_settime(fd, 0, &spec, NULL) == 0);
+}
+
+static bool _klm_runtime_align_timer(int fd, int64_t start_nanos, int64_t period_nanos) {
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = period_nanos / KLM_ONE_BILLION;
+    spec.it_interval.tv_nsec = period_nanos % KLM_ONE_BILLION;
+    spec.it_value.tv_sec = start_nanos / KLM_ONE_BILLION;
+    spec.it_value.tv_nsec = start_nanos % KLM_ONE_BILLION;
+
+    return (timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, NULL) == 0);
+}
+
+static void _klm_runtime_dispatch(klm_runtime * const runtime,
+                                  __klm_runtime_source_t * const source,
+                                  uint32_t events)
+{
+    uint64_t expirations;
+
+    switch (source->type) {
+        case KLM_RUNTIME_SOURCE_TICK:
+            if (read(source->fd, &expirations, sizeof(expirations)) > 0) {
+                // Missed ticks are dropped rather than run back to back
+                klm_mat_tick(source->matrix);
+            }
+            break;
+
+        case KLM_RUNTIME_SOURCE_SCAN:
+            if (read(source->fd, &expirations, sizeof(expirations)) > 0) {
+                klm_mat_scan_row(source->matrix);
+
+                // Follow any change to the matrix's refresh rate
+                int64_t period = klm_pacer_get_row_period_nanos(source->matrix->pacer);
+                if (source->matrix->on && period != source->period_nanos) {
+                    _klm_runtime_arm_timer(source->fd, period);
+                    source->period_nanos = period;
+                }
+            }
+            break;
+
+        case KLM_RUNTIME_SOURCE_USER:
+            source->callback(runtime, source->fd, events, source->user_data);
+            break;
+    }
+}
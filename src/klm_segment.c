@@ -29,24 +29,40 @@
 #include <tinyutf8.h>
 #include "klm_segment.h"
 #include "klm_matrix.h"
+#include "klm_layout.h"
+#include "klm_font_chain.h"
+#include "klm_counter.h"
+#include "klm_timeline.h"
+#include "klm_alloc.h"
 
 // Symbolic constants
 #define KLM_BYTE_WIDTH 8
 #define KLM_CHARACTER_SPACING 1
 
+static uint16_t _klm_seg_get_glyph_height(klm_segment * const seg);
+static void _klm_seg_update_text(klm_segment * const seg, const char * const text);
+static void _klm_seg_resolve_glyphs(klm_segment * const seg);
+static void _klm_seg_refresh_glyphs(klm_segment * const seg);
+static void _klm_seg_update_layout(klm_segment * const seg);
+static void _klm_seg_set_page(klm_segment * const seg, uint16_t page, bool animate);
+static void _klm_seg_tick_page(klm_segment * const seg);
+static void _klm_seg_render_layout(klm_segment * const seg);
 
 
-/** Create a segment object by */
+/** Create a segment object. Returns NULL if out of memory */
 klm_segment * const klm_seg_create(
                                 klm_matrix * const matrix,
-                                uint8_t x,
-                                uint8_t y,
+                                int16_t x,
+                                int16_t y,
                                 uint16_t width,
                                 uint16_t height,
                                 uint8_t font_index)
 {
     // Allocate memory for a klm_matrix structure and initialize all members
-    klm_segment * const segment = malloc(sizeof(klm_segment));
+    klm_segment * const segment = klm_malloc(sizeof(klm_segment));
+    if (segment == NULL) {
+        return NULL;
+    }
 
     segment->matrix = matrix;
     segment->x = x;
@@ -55,20 +71,39 @@ klm_segment * const klm_seg_create(
     segment->height = height;
 
     segment->font_index = font_index;
+    segment->font_chain = NULL;
+    segment->text_scale = 1;
+    segment->text_style = KLM_GLYPH_PLAIN;
+    segment->colour = KLM_COLOUR_WHITE;
     segment->visible = true;
     segment->paused = false;
     segment->reverse = false;
 
-    segment->text = strdup("");
+#ifdef KLM_STATIC
+    segment->_text_buffer[0] = '\0';
+    segment->text = segment->_text_buffer;
+#else
+    segment->text = klm_strdup("");
+    segment->_text_owned = (char *)segment->text;
+#endif
     segment->text_len = 0;
     segment->text_hspeed = 0;
     segment->text_vspeed = 0;
     segment->text_hpos = 0;
     segment->text_vpos = 0;
 
+    segment->multiline = false;
+    segment->text_align = KLM_ALIGN_LEFT;
+    segment->line_spacing = 0;
+    segment->page = 0;
+    segment->page_hold_ticks = 0;
+    segment->counter = NULL;
+    segment->timeline = NULL;
+
     int i;
     for (i=0; i<KLM_TEXT_LEN; i++) {
         segment->codepoints[i] = 0x0;
+        segment->_glyphs[i] = NULL;
     }
 
     segment->_row_width = (uint16_t)(width / KLM_BYTE_WIDTH);
@@ -76,17 +111,36 @@ klm_segment * const klm_seg_create(
     segment->_text_pixel_height = 0;
     segment->_dirty = false;
 
+    segment->_layout = NULL;
+    segment->_page_vpos = 0;
+    segment->_page_hold = 0;
+    segment->_remote = false;
+
     return segment;
 }
 
 void klm_seg_destroy(klm_segment * const seg) {
+    // Hand back any styled glyphs
+    int16_t i;
+    for (i=0; i<KLM_TEXT_LEN; i++) {
+        klm_mat_release_glyph(seg->matrix, seg->_glyphs[i]);
+    }
+
     // Free dynamically allocated memory
-    free((char *)seg->text);
-    free(seg);
+#ifndef KLM_STATIC
+    klm_free(seg->_text_owned);
+#endif
+    klm_free(seg->_layout);
+    klm_free(seg);
 }
 
 /** Drive animation */
 void klm_seg_tick(klm_segment * const seg) {
+    // A timeline can bring a hidden segment back, so it goes first
+    if (seg->timeline) {
+        klm_timeline_tick(seg->timeline);
+    }
+
     if (!seg->visible) {
         return;
     }
@@ -106,7 +160,17 @@ void klm_seg_tick(klm_segment * const seg) {
     }
     */
 
-    if (seg->text_hspeed != 0 && !seg->paused) {
+    if (seg->text_hspeed != 0 && !seg->paused && seg->matrix->sync) {
+        // Work the position out afresh from the shared frame number,
+        // so that every controller agrees on where the text is
+        seg->text_hpos =
+            klm_sync_get_text_hpos(seg->matrix->sync,
+                                   seg->matrix->_sync_frame,
+                                   seg->text_hspeed,
+                                   seg->_text_pixel_width,
+                                   seg->x);
+    }
+    else if (seg->text_hspeed != 0 && !seg->paused) {
         // Animate and render text horizontally
         seg->text_hpos += seg->text_hspeed;
         if (seg->text_hpos < -seg->_text_pixel_width) {
@@ -117,7 +181,11 @@ void klm_seg_tick(klm_segment * const seg) {
         }
     }
 
-    if (seg->text_vspeed != 0 && !seg->paused) {
+    if (seg->multiline && !seg->paused) {
+        // Multi-line text moves vertically a page at a time
+        _klm_seg_tick_page(seg);
+    }
+    else if (seg->text_vspeed != 0 && !seg->paused) {
         // Animate and render text vertically
         seg->text_vpos += seg->text_vspeed;
         if (seg->text_vpos < -seg->_text_pixel_height) {
@@ -146,12 +214,14 @@ void klm_seg_clear(klm_segment * const seg) {
 
 /** Add the given segment to the rendering loop */
 void klm_seg_show(klm_segment * const seg) {
+    klm_mat_invalidate_frames(seg->matrix);
     seg->visible = true;
     seg->_dirty = true;
 }
 
 /** Remove the given segment from the rendering loop */
 void klm_seg_hide(klm_segment * const seg) {
+    klm_mat_invalidate_frames(seg->matrix);
     klm_seg_clear(seg);
     seg->visible = false;
     seg->_dirty = true;
@@ -159,28 +229,89 @@ void klm_seg_hide(klm_segment * const seg) {
 
 /** Set the segment's text content */
 void klm_seg_set_text(klm_segment *seg, const char * const text) {
-    //[TODO: should the codepoints buffer by dynamically allocated?]
-    seg->text_len = tinyutf8_strlen(text);
-    if (seg->text_len > KLM_TEXT_LEN) {
-        seg->text_len = KLM_TEXT_LEN;
+#ifdef KLM_STATIC
+    // The text is copied into the segment, so there's nothing to duplicate
+    klm_seg_take_text(seg, (char *)text);
+#else
+    klm_seg_take_text(seg, klm_strdup(text));
+#endif
+}
+
+/** Set the segment's text content, taking ownership of the given heap allocated string.
+    A KLM_STATIC build copies the text instead, and the caller keeps ownership */
+void klm_seg_take_text(klm_segment * const seg, char * const text) {
+    klm_mat_invalidate_frames(seg->matrix);
+    if (seg->timeline) {
+        klm_timeline_set_base_text(seg->timeline, text);
     }
 
-    // Decompose the text into codepoints
-    size_t i=0, cnt=0;
-    while (cnt < seg->text_len) {
-        seg->codepoints[cnt] = tinyutf8_next_codepoint(text, &i);
-        cnt++;
+#ifndef KLM_STATIC
+    if (seg->_text_owned != text) {
+        klm_free(seg->_text_owned);
     }
+    seg->_text_owned = text;
+#endif
+    _klm_seg_update_text(seg, text);
+}
 
-    // Save the original text
-    free((char *)seg->text);
-    seg->text = strdup(text);
+/** Show the given text without copying it or dropping frames rendered ahead, e.g. from inside the tick.
+    Unless this is a KLM_STATIC build the text must stay put until it is replaced */
+void klm_seg_set_text_ref(klm_segment * const seg, const char * const text) {
+    _klm_seg_update_text(seg, text);
+}
 
-    seg->_text_pixel_width = klm_seg_get_text_pixel_width(seg);
-    seg->_text_pixel_height = klm_seg_get_text_pixel_height(seg);
-    seg->_dirty = true;
+/** Drive the segment from the given timeline, starting at its first keyframe (NULL to stop) */
+void klm_seg_set_timeline(klm_segment * const seg, klm_timeline * const timeline) {
+    klm_mat_invalidate_frames(seg->matrix);
+
+#ifndef KLM_STATIC
+    // Take a copy of any text still borrowed from the old timeline
+    if (seg->text != seg->_text_owned) {
+        klm_seg_set_text(seg, seg->text);
+    }
+#endif
+
+    seg->timeline = timeline;
+    if (timeline) {
+        klm_timeline_reset(timeline);
+    }
+}
+
+/** Look up glyphs in the given fallback chain rather than the single font_index (NULL to go back) */
+void klm_seg_set_font_chain(klm_segment * const seg, klm_font_chain * const chain) {
+    klm_mat_invalidate_frames(seg->matrix);
+    seg->font_chain = chain;
+    _klm_seg_refresh_glyphs(seg);
+}
+
+/** Draw the text scaled up by an integer factor, up to the config's glyph_cache_max_scale,
+    and in any combination of klm_glyph_style. Without a glyph cache it stays plain */
+void klm_seg_set_text_style(klm_segment * const seg, uint8_t scale, uint8_t style) {
+    const klm_config * const config = seg->matrix->config;
+    const bool cached = (config->glyph_cache_capacity != KLM_GLYPH_CACHE_OFF);
+
+    klm_mat_invalidate_frames(seg->matrix);
+    seg->text_scale = (scale > 0) ? scale : 1;
+    if (seg->text_scale > config->glyph_cache_max_scale || !cached) {
+        seg->text_scale = cached ? config->glyph_cache_max_scale : 1;
+    }
+    seg->text_style = cached ? style : KLM_GLYPH_PLAIN;
+    _klm_seg_refresh_glyphs(seg);
+}
+
+/** Set the colour of the segment's pixels, on panels which have colour */
+void klm_seg_set_colour(klm_segment * const seg, klm_colour colour) {
+    seg->colour = colour;
+    if (seg->matrix->bitplanes == NULL) {
+        return;
+    }
 
-    return;
+    // Colour is applied when the frame is encoded, so any frames rendered ahead are still good
+    klm_bitplanes_fill(seg->matrix->bitplanes,
+                       seg->x, seg->y,
+                       seg->width, seg->height,
+                       klm_bitplanes_add_colour(seg->matrix->bitplanes, colour));
+    seg->matrix->_wire_dirty = true;
 }
 
 /** Clear the text of a particular segment */
@@ -192,6 +323,7 @@ void klm_seg_clear_text(klm_segment * const seg) {
 
 /** Set the animation scroll speed of the segment in pixels per frame */
 void klm_seg_set_text_speed(klm_segment *seg, float hspeed, float vspeed) {
+    klm_mat_invalidate_frames(seg->matrix);
     seg->text_hspeed = hspeed;
     seg->text_vspeed = vspeed;
     seg->_dirty = true;
@@ -199,18 +331,21 @@ void klm_seg_set_text_speed(klm_segment *seg, float hspeed, float vspeed) {
 
 /** Start animation of the given segment */
 void klm_seg_start(klm_segment * const seg) {
+    klm_mat_invalidate_frames(seg->matrix);
     seg->paused = false;
     seg->_dirty = true;
 }
 
 /** Stop animation of the given segment */
 void klm_seg_stop(klm_segment * const seg) {
+    klm_mat_invalidate_frames(seg->matrix);
     seg->paused = true;
     seg->_dirty = true;
 }
 
 /** Set the position of the segment's text */
 void klm_seg_set_text_position(klm_segment * const seg, float text_hpos, float text_vpos) {
+    klm_mat_invalidate_frames(seg->matrix);
     seg->text_hpos = text_hpos;
     seg->text_vpos = text_vpos;
     seg->_dirty = true;
@@ -218,6 +353,7 @@ void klm_seg_set_text_position(klm_segment * const seg, float text_hpos, float t
 
 /** Center the segment's text */
 void klm_seg_center_text(klm_segment * const seg, const bool h, const bool v) {
+    klm_mat_invalidate_frames(seg->matrix);
     if (h) {
         uint16_t pl = klm_seg_get_text_pixel_width(seg);
         seg->text_hpos = -(pl/2 - seg->width/2);
@@ -242,20 +378,29 @@ void klm_seg_query_center_text(klm_segment * const seg, float * h, float *v) {
 
 /** Reverse the segment */
 void klm_seg_reverse(klm_segment * const seg) {
+    klm_mat_invalidate_frames(seg->matrix);
     seg->reverse = !seg->reverse;
 }
 
 /** Render the segment's text */
 void klm_seg_render_text(klm_segment *seg) {
+    if (seg->counter) {
+        klm_counter_render(seg->counter);
+        return;
+    }
+
+    if (seg->multiline) {
+        _klm_seg_render_layout(seg);
+        return;
+    }
+
     uint16_t width_accum = 0;
-    hexfont * const font =
-        hexfont_list_get_nth(seg->matrix->font_list, seg->font_index);
 
     int16_t i;
     for (i=0; i<seg->text_len; i++) {
         int16_t _x = (seg->x + (int16_t)seg->text_hpos + width_accum);
         int16_t _y = (seg->y + (int16_t)seg->text_vpos);
-        hexfont_character * const c = hexfont_get(font, seg->codepoints[i]);
+        hexfont_character * const c = seg->_glyphs[i];
         if (c == NULL) {
             continue;
         }
@@ -272,14 +417,62 @@ void klm_seg_render_text(klm_segment *seg) {
     }
 }
 
+/** Wrap the segment's text over multiple lines, or go back to a single line */
+void klm_seg_set_multiline(klm_segment * const seg, bool multiline, klm_text_align align, uint8_t line_spacing) {
+    klm_mat_invalidate_frames(seg->matrix);
+    seg->multiline = multiline;
+    seg->text_align = align;
+    seg->line_spacing = line_spacing;
+
+    if (multiline) {
+        if (seg->_layout == NULL) {
+            seg->_layout = klm_malloc(sizeof(klm_layout));
+        }
+        _klm_seg_update_layout(seg);
+    }
+
+    seg->_text_pixel_width = klm_seg_get_text_pixel_width(seg);
+    seg->_text_pixel_height = klm_seg_get_text_pixel_height(seg);
+    klm_seg_set_page(seg, 0, false);
+}
+
+/** Show the given page of multi-line text, scrolling to it at the vertical text speed if animate is set */
+void klm_seg_set_page(klm_segment * const seg, uint16_t page, bool animate) {
+    klm_mat_invalidate_frames(seg->matrix);
+    _klm_seg_set_page(seg, page, animate);
+}
+
+/** Automatically advance to the next page after holding each one for hold_ticks (0 to disable) */
+void klm_seg_set_paging(klm_segment * const seg, uint16_t hold_ticks) {
+    klm_mat_invalidate_frames(seg->matrix);
+    seg->page_hold_ticks = hold_ticks;
+    seg->_page_hold = hold_ticks;
+}
+
+/** Number of pages the segment's multi-line text fills */
+uint16_t klm_seg_get_page_count(klm_segment * const seg) {
+    if (!seg->multiline || seg->_layout->line_height >= seg->height) {
+        return seg->multiline ? seg->_layout->line_count : 1;
+    }
+
+    uint16_t lines_per_page = (seg->height + seg->line_spacing) / seg->_layout->line_height;
+    return (seg->_layout->line_count + lines_per_page - 1) / lines_per_page;
+}
+
 uint16_t klm_seg_get_text_pixel_width(klm_segment * const seg) {
+    if (seg->counter) {
+        return klm_counter_get_pixel_width(seg->counter);
+    }
+
+    if (seg->multiline) {
+        return seg->_layout->pixel_width;
+    }
+
     uint16_t ret = 0;
-    hexfont * const font =
-        hexfont_list_get_nth(seg->matrix->font_list, seg->font_index);
 
     int16_t i;
     for (i=0; i<seg->text_len; i++) {
-        hexfont_character * const c = hexfont_get(font, seg->codepoints[i]);
+        hexfont_character * const c = seg->_glyphs[i];
         if (c == NULL) {
             continue;
         }
@@ -291,8 +484,223 @@ uint16_t klm_seg_get_text_pixel_width(klm_segment * const seg) {
 }
 
 uint16_t klm_seg_get_text_pixel_height(klm_segment * const seg) {
+    if (seg->counter) {
+        return seg->counter->cell_height;
+    }
+
+    if (seg->multiline) {
+        return seg->_layout->pixel_height;
+    }
+
+    return _klm_seg_get_glyph_height(seg);
+}
+
+static uint16_t _klm_seg_get_glyph_height(klm_segment * const seg) {
+    if (seg->font_chain == NULL || seg->font_chain->length == 0) {
+        hexfont * const font =
+            hexfont_list_get_nth(seg->matrix->font_list, seg->font_index);
+        return font->glyph_height * seg->text_scale;
+    }
+
+    // Leave room for the tallest font any character might come from
+    uint16_t ret = 0;
+    uint8_t i;
+    for (i=0; i<seg->font_chain->length; i++) {
+        hexfont * const font =
+            hexfont_list_get_nth(seg->matrix->font_list, seg->font_chain->font_indices[i]);
+        if (font->glyph_height > ret) {
+            ret = font->glyph_height;
+        }
+    }
+    return ret * seg->text_scale;
+}
+
+static void _klm_seg_update_text(klm_segment * const seg, const char * const text) {
+    //[TODO: should the codepoints buffer by dynamically allocated?]
+    seg->text_len = tinyutf8_strlen(text);
+    if (seg->text_len > KLM_TEXT_LEN) {
+        seg->text_len = KLM_TEXT_LEN;
+    }
+
+    // Decompose the text into codepoints
+    size_t i=0, cnt=0;
+    while (cnt < seg->text_len) {
+#ifdef KLM_STATIC
+        size_t start = i;
+#endif
+        uint32_t codepoint = tinyutf8_next_codepoint(text, &i);
+#ifdef KLM_STATIC
+        // Only whole characters are kept, so the text buffer is never cut mid-sequence
+        if (i > KLM_TEXT_BYTES - 1) {
+            i = start;
+            break;
+        }
+
+        // Codepoints are 16 bits here, anything past the BMP is shown as U+FFFD
+        if (codepoint > 0xffff) {
+            codepoint = 0xfffd;
+        }
+#endif
+        seg->codepoints[cnt] = codepoint;
+        cnt++;
+    }
+    seg->text_len = cnt;
+
+    // Keep the original text
+#ifdef KLM_STATIC
+    memmove(seg->_text_buffer, text, i);
+    seg->_text_buffer[i] = '\0';
+#else
+    seg->text = text;
+#endif
+
+    // Find each character's font now, so that rendering doesn't have to
+    _klm_seg_resolve_glyphs(seg);
+
+    // Work out the line breaks once, rather than on every tick
+    if (seg->multiline) {
+        _klm_seg_update_layout(seg);
+    }
+
+    seg->_text_pixel_width = klm_seg_get_text_pixel_width(seg);
+    seg->_text_pixel_height = klm_seg_get_text_pixel_height(seg);
+    seg->_dirty = true;
+}
+
+static void _klm_seg_resolve_glyphs(klm_segment * const seg) {
     hexfont * const font =
         hexfont_list_get_nth(seg->matrix->font_list, seg->font_index);
 
-    return font->glyph_height;
+    // Hand back the styled glyphs for the old text, including any past its end
+    size_t i;
+    for (i=0; i<KLM_TEXT_LEN; i++) {
+        klm_mat_release_glyph(seg->matrix, seg->_glyphs[i]);
+        seg->_glyphs[i] = NULL;
+    }
+
+    for (i=0; i<seg->text_len; i++) {
+        // Characters missing from every font in the chain are skipped
+        hexfont_character * const c = seg->font_chain ?
+                            klm_font_chain_get(seg->font_chain, seg->codepoints[i], NULL) :
+                            hexfont_get(font, seg->codepoints[i]);
+
+        // Styled text is drawn from ready made variants, just like plain text
+        seg->_glyphs[i] =
+            klm_mat_get_styled_glyph(seg->matrix, c, seg->text_scale, seg->text_style);
+    }
+}
+
+static void _klm_seg_refresh_glyphs(klm_segment * const seg) {
+    _klm_seg_resolve_glyphs(seg);
+    if (seg->counter) {
+        klm_counter_refresh(seg->counter);
+    }
+    if (seg->multiline) {
+        _klm_seg_update_layout(seg);
+    }
+
+    seg->_text_pixel_width = klm_seg_get_text_pixel_width(seg);
+    seg->_text_pixel_height = klm_seg_get_text_pixel_height(seg);
+    seg->_dirty = true;
+}
+
+static void _klm_seg_update_layout(klm_segment * const seg) {
+    klm_layout_compute(seg->_layout,
+                       seg->_glyphs,
+                       _klm_seg_get_glyph_height(seg),
+                       seg->codepoints,
+                       seg->text_len,
+                       seg->width,
+                       seg->text_align,
+                       seg->line_spacing,
+                       KLM_CHARACTER_SPACING);
+
+    // The page boundaries may have moved
+    _klm_seg_set_page(seg,
+                     (seg->page < klm_seg_get_page_count(seg)) ? seg->page : 0,
+                     false);
+}
+
+static void _klm_seg_set_page(klm_segment * const seg, uint16_t page, bool animate) {
+    uint16_t page_count = klm_seg_get_page_count(seg);
+    if (page >= page_count) {
+        page = page_count - 1;
+    }
+
+    uint16_t lines_per_page = 1;
+    if (seg->multiline && seg->_layout->line_height < seg->height) {
+        lines_per_page = (seg->height + seg->line_spacing) / seg->_layout->line_height;
+    }
+
+    // Wrapping back to the start scrolls the first page in from below
+    if (animate && page < seg->page && page == 0) {
+        seg->text_vpos = seg->height;
+    }
+
+    seg->page = page;
+    seg->_page_vpos = seg->multiline ?
+                        -(float)(page * lines_per_page * seg->_layout->line_height) : 0;
+    if (!animate) {
+        seg->text_vpos = seg->_page_vpos;
+    }
+    seg->_page_hold = seg->page_hold_ticks;
+    seg->_dirty = true;
+}
+
+static void _klm_seg_tick_page(klm_segment * const seg) {
+    // Move towards the current page at the vertical text speed
+    if (seg->text_vpos != seg->_page_vpos) {
+        float step = fabsf(seg->text_vspeed);
+        float distance = seg->_page_vpos - seg->text_vpos;
+
+        if (step == 0 || fabsf(distance) <= step) {
+            seg->text_vpos = seg->_page_vpos;
+        }
+        else {
+            seg->text_vpos += (distance > 0) ? step : -step;
+        }
+        seg->_page_hold = seg->page_hold_ticks;
+        return;
+    }
+
+    // Hold the page for a while, then move on to the next
+    if (seg->page_hold_ticks > 0) {
+        if (seg->_page_hold > 0) {
+            seg->_page_hold--;
+        }
+        else {
+            _klm_seg_set_page(seg,
+                              (seg->page + 1) % klm_seg_get_page_count(seg),
+                              true);
+        }
+    }
 }
+
+static void _klm_seg_render_layout(klm_segment * const seg) {
+    klm_layout * const layout = seg->_layout;
+    int16_t x0 = seg->x + (int16_t)seg->text_hpos;
+    int16_t y0 = seg->y + (int16_t)seg->text_vpos;
+
+    uint16_t l, i;
+    for (l=0; l<layout->line_count; l++) {
+        // Skip whole lines which are outside the segment
+        int16_t ly = y0 + l * layout->line_height;
+        if (ly >= seg->y + seg->height || ly + layout->line_height <= seg->y) {
+            continue;
+        }
+
+        for (i=layout->line_start[l]; i<layout->line_end[l]; i++) {
+            klm_layout_glyph * const g = &layout->glyphs[i];
+            if (g->c == NULL) {
+                continue;
+            }
+
+            klm_mat_render_sprite(seg->matrix,
+                                  g->c,
+                                  x0 + g->x, y0 + g->y,
+                                  seg->x, seg->y,
+                                  seg->x + seg->width, seg->y + seg->height);
+        }
+    }
+}
+
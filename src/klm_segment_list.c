@@ -25,11 +25,15 @@
 #include <string.h>
 #include "klm_segment.h"
 #include "klm_segment_list.h"
+#include "klm_alloc.h"
 
 
 klm_segment_list * const klm_segment_list_create(klm_segment * const item) {
     // Allocate memory for the head element
-    klm_segment_list * const list = malloc(sizeof(klm_segment_list));
+    klm_segment_list * const list = klm_malloc(sizeof(klm_segment_list));
+    if (list == NULL) {
+        return NULL;
+    }
 
     list->item = item;
     list->next = NULL;
@@ -48,10 +52,10 @@ void klm_segment_list_destroy(klm_segment_list * const head) {
         iter = iter->next;
 
         klm_seg_destroy(tmp->item);
-        free(tmp);
+        klm_free(tmp);
     }
     klm_seg_destroy(iter->item);
-    free(iter);
+    klm_free(iter);
 }
 
 void klm_segment_list_append(klm_segment_list * const head, klm_segment * const new_item) {
@@ -72,6 +76,25 @@ void klm_segment_list_append(klm_segment_list * const head, klm_segment * const
     }
 }
 
+klm_segment_list * const klm_segment_list_remove(klm_segment_list * const head, klm_segment * const item) {
+    // Unlink the segment without destroying it, which may leave the list empty
+    klm_segment_list *prev = NULL;
+    klm_segment_list *iter;
+    for (iter=head; iter!=NULL; iter=iter->next) {
+        if (iter->item == item) {
+            klm_segment_list * const next = iter->next;
+            klm_free(iter);
+            if (prev == NULL) {
+                return next;
+            }
+            prev->next = next;
+            return head;
+        }
+        prev = iter;
+    }
+    return head;
+}
+
 uint16_t klm_segment_list_get_length(klm_segment_list * const head) {
     if (head == NULL) {
         return 0;
@@ -0,0 +1,355 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "klm_snapshot.h"
+#include "klm_matrix.h"
+#include "klm_segment.h"
+#include "klm_segment_list.h"
+#include "klm_alloc.h"
+
+// How many torn copies a reader puts up with before giving up
+#define KLM_SNAPSHOT_READ_RETRIES 1000
+
+#define KLM_SNAPSHOT_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+static __klm_snapshot_slot_t * _klm_snapshot_get_slot(klm_snapshot * const snapshot, int index);
+static __klm_snapshot_seg_t * _klm_snapshot_get_segs(__klm_snapshot_slot_t * const slot);
+static uint8_t * _klm_snapshot_get_buffer(klm_snapshot * const snapshot, __klm_snapshot_slot_t * const slot);
+static void _klm_snapshot_save_seg(__klm_snapshot_seg_t * const rec, klm_segment * const seg);
+static void _klm_snapshot_load_seg(__klm_snapshot_seg_t * const rec, klm_segment * const seg);
+static bool _klm_snapshot_is_current(klm_snapshot * const snapshot, klm_matrix * const matrix);
+static bool _klm_snapshot_read(klm_snapshot * const snapshot, void * const dst, size_t offset, size_t len);
+
+
+/** Open the snapshot file at path, starting a fresh one if it doesn't match the given dimensions */
+klm_snapshot * const klm_snapshot_open(const char *path,
+                                       uint16_t width,
+                                       uint16_t height,
+                                       uint16_t max_segments)
+{
+    size_t buffer_len = KLM_BUFFER_LEN(width, height);
+    size_t slot_size =
+        KLM_SNAPSHOT_ALIGN(sizeof(__klm_snapshot_slot_t) +
+                           max_segments * sizeof(__klm_snapshot_seg_t) +
+                           buffer_len);
+    size_t size = KLM_SNAPSHOT_ALIGN(sizeof(__klm_snapshot_header_t)) + 2*slot_size;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    // A file of the wrong size can't be one of ours
+    struct stat st;
+    bool fresh = (fstat(fd, &st) < 0 || (size_t)st.st_size != size);
+    if (fresh && ftruncate(fd, size) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    klm_snapshot * const snapshot = klm_malloc(sizeof(klm_snapshot));
+    snapshot->fd = fd;
+    snapshot->size = size;
+    snapshot->update_count = 0;
+    snapshot->write_count = 0;
+    snapshot->_header = map;
+    snapshot->_buffer_len = buffer_len;
+
+    __klm_snapshot_header_t * const header = snapshot->_header;
+    if (fresh ||
+        header->magic != KLM_SNAPSHOT_MAGIC ||
+        header->version != KLM_SNAPSHOT_VERSION ||
+        header->width != width ||
+        header->height != height ||
+        header->max_segments != max_segments ||
+        header->slot_size != (uint32_t)slot_size)
+    {
+        // Start again with no snapshot
+        memset(map, 0, size);
+        header->magic = KLM_SNAPSHOT_MAGIC;
+        header->version = KLM_SNAPSHOT_VERSION;
+        header->width = width;
+        header->height = height;
+        header->max_segments = max_segments;
+        header->slot_size = slot_size;
+        atomic_store(&header->current, -1);
+    }
+    else {
+        // A writer which crashed mid-update leaves its slot odd, and never the current one
+        for (int i = 0; i < 2; i++) {
+            __klm_snapshot_slot_t * const slot = _klm_snapshot_get_slot(snapshot, i);
+            atomic_fetch_and(&slot->sequence, ~1u);
+        }
+    }
+
+    return snapshot;
+}
+
+/** Flush the snapshot to disk and close it */
+void klm_snapshot_close(klm_snapshot * const snapshot) {
+    msync(snapshot->_header, snapshot->size, MS_SYNC);
+    munmap(snapshot->_header, snapshot->size);
+    close(snapshot->fd);
+    klm_free(snapshot);
+}
+
+/** Whether the file holds a complete snapshot to restore from */
+bool klm_snapshot_is_valid(klm_snapshot * const snapshot) {
+    return (atomic_load_explicit(&snapshot->_header->current, memory_order_acquire) >= 0);
+}
+
+/** Save any of the matrix's state which differs from the snapshot */
+void klm_snapshot_update(klm_snapshot * const snapshot, klm_matrix * const matrix) {
+    snapshot->update_count++;
+
+    // Most ticks of a static display change nothing
+    if (_klm_snapshot_is_current(snapshot, matrix)) {
+        return;
+    }
+
+    // Write over the older of the two copies
+    int current = atomic_load_explicit(&snapshot->_header->current, memory_order_relaxed);
+    int target = (current == 0) ? 1 : 0;
+    __klm_snapshot_slot_t * const slot = _klm_snapshot_get_slot(snapshot, target);
+    __klm_snapshot_seg_t * const recs = _klm_snapshot_get_segs(slot);
+
+    // Mark the slot as being written, for any reader in another process
+    // forcing it odd, in case an earlier writer died part way through
+    unsigned seq = atomic_load_explicit(&slot->sequence, memory_order_relaxed) | 1;
+    atomic_store_explicit(&slot->sequence, seq, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    // Only touch the records which differ from what the slot already holds
+    __klm_snapshot_seg_t rec;
+    uint16_t n = 0;
+    klm_segment_list *iter = matrix->segment_list;
+    while (iter && n < snapshot->_header->max_segments) {
+        if (iter->item) {
+            _klm_snapshot_save_seg(&rec, iter->item);
+            if (n >= slot->segment_count || memcmp(&recs[n], &rec, sizeof(rec)) != 0) {
+                recs[n] = rec;
+                snapshot->write_count++;
+            }
+            n++;
+        }
+        iter = iter->next;
+    }
+    slot->segment_count = n;
+
+    uint8_t * const buffer = _klm_snapshot_get_buffer(snapshot, slot);
+    if (memcmp(buffer, matrix->display_buffer1, snapshot->_buffer_len) != 0) {
+        memcpy(buffer, matrix->display_buffer1, snapshot->_buffer_len);
+        snapshot->write_count++;
+    }
+
+    // Complete, then make it the current snapshot
+    atomic_store_explicit(&slot->sequence, seq + 1, memory_order_release);
+    atomic_store_explicit(&snapshot->_header->current, target, memory_order_release);
+}
+
+/** Copy the saved front buffer into buffer, returns false if there is no snapshot or the writer holds it */
+bool klm_snapshot_read_frame(klm_snapshot * const snapshot, uint8_t * const buffer) {
+    return _klm_snapshot_read(snapshot,
+                              buffer,
+                              sizeof(__klm_snapshot_slot_t) +
+                              snapshot->_header->max_segments * sizeof(__klm_snapshot_seg_t),
+                              snapshot->_buffer_len);
+}
+
+/** Put the saved frame on display straight away, before any fonts or segments exist */
+bool klm_snapshot_restore_frame(klm_snapshot * const snapshot, klm_matrix * const matrix) {
+    if (!klm_snapshot_read_frame(snapshot, matrix->display_buffer1)) {
+        return false;
+    }
+
+    matrix->_wire_dirty = true;
+    klm_mat_encode_wire(matrix);
+    return true;
+}
+
+/**
+ * Restore the saved segments, once the matrix has its fonts. If the matrix
+ * has no segments they are created, otherwise the existing ones are updated in order.
+ */
+bool klm_snapshot_restore_segments(klm_snapshot * const snapshot, klm_matrix * const matrix) {
+    uint16_t count;
+    if (!_klm_snapshot_read(snapshot, &count,
+                            offsetof(__klm_snapshot_slot_t, segment_count), sizeof(count)))
+    {
+        return false;
+    }
+
+    uint16_t n;
+    for (n=0; n<count; n++) {
+        __klm_snapshot_seg_t rec;
+        if (!_klm_snapshot_read(snapshot, &rec,
+                                sizeof(__klm_snapshot_slot_t) + n*sizeof(rec), sizeof(rec)))
+        {
+            return false;
+        }
+
+        klm_segment *seg = klm_segment_list_get_nth(matrix->segment_list, n);
+        if (seg == NULL) {
+            seg = klm_seg_create(matrix, rec.x, rec.y, rec.width, rec.height, rec.font_index);
+            if (matrix->segment_list == NULL) {
+                matrix->segment_list = klm_segment_list_create(seg);
+            }
+            else {
+                klm_segment_list_append(matrix->segment_list, seg);
+            }
+        }
+        _klm_snapshot_load_seg(&rec, seg);
+    }
+    return true;
+}
+
+static __klm_snapshot_slot_t * _klm_snapshot_get_slot(klm_snapshot * const snapshot, int index) {
+    return (__klm_snapshot_slot_t *)
+                ((uint8_t *)snapshot->_header +
+                 KLM_SNAPSHOT_ALIGN(sizeof(__klm_snapshot_header_t)) +
+                 index * snapshot->_header->slot_size);
+}
+
+static __klm_snapshot_seg_t * _klm_snapshot_get_segs(__klm_snapshot_slot_t * const slot) {
+    return (__klm_snapshot_seg_t *)(slot + 1);
+}
+
+static uint8_t * _klm_snapshot_get_buffer(klm_snapshot * const snapshot, __klm_snapshot_slot_t * const slot) {
+    return (uint8_t *)(_klm_snapshot_get_segs(slot) + snapshot->_header->max_segments);
+}
+
+static void _klm_snapshot_save_seg(__klm_snapshot_seg_t * const rec, klm_segment * const seg) {
+    // Zero everything first, so that records can be compared byte for byte
+    memset(rec, 0, sizeof(*rec));
+
+    rec->x = seg->x;
+    rec->y = seg->y;
+    rec->width = seg->width;
+    rec->height = seg->height;
+    rec->font_index = seg->font_index;
+    rec->visible = seg->visible;
+    rec->paused = seg->paused;
+    rec->reverse = seg->reverse;
+    rec->multiline = seg->multiline;
+    rec->text_align = seg->text_align;
+    rec->line_spacing = seg->line_spacing;
+    rec->page = seg->page;
+    rec->page_hold_ticks = seg->page_hold_ticks;
+    rec->text_hspeed = seg->text_hspeed;
+    rec->text_vspeed = seg->text_vspeed;
+    rec->text_hpos = seg->text_hpos;
+    rec->text_vpos = seg->text_vpos;
+    if (seg->text) {
+        strncpy(rec->text, seg->text, KLM_SNAPSHOT_TEXT_BYTES - 1);
+    }
+}
+
+static void _klm_snapshot_load_seg(__klm_snapshot_seg_t * const rec, klm_segment * const seg) {
+    rec->text[KLM_SNAPSHOT_TEXT_BYTES - 1] = '\0';
+
+    klm_seg_set_multiline(seg, rec->multiline, rec->text_align, rec->line_spacing);
+    klm_seg_set_text(seg, rec->text);
+    klm_seg_set_paging(seg, rec->page_hold_ticks);
+    if (rec->multiline) {
+        klm_seg_set_page(seg, rec->page, false);
+    }
+
+    // Pick up exactly where it left off
+    klm_seg_set_text_speed(seg, rec->text_hspeed, rec->text_vspeed);
+    klm_seg_set_text_position(seg, rec->text_hpos, rec->text_vpos);
+
+    seg->paused = rec->paused;
+    seg->reverse = rec->reverse;
+    seg->visible = rec->visible;
+}
+
+static bool _klm_snapshot_is_current(klm_snapshot * const snapshot, klm_matrix * const matrix) {
+    int current = atomic_load_explicit(&snapshot->_header->current, memory_order_relaxed);
+    if (current < 0) {
+        return false;
+    }
+
+    __klm_snapshot_slot_t * const slot = _klm_snapshot_get_slot(snapshot, current);
+    __klm_snapshot_seg_t * const recs = _klm_snapshot_get_segs(slot);
+
+    if (memcmp(_klm_snapshot_get_buffer(snapshot, slot),
+               matrix->display_buffer1,
+               snapshot->_buffer_len) != 0)
+    {
+        return false;
+    }
+
+    __klm_snapshot_seg_t rec;
+    uint16_t n = 0;
+    klm_segment_list *iter = matrix->segment_list;
+    while (iter && n < snapshot->_header->max_segments) {
+        if (iter->item) {
+            _klm_snapshot_save_seg(&rec, iter->item);
+            if (n >= slot->segment_count || memcmp(&recs[n], &rec, sizeof(rec)) != 0) {
+                return false;
+            }
+            n++;
+        }
+        iter = iter->next;
+    }
+    return (n == slot->segment_count);
+}
+
+static bool _klm_snapshot_read(klm_snapshot * const snapshot, void * const dst, size_t offset, size_t len) {
+    for (int retry = 0; retry < KLM_SNAPSHOT_READ_RETRIES; retry++) {
+        int current = atomic_load_explicit(&snapshot->_header->current, memory_order_acquire);
+        if (current < 0) {
+            return false;
+        }
+
+        // Retry if the writer was busy with the slot while it was being copied
+        __klm_snapshot_slot_t * const slot = _klm_snapshot_get_slot(snapshot, current);
+        unsigned seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+
+        memcpy(dst, (uint8_t *)slot + offset, len);
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) == seq) {
+            return true;
+        }
+    }
+
+    // The writer never let go of the slot
+    return false;
+}
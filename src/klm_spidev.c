@@ -0,0 +1,152 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/spi/spidev.h>
+
+#include "klm_spidev.h"
+#include "klm_alloc.h"
+
+static klm_spidev * const _klm_spidev_create(int fd, uint32_t speed_hz, bool fake);
+static bool _klm_spidev_write_all(int fd, const uint8_t *buf, size_t len);
+
+
+/** Open the given spidev device. Returns NULL if it isn't one */
+klm_spidev * const klm_spidev_create(const char * const path, uint32_t speed_hz) {
+    // A mistyped device path must not turn into a file of its own
+    int fd = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISCHR(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+
+    // Configure the bus: mode 0, 8 bit words, MSB first
+    uint8_t mode = SPI_MODE_0;
+    uint8_t bits = 8;
+    if (ioctl(fd, SPI_IOC_WR_MODE, &mode) < 0 ||
+        ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+        ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed_hz) < 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    return _klm_spidev_create(fd, speed_hz, false);
+}
+
+/** Open a stand-in which receives the bytes as-is, creating or emptying path if it is a plain file */
+klm_spidev * const klm_spidev_create_stand_in(const char * const path) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_NOCTTY | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    return _klm_spidev_create(fd, 0, true);
+}
+
+/** Close the device and clean up */
+void klm_spidev_destroy(klm_spidev * const spi) {
+    close(spi->fd);
+    klm_free(spi);
+}
+
+/** Send a buffer in a single transfer */
+bool klm_spidev_transfer(klm_spidev * const spi, const uint8_t * const buf, size_t len) {
+    return klm_spidev_transfer_rows(spi, buf, len, 1);
+}
+
+/** Send a number of rows of stride bytes each, with one transfer per row batched into one ioctl */
+bool klm_spidev_transfer_rows(klm_spidev * const spi,
+                              const uint8_t * const buf,
+                              size_t stride,
+                              uint16_t n_rows)
+{
+    if (spi->_fake) {
+        // A stand-in receives exactly the bytes which would go on the wire
+        spi->transfer_count++;
+        spi->byte_count += stride * n_rows;
+        return _klm_spidev_write_all(spi->fd, buf, stride * n_rows);
+    }
+
+    struct spi_ioc_transfer xfer[KLM_SPIDEV_MAX_TRANSFERS];
+    uint16_t row = 0;
+    while (row < n_rows) {
+        uint16_t n = n_rows - row;
+        if (n > KLM_SPIDEV_MAX_TRANSFERS) {
+            n = KLM_SPIDEV_MAX_TRANSFERS;
+        }
+
+        memset(xfer, 0, n * sizeof(*xfer));
+
+        uint16_t i;
+        for (i=0; i<n; i++) {
+            xfer[i].tx_buf = (unsigned long)(buf + (row + i)*stride);
+            xfer[i].len = stride;
+            xfer[i].speed_hz = spi->speed_hz;
+            xfer[i].bits_per_word = 8;
+        }
+
+        if (ioctl(spi->fd, SPI_IOC_MESSAGE(n), xfer) < 0) {
+            return false;
+        }
+
+        spi->transfer_count++;
+        spi->byte_count += stride * n;
+        row += n;
+    }
+    return true;
+}
+
+static klm_spidev * const _klm_spidev_create(int fd, uint32_t speed_hz, bool fake) {
+    // Allocate memory for the spidev structure and initialize all members
+    klm_spidev * const spi = klm_malloc(sizeof(klm_spidev));
+
+    spi->fd = fd;
+    spi->speed_hz = speed_hz;
+    spi->transfer_count = 0;
+    spi->byte_count = 0;
+    spi->_fake = fake;
+
+    return spi;
+}
+
+static bool _klm_spidev_write_all(int fd, const uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
@@ -0,0 +1,299 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include "klm_sync.h"
+#include "klm_pacer.h"
+#include "klm_alloc.h"
+
+#define KLM_SYNC_POLL_NANOS 1000000
+
+static __klm_sync_shared_t * _klm_sync_join(int fd);
+static void _klm_sync_init(__klm_sync_shared_t * const shared,
+                           uint16_t canvas_width,
+                           uint32_t tick_period_micros,
+                           const char * const boot_id);
+static bool _klm_sync_is_stale(__klm_sync_shared_t * const shared, const char * const boot_id);
+static void _klm_sync_get_boot_id(char * const boot_id);
+static int64_t _klm_sync_get_clock_frame(klm_sync * const sync);
+
+
+/** Join the sign's sync file at path, creating it with the given canvas width and frame period if this is the first controller */
+klm_sync * const klm_sync_open(const char *path,
+                               uint16_t canvas_width,
+                               uint32_t tick_period_micros,
+                               int16_t offset_x)
+{
+    // Exactly one controller gets to create the file and set the epoch
+    bool creator = true;
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        creator = false;
+        fd = open(path, O_RDWR | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        return NULL;
+    }
+
+    char boot_id[KLM_SYNC_BOOT_ID_LEN];
+    _klm_sync_get_boot_id(boot_id);
+
+    __klm_sync_shared_t *shared = NULL;
+    if (creator) {
+        if (ftruncate(fd, sizeof(__klm_sync_shared_t)) == 0) {
+            void *map = mmap(NULL, sizeof(__klm_sync_shared_t),
+                             PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (map != MAP_FAILED) {
+                shared = map;
+                _klm_sync_init(shared, canvas_width, tick_period_micros, boot_id);
+
+                // Publish the fields above to the other controllers
+                atomic_store_explicit(&shared->ready, 1, memory_order_release);
+            }
+        }
+    }
+    else {
+        shared = _klm_sync_join(fd);
+
+        // The epoch of a file from before a reboot is meaningless now. Only
+        // one joining controller at a time may check it and start it again
+        if (shared && flock(fd, LOCK_EX) == 0) {
+            if (_klm_sync_is_stale(shared, boot_id)) {
+                _klm_sync_init(shared, canvas_width, tick_period_micros, boot_id);
+            }
+            flock(fd, LOCK_UN);
+        }
+    }
+
+    if (shared == NULL) {
+        // Don't leave a half made file for the other controllers to wait on
+        if (creator) {
+            unlink(path);
+        }
+        close(fd);
+        return NULL;
+    }
+
+    // Allocate memory for the sync structure and initialize all members
+    klm_sync * const sync = klm_malloc(sizeof(klm_sync));
+    sync->fd = fd;
+    sync->offset_x = offset_x;
+    sync->frame_count = 0;
+    sync->skip_count = 0;
+    sync->_shared = shared;
+    sync->_last_frame = 0;
+
+    return sync;
+}
+
+/** Leave the sync file. The file is left for the other controllers */
+void klm_sync_close(klm_sync * const sync) {
+    munmap(sync->_shared, sizeof(__klm_sync_shared_t));
+    close(sync->fd);
+    klm_free(sync);
+}
+
+/** The frame due on display now, or the latest frame any controller has shown if that is later */
+uint32_t klm_sync_get_frame(klm_sync * const sync) {
+    uint32_t frame = (uint32_t)_klm_sync_get_clock_frame(sync);
+
+    // Another controller may have crossed the frame boundary a moment before us
+    uint32_t heartbeat =
+        atomic_load_explicit(&sync->_shared->heartbeat, memory_order_acquire);
+    if (heartbeat > frame) {
+        frame = heartbeat;
+    }
+
+    // Keep count of frames which went by without this controller showing them
+    if (sync->frame_count > 0 && frame > sync->_last_frame + 1) {
+        sync->skip_count += frame - sync->_last_frame - 1;
+    }
+    sync->frame_count++;
+    sync->_last_frame = frame;
+
+    return frame;
+}
+
+/** CLOCK_MONOTONIC time at which the given frame is due */
+int64_t klm_sync_get_frame_nanos(klm_sync * const sync, uint32_t frame) {
+    return sync->_shared->epoch_nanos + (int64_t)frame * sync->_shared->period_nanos;
+}
+
+/** CLOCK_MONOTONIC time at which the next frame is due */
+int64_t klm_sync_get_next_frame_nanos(klm_sync * const sync) {
+    return klm_sync_get_frame_nanos(sync, (uint32_t)(_klm_sync_get_clock_frame(sync) + 1));
+}
+
+/** Block until the start of the next frame, and return its number */
+uint32_t klm_sync_wait_frame(klm_sync * const sync) {
+    uint32_t frame = (uint32_t)(_klm_sync_get_clock_frame(sync) + 1);
+    int64_t deadline = klm_sync_get_frame_nanos(sync, frame);
+
+    struct timespec t;
+    t.tv_sec = deadline / KLM_ONE_BILLION;
+    t.tv_nsec = deadline % KLM_ONE_BILLION;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR);
+
+    return frame;
+}
+
+/** Let the other controllers know that the given frame is on display */
+void klm_sync_beat(klm_sync * const sync, uint32_t frame) {
+    // The heartbeat only moves forwards, whichever controller gets there first
+    unsigned heartbeat =
+        atomic_load_explicit(&sync->_shared->heartbeat, memory_order_relaxed);
+    while (heartbeat < frame &&
+           !atomic_compare_exchange_weak_explicit(&sync->_shared->heartbeat,
+                                                  &heartbeat,
+                                                  frame,
+                                                  memory_order_release,
+                                                  memory_order_relaxed));
+}
+
+/** Where text scrolling at hspeed should be in the given frame, relative to a segment at seg_x */
+float klm_sync_get_text_hpos(klm_sync * const sync,
+                             uint32_t frame,
+                             float hspeed,
+                             int16_t text_width,
+                             int16_t seg_x)
+{
+    // Text enters at one edge of the canvas and leaves at the other,
+    // then starts again, so its position repeats every period pixels
+    double canvas_width = sync->_shared->canvas_width;
+    double period = canvas_width + text_width;
+    double phase = fmod(fabs((double)hspeed) * frame, period);
+
+    double hpos = (hspeed < 0) ? canvas_width - phase : phase - text_width;
+
+    // From canvas coordinates to the segment's own
+    return (float)(hpos - sync->offset_x - seg_x);
+}
+
+static __klm_sync_shared_t * _klm_sync_join(int fd) {
+    struct timespec poll;
+    poll.tv_sec = 0;
+    poll.tv_nsec = KLM_SYNC_POLL_NANOS;
+
+    // The creator may not have sized or filled in the file yet
+    __klm_sync_shared_t *shared = NULL;
+    int i;
+    for (i=0; i<KLM_SYNC_JOIN_TIMEOUT_MILLIS; i++) {
+        struct stat st;
+        if (shared == NULL &&
+            fstat(fd, &st) == 0 &&
+            (size_t)st.st_size >= sizeof(__klm_sync_shared_t))
+        {
+            void *map = mmap(NULL, sizeof(__klm_sync_shared_t),
+                             PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) {
+                return NULL;
+            }
+            shared = map;
+        }
+
+        if (shared && atomic_load_explicit(&shared->ready, memory_order_acquire)) {
+            if (shared->magic != KLM_SYNC_MAGIC ||
+                shared->version != KLM_SYNC_VERSION ||
+                shared->period_nanos <= 0)
+            {
+                break;
+            }
+            return shared;
+        }
+
+        nanosleep(&poll, NULL);
+    }
+
+    // Left over from a controller which died part way through creating it,
+    // or not one of ours
+    if (shared) {
+        munmap(shared, sizeof(__klm_sync_shared_t));
+    }
+    return NULL;
+}
+
+static void _klm_sync_init(__klm_sync_shared_t * const shared,
+                           uint16_t canvas_width,
+                           uint32_t tick_period_micros,
+                           const char * const boot_id)
+{
+    shared->magic = KLM_SYNC_MAGIC;
+    shared->version = KLM_SYNC_VERSION;
+    shared->epoch_nanos = klm_pacer_now_nanos();
+    shared->period_nanos = (int64_t)tick_period_micros * 1000LL;
+    shared->canvas_width = canvas_width;
+    memcpy(shared->boot_id, boot_id, KLM_SYNC_BOOT_ID_LEN);
+    atomic_store_explicit(&shared->heartbeat, 0, memory_order_release);
+}
+
+static bool _klm_sync_is_stale(__klm_sync_shared_t * const shared, const char * const boot_id) {
+    if (memcmp(shared->boot_id, boot_id, KLM_SYNC_BOOT_ID_LEN) != 0) {
+        return true;
+    }
+
+    // Without a boot id to go on, an epoch in the future or a heartbeat
+    // well ahead of the clock can only have come from an earlier boot
+    int64_t now = klm_pacer_now_nanos();
+    if (shared->epoch_nanos > now) {
+        return true;
+    }
+
+    int64_t frame = (now - shared->epoch_nanos) / shared->period_nanos;
+    unsigned heartbeat = atomic_load_explicit(&shared->heartbeat, memory_order_acquire);
+    return ((int64_t)heartbeat > frame + KLM_SYNC_MAX_LEAD_FRAMES);
+}
+
+static void _klm_sync_get_boot_id(char * const boot_id) {
+    // Left empty where the kernel doesn't say, then only the clock checks apply
+    memset(boot_id, 0, KLM_SYNC_BOOT_ID_LEN);
+
+    int fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    ssize_t len = read(fd, boot_id, KLM_SYNC_BOOT_ID_LEN - 1);
+    close(fd);
+
+    // Drop the trailing newline
+    if (len > 0 && boot_id[len - 1] == '\n') {
+        boot_id[len - 1] = '\0';
+    }
+}
+
+static int64_t _klm_sync_get_clock_frame(klm_sync * const sync) {
+    int64_t elapsed = klm_pacer_now_nanos() - sync->_shared->epoch_nanos;
+    if (elapsed < 0) {
+        return 0;
+    }
+    return elapsed / sync->_shared->period_nanos;
+}
+
@@ -0,0 +1,350 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "klm_timeline.h"
+#include "klm_segment.h"
+#include "klm_matrix.h"
+#include "klm_alloc.h"
+
+static void _klm_timeline_start_key(klm_timeline * const timeline, klm_keyframe * const key);
+static bool _klm_timeline_next_key(klm_timeline * const timeline);
+static float _klm_timeline_resolve(klm_anchor anchor, float pos, float current,
+                                   uint16_t size, uint16_t text_size);
+static float _klm_timeline_ease(klm_easing easing, float t);
+static void _klm_timeline_invalidate(klm_timeline * const timeline);
+
+
+/** Create an empty timeline for the given segment, played repeat times or KLM_TIMELINE_LOOP */
+klm_timeline * const klm_timeline_create(klm_segment * const seg, uint16_t repeat) {
+    klm_timeline * const timeline = klm_malloc(sizeof(klm_timeline));
+
+    timeline->segment = seg;
+    timeline->repeat = repeat;
+
+    timeline->_keys = klm_calloc(KLM_TIMELINE_INITIAL_KEYS, sizeof(klm_keyframe));
+    timeline->_key_count = 0;
+    timeline->_key_capacity = KLM_TIMELINE_INITIAL_KEYS;
+    timeline->_base_text = NULL;
+
+    memset(&timeline->state, 0, sizeof(timeline->state));
+    timeline->state.text_key = -1;
+
+    return timeline;
+}
+
+/** Clean up a timeline, and detach it from its segment */
+void klm_timeline_destroy(klm_timeline * const timeline) {
+    klm_segment * const seg = timeline->segment;
+    if (seg->timeline == timeline) {
+        klm_seg_set_timeline(seg, NULL);
+    }
+
+    uint16_t i;
+    for (i=0; i<timeline->_key_count; i++) {
+        klm_free(timeline->_keys[i].text);
+    }
+    klm_free(timeline->_keys);
+    klm_free(timeline->_base_text);
+    klm_free(timeline);
+}
+
+/** Add a keyframe. Any text is copied */
+void klm_timeline_add_key(klm_timeline * const timeline, const klm_keyframe * const key) {
+    _klm_timeline_invalidate(timeline);
+
+    if (timeline->_key_count == timeline->_key_capacity) {
+        klm_keyframe * const keys =
+            klm_calloc(timeline->_key_capacity * 2, sizeof(klm_keyframe));
+        memcpy(keys, timeline->_keys, timeline->_key_count * sizeof(klm_keyframe));
+        klm_free(timeline->_keys);
+        timeline->_keys = keys;
+        timeline->_key_capacity *= 2;
+    }
+
+    klm_keyframe * const _key = &timeline->_keys[timeline->_key_count++];
+    *_key = *key;
+    _key->text = NULL;
+    if ((key->flags & KLM_KEY_TEXT) && key->text) {
+        _key->text = klm_strdup(key->text);
+    }
+}
+
+/** Add a keyframe which moves the text to the given position over duration ticks */
+void klm_timeline_move(klm_timeline * const timeline,
+                       uint16_t duration,
+                       klm_easing easing,
+                       klm_anchor h_anchor, float hpos,
+                       klm_anchor v_anchor, float vpos)
+{
+    klm_keyframe key = {
+        .duration = duration,
+        .flags = KLM_KEY_POSITION,
+        .easing = easing,
+        .h_anchor = h_anchor,
+        .v_anchor = v_anchor,
+        .hpos = hpos,
+        .vpos = vpos
+    };
+    klm_timeline_add_key(timeline, &key);
+}
+
+/** Add a keyframe which leaves everything as it is for duration ticks */
+void klm_timeline_hold(klm_timeline * const timeline, uint16_t duration) {
+    klm_keyframe key = { .duration = duration };
+    klm_timeline_add_key(timeline, &key);
+}
+
+/** Add a keyframe which shows or hides the segment, then holds for duration ticks */
+void klm_timeline_show(klm_timeline * const timeline, bool visible, uint16_t duration) {
+    klm_keyframe key = {
+        .duration = duration,
+        .flags = KLM_KEY_VISIBLE,
+        .visible = visible
+    };
+    klm_timeline_add_key(timeline, &key);
+}
+
+/** Add a keyframe which reverses the segment or not, then holds for duration ticks */
+void klm_timeline_reverse(klm_timeline * const timeline, bool reverse, uint16_t duration) {
+    klm_keyframe key = {
+        .duration = duration,
+        .flags = KLM_KEY_REVERSE,
+        .reverse = reverse
+    };
+    klm_timeline_add_key(timeline, &key);
+}
+
+/** Add a keyframe which sets the scroll speed and unpauses the segment, then runs for duration ticks */
+void klm_timeline_scroll(klm_timeline * const timeline, float hspeed, float vspeed, uint16_t duration) {
+    klm_keyframe key = {
+        .duration = duration,
+        .flags = KLM_KEY_SPEED | KLM_KEY_PAUSED,
+        .hspeed = hspeed,
+        .vspeed = vspeed,
+        .paused = false
+    };
+    klm_timeline_add_key(timeline, &key);
+}
+
+/** Add a keyframe which pauses or unpauses the segment's scrolling */
+void klm_timeline_pause(klm_timeline * const timeline, bool paused) {
+    klm_keyframe key = {
+        .flags = KLM_KEY_PAUSED,
+        .paused = paused
+    };
+    klm_timeline_add_key(timeline, &key);
+}
+
+/** Add a keyframe which changes the segment's text */
+void klm_timeline_text(klm_timeline * const timeline, const char * const text) {
+    klm_keyframe key = {
+        .flags = KLM_KEY_TEXT,
+        .text = (char *)text
+    };
+    klm_timeline_add_key(timeline, &key);
+}
+
+/** Go back to the first keyframe */
+void klm_timeline_reset(klm_timeline * const timeline) {
+    klm_segment * const seg = timeline->segment;
+    _klm_timeline_invalidate(timeline);
+
+    if (timeline->state.text_key < 0) {
+        // Remember the segment's own text, to go back to when rewinding
+        klm_timeline_set_base_text(timeline, seg->text);
+    }
+    else if (seg->timeline == timeline) {
+        klm_seg_set_text_ref(seg, timeline->_base_text);
+    }
+
+    memset(&timeline->state, 0, sizeof(timeline->state));
+    timeline->state.text_key = -1;
+}
+
+/** Advance by one tick, called by the segment's tick */
+void klm_timeline_tick(klm_timeline * const timeline) {
+    klm_timeline_state * const state = &timeline->state;
+    if (state->finished || timeline->_key_count == 0) {
+        return;
+    }
+
+    // Keyframes which take no time all happen in this tick, up to the next
+    // one which does, but only go round the timeline once
+    klm_keyframe *key = NULL;
+    uint16_t i;
+    for (i=0; i<=timeline->_key_count; i++) {
+        key = &timeline->_keys[state->key];
+        if (state->tick == 0) {
+            _klm_timeline_start_key(timeline, key);
+        }
+        if (key->duration > 0) {
+            break;
+        }
+        if (!_klm_timeline_next_key(timeline)) {
+            return;
+        }
+    }
+    if (key->duration == 0) {
+        return;
+    }
+
+    state->tick++;
+    if (key->flags & KLM_KEY_POSITION) {
+        klm_segment * const seg = timeline->segment;
+        float t = _klm_timeline_ease(key->easing, (float)state->tick / key->duration);
+        seg->text_hpos = state->from_hpos + (state->to_hpos - state->from_hpos) * t;
+        seg->text_vpos = state->from_vpos + (state->to_vpos - state->from_vpos) * t;
+    }
+
+    if (state->tick >= key->duration) {
+        _klm_timeline_next_key(timeline);
+    }
+}
+
+/** The segment's text was set from outside, keep a copy to rewind to until the next text keyframe */
+void klm_timeline_set_base_text(klm_timeline * const timeline, const char * const text) {
+#ifdef KLM_STATIC
+    // One buffer for good, so that changing the text doesn't use up the arena
+    if (timeline->_base_text == NULL) {
+        timeline->_base_text = klm_malloc(KLM_TEXT_BYTES);
+    }
+    strncpy(timeline->_base_text, text, KLM_TEXT_BYTES - 1);
+    timeline->_base_text[KLM_TEXT_BYTES - 1] = '\0';
+#else
+    char * const copy = klm_strdup(text);
+    klm_free(timeline->_base_text);
+    timeline->_base_text = copy;
+#endif
+    timeline->state.text_key = -1;
+}
+
+/** Rewind to a saved state, called when frames rendered ahead are dropped */
+void klm_timeline_restore(klm_timeline * const timeline, const klm_timeline_state * const state) {
+    // Only the text needs putting back, everything else is in the segment's own state
+    if (state->text_key != timeline->state.text_key) {
+        klm_seg_set_text_ref(timeline->segment,
+                             (state->text_key < 0) ?
+                                timeline->_base_text :
+                                timeline->_keys[state->text_key].text);
+    }
+    timeline->state = *state;
+}
+
+static void _klm_timeline_start_key(klm_timeline * const timeline, klm_keyframe * const key) {
+    klm_segment * const seg = timeline->segment;
+    klm_timeline_state * const state = &timeline->state;
+
+    // The text goes first, so that positions are worked out from its new size
+    if (key->flags & KLM_KEY_TEXT) {
+        klm_seg_set_text_ref(seg, key->text ? key->text : "");
+        state->text_key = state->key;
+    }
+    if (key->flags & KLM_KEY_VISIBLE) {
+        seg->visible = key->visible;
+    }
+    if (key->flags & KLM_KEY_REVERSE) {
+        seg->reverse = key->reverse;
+    }
+    if (key->flags & KLM_KEY_PAUSED) {
+        seg->paused = key->paused;
+    }
+    if (key->flags & KLM_KEY_SPEED) {
+        seg->text_hspeed = key->hspeed;
+        seg->text_vspeed = key->vspeed;
+    }
+
+    if (key->flags & KLM_KEY_POSITION) {
+        state->from_hpos = seg->text_hpos;
+        state->from_vpos = seg->text_vpos;
+        state->to_hpos = _klm_timeline_resolve(key->h_anchor, key->hpos, seg->text_hpos,
+                                               seg->width, seg->_text_pixel_width);
+        state->to_vpos = _klm_timeline_resolve(key->v_anchor, key->vpos, seg->text_vpos,
+                                               seg->height, seg->_text_pixel_height);
+        if (key->duration == 0) {
+            seg->text_hpos = state->to_hpos;
+            seg->text_vpos = state->to_vpos;
+        }
+    }
+    seg->_dirty = true;
+}
+
+static bool _klm_timeline_next_key(klm_timeline * const timeline) {
+    klm_timeline_state * const state = &timeline->state;
+
+    state->tick = 0;
+    state->key++;
+    if (state->key == timeline->_key_count) {
+        state->key = 0;
+        state->loop++;
+        if (timeline->repeat != KLM_TIMELINE_LOOP && state->loop >= timeline->repeat) {
+            state->finished = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+static float _klm_timeline_resolve(klm_anchor anchor, float pos, float current,
+                                   uint16_t size, uint16_t text_size)
+{
+    switch (anchor) {
+        case KLM_ANCHOR_CURRENT:
+            return current + pos;
+        case KLM_ANCHOR_CENTRE:
+            // The same as klm_seg_center_text
+            return -(text_size/2 - size/2) + pos;
+        case KLM_ANCHOR_BEFORE:
+            return -text_size + pos;
+        case KLM_ANCHOR_AFTER:
+            return size + pos;
+        case KLM_ANCHOR_START:
+        default:
+            return pos;
+    }
+}
+
+static float _klm_timeline_ease(klm_easing easing, float t) {
+    switch (easing) {
+        case KLM_EASE_IN:
+            return t*t;
+        case KLM_EASE_OUT:
+            return t*(2 - t);
+        case KLM_EASE_IN_OUT:
+            return (t < 0.5f) ? 2*t*t : -1 + (4 - 2*t)*t;
+        case KLM_EASE_STEP:
+            return (t < 1) ? 0 : 1;
+        case KLM_EASE_LINEAR:
+        default:
+            return t;
+    }
+}
+
+static void _klm_timeline_invalidate(klm_timeline * const timeline) {
+    // Changing the timeline that is playing changes the frames to come
+    if (timeline->segment->timeline == timeline) {
+        klm_mat_invalidate_frames(timeline->segment->matrix);
+    }
+}
@@ -0,0 +1,362 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "klm_transition.h"
+#include "klm_alloc.h"
+
+// Symbolic constants
+#define KLM_BYTE_WIDTH 8
+#define KLM_TRANSITION_WORD_BYTES 4
+#define KLM_TRANSITION_WORD_BITS 32
+#define KLM_TRANSITION_SCRAMBLE_ROUNDS 3
+#define KLM_TRANSITION_SCRAMBLE_MULTIPLIER 0x2C1B3C6D
+
+static void _klm_transition_make_dissolve(klm_transition * const transition);
+static uint32_t _klm_transition_scramble(uint32_t x, uint8_t bits);
+static void _klm_transition_slide_h(klm_transition * const transition,
+                                    const uint8_t * const from, int32_t from_shift,
+                                    const uint8_t * const to, int32_t to_shift,
+                                    uint8_t * const dst);
+static void _klm_transition_copy_rows(klm_transition * const transition,
+                                      uint8_t * const dst, uint16_t dst_y,
+                                      const uint8_t * const src, uint16_t src_y,
+                                      uint16_t rows);
+static void _klm_transition_wipe_h(klm_transition * const transition,
+                                   const uint8_t * const from,
+                                   const uint8_t * const to,
+                                   uint8_t * const dst,
+                                   uint16_t x0, uint16_t x1);
+static void _klm_transition_dissolve(klm_transition * const transition,
+                                     const uint8_t * const from,
+                                     const uint8_t * const to,
+                                     uint8_t * const dst,
+                                     uint16_t level);
+static uint32_t _klm_transition_get_word(const uint8_t * const row, int32_t len, int32_t bit);
+static inline uint32_t _klm_transition_load(const uint8_t * const buf, int32_t len, int32_t i);
+static inline void _klm_transition_store(uint8_t * const buf, int32_t len, int32_t i, uint32_t v);
+
+
+/** Create a transition between frames of the given size */
+klm_transition * const klm_transition_create(uint16_t width, uint16_t height) {
+    // Allocate memory for the transition structure and initialize all members
+    klm_transition * const transition = klm_malloc(sizeof(klm_transition));
+
+    transition->width = width;
+    transition->height = height;
+    transition->type = KLM_TRANSITION_SLIDE_LEFT;
+    transition->duration = 0;
+    transition->tick = 0;
+
+    transition->_row_width = width / KLM_BYTE_WIDTH;
+    transition->_buffer_len = (size_t)transition->_row_width * height;
+    transition->from = klm_calloc(transition->_buffer_len, 1);
+    transition->_frame = klm_calloc(transition->_buffer_len, 1);
+    transition->_row_mask = klm_calloc(transition->_row_width, 1);
+    transition->_dissolve =
+        klm_calloc(KLM_TRANSITION_DISSOLVE_BITS * transition->_buffer_len, 1);
+    _klm_transition_make_dissolve(transition);
+
+    return transition;
+}
+
+/** Clean up a transition */
+void klm_transition_destroy(klm_transition * const transition) {
+    klm_free(transition->_dissolve);
+    klm_free(transition->_row_mask);
+    klm_free(transition->_frame);
+    klm_free(transition->from);
+    klm_free(transition);
+}
+
+/** Start a transition away from a copy of the given frame, lasting duration ticks */
+void klm_transition_start(klm_transition * const transition,
+                          klm_transition_type type,
+                          uint16_t duration,
+                          const uint8_t * const from)
+{
+    memcpy(transition->from, from, transition->_buffer_len);
+    transition->type = type;
+    transition->duration = duration;
+    transition->tick = 0;
+}
+
+/** Compose the frame tick ticks into the transition from one frame to another into dst, which mustn't be either of them */
+void klm_transition_compose(klm_transition * const transition,
+                            const uint8_t * const from,
+                            const uint8_t * const to,
+                            uint8_t * const dst,
+                            uint16_t tick)
+{
+    if (tick >= transition->duration) {
+        memcpy(dst, to, transition->_buffer_len);
+        return;
+    }
+
+    // How far the edge has moved, in pixels or rows
+    const uint16_t w = transition->width;
+    const uint16_t h = transition->height;
+    const uint16_t dx = (uint32_t)w * tick / transition->duration;
+    const uint16_t dy = (uint32_t)h * tick / transition->duration;
+
+    switch (transition->type) {
+        case KLM_TRANSITION_SLIDE_LEFT:
+            _klm_transition_slide_h(transition, from, dx, to, dx - w, dst);
+            break;
+        case KLM_TRANSITION_SLIDE_RIGHT:
+            _klm_transition_slide_h(transition, from, -dx, to, w - dx, dst);
+            break;
+        case KLM_TRANSITION_SLIDE_UP:
+            _klm_transition_copy_rows(transition, dst, 0, from, dy, h - dy);
+            _klm_transition_copy_rows(transition, dst, h - dy, to, 0, dy);
+            break;
+        case KLM_TRANSITION_SLIDE_DOWN:
+            _klm_transition_copy_rows(transition, dst, 0, to, h - dy, dy);
+            _klm_transition_copy_rows(transition, dst, dy, from, 0, h - dy);
+            break;
+        case KLM_TRANSITION_WIPE_LEFT:
+            _klm_transition_wipe_h(transition, from, to, dst, w - dx, w);
+            break;
+        case KLM_TRANSITION_WIPE_RIGHT:
+            _klm_transition_wipe_h(transition, from, to, dst, 0, dx);
+            break;
+        case KLM_TRANSITION_WIPE_UP:
+            _klm_transition_copy_rows(transition, dst, 0, from, 0, h - dy);
+            _klm_transition_copy_rows(transition, dst, h - dy, to, h - dy, dy);
+            break;
+        case KLM_TRANSITION_WIPE_DOWN:
+            _klm_transition_copy_rows(transition, dst, 0, to, 0, dy);
+            _klm_transition_copy_rows(transition, dst, dy, from, dy, h - dy);
+            break;
+        case KLM_TRANSITION_DISSOLVE:
+            _klm_transition_dissolve(transition, from, to, dst,
+                                     (uint32_t)KLM_TRANSITION_DISSOLVE_LEVELS * tick / transition->duration);
+            break;
+    }
+}
+
+/** Advance the transition, and compose its next frame in place of *frame, by swapping buffers */
+void klm_transition_tick(klm_transition * const transition, uint8_t ** const frame) {
+    if (!klm_transition_is_active(transition)) {
+        return;
+    }
+
+    // The last tick is just the new frame, as it is
+    transition->tick++;
+    if (!klm_transition_is_active(transition)) {
+        return;
+    }
+
+    klm_transition_compose(transition, transition->from, *frame, transition->_frame, transition->tick);
+
+    uint8_t *tmp = *frame;
+    *frame = transition->_frame;
+    transition->_frame = tmp;
+}
+
+static void _klm_transition_make_dissolve(klm_transition * const transition) {
+    const uint32_t pixels = (uint32_t)transition->width * transition->height;
+
+    // Enough bits to number every pixel
+    uint8_t bits = 1;
+    while (bits < KLM_TRANSITION_WORD_BITS && (1UL << bits) < pixels) {
+        bits++;
+    }
+
+    // Shuffle the pixels by scrambling their indices, walking round any
+    // which land past the end, then spread the shuffled order evenly over
+    // the levels so that each tick changes over the same number of pixels
+    uint32_t p;
+    for (p=0; p<pixels; p++) {
+        uint32_t order = _klm_transition_scramble(p, bits);
+        while (order >= pixels) {
+            order = _klm_transition_scramble(order, bits);
+        }
+
+        uint32_t level = (uint64_t)order * KLM_TRANSITION_DISSOLVE_LEVELS / pixels;
+        uint8_t b;
+        for (b=0; b<KLM_TRANSITION_DISSOLVE_BITS; b++) {
+            if (level & (1 << b)) {
+                transition->_dissolve[b*transition->_buffer_len + p/KLM_BYTE_WIDTH] |=
+                    (1 << (p % KLM_BYTE_WIDTH));
+            }
+        }
+    }
+}
+
+/** A bijection on numbers of the given number of bits */
+static uint32_t _klm_transition_scramble(uint32_t x, uint8_t bits) {
+    const uint32_t mask = (bits >= KLM_TRANSITION_WORD_BITS) ? 0xFFFFFFFF : ((1UL << bits) - 1);
+    uint8_t round;
+    for (round=0; round<KLM_TRANSITION_SCRAMBLE_ROUNDS; round++) {
+        x = (x*KLM_TRANSITION_SCRAMBLE_MULTIPLIER + KLM_TRANSITION_DISSOLVE_SEED) & mask;
+        x ^= x >> ((bits + 1) / 2);
+    }
+    return x;
+}
+
+/** Each row is the from row shifted along by from_shift pixels, over the to row shifted by to_shift */
+static void _klm_transition_slide_h(klm_transition * const transition,
+                                    const uint8_t * const from, int32_t from_shift,
+                                    const uint8_t * const to, int32_t to_shift,
+                                    uint8_t * const dst)
+{
+    const int32_t len = transition->_row_width;
+    uint16_t y;
+    for (y=0; y<transition->height; y++) {
+        const size_t offset = (size_t)y*len;
+        int32_t i;
+        for (i=0; i<len; i+=KLM_TRANSITION_WORD_BYTES) {
+            // Pixels shifted in from past either end are unlit, so the two just OR together
+            const int32_t bit = i*KLM_BYTE_WIDTH;
+            _klm_transition_store(dst + offset, len, i,
+                                  _klm_transition_get_word(from + offset, len, bit + from_shift) |
+                                  _klm_transition_get_word(to + offset, len, bit + to_shift));
+        }
+    }
+}
+
+static void _klm_transition_copy_rows(klm_transition * const transition,
+                                      uint8_t * const dst, uint16_t dst_y,
+                                      const uint8_t * const src, uint16_t src_y,
+                                      uint16_t rows)
+{
+    memcpy(dst + (size_t)dst_y*transition->_row_width,
+           src + (size_t)src_y*transition->_row_width,
+           (size_t)rows*transition->_row_width);
+}
+
+/** The to frame between columns x0 and x1, the from frame elsewhere */
+static void _klm_transition_wipe_h(klm_transition * const transition,
+                                   const uint8_t * const from,
+                                   const uint8_t * const to,
+                                   uint8_t * const dst,
+                                   uint16_t x0, uint16_t x1)
+{
+    const int32_t len = transition->_row_width;
+
+    // Every row has the same mask
+    int32_t i;
+    for (i=0; i<len; i++) {
+        int32_t lo = (int32_t)x0 - i*KLM_BYTE_WIDTH;
+        int32_t hi = (int32_t)x1 - i*KLM_BYTE_WIDTH;
+        lo = (lo < 0) ? 0 : (lo > KLM_BYTE_WIDTH) ? KLM_BYTE_WIDTH : lo;
+        hi = (hi < 0) ? 0 : (hi > KLM_BYTE_WIDTH) ? KLM_BYTE_WIDTH : hi;
+        transition->_row_mask[i] = ((1 << hi) - 1) & ~((1 << lo) - 1);
+    }
+
+    uint16_t y;
+    for (y=0; y<transition->height; y++) {
+        const size_t offset = (size_t)y*len;
+        for (i=0; i<len; i+=KLM_TRANSITION_WORD_BYTES) {
+            const uint32_t mask = _klm_transition_load(transition->_row_mask, len, i);
+            _klm_transition_store(dst + offset, len, i,
+                                  (_klm_transition_load(to + offset, len, i) & mask) |
+                                  (_klm_transition_load(from + offset, len, i) & ~mask));
+        }
+    }
+}
+
+/** The to frame wherever a pixel's level is below the given level, the from frame elsewhere */
+static void _klm_transition_dissolve(klm_transition * const transition,
+                                     const uint8_t * const from,
+                                     const uint8_t * const to,
+                                     uint8_t * const dst,
+                                     uint16_t level)
+{
+    const int32_t len = transition->_buffer_len;
+    int32_t i;
+    for (i=0; i<len; i+=KLM_TRANSITION_WORD_BYTES) {
+        // Compare 32 levels at once, a bit at a time from the top: below is
+        // settled by the first bit which differs, while the rest are equal
+        uint32_t below = 0;
+        uint32_t equal = 0xFFFFFFFF;
+        int8_t b;
+        for (b=KLM_TRANSITION_DISSOLVE_BITS-1; b>=0; b--) {
+            const uint32_t plane = _klm_transition_load(transition->_dissolve + b*len, len, i);
+            if (level & (1 << b)) {
+                below |= equal & ~plane;
+                equal &= plane;
+            }
+            else {
+                equal &= ~plane;
+            }
+        }
+
+        _klm_transition_store(dst, len, i,
+                              (_klm_transition_load(to, len, i) & below) |
+                              (_klm_transition_load(from, len, i) & ~below));
+    }
+}
+
+/** The 32 pixels of a row starting at the given pixel, which may be off either end */
+static uint32_t _klm_transition_get_word(const uint8_t * const row, int32_t len, int32_t bit) {
+    // Round down, towards minus infinity
+    const int32_t i = (bit >= 0) ?
+                        bit / KLM_BYTE_WIDTH :
+                        -((-bit + KLM_BYTE_WIDTH - 1) / KLM_BYTE_WIDTH);
+    const uint8_t shift = bit - i*KLM_BYTE_WIDTH;
+
+    const uint64_t v =
+        (uint64_t)_klm_transition_load(row, len, i) |
+        ((uint64_t)_klm_transition_load(row, len, i + KLM_TRANSITION_WORD_BYTES) << KLM_TRANSITION_WORD_BITS);
+    return (uint32_t)(v >> shift);
+}
+
+/** Load 4 bytes as a little endian word, so bit n is pixel n. Bytes outside the buffer read as 0 */
+static inline uint32_t _klm_transition_load(const uint8_t * const buf, int32_t len, int32_t i) {
+    if (i >= 0 && i + KLM_TRANSITION_WORD_BYTES <= len) {
+        return (uint32_t)buf[i] |
+               ((uint32_t)buf[i + 1] << 8) |
+               ((uint32_t)buf[i + 2] << 16) |
+               ((uint32_t)buf[i + 3] << 24);
+    }
+
+    uint32_t v = 0;
+    uint8_t b;
+    for (b=0; b<KLM_TRANSITION_WORD_BYTES; b++) {
+        if (i + b >= 0 && i + b < len) {
+            v |= (uint32_t)buf[i + b] << (b*KLM_BYTE_WIDTH);
+        }
+    }
+    return v;
+}
+
+/** Store a little endian word, dropping any bytes outside the buffer */
+static inline void _klm_transition_store(uint8_t * const buf, int32_t len, int32_t i, uint32_t v) {
+    if (i >= 0 && i + KLM_TRANSITION_WORD_BYTES <= len) {
+        buf[i] = (uint8_t)v;
+        buf[i + 1] = (uint8_t)(v >> 8);
+        buf[i + 2] = (uint8_t)(v >> 16);
+        buf[i + 3] = (uint8_t)(v >> 24);
+        return;
+    }
+
+    uint8_t b;
+    for (b=0; b<KLM_TRANSITION_WORD_BYTES; b++) {
+        if (i + b >= 0 && i + b < len) {
+            buf[i + b] = (uint8_t)(v >> (b*KLM_BYTE_WIDTH));
+        }
+    }
+}
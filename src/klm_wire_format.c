@@ -0,0 +1,167 @@
+/**
+ * Konker's LED matrix library
+ *
+ * A library for driving a red LED matrix
+ *
+ * Copyright 2015, Konrad Markus <konker@luxvelocitas.com>
+ *
+ * This file is part of konker_led_matrix.
+ *
+ * konker_led_matrix is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * konker_led_matrix is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with konker_led_matrix.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "klm_wire_format.h"
+
+// Symbolic constants
+#define KLM_BYTE_WIDTH 8
+
+// Lookup table to reverse the bits of a byte
+#define R2(n) n, n + 2*64, n + 1*64, n + 3*64
+#define R4(n) R2(n), R2(n + 2*16), R2(n + 1*16), R2(n + 3*16)
+#define R6(n) R4(n), R4(n + 2*4 ), R4(n + 1*4 ), R4(n + 3*4 )
+static const uint8_t _klm_wire_bit_reverse[256] = { R6(0), R6(2), R6(1), R6(3) };
+
+static void _klm_wire_encode_transposed(const klm_wire_format * const format,
+                                        const uint8_t * const src,
+                                        uint8_t * const dst,
+                                        uint16_t width,
+                                        uint16_t height);
+static inline uint64_t _klm_wire_transpose8(uint64_t x);
+
+
+/** Turn and mirror the picture to suit how the panel is mounted, on top of the panel's own wiring */
+bool klm_wire_set_orientation(klm_wire_format * const format,
+                              klm_rotation rotation,
+                              bool mirror_x,
+                              bool mirror_y,
+                              uint16_t height)
+{
+    format->transpose = (rotation == KLM_ROTATE_90 || rotation == KLM_ROTATE_270);
+    if (format->transpose && height % KLM_BYTE_WIDTH != 0) {
+        format->transpose = false;
+        return false;
+    }
+
+    // A half turn is a mirror both ways. Transposing turns a quarter turn
+    // clockwise and mirrors left to right, or anticlockwise and top to bottom
+    if (mirror_x ^ (rotation == KLM_ROTATE_90 || rotation == KLM_ROTATE_180)) {
+        format->reverse_bytes = !format->reverse_bytes;
+        format->reverse_bits = !format->reverse_bits;
+    }
+    if (mirror_y ^ (rotation == KLM_ROTATE_180 || rotation == KLM_ROTATE_270)) {
+        format->reverse_rows = !format->reverse_rows;
+    }
+    return true;
+}
+
+/** Encode a 1bpp frame buffer into the given wire format */
+void klm_wire_encode(const klm_wire_format * const format,
+                     const uint8_t * const src,
+                     uint8_t * const dst,
+                     uint16_t width,
+                     uint16_t height)
+{
+    if (format->transpose) {
+        _klm_wire_encode_transposed(format, src, dst, width, height);
+        return;
+    }
+
+    const uint16_t row_width = width / KLM_BYTE_WIDTH;
+    const uint16_t addresses = klm_wire_get_address_count(format, width, height);
+    const uint8_t xor_mask = format->invert ? 0xFF : 0x00;
+
+    uint8_t *out = dst;
+    uint16_t address, k, x8;
+    for (address=0; address<addresses; address++) {
+        for (k=0; k<format->interleave; k++) {
+            // Work out which buffer row is shifted out at this point
+            uint16_t row = address + k*addresses;
+            if (format->reverse_rows) {
+                row = height - 1 - row;
+            }
+            const uint8_t *in = src + row*row_width;
+
+            for (x8=0; x8<row_width; x8++) {
+                uint8_t pixel8 =
+                    in[format->reverse_bytes ? (row_width - 1 - x8) : x8];
+
+                if (format->reverse_bits) {
+                    pixel8 = _klm_wire_bit_reverse[pixel8];
+                }
+                *out++ = pixel8 ^ xor_mask;
+            }
+        }
+    }
+}
+
+/** Encode with the buffer's columns as the panel's rows, 8x8 pixels at a time */
+static void _klm_wire_encode_transposed(const klm_wire_format * const format,
+                                        const uint8_t * const src,
+                                        uint8_t * const dst,
+                                        uint16_t width,
+                                        uint16_t height)
+{
+    // The panel is height pixels wide and width pixels high
+    const uint16_t row_width = width / KLM_BYTE_WIDTH;
+    const uint16_t panel_row_width = height / KLM_BYTE_WIDTH;
+    const uint16_t addresses = klm_wire_get_address_count(format, width, height);
+    const uint8_t xor_mask = format->invert ? 0xFF : 0x00;
+
+    size_t out[KLM_BYTE_WIDTH];
+    uint16_t x8, y8, i;
+    for (x8=0; x8<row_width; x8++) {
+        // Eight buffer columns make eight panel rows, find where each is sent
+        for (i=0; i<KLM_BYTE_WIDTH; i++) {
+            uint16_t row = x8*KLM_BYTE_WIDTH + i;
+            if (format->reverse_rows) {
+                row = width - 1 - row;
+            }
+            out[i] = ((size_t)(row % addresses)*format->interleave + row / addresses) *
+                        panel_row_width;
+        }
+
+        for (y8=0; y8<panel_row_width; y8++) {
+            // Gather an 8x8 block, a byte from each of eight buffer rows
+            const uint8_t *in = src + (size_t)y8*KLM_BYTE_WIDTH*row_width + x8;
+            uint64_t block = 0;
+            for (i=0; i<KLM_BYTE_WIDTH; i++) {
+                block |= (uint64_t)in[i*row_width] << (i*KLM_BYTE_WIDTH);
+            }
+            block = _klm_wire_transpose8(block);
+
+            const uint16_t column = format->reverse_bytes ? (panel_row_width - 1 - y8) : y8;
+            for (i=0; i<KLM_BYTE_WIDTH; i++) {
+                uint8_t pixel8 = (uint8_t)(block >> (i*KLM_BYTE_WIDTH));
+                if (format->reverse_bits) {
+                    pixel8 = _klm_wire_bit_reverse[pixel8];
+                }
+                dst[out[i] + column] = pixel8 ^ xor_mask;
+            }
+        }
+    }
+}
+
+/** Transpose an 8x8 bit matrix held a row per byte, in three rounds of block swaps */
+static inline uint64_t _klm_wire_transpose8(uint64_t x) {
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x ^= t ^ (t << 28);
+    return x;
+}